@@ -0,0 +1,263 @@
+#include "fpu.h"
+#include "process.h"
+#include "heap.h"
+#include "kstring.h"
+#include "panic.h"
+#include "preempt.h"
+#include "debug.h"
+
+// CR0/CR4 bits
+#define CR0_MP        (1ULL << 1)   // Monitor coprocessor (WAIT honors TS)
+#define CR0_EM        (1ULL << 2)   // Emulation (must be clear)
+#define CR0_TS        (1ULL << 3)   // Task switched (FPU access traps with #NM)
+#define CR4_OSFXSR    (1ULL << 9)   // Enable fxsave/fxrstor and SSE
+#define CR4_OSXMMEXCPT (1ULL << 10) // Enable SSE exceptions
+#define CR4_OSXSAVE   (1ULL << 18)  // Enable xsave/xrstor and XCR0
+
+// XCR0 feature bits
+#define XFEATURE_X87       (1ULL << 0)
+#define XFEATURE_SSE       (1ULL << 1)
+#define XFEATURE_AVX       (1ULL << 2)
+#define XFEATURE_OPMASK    (1ULL << 5)
+#define XFEATURE_ZMM_HI256 (1ULL << 6)
+#define XFEATURE_HI16_ZMM  (1ULL << 7)
+#define XFEATURE_AVX512    (XFEATURE_OPMASK | XFEATURE_ZMM_HI256 | XFEATURE_HI16_ZMM)
+
+#define FXSAVE_SIZE        512
+#define FPU_STATE_MAX      4096   // Upper bound we are willing to allocate
+#define FPU_STATE_ALIGN    64     // XSAVE requires 64-byte alignment
+
+enum FpuMode {
+    FPU_MODE_FXSAVE,
+    FPU_MODE_XSAVE,
+    FPU_MODE_XSAVEOPT
+};
+
+static FpuMode fpu_mode = FPU_MODE_FXSAVE;
+static size_t fpu_state_size = FXSAVE_SIZE;
+static uint64_t fpu_xcr0 = 0;
+
+// Pristine register image loaded on a task's first FPU instruction
+__attribute__((aligned(FPU_STATE_ALIGN)))
+static uint8_t fpu_init_image[FPU_STATE_MAX];
+
+// Task whose state is currently live in the FPU registers
+static Process* fpu_owner = nullptr;
+static bool ts_set = false;
+static uint64_t restore_count = 0;
+
+// kernel_fpu_begin() nesting
+static uint32_t kernel_fpu_depth = 0;
+
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(subleaf));
+}
+
+static inline void clts() {
+    asm volatile("clts" ::: "memory");
+    ts_set = false;
+}
+
+static inline void stts() {
+    uint64_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" :: "r"(cr0 | CR0_TS) : "memory");
+    ts_set = true;
+}
+
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    asm volatile("xsetbv" :: "c"(index), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+// Save live registers into buf (TS must be clear)
+static void save_state(uint8_t* buf) {
+    switch (fpu_mode) {
+        case FPU_MODE_XSAVEOPT:
+            asm volatile("xsaveopt64 (%0)" :: "r"(buf), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+            break;
+        case FPU_MODE_XSAVE:
+            asm volatile("xsave64 (%0)" :: "r"(buf), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+            break;
+        default:
+            asm volatile("fxsave64 (%0)" :: "r"(buf) : "memory");
+            break;
+    }
+}
+
+// Load registers from buf (TS must be clear)
+static void restore_state(const uint8_t* buf) {
+    if (fpu_mode == FPU_MODE_FXSAVE) {
+        asm volatile("fxrstor64 (%0)" :: "r"(buf) : "memory");
+    } else {
+        asm volatile("xrstor64 (%0)" :: "r"(buf), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+    }
+}
+
+void fpu_init() {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    bool has_xsave = (ecx & (1 << 26)) != 0;
+    bool has_avx = (ecx & (1 << 28)) != 0;
+
+    uint64_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (has_xsave) cr4 |= CR4_OSXSAVE;
+    asm volatile("mov %0, %%cr4" :: "r"(cr4));
+
+    uint64_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(CR0_EM | CR0_TS);  // Don't emulate; no trap until a task switch
+    cr0 |= CR0_MP;
+    asm volatile("mov %0, %%cr0" :: "r"(cr0));
+
+    if (has_xsave) {
+        // Enable every component we know how to handle that the CPU supports
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        uint64_t supported = ((uint64_t)edx << 32) | eax;
+        uint64_t want = XFEATURE_X87 | XFEATURE_SSE;
+        if (has_avx) {
+            want |= XFEATURE_AVX;
+            if ((supported & XFEATURE_AVX512) == XFEATURE_AVX512) want |= XFEATURE_AVX512;
+        }
+        fpu_xcr0 = supported & want;
+        xsetbv(0, fpu_xcr0);
+
+        // EBX now reports the area size for the features enabled in XCR0
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        if (ebx <= FPU_STATE_MAX) {
+            fpu_state_size = ebx;
+            cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+            fpu_mode = (eax & 1) ? FPU_MODE_XSAVEOPT : FPU_MODE_XSAVE;
+        } else {
+            // Unexpectedly large area - fall back to legacy x87/SSE only
+            fpu_xcr0 = XFEATURE_X87 | XFEATURE_SSE;
+            xsetbv(0, fpu_xcr0);
+        }
+    }
+
+    // Capture the reset state once; every task starts from this image
+    asm volatile("fninit");
+    uint32_t mxcsr = 0x1F80;  // Default MXCSR: mask all exceptions
+    asm volatile("ldmxcsr %0" :: "m"(mxcsr));
+    kstring::memset(fpu_init_image, 0, sizeof(fpu_init_image));
+    if (fpu_mode == FPU_MODE_FXSAVE) {
+        asm volatile("fxsave64 (%0)" :: "r"(fpu_init_image) : "memory");
+    } else {
+        // Plain xsave: xsaveopt may skip components in their init state
+        asm volatile("xsave64 (%0)" :: "r"(fpu_init_image), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+    }
+}
+
+void fpu_switch(Process* next) {
+    // Owner's registers are still live: no trap needed
+    if (next == fpu_owner) {
+        if (ts_set) clts();
+    } else if (!ts_set) {
+        stts();
+    }
+}
+
+void fpu_handle_nm() {
+    clts();
+
+    Process* cur = process_get_current();
+    if (!cur || cur == fpu_owner) return;
+
+    if (fpu_owner) {
+        save_state(fpu_owner->fpu_state);
+    }
+
+    if (!cur->fpu_state) {
+        cur->fpu_state = (uint8_t*)aligned_alloc(FPU_STATE_ALIGN, fpu_state_size);
+        if (!cur->fpu_state) {
+            panic("Out of memory allocating FPU state");
+        }
+        // XSAVE leaves the header's XCOMP_BV and reserved bytes alone, and
+        // XRSTOR faults if they are not zero
+        kstring::memcpy(cur->fpu_state, fpu_init_image, fpu_state_size);
+    }
+
+    if (cur->fpu_used) {
+        restore_state(cur->fpu_state);
+    } else {
+        restore_state(fpu_init_image);
+        cur->fpu_used = true;
+    }
+
+    fpu_owner = cur;
+    restore_count++;
+}
+
+bool fpu_fork(Process* child, Process* parent) {
+    child->fpu_state = nullptr;
+    child->fpu_used = false;
+    if (!parent->fpu_used) return true;
+
+    child->fpu_state = (uint8_t*)aligned_alloc(FPU_STATE_ALIGN, fpu_state_size);
+    if (!child->fpu_state) return false;
+    kstring::memcpy(child->fpu_state, fpu_init_image, fpu_state_size);  // Valid XSAVE header
+
+    // Parent's freshest state may only exist in the registers
+    if (fpu_owner == parent) {
+        bool was_set = ts_set;
+        clts();
+        save_state(parent->fpu_state);
+        if (was_set) stts();
+    }
+
+    kstring::memcpy(child->fpu_state, parent->fpu_state, fpu_state_size);
+    child->fpu_used = true;
+    return true;
+}
+
+void fpu_release(Process* p) {
+    if (fpu_owner == p) fpu_owner = nullptr;
+    if (p->fpu_state) {
+        aligned_free(p->fpu_state);
+        p->fpu_state = nullptr;
+    }
+    p->fpu_used = false;
+}
+
+bool kernel_fpu_usable() {
+    return !in_interrupt();
+}
+
+void kernel_fpu_begin() {
+    preempt_disable();
+    if (kernel_fpu_depth++ > 0) return;
+
+    if (ts_set) clts();
+    if (fpu_owner) {
+        save_state(fpu_owner->fpu_state);
+        fpu_owner = nullptr;
+    }
+}
+
+void kernel_fpu_end() {
+    // No owner now: the next user FPU instruction traps and reloads
+    if (--kernel_fpu_depth == 0) stts();
+    preempt_enable();
+}
+
+const char* fpu_get_mode_name() {
+    switch (fpu_mode) {
+        case FPU_MODE_XSAVEOPT: return "xsaveopt";
+        case FPU_MODE_XSAVE:    return "xsave";
+        default:                return "fxsave";
+    }
+}
+
+size_t fpu_get_state_size() {
+    return fpu_state_size;
+}
+
+uint64_t fpu_get_xcr0() {
+    return fpu_xcr0;
+}
+
+uint64_t fpu_get_restore_count() {
+    return restore_count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+struct Process;
+
+// ============================================================================
+// Lazy FPU/SSE/AVX Context Switching
+// ============================================================================
+// The kernel is built with -mno-sse. Apart from the SSE copies in the
+// graphics driver, which bracket themselves with kernel_fpu_begin/end,
+// only user programs touch the FPU. Instead of saving/restoring extended
+// state on every context switch, we set CR0.TS when switching to a task
+// that doesn't own the live FPU registers. Its first FPU instruction
+// raises #NM (vector 7); the handler saves the previous owner's state and
+// loads the current task's state.
+//
+// State is saved with XSAVEOPT (skips unmodified components), XSAVE, or
+// FXSAVE depending on CPU support. With XSAVE, AVX (and AVX-512 when present)
+// state is enabled in XCR0 so user programs can use it.
+// ============================================================================
+
+// Detect FPU features and program CR0/CR4/XCR0 (call early, before heap)
+void fpu_init();
+
+// Called by the scheduler before switching to `next`
+void fpu_switch(Process* next);
+
+// #NM (Device Not Available) handler
+void fpu_handle_nm();
+
+// Duplicate parent's FPU state into child (for fork). Returns false on OOM.
+bool fpu_fork(Process* child, Process* parent);
+
+// Drop a dead task's FPU state
+void fpu_release(Process* p);
+
+// Let kernel code use SSE registers until kernel_fpu_end(). The owner's
+// registers are saved first, and it reloads them on its next FPU
+// instruction. Preemption stays off in between; interrupts stay on, so
+// handlers must not touch SSE. Calls may nest.
+void kernel_fpu_begin();
+void kernel_fpu_end();
+
+// False in interrupt and softirq handlers, which may have interrupted a
+// kernel_fpu_begin() section; callers there take a non-SSE path instead
+bool kernel_fpu_usable();
+
+// Info for diagnostics
+const char* fpu_get_mode_name();      // "xsaveopt", "xsave" or "fxsave"
+size_t fpu_get_state_size();          // Bytes per saved context
+uint64_t fpu_get_xcr0();              // Enabled XSAVE features (0 if none)
+uint64_t fpu_get_restore_count();     // #NM traps that loaded a context
@@ -1,12 +1,16 @@
 #include "gdt.h"
 
 __attribute__((aligned(0x1000)))
-static struct gdt_entry gdt[7]; // Null, Kernel Code, Kernel Data, User Code, User Data, TSS (Low), TSS (High)
+static struct gdt_entry gdt[7]; // Null, Kernel Code, Kernel Data, User Data, User Code, TSS (Low), TSS (High)
 static struct gdt_descriptor gdtr;
 
 __attribute__((aligned(16)))
 static struct tss_entry tss;
 
+// Single CPU for now, so a single per-CPU block
+__attribute__((aligned(64)))
+static PerCpu percpu;
+
 // Stack for the TSS (Privilege level 0 stack)
 __attribute__((aligned(16)))
 static uint8_t tss_stack[4096];
@@ -32,6 +36,10 @@ void gdt_init() {
     // Setup IST1 for Double Fault handler (vector 8)
     // This provides a known-good stack even if the kernel stack is corrupted
     tss.ist1 = (uint64_t)&double_fault_stack[sizeof(double_fault_stack)];
+    
+    percpu.self = &percpu;
+    percpu.kernel_rsp = tss.rsp0;
+    percpu.user_rsp = 0;
 
     // Null descriptor (0x00)
     gdt[0] = {0, 0, 0, 0, 0, 0};
@@ -56,23 +64,23 @@ void gdt_init() {
         .base_high = 0
     };
 
-    // User Code (64-bit) - Selector 0x18 | 3 = 0x1B
+    // User Data (64-bit) - Selector 0x18 | 3 = 0x1B
     gdt[3] = {
         .limit_low = 0xFFFF,
         .base_low = 0,
         .base_middle = 0,
-        .access = 0xFA,      // Present, Ring3, Code, Readable
-        .granularity = 0xAF, // 64-bit
+        .access = 0xF2,      // Present, Ring3, Data, Writable
+        .granularity = 0xCF,
         .base_high = 0
     };
 
-    // User Data (64-bit) - Selector 0x20 | 3 = 0x23
+    // User Code (64-bit) - Selector 0x20 | 3 = 0x23
     gdt[4] = {
         .limit_low = 0xFFFF,
         .base_low = 0,
         .base_middle = 0,
-        .access = 0xF2,      // Present, Ring3, Data, Writable
-        .granularity = 0xCF,
+        .access = 0xFA,      // Present, Ring3, Code, Readable
+        .granularity = 0xAF, // 64-bit
         .base_high = 0
     };
 
@@ -104,4 +112,9 @@ void gdt_init() {
 // transitions use the correct kernel stack
 void tss_set_rsp0(uint64_t rsp0) {
     tss.rsp0 = rsp0;
+    percpu.kernel_rsp = rsp0;  // SYSCALL entry has no TSS stack switch
+}
+
+PerCpu* percpu_get() {
+    return &percpu;
 }
\ No newline at end of file
@@ -33,5 +33,24 @@ struct tss_entry {
     uint16_t iomap_base;
 } __attribute__((packed));
 
+// Segment selectors. User data sits below user code because SYSRET derives
+// both from one STAR base: SS = base + 8, CS = base + 16.
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_USER_DATA   0x1B    // 0x18 | RPL 3
+#define GDT_USER_CODE   0x23    // 0x20 | RPL 3
+#define GDT_TSS         0x28
+
+// Per-CPU block reached through GS on SYSCALL entry (swapgs loads it from
+// IA32_KERNEL_GS_BASE). Field offsets are hardcoded in interrupts.asm.
+struct PerCpu {
+    PerCpu* self;           // 0: Own address
+    uint64_t kernel_rsp;    // 8: Kernel stack top of the current task (= TSS rsp0)
+    uint64_t user_rsp;      // 16: Scratch slot for the user RSP during entry
+};
+
 void gdt_init();
 void tss_set_rsp0(uint64_t rsp0);
+
+// This CPU's per-CPU block
+PerCpu* percpu_get();
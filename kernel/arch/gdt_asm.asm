@@ -28,22 +28,22 @@ load_tss:
 ; Jump to user mode
 global jump_to_user_mode
 ; void jump_to_user_mode(uint64_t code, uint64_t stack, uint64_t entry)
-; RDI = user code selector (0x1B)
+; RDI = user code selector (0x23)
 ; RSI = user stack pointer
 ; RDX = entry point
 jump_to_user_mode:
-    mov ax, 0x23       ; User data segment (0x20 | 3)
+    mov ax, 0x1B       ; User data segment (0x18 | 3)
     mov ds, ax
     mov es, ax
     mov fs, ax
     mov gs, ax
     
     ; Build iretq frame
-    push 0x23          ; SS (user data)
+    push 0x1B          ; SS (user data)
     push rsi           ; RSP (user stack)
     pushfq             ; RFLAGS
     or qword [rsp], 0x200 ; Enable interrupts
-    push 0x1B          ; CS (user code = 0x18 | 3)
+    push 0x23          ; CS (user code = 0x20 | 3)
     push rdx           ; RIP (entry point)
     
     iretq
@@ -207,12 +207,21 @@ load_idt:
 
 ; Syscall handler (int 0x80)
 extern syscall_handler
+extern smap_enabled
 
 global isr128
 isr128:
     ; TODO: swapgs handling requires proper GS base initialization
     ; For now, skip it - user code doesn't need GS
 
+    ; User code can set RFLAGS.AC, which would open every user page to
+    ; the kernel under SMAP. SYSCALL clears it through FMASK; here it has
+    ; to be done by hand (clac is #UD without SMAP).
+    cmp byte [rel smap_enabled], 0
+    je .ac_clear
+    clac
+.ac_clear:
+
     ; Save callee-saved registers
     push rbx
     push rbp
@@ -222,18 +231,19 @@ isr128:
     push r15
     
     ; Linux x86-64 syscall convention:
-    ; User passes: RAX=syscall_num, RDI=arg1, RSI=arg2, RDX=arg3
-    ; C function expects: RDI=syscall_num, RSI=arg1, RDX=arg2, RCX=arg3
-    ; We need to shuffle without clobbering, use r10/r11 as temps
-    mov r10, rdi    ; save arg1
-    mov r11, rsi    ; save arg2
-    ; Now we can safely overwrite
-    mov rdi, rax    ; syscall_num = RAX
-    mov rsi, r10    ; arg1 = saved RDI
-    mov rcx, rdx    ; arg3 = RDX (before we clobber rdx)
-    mov rdx, r11    ; arg2 = saved RSI
+    ; User passes: RAX=syscall_num, RDI, RSI, RDX, R10, R8, R9 = arg1-arg6
+    ; C function expects: RDI=syscall_num, RSI, RDX, RCX, R8, R9 = arg1-arg5,
+    ; arg6 on the stack. Shifting from the top down needs no temporaries.
+    push r9         ; arg6 (stack argument)
+    mov r9, r8      ; arg5
+    mov r8, r10     ; arg4
+    mov rcx, rdx    ; arg3
+    mov rdx, rsi    ; arg2
+    mov rsi, rdi    ; arg1
+    mov rdi, rax    ; syscall_num
     
     call syscall_handler
+    add rsp, 8      ; Drop arg6
     
     ; RAX already has return value
     
@@ -248,3 +258,93 @@ isr128:
     iretq
 
 
+; =============================================================================
+; Fast syscall entry (SYSCALL instruction, MSR_LSTAR)
+; =============================================================================
+; The CPU has loaded kernel CS/SS from STAR, saved the user RIP in RCX and
+; RFLAGS in R11, and cleared IF through FMASK - but it has NOT switched
+; stacks. GS is borrowed just long enough to fetch the kernel stack from the
+; per-CPU block and is swapped straight back, so nothing else in the kernel
+; depends on which GS base is live.
+;
+; ABI (same as Linux): RAX = syscall number, RDI, RSI, RDX, R10, R8, R9 =
+; arg1-arg6. RAX returns the result; RCX and R11 are clobbered, every other
+; register is preserved.
+; =============================================================================
+PERCPU_KERNEL_RSP equ 8     ; Offsets into PerCpu (gdt.h)
+PERCPU_USER_RSP   equ 16
+
+USER_CODE_SEL equ 0x23      ; GDT_USER_CODE
+USER_DATA_SEL equ 0x1B      ; GDT_USER_DATA
+
+global syscall_entry
+syscall_entry:
+    swapgs
+    mov [gs:PERCPU_USER_RSP], rsp
+    mov rsp, [gs:PERCPU_KERNEL_RSP]
+    push qword [gs:PERCPU_USER_RSP]     ; User RSP
+    swapgs
+    
+    push r11            ; User RFLAGS
+    push rcx            ; User RIP
+    
+    ; Argument registers are preserved for the caller
+    push rdi
+    push rsi
+    push rdx
+    push r10
+    push r8
+    push r9
+    
+    ; Same shuffle as isr128; the 10th push leaves RSP 16-byte aligned
+    push r9             ; arg6 (stack argument)
+    mov r9, r8          ; arg5
+    mov r8, r10         ; arg4
+    mov rcx, rdx        ; arg3
+    mov rdx, rsi        ; arg2
+    mov rsi, rdi        ; arg1
+    mov rdi, rax        ; syscall_num
+    
+    call syscall_handler
+    add rsp, 8          ; Drop arg6
+    
+    ; A blocking syscall may come back with interrupts on; none may arrive
+    ; once RSP points at the user stack
+    cli
+    
+    ; SYSRET with a non-canonical RIP faults in ring 0 on Intel CPUs. Any
+    ; RIP outside the lower half takes the iretq path, which faults in ring 3.
+    mov rcx, [rsp + 48]
+    shr rcx, 47
+    jnz .slow_return
+    
+    pop r9
+    pop r8
+    pop r10
+    pop rdx
+    pop rsi
+    pop rdi
+    pop rcx             ; User RIP
+    pop r11             ; User RFLAGS
+    pop rsp             ; User RSP
+    o64 sysret
+
+.slow_return:
+    pop r9
+    pop r8
+    pop r10
+    pop rdx
+    pop rsi
+    pop rdi
+    pop rcx             ; User RIP
+    pop r11             ; User RFLAGS
+    
+    ; [rsp] = user RSP; build an iretq frame below it
+    push USER_DATA_SEL  ; SS
+    push qword [rsp + 8] ; RSP
+    push r11            ; RFLAGS
+    push USER_CODE_SEL  ; CS
+    push rcx            ; RIP
+    iretq
+
+
@@ -87,3 +87,31 @@ static inline void mmio_write64(volatile void* addr, uint64_t val) {
     *(volatile uint64_t*)addr = val;
     asm volatile("mfence" ::: "memory");
 }
+
+// Timestamp counter (monotonic cycle count on invariant-TSC CPUs)
+static inline uint64_t rdtsc() {
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// Model-specific registers
+#define MSR_EFER           0xC0000080  // Extended features (bit 0: SYSCALL enable)
+#define MSR_STAR           0xC0000081  // SYSCALL/SYSRET segment bases
+#define MSR_LSTAR          0xC0000082  // SYSCALL entry point (64-bit mode)
+#define MSR_FMASK          0xC0000084  // RFLAGS bits cleared on SYSCALL
+#define MSR_FS_BASE        0xC0000100  // User TLS base (used by %fs-relative loads)
+#define MSR_GS_BASE        0xC0000101  // Active GS base
+#define MSR_KERNEL_GS_BASE 0xC0000102  // GS base swapped in by swapgs
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    uint32_t low = (uint32_t)value;
+    uint32_t high = (uint32_t)(value >> 32);
+    asm volatile("wrmsr" : : "c"(msr), "a"(low), "d"(high));
+}
@@ -1,5 +1,6 @@
 global switch_to_task
-global init_fpu_state
+global kthread_start
+extern kthread_main
 
 section .text
 
@@ -8,12 +9,12 @@ section .text
 ; RSI = next process pointer
 ;
 ; Process struct offsets:
-;   fpu_state:    0    (512 bytes, 16-byte aligned)
-;   pid:          512
-;   parent_pid:   520
-;   name:         528  (32 bytes)
-;   cpu_time:     560
-;   sp:           568
+;   fpu_state:    0    (pointer, FPU state is switched lazily - see fpu.cpp)
+;   pid:          8
+;   parent_pid:   16
+;   name:         24   (32 bytes)
+;   cpu_time:     56
+;   sp:           64
 ;
 switch_to_task:
     ; Save current context - general purpose registers
@@ -25,18 +26,11 @@ switch_to_task:
     push r14
     push r15
     
-    ; Save RSP to current->sp (offset 568)
-    mov [rdi + 568], rsp
+    ; Save RSP to current->sp (offset 64)
+    mov [rdi + 64], rsp
     
-    ; Save FPU/SSE state to current->fpu_state (offset 0)
-    ; fxsave requires 16-byte aligned address
-    fxsave [rdi]
-    
-    ; Load RSP from next->sp (offset 568)
-    mov rsp, [rsi + 568]
-    
-    ; Restore FPU/SSE state from next->fpu_state (offset 0)
-    fxrstor [rsi]
+    ; Load RSP from next->sp (offset 64)
+    mov rsp, [rsi + 64]
     
     ; Restore next context - general purpose registers
     pop r15
@@ -49,25 +43,11 @@ switch_to_task:
     
     ret
 
-; void init_fpu_state(uint8_t* fpu_buffer)
-; RDI = pointer to 512-byte aligned buffer
-; Initializes FPU state to default values
-init_fpu_state:
-    ; Reset FPU to default state
-    fninit              ; Initialize x87 FPU
-    
-    ; Initialize SSE: set MXCSR to default (mask all exceptions)
-    ; Use stack with proper 32-bit push
-    sub rsp, 8          ; Allocate stack space (maintain 16-byte alignment)
-    mov dword [rsp], 0x1F80  ; Default MXCSR value (mask all exceptions)
-    ldmxcsr [rsp]
-    add rsp, 8
-    
-    ; Save initialized state to the buffer
-    fxsave [rdi]
-    
-    ret
-
-section .data
-    align 4
-    default_mxcsr: dd 0x1F80  ; Default MXCSR: mask all exceptions
+; First code run by a task from scheduler_create_kthread
+; R12 = entry(void*), R13 = argument (loaded by switch_to_task)
+kthread_start:
+    mov rdi, r12
+    mov rsi, r13
+    and rsp, -16
+    call kthread_main   ; Runs entry(arg), then exits the task
+    jmp $
@@ -20,8 +20,8 @@ enter_user_mode:
     ; Disable interrupts during transition
     cli
     
-    ; Set up user data segment selectors (0x20 | 3 = 0x23)
-    mov ax, 0x23        ; User data selector
+    ; Set up user data segment selectors (0x18 | 3 = 0x1B)
+    mov ax, 0x1B        ; User data selector
     mov ds, ax
     mov es, ax
     mov fs, ax
@@ -36,7 +36,7 @@ enter_user_mode:
     ; [CS]     - Code segment selector
     ; [RIP]    - User entry point
     
-    push 0x23           ; SS (user data selector: GDT index 4 | RPL 3)
+    push 0x1B           ; SS (user data selector: GDT index 3 | RPL 3)
     push rsi            ; RSP (user stack pointer)
     
     ; Push RFLAGS with IF set (bit 9 = interrupts enabled)
@@ -46,7 +46,7 @@ enter_user_mode:
     or rax, 0x202       ; Set IF and reserved bit 1
     push rax            ; RFLAGS
     
-    push 0x1B           ; CS (user code selector: GDT index 3 | RPL 3)
+    push 0x23           ; CS (user code selector: GDT index 4 | RPL 3)
     push rdi            ; RIP (entry point)
     
     ; TODO: swapgs requires proper GS base initialization
@@ -57,6 +57,80 @@ enter_user_mode:
     iretq
 
 
+; =============================================================================
+; enter_user_thread(uint64_t entry, uint64_t user_stack, uint64_t arg,
+;                   uint64_t fs_base)
+; =============================================================================
+; Like enter_user_mode, but for threads created by SYS_CLONE: passes `arg`
+; to the thread in RDI and installs its TLS pointer in IA32_FS_BASE.
+;
+; Parameters:
+;   RDI = user entry point
+;   RSI = user stack pointer
+;   RDX = argument for the thread (delivered in RDI)
+;   RCX = FS base (TLS pointer)
+;
+; FS base must be written AFTER loading the FS selector, since a selector
+; load resets the hidden base.
+; =============================================================================
+global enter_user_thread
+enter_user_thread:
+    cli
+    
+    mov r8, rdx         ; Keep arg safe from wrmsr's EDX
+    
+    mov ax, 0x1B        ; User data selector
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    
+    ; wrmsr(IA32_FS_BASE, fs_base): ECX = MSR, EDX:EAX = value
+    mov rax, rcx
+    mov rdx, rcx
+    shr rdx, 32
+    mov ecx, 0xC0000100
+    wrmsr
+    
+    ; Build iretq frame (same layout as enter_user_mode)
+    push 0x1B           ; SS
+    push rsi            ; RSP
+    pushfq
+    pop rax
+    or rax, 0x202       ; IF + reserved bit 1
+    push rax            ; RFLAGS
+    push 0x23           ; CS
+    push rdi            ; RIP
+    
+    ; Thread argument; don't leak kernel values in scratch registers
+    mov rdi, r8
+    xor eax, eax
+    xor ecx, ecx
+    xor edx, edx
+    xor esi, esi
+    xor r8d, r8d
+    xor r9d, r9d
+    xor r10d, r10d
+    xor r11d, r11d
+    
+    iretq
+
+
+; =============================================================================
+; thread_start()
+; =============================================================================
+; First code run by a cloned thread, reached from switch_to_task's `ret`.
+; process_clone seeds the callee-saved registers on the initial stack:
+;   R12 = entry, R13 = user stack, R14 = arg, R15 = FS base
+; =============================================================================
+global thread_start
+thread_start:
+    mov rdi, r12
+    mov rsi, r13
+    mov rdx, r14
+    mov rcx, r15
+    jmp enter_user_thread
+
+
 ; =============================================================================
 ; return_to_kernel()
 ; =============================================================================
@@ -0,0 +1,130 @@
+; vdso.asm - User-space time functions for uniOS (the vDSO)
+; This code is linked into the kernel but only ever runs in Ring 3: its
+; pages are mapped into every process at VDSO_TEXT_BASE, next to the
+; read-only time page at VDSO_DATA_BASE (see vdso.h). It must stay
+; position-independent and may only touch the time page and its arguments.
+
+bits 64
+section .vdso_text progbits alloc exec nowrite align=4096
+
+VDSO_DATA_BASE      equ 0x00007FFFFFFF0000
+
+; VdsoTimePage offsets (must match vdso.h)
+TP_SEQ              equ 0
+TP_TSC_BASE         equ 16
+TP_MONO_BASE        equ 24
+TP_TSC_MULT         equ 32
+TP_WALL_OFFSET      equ 40
+
+CLOCK_REALTIME      equ 0
+CLOCK_MONOTONIC     equ 1
+CLOCK_MONOTONIC_RAW equ 4
+CLOCK_BOOTTIME      equ 7
+
+SYS_CLOCK_GETTIME   equ 228
+
+NSEC_PER_SEC        equ 1000000000
+
+; =============================================================================
+; Entry points, at fixed 16-byte slots from the start of the page
+; =============================================================================
+global __vdso_text
+__vdso_text:
+    jmp vdso_clock_gettime          ; VDSO_TEXT_BASE + 0x00
+    align 16
+    jmp vdso_gettimeofday           ; VDSO_TEXT_BASE + 0x10
+    align 16
+
+; =============================================================================
+; read_clock - consistent snapshot of the time page
+; =============================================================================
+; Returns:
+;   RAX = CLOCK_MONOTONIC in ns
+;   R8  = CLOCK_REALTIME - CLOCK_MONOTONIC in ns
+; Clobbers RCX, RDX, RDI, R9, R10, R11 (RSI is preserved)
+; =============================================================================
+read_clock:
+    mov rdi, VDSO_DATA_BASE
+.retry:
+    mov r9d, [rdi + TP_SEQ]
+    test r9d, 1                     ; Odd: the kernel is mid-update
+    jnz .busy
+    mov r10, [rdi + TP_TSC_BASE]
+    mov r11, [rdi + TP_TSC_MULT]
+    mov rcx, [rdi + TP_MONO_BASE]
+    mov r8, [rdi + TP_WALL_OFFSET]
+    lfence                          ; Don't let rdtsc run ahead of the loads
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    cmp r9d, [rdi + TP_SEQ]         ; Loads stay in order on x86
+    jne .retry
+
+    sub rax, r10                    ; Cycles since the last tick
+    mul r11                         ; RDX:RAX = cycles * mult (32.32)
+    shrd rax, rdx, 32
+    add rax, rcx
+    ret
+.busy:
+    pause
+    jmp .retry
+
+; =============================================================================
+; int clock_gettime(int clock (EDI), struct timespec* ts (RSI))
+; =============================================================================
+vdso_clock_gettime:
+    cmp edi, CLOCK_REALTIME
+    je .realtime
+    cmp edi, CLOCK_MONOTONIC
+    je .monotonic
+    cmp edi, CLOCK_MONOTONIC_RAW
+    je .monotonic
+    cmp edi, CLOCK_BOOTTIME
+    je .monotonic
+
+    ; Not a clock the page knows: let the kernel answer
+    mov eax, SYS_CLOCK_GETTIME
+    syscall
+    ret
+
+.realtime:
+    call read_clock
+    add rax, r8
+    jmp .store
+.monotonic:
+    call read_clock
+.store:
+    xor edx, edx
+    mov ecx, NSEC_PER_SEC
+    div rcx
+    mov [rsi], rax                  ; tv_sec
+    mov [rsi + 8], rdx              ; tv_nsec
+    xor eax, eax
+    ret
+
+; =============================================================================
+; int gettimeofday(struct timeval* tv (RDI), struct timezone* tz (RSI))
+; =============================================================================
+vdso_gettimeofday:
+    test rsi, rsi
+    jz .no_tz
+    mov qword [rsi], 0              ; UTC, no DST
+.no_tz:
+    test rdi, rdi
+    jz .done
+
+    mov rsi, rdi                    ; read_clock clobbers RDI
+    call read_clock
+    add rax, r8
+    xor edx, edx
+    mov ecx, NSEC_PER_SEC
+    div rcx
+    mov [rsi], rax                  ; tv_sec
+    mov rax, rdx
+    xor edx, edx
+    mov ecx, 1000
+    div rcx
+    mov [rsi + 8], rax              ; tv_usec
+.done:
+    xor eax, eax
+    ret
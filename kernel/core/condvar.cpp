@@ -0,0 +1,29 @@
+#include "condvar.h"
+
+bool cond_wait_timeout(CondVar* cv, Mutex* mtx, uint64_t timeout_ticks) {
+    // Queue up before dropping the mutex: a signaler must take cv->lock
+    // after we do, so it can't fire between the unlock and the sleep
+    spinlock_acquire(&cv->lock);
+    mutex_unlock(mtx);
+    bool signaled = wait_queue_sleep(&cv->waiters, &cv->lock, timeout_ticks);
+    spinlock_release(&cv->lock);
+
+    mutex_lock(mtx);
+    return signaled;
+}
+
+void cond_wait(CondVar* cv, Mutex* mtx) {
+    cond_wait_timeout(cv, mtx, WAIT_FOREVER);
+}
+
+void cond_signal(CondVar* cv) {
+    spinlock_acquire(&cv->lock);
+    wait_queue_wake_one(&cv->waiters);
+    spinlock_release(&cv->lock);
+}
+
+void cond_broadcast(CondVar* cv) {
+    spinlock_acquire(&cv->lock);
+    wait_queue_wake_all(&cv->waiters);
+    spinlock_release(&cv->lock);
+}
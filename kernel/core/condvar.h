@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "waitqueue.h"
+#include "mutex.h"
+
+/**
+ * @file condvar.h
+ * @brief Condition variable used together with a Mutex
+ * 
+ * cond_wait() atomically releases the mutex and sleeps; the mutex is
+ * re-acquired before it returns. Always re-check the predicate in a loop,
+ * since another task may run between the signal and the wakeup.
+ * 
+ * Usage:
+ *   mutex_lock(&mtx);
+ *   while (!ready) cond_wait(&cv, &mtx);
+ *   mutex_unlock(&mtx);
+ * 
+ *   // Elsewhere
+ *   mutex_lock(&mtx);
+ *   ready = true;
+ *   cond_signal(&cv);
+ *   mutex_unlock(&mtx);
+ */
+
+struct CondVar {
+    Spinlock lock;                  // Protects waiters
+    WaitQueue waiters;
+};
+
+#define CONDVAR_INIT {SPINLOCK_INIT, WAIT_QUEUE_INIT}
+
+static inline void cond_init(CondVar* cv) {
+    spinlock_init(&cv->lock);
+    wait_queue_init(&cv->waiters);
+}
+
+// Release mtx, sleep until signaled, re-acquire mtx
+void cond_wait(CondVar* cv, Mutex* mtx);
+
+// As cond_wait, but gives up after timeout_ticks. Returns false on timeout
+// (the mutex is held again either way).
+bool cond_wait_timeout(CondVar* cv, Mutex* mtx, uint64_t timeout_ticks);
+
+// Wake one waiter
+void cond_signal(CondVar* cv);
+
+// Wake all waiters
+void cond_broadcast(CondVar* cv);
@@ -0,0 +1,62 @@
+#include "crc32c.h"
+
+// ============================================================================
+// CRC-32C
+// ============================================================================
+// Slicing-by-8: table k maps a byte to its contribution k bytes further
+// along, so eight table lookups retire a whole 64-bit word. The tables
+// are built at compile time (8 KB of .rodata).
+// ============================================================================
+
+#define CRC32C_POLY 0x82F63B78u  // Reflected Castagnoli polynomial
+
+struct Crc32cTables {
+    uint32_t t[8][256];
+
+    constexpr Crc32cTables() : t() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+            }
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static constexpr Crc32cTables tables;
+
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+
+    // Byte at a time up to an 8-byte boundary
+    while (len > 0 && ((uintptr_t)p & 7)) {
+        crc = (crc >> 8) ^ tables.t[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+
+    while (len >= 8) {
+        uint64_t word = *(const uint64_t*)p ^ crc;
+        crc = tables.t[7][word & 0xFF] ^
+              tables.t[6][(word >> 8) & 0xFF] ^
+              tables.t[5][(word >> 16) & 0xFF] ^
+              tables.t[4][(word >> 24) & 0xFF] ^
+              tables.t[3][(word >> 32) & 0xFF] ^
+              tables.t[2][(word >> 40) & 0xFF] ^
+              tables.t[1][(word >> 48) & 0xFF] ^
+              tables.t[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        crc = (crc >> 8) ^ tables.t[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+    return crc;
+}
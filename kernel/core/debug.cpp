@@ -5,7 +5,8 @@
 #include <stdarg.h>
 
 // Spinlock for preventing interleaved debug output
-static Spinlock debug_lock;
+static LockStats debug_lock_stats = LOCK_STATS_INIT("debug");
+static Spinlock debug_lock = SPINLOCK_INIT_STATS(&debug_lock_stats);
 
 // Global log filter settings
 int g_log_min_level = LOG_INFO;           // Default: show INFO and above
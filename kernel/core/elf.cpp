@@ -3,6 +3,9 @@
 #include "pmm.h"
 #include "heap.h"
 #include "kstring.h"
+#include "spinlock.h"
+#include "unifs.h"
+#include "uaccess.h"
 #include <stddef.h>
 
 // Use kstring memory utilities
@@ -91,69 +94,390 @@ uint64_t elf_load(const uint8_t* data, uint64_t size) {
     return ehdr->e_entry;
 }
 
-// Load ELF for Ring 3 execution (with user flag on all pages)
-uint64_t elf_load_user(const uint8_t* data, uint64_t size) {
-    if (!elf_validate(data, size)) return 0;
+// ============================================================================
+// Parsing
+// ============================================================================
+
+#define PAGE_SIZE 0x1000ULL
+
+static uint64_t page_down(uint64_t addr) { return addr & ~(PAGE_SIZE - 1); }
+static uint64_t page_up(uint64_t addr) { return (addr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); }
+
+// True if [offset, offset + len) lies inside a file of the given size
+static bool in_file(uint64_t offset, uint64_t len, uint64_t size) {
+    return offset <= size && len <= size - offset;
+}
+
+bool elf_parse(const uint8_t* data, uint64_t size, ElfImage* image) {
+    if (!elf_validate(data, size)) return false;
     
     const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)data;
+    if (ehdr->e_phentsize != sizeof(Elf64_Phdr)) return false;
+    if (!in_file(ehdr->e_phoff, (uint64_t)ehdr->e_phnum * sizeof(Elf64_Phdr), size)) return false;
+    
+    image->type = ehdr->e_type;
+    image->phnum = ehdr->e_phnum;
+    image->entry = ehdr->e_entry;
+    image->phdr_vaddr = 0;
+    image->dynamic_offset = 0;
+    image->dynamic_size = 0;
+    image->segment_count = 0;
+    image->interp[0] = '\0';
+    
     const Elf64_Phdr* phdr = (const Elf64_Phdr*)(data + ehdr->e_phoff);
+    uint64_t prev_end = 0;
     
-    // Load each PT_LOAD segment
     for (uint16_t i = 0; i < ehdr->e_phnum; i++) {
-        if (phdr[i].p_type != PT_LOAD) continue;
-        
-        uint64_t vaddr = phdr[i].p_vaddr;
-        uint64_t filesz = phdr[i].p_filesz;
-        uint64_t memsz = phdr[i].p_memsz;
-        uint64_t offset = phdr[i].p_offset;
+        const Elf64_Phdr* ph = &phdr[i];
         
-        uint64_t num_pages = (memsz + 0xFFF) / 0x1000;
-        uint64_t bytes_copied = 0;
-        
-        for (uint64_t p = 0; p < num_pages; p++) {
-            void* frame = pmm_alloc_frame();
-            if (!frame) return 0;
-            
-            uint64_t page_vaddr = (vaddr & ~0xFFF) + (p * 0x1000);
-            // Always set USER flag for Ring 3
-            uint64_t flags = PTE_PRESENT | PTE_WRITABLE | PTE_USER;
-            
-            vmm_map_page(page_vaddr, (uint64_t)frame, flags);
-            
-            void* dest = (void*)vmm_phys_to_virt((uint64_t)frame);
-            memset(dest, 0, 0x1000);
-            
-            if (bytes_copied < filesz) {
-                uint64_t copy_start = (p == 0) ? (vaddr & 0xFFF) : 0;
-                uint64_t copy_amount = 0x1000 - copy_start;
-                if (bytes_copied + copy_amount > filesz) {
-                    copy_amount = filesz - bytes_copied;
-                }
+        switch (ph->p_type) {
+            case PT_LOAD: {
+                if (image->segment_count == ELF_MAX_SEGMENTS) return false;
+                if (!in_file(ph->p_offset, ph->p_filesz, size)) return false;
+                if (ph->p_filesz > ph->p_memsz) return false;
                 
-                if (copy_amount > 0) {
-                    memcpy((uint8_t*)dest + copy_start, data + offset + bytes_copied, copy_amount);
-                    bytes_copied += copy_amount;
-                }
+                uint64_t end = ph->p_vaddr + ph->p_memsz;
+                if (end < ph->p_vaddr || end > USER_SPACE_MAX) return false;
+                if (ph->p_vaddr < prev_end) return false;  // Unordered or overlapping
+                prev_end = end;
+                
+                ElfSegment* seg = &image->segments[image->segment_count++];
+                seg->vaddr = ph->p_vaddr;
+                seg->memsz = ph->p_memsz;
+                seg->offset = ph->p_offset;
+                seg->filesz = ph->p_filesz;
+                seg->flags = ph->p_flags;
+                break;
             }
+            case PT_INTERP:
+                if (!in_file(ph->p_offset, ph->p_filesz, size)) return false;
+                if (ph->p_filesz == 0 || ph->p_filesz > ELF_INTERP_MAX) return false;
+                memcpy(image->interp, data + ph->p_offset, ph->p_filesz);
+                image->interp[ph->p_filesz - 1] = '\0';  // Stored with its NUL
+                break;
+            case PT_DYNAMIC:
+                if (!in_file(ph->p_offset, ph->p_filesz, size)) return false;
+                image->dynamic_offset = ph->p_offset;
+                image->dynamic_size = ph->p_filesz;
+                break;
+            case PT_PHDR:
+                image->phdr_vaddr = ph->p_vaddr;
+                break;
+            default:
+                break;
         }
     }
+    if (image->segment_count == 0) return false;
     
-    // Also map a user stack (64KB = 16 pages) at USER_STACK_TOP
-    // Stack grows down, so we map pages below USER_STACK_TOP
-    #define USER_STACK_PAGES 16
-    #define USER_STACK_SIZE (USER_STACK_PAGES * 0x1000)
-    #define USER_STACK_TOP 0x7FFFF000ULL
-    
-    uint64_t stack_base = USER_STACK_TOP - USER_STACK_SIZE;
-    for (int i = 0; i < USER_STACK_PAGES; i++) {
-        void* stack_frame = pmm_alloc_frame();
-        if (stack_frame) {
-            uint64_t vaddr = stack_base + i * 0x1000;
-            vmm_map_page(vaddr, (uint64_t)stack_frame, PTE_PRESENT | PTE_WRITABLE | PTE_USER);
-            void* stack_dest = (void*)vmm_phys_to_virt((uint64_t)stack_frame);
-            memset(stack_dest, 0, 0x1000);
+    // Without PT_PHDR, the headers are visible if a segment maps them
+    if (!image->phdr_vaddr) {
+        for (uint32_t i = 0; i < image->segment_count; i++) {
+            const ElfSegment* seg = &image->segments[i];
+            if (ehdr->e_phoff >= seg->offset && ehdr->e_phoff - seg->offset < seg->filesz) {
+                image->phdr_vaddr = seg->vaddr + (ehdr->e_phoff - seg->offset);
+                break;
+            }
         }
     }
+    return true;
+}
+
+// Parsed images of boot files, which never change or move: the data
+// pointer alone identifies the binary
+#define ELF_CACHE_SLOTS 8
+
+struct ElfCacheEntry {
+    const uint8_t* data;
+    uint64_t size;
+    ElfImage image;
+};
+
+static ElfCacheEntry elf_cache[ELF_CACHE_SLOTS];
+static uint32_t elf_cache_next = 0;     // Round-robin replacement
+static Spinlock elf_cache_lock = SPINLOCK_INIT;
+
+static bool parse_file(const UniFSFile* file, ElfImage* image) {
+    if (file->immutable) {
+        spinlock_acquire(&elf_cache_lock);
+        for (uint32_t i = 0; i < ELF_CACHE_SLOTS; i++) {
+            if (elf_cache[i].data == file->data && elf_cache[i].size == file->size) {
+                *image = elf_cache[i].image;
+                spinlock_release(&elf_cache_lock);
+                return true;
+            }
+        }
+        spinlock_release(&elf_cache_lock);
+    }
     
-    return ehdr->e_entry;
+    if (!elf_parse(file->data, file->size, image)) return false;
+    
+    if (file->immutable) {
+        spinlock_acquire(&elf_cache_lock);
+        ElfCacheEntry* slot = &elf_cache[elf_cache_next];
+        elf_cache_next = (elf_cache_next + 1) % ELF_CACHE_SLOTS;
+        slot->data = file->data;
+        slot->size = file->size;
+        slot->image = *image;
+        spinlock_release(&elf_cache_lock);
+    }
+    return true;
+}
+
+// ============================================================================
+// Mapping
+// ============================================================================
+
+// Fill [va, va + len), backed by dest, with the segment's file bytes.
+// With zero_rest, the parts the file doesn't cover are cleared too.
+static void fill_range(uint8_t* dest, uint64_t va, uint64_t len, const uint8_t* data,
+                       const ElfSegment* seg, uint64_t bias, bool zero_rest) {
+    uint64_t file_start = bias + seg->vaddr;
+    uint64_t file_end = file_start + seg->filesz;
+    uint64_t lo = (va > file_start) ? va : file_start;
+    uint64_t hi = (va + len < file_end) ? va + len : file_end;
+    
+    if (lo >= hi) {
+        if (zero_rest) memset(dest, 0, len);
+        return;
+    }
+    
+    memcpy(dest + (lo - va), data + seg->offset + (lo - file_start), hi - lo);
+    if (zero_rest) {
+        memset(dest, 0, lo - va);
+        memset(dest + (hi - va), 0, va + len - hi);
+    }
+}
+
+// Map a read-only segment straight onto the pages of a page-aligned boot
+// file. The entries are PTE_SHARED: fork shares them and exit leaves the
+// frames alone. Returns false if the segment doesn't qualify.
+static bool share_segment(uint64_t* pml4, const uint8_t* data, const ElfSegment* seg, uint64_t bias) {
+    uint64_t start = page_down(bias + seg->vaddr);
+    uint64_t end = page_up(bias + seg->vaddr + seg->memsz);
+    
+    if (seg->flags & PF_W) return false;
+    if (seg->memsz != seg->filesz) return false;   // No .bss to clear
+    if (((bias + seg->vaddr) ^ seg->offset) & (PAGE_SIZE - 1)) return false;
+    if (start >= end || vmm_virt_to_phys_in(pml4, start)) return false;
+    
+    const uint8_t* src = data + page_down(seg->offset);
+    for (uint64_t va = start; va < end; va += PAGE_SIZE, src += PAGE_SIZE) {
+        uint64_t phys = vmm_virt_to_phys((uint64_t)src);
+        if (!phys) return false;
+        vmm_map_page_in(pml4, va, phys, PTE_PRESENT | PTE_USER | PTE_SHARED);
+    }
+    return true;
+}
+
+// Map one segment at bias. Its first page may already hold the end of the
+// previous segment; everything after that is fresh. With share, read-only
+// segments may map the file's own pages (see share_segment).
+static bool map_segment(uint64_t* pml4, const uint8_t* data, const ElfSegment* seg, uint64_t bias,
+                        bool share) {
+    if (share && share_segment(pml4, data, seg, bias)) return true;
+    
+    uint64_t start = page_down(bias + seg->vaddr);
+    uint64_t end = page_up(bias + seg->vaddr + seg->memsz);
+    uint64_t flags = PTE_PRESENT | PTE_USER;
+    if (seg->flags & PF_W) flags |= PTE_WRITABLE;
+    
+    uint64_t va = start;
+    if (va < end) {
+        uint64_t shared = vmm_virt_to_phys_in(pml4, va);
+        if (shared) {
+            shared = page_down(shared);
+            if (vmm_get_pte_in(pml4, va) & PTE_SHARED) {
+                // A page of the boot image: fill a private copy instead
+                void* frame = pmm_alloc_frame();
+                if (!frame) return false;
+                memcpy((void*)vmm_phys_to_virt((uint64_t)frame), (const void*)vmm_phys_to_virt(shared), PAGE_SIZE);
+                shared = (uint64_t)frame;
+            }
+            // Shared pages stay writable: one of the segments may need it
+            vmm_map_page_in(pml4, va, shared, PTE_PRESENT | PTE_USER | PTE_WRITABLE);
+            fill_range((uint8_t*)vmm_phys_to_virt(shared), va, PAGE_SIZE, data, seg, bias, false);
+            va += PAGE_SIZE;
+        }
+    }
+    
+    uint64_t pages = (end - va) / PAGE_SIZE;
+    if (pages == 0) return true;
+    
+    // Fast path: one contiguous run, one walk, one copy
+    void* run = pmm_alloc_frames(pages);
+    if (run) {
+        if (!vmm_map_range_in(pml4, va, (uint64_t)run, pages, flags)) return false;
+        fill_range((uint8_t*)vmm_phys_to_virt((uint64_t)run), va, pages * PAGE_SIZE, data, seg, bias, true);
+        return true;
+    }
+    
+    // Fragmented memory: page at a time
+    for (; va < end; va += PAGE_SIZE) {
+        void* frame = pmm_alloc_frame();
+        if (!frame) return false;
+        vmm_map_page_in(pml4, va, (uint64_t)frame, flags);
+        fill_range((uint8_t*)vmm_phys_to_virt((uint64_t)frame), va, PAGE_SIZE, data, seg, bias, true);
+    }
+    return true;
+}
+
+// Store a 64-bit value at a user address of pml4 (may straddle two pages)
+static bool poke_u64(uint64_t* pml4, uint64_t va, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t phys = vmm_virt_to_phys_in(pml4, va + i);
+        if (!phys) return false;
+        *(uint8_t*)vmm_phys_to_virt(phys) = (uint8_t)(value >> (i * 8));
+    }
+    return true;
+}
+
+// File offset of a virtual address covered by file data, or -1
+static int64_t vaddr_to_offset(const ElfImage* image, uint64_t vaddr) {
+    for (uint32_t i = 0; i < image->segment_count; i++) {
+        const ElfSegment* seg = &image->segments[i];
+        if (vaddr >= seg->vaddr && vaddr - seg->vaddr < seg->filesz) {
+            return (int64_t)(seg->offset + (vaddr - seg->vaddr));
+        }
+    }
+    return -1;
+}
+
+// Apply a static PIE's relocations (only R_X86_64_RELATIVE is supported)
+static bool relocate(uint64_t* pml4, const uint8_t* data, uint64_t size, const ElfImage* image, uint64_t bias) {
+    if (image->dynamic_size == 0) return true;
+    
+    const Elf64_Dyn* dyn = (const Elf64_Dyn*)(data + image->dynamic_offset);
+    uint64_t count = image->dynamic_size / sizeof(Elf64_Dyn);
+    uint64_t rela = 0, relasz = 0, relaent = sizeof(Elf64_Rela);
+    
+    for (uint64_t i = 0; i < count && dyn[i].d_tag != DT_NULL; i++) {
+        switch (dyn[i].d_tag) {
+            case DT_RELA:    rela = dyn[i].d_val; break;
+            case DT_RELASZ:  relasz = dyn[i].d_val; break;
+            case DT_RELAENT: relaent = dyn[i].d_val; break;
+        }
+    }
+    if (relasz == 0) return true;
+    if (relaent != sizeof(Elf64_Rela)) return false;
+    
+    int64_t offset = vaddr_to_offset(image, rela);
+    if (offset < 0 || !in_file((uint64_t)offset, relasz, size)) return false;
+    
+    const Elf64_Rela* r = (const Elf64_Rela*)(data + offset);
+    for (uint64_t i = 0; i < relasz / sizeof(Elf64_Rela); i++) {
+        if ((uint32_t)r[i].r_info != R_X86_64_RELATIVE) return false;
+        if (!poke_u64(pml4, bias + r[i].r_offset, bias + r[i].r_addend)) return false;
+    }
+    return true;
+}
+
+static bool map_image(uint64_t* pml4, const uint8_t* data, const ElfImage* image, uint64_t bias,
+                      bool share) {
+    const ElfSegment* last = &image->segments[image->segment_count - 1];
+    if (bias + last->vaddr + last->memsz > USER_SPACE_MAX) return false;
+    
+    for (uint32_t i = 0; i < image->segment_count; i++) {
+        if (!map_segment(pml4, data, &image->segments[i], bias, share)) return false;
+    }
+    return true;
+}
+
+// Whether a file's pages can back read-only segments directly: a boot file
+// (never changes or moves) starting on a page boundary (UNIFS v2 images)
+static bool can_share(const UniFSFile* file) {
+    return file->immutable && ((uint64_t)file->data & (PAGE_SIZE - 1)) == 0;
+}
+
+// Map the stack and lay out argc = 0, empty argv/envp and the auxv.
+// Returns the initial RSP (16-byte aligned), or 0.
+static uint64_t setup_stack(uint64_t* pml4, const uint64_t* auxv, uint64_t auxv_words) {
+    uint64_t base = USER_STACK_TOP - USER_STACK_PAGES * PAGE_SIZE;
+    uint64_t flags = PTE_PRESENT | PTE_WRITABLE | PTE_USER;
+    
+    uint64_t phys = (uint64_t)pmm_alloc_frames(USER_STACK_PAGES);
+    if (phys) {
+        if (!vmm_map_range_in(pml4, base, phys, USER_STACK_PAGES, flags)) return 0;
+        memset((void*)vmm_phys_to_virt(phys), 0, USER_STACK_PAGES * PAGE_SIZE);
+    } else {
+        for (uint64_t i = 0; i < USER_STACK_PAGES; i++) {
+            void* frame = pmm_alloc_frame();
+            if (!frame) return 0;
+            vmm_map_page_in(pml4, base + i * PAGE_SIZE, (uint64_t)frame, flags);
+            memset((void*)vmm_phys_to_virt((uint64_t)frame), 0, PAGE_SIZE);
+        }
+    }
+    
+    uint64_t words = 3 + auxv_words;    // argc, argv[0], envp[0], auxv
+    uint64_t rsp = (USER_STACK_TOP - words * 8) & ~0xFULL;
+    
+    // argc/argv/envp are already zero
+    uint64_t* top = (uint64_t*)vmm_phys_to_virt(vmm_virt_to_phys_in(pml4, rsp));
+    for (uint64_t i = 0; i < auxv_words; i++) top[3 + i] = auxv[i];
+    return rsp;
+}
+
+// Map the interpreter `name` at ELF_INTERP_BASE; *start gets its entry point
+static bool load_interp(uint64_t* pml4, const char* name, uint64_t* start) {
+    UniFSFile file;
+    ElfImage interp;
+    if (!unifs_open_into(name, &file)) return false;
+    
+    bool ok = parse_file(&file, &interp) && interp.type == ET_DYN && !interp.interp[0] &&
+              map_image(pml4, file.data, &interp, ELF_INTERP_BASE, can_share(&file));
+    if (ok) *start = ELF_INTERP_BASE + interp.entry;
+    
+    unifs_close_into(&file);
+    return ok;
+}
+
+static bool load_program(uint64_t* pml4, const UniFSFile* file, uint64_t* entry, uint64_t* stack) {
+    ElfImage image;
+    if (!parse_file(file, &image)) return false;
+    
+    uint64_t bias = (image.type == ET_DYN) ? ELF_PIE_BASE : 0;
+    
+    // relocate() stores through the kernel mapping, so an image it will
+    // patch gets private pages
+    bool self_reloc = bias && !image.interp[0] && image.dynamic_size;
+    if (!map_image(pml4, file->data, &image, bias, can_share(file) && !self_reloc)) return false;
+    
+    uint64_t start = bias + image.entry;
+    uint64_t interp_base = 0;
+    
+    if (image.interp[0]) {
+        // The interpreter relocates the program (and itself)
+        const char* name = image.interp;
+        while (*name == '/') name++;
+        
+        if (!load_interp(pml4, name, &start)) return false;
+        interp_base = ELF_INTERP_BASE;
+    } else if (bias && !relocate(pml4, file->data, file->size, &image, bias)) {
+        return false;
+    }
+    
+    uint64_t auxv[] = {
+        AT_PHDR,   image.phdr_vaddr ? bias + image.phdr_vaddr : 0,
+        AT_PHENT,  sizeof(Elf64_Phdr),
+        AT_PHNUM,  image.phnum,
+        AT_PAGESZ, PAGE_SIZE,
+        AT_BASE,   interp_base,
+        AT_ENTRY,  bias + image.entry,
+        AT_NULL,   0,
+    };
+    
+    uint64_t rsp = setup_stack(pml4, auxv, sizeof(auxv) / sizeof(auxv[0]));
+    if (!rsp) return false;
+    
+    *entry = start;
+    *stack = rsp;
+    return true;
+}
+
+bool elf_load_program(uint64_t* pml4, const char* path, uint64_t* entry, uint64_t* stack) {
+    UniFSFile file;
+    if (!unifs_open_into(path, &file)) return false;
+    
+    bool ok = load_program(pml4, &file, entry, stack);
+    unifs_close_into(&file);
+    return ok;
 }
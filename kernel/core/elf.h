@@ -22,6 +22,7 @@
 #define PT_LOAD    1
 #define PT_DYNAMIC 2
 #define PT_INTERP  3
+#define PT_PHDR    6
 
 // Program header flags
 #define PF_X 0x1 // Execute
@@ -58,7 +59,91 @@ struct Elf64_Phdr {
     uint64_t p_align;   // Segment alignment
 } __attribute__((packed));
 
+// ELF64 Dynamic section entry
+struct Elf64_Dyn {
+    int64_t  d_tag;
+    uint64_t d_val;
+} __attribute__((packed));
+
+// ELF64 Relocation with addend
+struct Elf64_Rela {
+    uint64_t r_offset;  // Address to patch (relative to the load bias)
+    uint64_t r_info;    // Symbol index << 32 | type
+    int64_t  r_addend;
+} __attribute__((packed));
+
+// Dynamic tags
+#define DT_NULL    0
+#define DT_RELA    7
+#define DT_RELASZ  8
+#define DT_RELAENT 9
+
+// Relocation types
+#define R_X86_64_RELATIVE 8
+
+// Auxiliary vector types (passed to the program on its initial stack)
+#define AT_NULL   0
+#define AT_PHDR   3
+#define AT_PHENT  4
+#define AT_PHNUM  5
+#define AT_PAGESZ 6
+#define AT_BASE   7
+#define AT_ENTRY  9
+
 // ELF Loader functions
 bool elf_validate(const uint8_t* data, uint64_t size);
 uint64_t elf_load(const uint8_t* data, uint64_t size);
-uint64_t elf_load_user(const uint8_t* data, uint64_t size);
+
+// ============================================================================
+// User Program Loading
+// ============================================================================
+// exec parses a binary into an ElfImage once - validating every header
+// against the file size - and caches it per boot file, whose data never
+// changes. Mapping then allocates each segment as one contiguous run of
+// frames, maps it with a single page table walk and copies the file bytes
+// in one go, zeroing only what the file doesn't cover.
+//
+// ET_DYN programs (PIE) load at ELF_PIE_BASE. A program with PT_INTERP
+// gets its interpreter loaded at ELF_INTERP_BASE and started instead, and
+// finds the program through the auxiliary vector. A PIE without one must
+// be static: its R_X86_64_RELATIVE relocations are applied by the loader.
+// ============================================================================
+
+#define ELF_MAX_SEGMENTS 8                          // PT_LOADs per binary
+#define ELF_INTERP_MAX   64                         // PT_INTERP path length
+#define ELF_PIE_BASE     0x0000555555554000ULL      // Bias for ET_DYN programs
+#define ELF_INTERP_BASE  0x00007F0000000000ULL      // Bias for the interpreter
+
+// User stack (64KB = 16 pages), growing down from USER_STACK_TOP
+#define USER_STACK_TOP   0x7FFFF000ULL
+#define USER_STACK_PAGES 16
+
+struct ElfSegment {
+    uint64_t vaddr;
+    uint64_t memsz;
+    uint64_t offset;
+    uint64_t filesz;
+    uint32_t flags;     // PF_*
+};
+
+// Validated summary of a binary's program headers
+struct ElfImage {
+    uint16_t type;                  // ET_EXEC or ET_DYN
+    uint16_t phnum;
+    uint64_t entry;                 // Unbiased entry point
+    uint64_t phdr_vaddr;            // Where the headers are mapped (0 = not)
+    uint64_t dynamic_offset;        // PT_DYNAMIC in the file (size 0 = none)
+    uint64_t dynamic_size;
+    uint32_t segment_count;
+    ElfSegment segments[ELF_MAX_SEGMENTS];  // PT_LOADs, in address order
+    char interp[ELF_INTERP_MAX];    // PT_INTERP path ("" = none)
+};
+
+// Parse and validate a binary. Returns false if it is malformed or
+// unsupported.
+bool elf_parse(const uint8_t* data, uint64_t size, ElfImage* image);
+
+// Load the program at path (a uniFS name) into a fresh address space and
+// build its initial stack (argc, argv, envp, auxv). Returns false on
+// failure; pages mapped so far belong to pml4.
+bool elf_load_program(uint64_t* pml4, const char* path, uint64_t* entry, uint64_t* stack);
@@ -0,0 +1,100 @@
+#include "futex.h"
+#include "process.h"
+#include "scheduler.h"
+#include "spinlock.h"
+#include "uaccess.h"
+
+// Each waiter lives on its own kernel stack for the duration of the wait,
+// so no allocation is needed and nothing can leak if the task is killed.
+struct FutexWaiter {
+    Process* task;
+    uint64_t* mm;             // Page table of the waiter (key part 1)
+    uint32_t* uaddr;          // User address (key part 2)
+    FutexWaiter* next;
+    volatile bool woken;
+};
+
+#define FUTEX_BUCKETS 64
+
+static FutexWaiter* buckets[FUTEX_BUCKETS];
+static Spinlock futex_lock = SPINLOCK_INIT;
+
+static inline uint32_t futex_hash(uint64_t* mm, uint32_t* uaddr) {
+    uint64_t key = (uint64_t)uaddr ^ ((uint64_t)mm >> 12);
+    key ^= key >> 17;
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(key >> 58);   // Top 6 bits -> 0..63
+}
+
+int64_t futex_wait(uint32_t* uaddr, uint32_t val) {
+    Process* current = process_get_current();
+    uint64_t* mm = current->page_table;
+    uint32_t b = futex_hash(mm, uaddr);
+
+    FutexWaiter w;
+    w.task = current;
+    w.mm = mm;
+    w.uaddr = uaddr;
+    w.next = nullptr;
+    w.woken = false;
+
+    spinlock_acquire(&futex_lock);
+
+    // Checked under the lock: a waker that changed the word before we
+    // queued would otherwise be missed
+    uint32_t current_val;
+    if (copy_from_user(&current_val, uaddr, sizeof(uint32_t)) < 0 || current_val != val) {
+        spinlock_release(&futex_lock);
+        return -1;
+    }
+
+    // Append so wakeups are FIFO
+    FutexWaiter** link = &buckets[b];
+    while (*link) link = &(*link)->next;
+    *link = &w;
+
+    current->state = PROCESS_BLOCKED;
+    spinlock_release(&futex_lock);
+
+    scheduler_schedule();
+
+    // Not woken by futex_wake (e.g. spurious reschedule) - dequeue ourselves
+    if (!w.woken) {
+        spinlock_acquire(&futex_lock);
+        current->state = PROCESS_RUNNING;
+        for (link = &buckets[b]; *link; link = &(*link)->next) {
+            if (*link == &w) {
+                *link = w.next;
+                break;
+            }
+        }
+        spinlock_release(&futex_lock);
+    }
+
+    return 0;
+}
+
+int64_t futex_wake(uint32_t* uaddr, uint32_t count) {
+    Process* current = process_get_current();
+    uint64_t* mm = current->page_table;
+    uint32_t b = futex_hash(mm, uaddr);
+    int64_t woken = 0;
+
+    spinlock_acquire(&futex_lock);
+
+    FutexWaiter** link = &buckets[b];
+    while (*link && (uint32_t)woken < count) {
+        FutexWaiter* w = *link;
+        if (w->mm == mm && w->uaddr == uaddr) {
+            *link = w->next;
+            w->woken = true;
+            scheduler_wake(w->task);
+            woken++;
+        } else {
+            link = &w->next;
+        }
+    }
+
+    spinlock_release(&futex_lock);
+    return woken;
+}
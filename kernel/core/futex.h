@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @file futex.h
+ * @brief Fast user-space mutex support (SYS_FUTEX)
+ * 
+ * User-space locks spin/CAS on a 32-bit word in shared memory and only
+ * enter the kernel when they must sleep or wake someone. Waiters are keyed
+ * by (address space, user address), so threads sharing a page table meet
+ * on the same queue.
+ * 
+ * Usage (from user space, via SYS_FUTEX):
+ *   futex(&word, FUTEX_WAIT, expected)   // sleep while word == expected
+ *   futex(&word, FUTEX_WAKE, n)          // wake up to n sleepers
+ */
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+// Block while *uaddr == val. Returns 0 when woken, -1 if *uaddr != val.
+int64_t futex_wait(uint32_t* uaddr, uint32_t val);
+
+// Wake up to `count` tasks waiting on uaddr. Returns the number woken.
+int64_t futex_wake(uint32_t* uaddr, uint32_t count);
@@ -37,6 +37,7 @@ static volatile LIMINE_REQUESTS_END_MARKER;
 #include "timer.h"
 #include "pmm.h"
 #include "vmm.h"
+#include "uaccess.h"
 #include "pat.h"
 #include "heap.h"
 #include "scheduler.h"
@@ -52,12 +53,17 @@ static volatile LIMINE_REQUESTS_END_MARKER;
 #include "input.h"
 #include "acpi.h"
 #include "rtc.h"
+#include "vdso.h"
 #include "serial.h"
 #include "net.h"
 #include "version.h"
 
 // New
 #include "sound.h"
+#include "block.h"
+#include "softirq.h"
+#include "workqueue.h"
+#include "rcu.h"
 
 // Global framebuffer pointer
 struct limine_framebuffer* g_framebuffer = nullptr;
@@ -70,23 +76,8 @@ const char* g_bootloader_name = nullptr;
 const char* g_bootloader_version = nullptr;
 
 #include "panic.h"
-
-// Enable SSE/FPU in control registers (required for fxsave/fxrstor)
-static void cpu_enable_sse() {
-    // Enable SSE in CR4
-    uint64_t cr4;
-    asm volatile("mov %%cr4, %0" : "=r"(cr4));
-    cr4 |= (1 << 9);   // OSFXSR - Enable fxsave/fxrstor
-    cr4 |= (1 << 10);  // OSXMMEXCPT - Enable SSE exceptions
-    asm volatile("mov %0, %%cr4" :: "r"(cr4));
-    
-    // Enable FPU in CR0
-    uint64_t cr0;
-    asm volatile("mov %%cr0, %0" : "=r"(cr0));
-    cr0 &= ~(1 << 2);  // Clear EM (Emulation) - don't trap FPU instructions
-    cr0 |= (1 << 1);   // Set MP (Monitor Coprocessor) - monitor FPU
-    asm volatile("mov %0, %%cr0" :: "r"(cr0));
-}
+#include "fpu.h"
+#include "syscall.h"
 
 // Idle task - runs when no other task is ready
 // This prevents CPU starvation when all tasks are sleeping/waiting
@@ -96,6 +87,35 @@ static void idle_task_entry() {
     }
 }
 
+// ============================================================================
+// Deferred Device Polling
+// ============================================================================
+// USB HID, the NIC and the sound card are polled rather than interrupt
+// driven. Each timer tick raises their softirqs, so polling happens once per
+// millisecond on IRQ exit instead of in every iteration of the main loop.
+// Sound buffer refills copy whole periods of PCM data and go to the system
+// workqueue instead.
+// ============================================================================
+
+static void input_softirq() {
+    input_poll();
+}
+
+static void net_rx_softirq() {
+    net_poll();
+}
+
+static void sound_work_fn(WorkItem*) {
+    sound_poll();
+}
+
+static WorkItem sound_work = WORK_INIT(sound_work_fn);
+
+static void deferred_polling_init() {
+    open_softirq(SOFTIRQ_INPUT, input_softirq);
+    open_softirq(SOFTIRQ_NET_RX, net_rx_softirq);
+}
+
 // IRQ handler
 extern "C" void irq_handler(void* stack_frame) {
     uint64_t* regs = (uint64_t*)stack_frame;
@@ -103,14 +123,27 @@ extern "C" void irq_handler(void* stack_frame) {
     uint8_t irq = int_no - 32;
     
     pic_send_eoi(irq);
+    irq_enter();
 
     if (irq == 0) {
         timer_handler();
-        scheduler_schedule();
+        raise_softirq(SOFTIRQ_INPUT);
+        raise_softirq(SOFTIRQ_NET_RX);
+        if (sound_is_initialized() && sound_is_playing()) {
+            schedule_work(&sound_work);  // No-op while a refill is pending
+        }
     } else if (irq == 1) {
         ps2_keyboard_handler();
     } else if (irq == 12) {
         ps2_mouse_handler();
+    } else {
+        block_irq(irq);
+    }
+    
+    // Run deferred work with interrupts enabled, then let the tick preempt
+    irq_exit();
+    if (irq == 0) {
+        scheduler_tick();
     }
 }
 
@@ -530,8 +563,9 @@ extern "C" void _start(void) {
     // Call C++ global constructors first (before any C++ code runs)
     call_global_constructors();
     
-    // Enable SSE/FPU early - required before any SSE instructions in graphics code
-    cpu_enable_sse();
+    // Enable SSE/FPU (and XSAVE/AVX when available) early - required before
+    // any SSE instructions in graphics code
+    fpu_init();
     
     if (!LIMINE_BASE_REVISION_SUPPORTED) hcf();
     if (!framebuffer_request.response || framebuffer_request.response->framebuffer_count < 1) hcf();
@@ -590,6 +624,9 @@ extern "C" void _start(void) {
     idt_init();
     DEBUG_INFO("IDT Initialized");
     
+    syscall_init();
+    DEBUG_INFO("SYSCALL/SYSRET Enabled");
+    
     pic_remap(32, 40);
     for (int i = 0; i < 16; i++) pic_set_mask(i);
     DEBUG_INFO("PIC Remapped and Masked");
@@ -609,6 +646,9 @@ extern "C" void _start(void) {
     vmm_init();
     DEBUG_INFO("VMM Initialized");
     
+    uaccess_init();
+    DEBUG_INFO("SMAP %s", uaccess_smap_enabled() ? "Enabled" : "Not Supported");
+    
     // Initialize PAT for Write-Combining support (improves graphics performance on AMD)
     pat_init();
     
@@ -634,9 +674,17 @@ extern "C" void _start(void) {
     DEBUG_INFO("Scheduler Initialized");
     
     // Create dedicated idle task (always runnable, prevents deadlock)
-    scheduler_create_task(idle_task_entry, "Idle");
+    // SCHED_IDLE keeps it off the fair run queue so it never steals a slice
+    scheduler_set_policy(scheduler_create_task(idle_task_entry, "Idle"), SCHED_IDLE);
     DEBUG_INFO("Idle Task Created");
     
+    // Deferred work: softirqs (ksoftirqd) and the system workqueue (kworker)
+    softirq_init();
+    workqueue_init();
+    rcu_init();
+    deferred_polling_init();
+    DEBUG_INFO("Deferred Work Initialized");
+    
     // Initialize USB subsystem via unified input layer
     pci_init();
     DEBUG_INFO("PCI Subsystem Initialized");
@@ -646,6 +694,9 @@ extern "C" void _start(void) {
     rtc_init();  // Initialize RTC for date/time
     DEBUG_INFO("RTC Initialized");
     
+    vdso_init();  // User-space clocks (needs the timer and RTC)
+    DEBUG_INFO("vDSO Initialized");
+    
     usb_init();
     // usb_init logs its own status
     
@@ -661,6 +712,10 @@ extern "C" void _start(void) {
     // Initialize sound drivers
     sound_init();
     // sound_init logs its own status
+
+    // Initialize disks (AHCI, virtio-blk)
+    block_init();
+    // block_init logs its own status
     
     // Enable interrupts
     asm("sti");
@@ -668,8 +723,12 @@ extern "C" void _start(void) {
     
     // Initialize filesystem
     if (module_request.response && module_request.response->module_count > 0) {
-        unifs_init(module_request.response->modules[0]->address);
+        unifs_init(module_request.response->modules[0]->address,
+                   module_request.response->modules[0]->size);
         DEBUG_INFO("Filesystem Ready");
+
+        // Load files saved by the last sync (disk I/O needs interrupts on)
+        unifs_store_init();
     } else {
         DEBUG_WARN("Filesystem: No modules");
     }
@@ -710,17 +769,12 @@ extern "C" void _start(void) {
     const uint64_t frame_delay = 16;  // 16ms per frame ≈ 60 FPS
 
     // Main loop using unified input
+    // Hardware polling (USB, network, sound) runs from softirqs and the
+    // system workqueue on every timer tick; see deferred_polling_init()
     while (true) {
-        // 1. Always poll hardware (USB needs frequent polling)
-        input_poll();
-        net_poll();
-
-        // Poll sound
-        sound_poll();
-
         uint64_t now = timer_get_ticks();
         
-        // 2. Only process shell/UI updates if we're about to draw
+        // Only process shell/UI updates if we're about to draw
         // This reduces input latency by ensuring fresh input is displayed immediately
         if (now - last_frame_time >= frame_delay) {
             // Update logic RIGHT NOW based on the freshest input
@@ -736,7 +790,7 @@ extern "C" void _start(void) {
             gfx_swap_buffers();
             last_frame_time = now;
         } else {
-            // Sleep briefly to save power, but not too long to miss USB packets
+            // Sleep until the next interrupt (the tick also polls input)
             asm volatile("hlt");
         }
     }
@@ -0,0 +1,28 @@
+#include "lockstat.h"
+
+static LockStats* registry = nullptr;
+
+void lock_stats_register(LockStats* st) {
+    // Only the first caller links it in
+    if (__sync_lock_test_and_set(&st->registered, 1)) return;
+
+    LockStats* head;
+    do {
+        head = registry;
+        st->next = head;
+    } while (!__sync_bool_compare_and_swap(&registry, head, st));
+}
+
+LockStats* lock_stats_get_list() {
+    return registry;
+}
+
+void lock_stats_reset() {
+    for (LockStats* st = registry; st; st = st->next) {
+        st->acquisitions = 0;
+        st->contended = 0;
+        st->spins = 0;
+        st->max_hold = 0;
+        st->total_hold = 0;
+    }
+}
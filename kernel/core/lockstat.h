@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include "io.h"   // For rdtsc
+
+/**
+ * @file lockstat.h
+ * @brief Optional per-lock contention statistics
+ * 
+ * A lock opts in by pointing at a LockStats record (Spinlock / McsLock
+ * initializers take one). Instrumented locks count acquisitions, how many
+ * of them had to wait, how long they spun, and the longest time the lock
+ * was held (in TSC cycles). The `lockstat` shell command lists them.
+ * 
+ * Locks without a LockStats record pay nothing but a null check.
+ * 
+ * Usage:
+ *   static LockStats foo_stats = LOCK_STATS_INIT("foo");
+ *   static Spinlock foo_lock = SPINLOCK_INIT_STATS(&foo_stats);
+ */
+
+struct LockStats {
+    const char* name;
+    uint64_t acquisitions;      // Successful acquires
+    uint64_t contended;         // Acquires that found the lock held
+    uint64_t spins;             // Total pause iterations while waiting
+    uint64_t max_hold;          // Longest hold time (TSC cycles)
+    uint64_t total_hold;        // Sum of hold times (TSC cycles)
+    uint64_t acquired_at;       // TSC at the current acquisition
+    LockStats* next;            // Registry link
+    volatile uint32_t registered;
+};
+
+#define LOCK_STATS_INIT(n) {(n), 0, 0, 0, 0, 0, 0, nullptr, 0}
+
+// Add to the global registry (done automatically on first acquisition)
+void lock_stats_register(LockStats* st);
+
+// Head of the registry, for dumping
+LockStats* lock_stats_get_list();
+
+// Zero the counters of every registered lock
+void lock_stats_reset();
+
+// Called with the lock just acquired (interrupts off)
+static inline void lock_stats_acquired(LockStats* st, uint64_t spins) {
+    if (!st->registered) lock_stats_register(st);
+    st->acquisitions++;
+    if (spins) {
+        st->contended++;
+        st->spins += spins;
+    }
+    st->acquired_at = rdtsc();
+}
+
+// Called just before the lock is released
+static inline void lock_stats_released(LockStats* st) {
+    uint64_t held = rdtsc() - st->acquired_at;
+    st->total_hold += held;
+    if (held > st->max_hold) st->max_hold = held;
+}
@@ -0,0 +1,70 @@
+#include "lz4.h"
+#include "kstring.h"
+
+// ============================================================================
+// LZ4 Block Decoder
+// ============================================================================
+// Sequence layout:
+//   token         high nibble: literal length, low nibble: match length - 4
+//   [length+]     extra bytes while a nibble is 15 (each adds up to 255)
+//   literals
+//   offset        2 bytes, little-endian, 1..65535 back from the output end
+//   [length+]     extra match length bytes
+// The last sequence stops after its literals.
+// ============================================================================
+
+#define LZ4_MIN_MATCH 4
+
+// Add extension bytes to a length of 15. False if src runs out first.
+static bool read_length(const uint8_t** src, const uint8_t* end, size_t* len) {
+    uint8_t b;
+    do {
+        if (*src >= end) return false;
+        b = *(*src)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+int64_t lz4_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    const uint8_t* ip = src;
+    const uint8_t* ip_end = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* op_end = dst + dst_size;
+
+    while (ip < ip_end) {
+        uint8_t token = *ip++;
+
+        // Literals
+        size_t lit = token >> 4;
+        if (lit == 15 && !read_length(&ip, ip_end, &lit)) return -1;
+        if (lit > (size_t)(ip_end - ip) || lit > (size_t)(op_end - op)) return -1;
+        kstring::memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+
+        if (ip == ip_end) break;  // Last sequence: literals only
+
+        // Match
+        if (ip_end - ip < 2) return -1;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+        size_t len = token & 0xF;
+        if (len == 15 && !read_length(&ip, ip_end, &len)) return -1;
+        len += LZ4_MIN_MATCH;
+        if (len > (size_t)(op_end - op)) return -1;
+
+        // A match closer than its length repeats bytes it is writing, so
+        // it must go a byte at a time
+        const uint8_t* match = op - offset;
+        if (offset >= len) {
+            kstring::memcpy(op, match, len);
+        } else {
+            for (size_t i = 0; i < len; i++) op[i] = match[i];
+        }
+        op += len;
+    }
+    return op - dst;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file lz4.h
+ * @brief LZ4 block decompression
+ *
+ * Decodes the LZ4 block format (no frame header): a run of sequences, each
+ * a token, literals and a back-reference into the output. Every read and
+ * write is bounds-checked, so damaged input fails instead of overrunning.
+ *
+ * Usage:
+ *   int64_t n = lz4_decompress(src, src_size, dst, dst_size);
+ *   if (n < 0) ... // Malformed input or dst too small
+ */
+
+// Decode src into dst. Returns the number of bytes written, or -1.
+int64_t lz4_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "lockstat.h"
+
+/**
+ * @file mcslock.h
+ * @brief MCS queued spinlock for hot, contended locks
+ * 
+ * Each acquirer brings its own queue node (normally on its stack) and spins
+ * only on that node's flag; the releaser hands the lock directly to the
+ * next node. Unlike a test-and-set or ticket lock, a waiting CPU never
+ * bounces the lock's cache line, and hand-off is strictly FIFO.
+ * 
+ * Like Spinlock, interrupts and preemption are disabled while the lock is
+ * held.
+ * The same node must be passed to acquire and release.
+ * 
+ * Usage:
+ *   McsLock lock = MCS_LOCK_INIT;
+ *   McsNode node;
+ *   mcs_acquire(&lock, &node);
+ *   // critical section
+ *   mcs_release(&lock, &node);
+ */
+
+struct McsNode {
+    McsNode* volatile next;
+    volatile uint32_t waiting;  // 1 until our predecessor hands over
+};
+
+struct McsLock {
+    McsNode* volatile tail;     // Last node in the queue (nullptr = free)
+    uint64_t saved_flags;       // Saved RFLAGS of the holder
+    LockStats* stats;           // Optional instrumentation (nullptr = off)
+};
+
+#define MCS_LOCK_INIT {nullptr, 0, nullptr}
+#define MCS_LOCK_INIT_STATS(st) {nullptr, 0, (st)}
+
+static inline void mcs_acquire(McsLock* lock, McsNode* node) {
+    uint64_t flags = interrupts_save_disable();
+    preempt_disable();
+    
+    node->next = nullptr;
+    node->waiting = 1;
+    
+    // Join the queue; if someone was ahead, link behind them and wait
+    McsNode* prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    uint64_t spins = 0;
+    if (prev) {
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->waiting, __ATOMIC_ACQUIRE)) {
+            asm volatile("pause" ::: "memory");
+            spins++;
+        }
+    }
+    
+    lock->saved_flags = flags;
+    if (lock->stats) lock_stats_acquired(lock->stats, spins);
+}
+
+static inline void mcs_release(McsLock* lock, McsNode* node) {
+    if (lock->stats) lock_stats_released(lock->stats);
+    uint64_t flags = lock->saved_flags;
+    
+    McsNode* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+        // No known successor: try to mark the lock free
+        McsNode* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, nullptr, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            interrupts_restore(flags);
+            preempt_enable();
+            return;
+        }
+        // A successor swapped itself in but hasn't linked yet - wait for it
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            asm volatile("pause" ::: "memory");
+        }
+    }
+    
+    __atomic_store_n(&next->waiting, 0, __ATOMIC_RELEASE);
+    interrupts_restore(flags);
+    preempt_enable();
+}
+
+static inline bool mcs_is_locked(McsLock* lock) {
+    return __atomic_load_n(&lock->tail, __ATOMIC_RELAXED) != nullptr;
+}
@@ -1,10 +1,35 @@
 #include "mutex.h"
 #include "scheduler.h"
 #include "spinlock.h"
+#include "timer.h"
 
-// Forward declaration
-extern void scheduler_yield();
-extern Process* process_get_current();
+// Slow path: sleep on the wait queue until the lock is free or time runs out
+static bool mutex_lock_slow(Mutex* mtx, Process* current, uint64_t timeout_ticks) {
+    uint64_t deadline = timer_get_ticks() + timeout_ticks;
+    bool acquired = true;
+    
+    spinlock_acquire(&mtx->wait_lock);
+    
+    // Testing under wait_lock pairs with mutex_unlock waking under it, so an
+    // unlock can't slip between our failed attempt and going to sleep
+    while (__sync_lock_test_and_set(&mtx->locked, 1)) {
+        uint64_t wait = WAIT_FOREVER;
+        if (timeout_ticks != WAIT_FOREVER) {
+            uint64_t now = timer_get_ticks();
+            if (now >= deadline) {
+                acquired = false;
+                break;
+            }
+            wait = deadline - now;
+        }
+        wait_queue_sleep(&mtx->waiters, &mtx->wait_lock, wait);
+    }
+    
+    spinlock_release(&mtx->wait_lock);
+    
+    if (acquired) mtx->owner_pid = current->pid;
+    return acquired;
+}
 
 void mutex_lock(Mutex* mtx) {
     Process* current = process_get_current();
@@ -16,35 +41,26 @@ void mutex_lock(Mutex* mtx) {
         return;
     }
     
-    while (true) {
-        // Try to acquire the lock atomically
-        if (__sync_lock_test_and_set(&mtx->locked, 1) == 0) {
-            // Got the lock!
-            mtx->owner_pid = current->pid;
-            return;
-        }
-        
-        // Lock is held by someone else - block and yield
-        spinlock_acquire(&mtx->wait_lock);
-        
-        // Double-check: maybe it was released while we were acquiring wait_lock
-        if (mtx->locked == 0) {
-            spinlock_release(&mtx->wait_lock);
-            continue;  // Try again
-        }
-        
-        // Add ourselves to the wait queue
-        current->state = PROCESS_BLOCKED;
-        current->next = mtx->wait_queue;
-        mtx->wait_queue = current;
-        
-        spinlock_release(&mtx->wait_lock);
-        
-        // Yield CPU to other tasks
-        scheduler_yield();
-        
-        // We've been woken up - try to acquire the lock again
+    // Fast path: uncontended
+    if (__sync_lock_test_and_set(&mtx->locked, 1) == 0) {
+        mtx->owner_pid = current->pid;
+        return;
+    }
+    
+    mutex_lock_slow(mtx, current, WAIT_FOREVER);
+}
+
+bool mutex_lock_timeout(Mutex* mtx, uint64_t timeout_ticks) {
+    if (__sync_lock_test_and_set(&mtx->locked, 1) == 0) {
+        Process* current = process_get_current();
+        if (current) mtx->owner_pid = current->pid;
+        return true;
     }
+    
+    Process* current = process_get_current();
+    if (!current || timeout_ticks == 0) return false;
+    
+    return mutex_lock_slow(mtx, current, timeout_ticks);
 }
 
 bool mutex_try_lock(Mutex* mtx) {
@@ -62,18 +78,10 @@ void mutex_unlock(Mutex* mtx) {
     // Clear owner
     mtx->owner_pid = 0;
     
-    // Release the lock
-    __sync_lock_release(&mtx->locked);
-    
-    // Wake one waiting process if any
+    // Release the lock and hand the wakeup to the longest waiter; it
+    // retries the lock when it runs
     spinlock_acquire(&mtx->wait_lock);
-    
-    if (mtx->wait_queue) {
-        Process* to_wake = mtx->wait_queue;
-        mtx->wait_queue = to_wake->next;
-        to_wake->next = nullptr;
-        to_wake->state = PROCESS_READY;
-    }
-    
+    __sync_lock_release(&mtx->locked);
+    wait_queue_wake_one(&mtx->waiters);
     spinlock_release(&mtx->wait_lock);
 }
@@ -1,7 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include "spinlock.h"
-#include "process.h"
+#include "waitqueue.h"
 
 /**
  * @file mutex.h
@@ -9,6 +9,7 @@
  * 
  * Unlike spinlocks which busy-wait, mutexes block the calling thread
  * and yield the CPU to other tasks. Use mutexes for longer critical sections.
+ * Contended lockers sleep on a wait queue until the owner unlocks.
  * 
  * Usage:
  *   Mutex mtx = MUTEX_INIT;
@@ -21,22 +22,25 @@ struct Mutex {
     volatile uint32_t locked;       // 0 = unlocked, 1 = locked
     volatile uint64_t owner_pid;    // PID of owner (for debugging)
     Spinlock wait_lock;             // Protects the wait queue
-    Process* wait_queue;            // Head of waiting process list
+    WaitQueue waiters;              // Tasks sleeping in mutex_lock
 };
 
-#define MUTEX_INIT {0, 0, SPINLOCK_INIT, nullptr}
+#define MUTEX_INIT {0, 0, SPINLOCK_INIT, WAIT_QUEUE_INIT}
 
 // Initialize a mutex
 static inline void mutex_init(Mutex* mtx) {
     mtx->locked = 0;
     mtx->owner_pid = 0;
     spinlock_init(&mtx->wait_lock);
-    mtx->wait_queue = nullptr;
+    wait_queue_init(&mtx->waiters);
 }
 
 // Acquire mutex (blocks if held by another thread)
 void mutex_lock(Mutex* mtx);
 
+// Acquire mutex, giving up after timeout_ticks. Returns true if acquired.
+bool mutex_lock_timeout(Mutex* mtx, uint64_t timeout_ticks);
+
 // Try to acquire mutex without blocking
 bool mutex_try_lock(Mutex* mtx);
 
@@ -1,6 +1,8 @@
 #include "panic.h"
 #include "debug.h"
 #include "graphics.h"
+#include "fpu.h"
+#include "uaccess.h"
 
 void hcf(void) {
     asm("cli");
@@ -34,6 +36,23 @@ extern "C" void exception_handler(void* stack_frame) {
     uint64_t err_code = regs[16];
     uint64_t rip = regs[17];
 
+    // #NM (Device Not Available): lazy FPU switch, not an error
+    if (int_no == 7) {
+        fpu_handle_nm();
+        return;
+    }
+
+    // #PF inside a user-copy routine: resume at its fixup, which makes the
+    // copy fail with -EFAULT
+    uint64_t cs = regs[18];
+    if (int_no == 14 && (cs & 3) == 0) {
+        uint64_t fixup = uaccess_fixup(rip);
+        if (fixup) {
+            regs[17] = fixup;
+            return;
+        }
+    }
+
     // Red background for exception
     if (gfx_get_width() > 0) {
         // We don't want to clear the whole screen if we can avoid it, 
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @file preempt.h
+ * @brief Kernel preemption control
+ * 
+ * The timer may preempt kernel code as well as user code, except where
+ * preemption is explicitly disabled. preempt_count records why the current
+ * context must not be switched out:
+ * 
+ *   bits  0-7   preempt_disable() nesting (spinlocks, RCU readers)
+ *   bits  8-15  softirq nesting (softirqs running or disabled)
+ *   bits 16-23  hardirq nesting (inside an interrupt handler)
+ * 
+ * A tick that lands while the count is non-zero only sets need_resched;
+ * the switch happens when the count drops back to zero in
+ * preempt_enable() (e.g. on spinlock release), bounding wakeup latency by
+ * the longest non-preemptible section rather than by the next tick.
+ * 
+ * The count is saved per task across context switches.
+ * 
+ * Usage:
+ *   preempt_disable();
+ *   // Touch state that must not be interleaved with another task
+ *   preempt_enable();   // May switch to a higher-priority task here
+ */
+
+#define PREEMPT_MASK    0x000000FFu
+#define SOFTIRQ_OFFSET  0x00000100u
+#define SOFTIRQ_MASK    0x0000FF00u
+#define HARDIRQ_OFFSET  0x00010000u
+#define HARDIRQ_MASK    0x00FF0000u
+
+extern volatile uint32_t preempt_count;
+
+// Set by the scheduler when a switch is wanted (tick or wakeup preemption)
+extern volatile bool need_resched;
+
+// Switch now if a reschedule is pending and we are preemptible
+void preempt_schedule();
+
+static inline void preempt_disable() {
+    preempt_count++;
+    asm volatile("" ::: "memory");
+}
+
+static inline void preempt_enable_no_resched() {
+    asm volatile("" ::: "memory");
+    preempt_count--;
+}
+
+static inline void preempt_enable() {
+    preempt_enable_no_resched();
+    if (preempt_count == 0 && need_resched) {
+        preempt_schedule();
+    }
+}
+
+static inline bool in_irq() {
+    return (preempt_count & HARDIRQ_MASK) != 0;
+}
+
+static inline bool in_interrupt() {
+    return (preempt_count & (HARDIRQ_MASK | SOFTIRQ_MASK)) != 0;
+}
+
+static inline bool preemptible() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0" : "=r"(flags));
+    return preempt_count == 0 && (flags & 0x200);
+}
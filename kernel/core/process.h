@@ -1,5 +1,7 @@
 #pragma once
 #include <stdint.h>
+#include "rbtree.h"
+#include "rcu.h"
 
 enum ProcessState {
     PROCESS_READY,
@@ -23,20 +25,26 @@ struct Context {
     uint64_t rip;
 };
 
-// FPU/SSE state size for fxsave/fxrstor (512 bytes, must be 16-byte aligned)
-#define FPU_STATE_SIZE 512
+// Tasks created with SYS_CLONE share their creator's page table. The group
+// is created lazily on the first clone and freed when its last task is reaped.
+struct ThreadGroup {
+    uint64_t tgid;            // PID of the task that created the group
+    uint32_t refcount;        // Tasks (alive or zombie) using the page table
+};
+
+struct FdTable;
 
 struct Process {
-    // FPU state MUST be first and 16-byte aligned for fxsave/fxrstor
-    // The Process struct itself will be allocated with 16-byte alignment
-    uint8_t fpu_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
+    // FPU/SSE/AVX save area, allocated on first FPU use (see fpu.cpp).
+    // Only valid while this task doesn't own the live FPU registers.
+    uint8_t* fpu_state;
     
-    // Offset 512: Process metadata
+    // Offset 8: Process metadata
     uint64_t pid;
     uint64_t parent_pid;      // Parent process ID
     char name[32];            // Human-readable task name (e.g., "Shell", "Idle")
     uint64_t cpu_time;        // Ticks consumed (for profiling)
-    uint64_t sp;              // Stack Pointer (offset 528 = 512 + 16)
+    uint64_t sp;              // Stack Pointer (offset 64, used by process.asm)
     uint64_t* stack_base;     // Virtual address of stack (KERNEL_STACK_TOP - SIZE)
     uint64_t stack_phys;      // Physical address of stack (for freeing)
     uint64_t* page_table;     // Process page table (PML4 virtual address)
@@ -44,15 +52,50 @@ struct Process {
     int32_t exit_status;      // Exit code when ZOMBIE
     uint64_t wait_for_pid;    // PID to wait for (0 = any child)
     uint64_t wake_time;       // Timer tick when process should wake (for SLEEPING)
-    bool fpu_initialized;     // Whether FPU state has been initialized
-    Process* next;
+    bool fpu_used;            // Task has executed FPU/SSE instructions
+    Process* next;            // Circular task list (RCU: readers walk it lock-free)
+    Process* prev;            // Back link for O(1) unlink (writers only)
+    RcuHead rcu;              // Deferred free after the task is reaped
+    
+    // Family (protected by the scheduler lock)
+    Process* parent;          // nullptr for the boot task and orphans
+    Process* children;        // Most recently created child
+    Process* sibling_next;    // Next/previous child of the same parent
+    Process* sibling_prev;
+    Process* reap_next;       // Reaper queue link
+    
+    // Threads
+    ThreadGroup* group;       // Shared address space, nullptr if single-threaded
+    uint64_t fs_base;         // User TLS pointer (IA32_FS_BASE)
+    
+    // Open files (see vfs.h): copied by fork, shared by clone, created on
+    // first use and closed at exit
+    FdTable* files;
+    
+    // Fair scheduler bookkeeping (see scheduler.cpp)
+    RBNode run_node;          // Link in the run queue, keyed by vruntime
+    bool on_rq;               // Currently queued in a run queue
+    uint8_t policy;           // SCHED_NORMAL or SCHED_IDLE
+    int8_t nice;              // Nice level (-20 = highest priority, 19 = lowest)
+    uint32_t weight;          // Load weight derived from nice
+    uint64_t vruntime;        // Virtual runtime (weighted TSC cycles)
+    uint64_t sum_exec;        // Total TSC cycles executed
+    uint64_t slice_exec;      // sum_exec when the task was last switched in
+    uint64_t exec_start;      // TSC at last accounting point while running
+    uint64_t wakeup_tsc;      // TSC of the last wakeup (latency tracing, 0 = none)
+    uint32_t preempt_count;   // Saved preempt_count while switched out
 };
 
 extern "C" void switch_to_task(Process* current, Process* next);
 
 // New process management functions
 Process* process_get_current();
+// Call inside rcu_read_lock(): the returned task stays valid until the
+// matching rcu_read_unlock(), as a reaped task is freed after a grace period
 Process* process_find_by_pid(uint64_t pid);
 uint64_t process_fork();
+uint64_t process_clone(uint64_t entry, uint64_t user_stack, uint64_t arg, uint64_t tls);
+uint64_t process_get_tgid(Process* p);
+void process_set_fs_base(uint64_t base);
 void process_exit(int32_t status);
 int64_t process_waitpid(int64_t pid, int32_t* status);
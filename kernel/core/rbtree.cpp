@@ -0,0 +1,225 @@
+#include "rbtree.h"
+
+// ============================================================================
+// Red-Black Tree
+// ============================================================================
+// Classic CLRS formulation with parent pointers and nullptr leaves.
+// nullptr children count as black.
+// ============================================================================
+
+static inline bool is_red(const RBNode* n) {
+    return n && n->color == RB_RED;
+}
+
+static inline bool is_black(const RBNode* n) {
+    return !n || n->color == RB_BLACK;
+}
+
+// Replace old_child with new_child in parent's child slot (or the root)
+static void change_child(RBNode* old_child, RBNode* new_child, RBNode* parent, RBRoot* root) {
+    if (!parent) {
+        root->node = new_child;
+    } else if (parent->left == old_child) {
+        parent->left = new_child;
+    } else {
+        parent->right = new_child;
+    }
+}
+
+static void rotate_left(RBNode* x, RBRoot* root) {
+    RBNode* y = x->right;
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    y->parent = x->parent;
+    change_child(x, y, x->parent, root);
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(RBNode* x, RBRoot* root) {
+    RBNode* y = x->left;
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    y->parent = x->parent;
+    change_child(x, y, x->parent, root);
+    y->right = x;
+    x->parent = y;
+}
+
+void rb_insert_color(RBNode* node, RBRoot* root) {
+    RBNode* parent;
+
+    while ((parent = node->parent) && is_red(parent)) {
+        RBNode* gparent = parent->parent;
+
+        if (parent == gparent->left) {
+            RBNode* uncle = gparent->right;
+            if (is_red(uncle)) {
+                // Case 1: recolor and move up
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                // Case 2: rotate into case 3
+                rotate_left(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            // Case 3
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rotate_right(gparent, root);
+        } else {
+            RBNode* uncle = gparent->left;
+            if (is_red(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rotate_right(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rotate_left(gparent, root);
+        }
+    }
+
+    root->node->color = RB_BLACK;
+}
+
+// Restore black height after removing a black node.
+// x may be nullptr, so its parent is tracked separately.
+static void erase_fixup(RBNode* x, RBNode* parent, RBRoot* root) {
+    while (x != root->node && is_black(x)) {
+        if (x == parent->left) {
+            RBNode* w = parent->right;
+            if (is_red(w)) {
+                w->color = RB_BLACK;
+                parent->color = RB_RED;
+                rotate_left(parent, root);
+                w = parent->right;
+            }
+            if (is_black(w->left) && is_black(w->right)) {
+                w->color = RB_RED;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (is_black(w->right)) {
+                    w->left->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rotate_right(w, root);
+                    w = parent->right;
+                }
+                w->color = parent->color;
+                parent->color = RB_BLACK;
+                if (w->right) w->right->color = RB_BLACK;
+                rotate_left(parent, root);
+                x = root->node;
+                break;
+            }
+        } else {
+            RBNode* w = parent->left;
+            if (is_red(w)) {
+                w->color = RB_BLACK;
+                parent->color = RB_RED;
+                rotate_right(parent, root);
+                w = parent->left;
+            }
+            if (is_black(w->left) && is_black(w->right)) {
+                w->color = RB_RED;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (is_black(w->left)) {
+                    w->right->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rotate_left(w, root);
+                    w = parent->left;
+                }
+                w->color = parent->color;
+                parent->color = RB_BLACK;
+                if (w->left) w->left->color = RB_BLACK;
+                rotate_right(parent, root);
+                x = root->node;
+                break;
+            }
+        }
+    }
+
+    if (x) x->color = RB_BLACK;
+}
+
+void rb_erase(RBNode* node, RBRoot* root) {
+    RBNode* child;
+    RBNode* parent;
+    uint8_t removed_color;
+
+    if (!node->left || !node->right) {
+        // At most one child: splice node out directly
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        removed_color = node->color;
+
+        if (child) child->parent = parent;
+        change_child(node, child, parent, root);
+    } else {
+        // Two children: move the in-order successor into node's place
+        RBNode* succ = node->right;
+        while (succ->left) succ = succ->left;
+
+        child = succ->right;
+        removed_color = succ->color;
+
+        if (succ->parent == node) {
+            parent = succ;
+        } else {
+            parent = succ->parent;
+            parent->left = child;
+            if (child) child->parent = parent;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+
+        succ->left = node->left;
+        node->left->parent = succ;
+        succ->parent = node->parent;
+        succ->color = node->color;
+        change_child(node, succ, node->parent, root);
+    }
+
+    node->parent = node->left = node->right = nullptr;
+
+    if (removed_color == RB_BLACK) {
+        erase_fixup(child, parent, root);
+    }
+}
+
+RBNode* rb_first(const RBRoot* root) {
+    RBNode* n = root->node;
+    if (!n) return nullptr;
+    while (n->left) n = n->left;
+    return n;
+}
+
+RBNode* rb_next(const RBNode* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) node = node->left;
+        return (RBNode*)node;
+    }
+
+    RBNode* parent = node->parent;
+    while (parent && node == parent->right) {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
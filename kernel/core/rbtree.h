@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file rbtree.h
+ * @brief Intrusive red-black tree
+ *
+ * The node is embedded in the owning structure; the tree never allocates.
+ * Callers do their own ordered descent (so the key and comparison stay
+ * with the owner), link the new node at the leaf they found, then let
+ * rb_insert_color() rebalance.
+ *
+ * Usage:
+ *   RBNode** link = &root->node;
+ *   RBNode* parent = nullptr;
+ *   while (*link) {
+ *       parent = *link;
+ *       Item* it = rb_entry(parent, Item, node);
+ *       link = (key < it->key) ? &parent->left : &parent->right;
+ *   }
+ *   rb_link_node(&item->node, parent, link);
+ *   rb_insert_color(&item->node, root);
+ */
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+struct RBNode {
+    RBNode* parent;
+    RBNode* left;
+    RBNode* right;
+    uint8_t color;
+};
+
+struct RBRoot {
+    RBNode* node;
+};
+
+#define RB_ROOT_INIT {nullptr}
+
+// Recover the containing structure from an embedded RBNode
+#define rb_entry(ptr, type, member) \
+    ((type*)((uint8_t*)(ptr) - offsetof(type, member)))
+
+/**
+ * @brief Attach a freshly zeroed node below parent at *link
+ */
+static inline void rb_link_node(RBNode* node, RBNode* parent, RBNode** link) {
+    node->parent = parent;
+    node->left = nullptr;
+    node->right = nullptr;
+    node->color = RB_RED;
+    *link = node;
+}
+
+// Rebalance after rb_link_node()
+void rb_insert_color(RBNode* node, RBRoot* root);
+
+// Remove a node from the tree
+void rb_erase(RBNode* node, RBRoot* root);
+
+// In-order traversal helpers (nullptr when the tree is empty / at the end)
+RBNode* rb_first(const RBRoot* root);
+RBNode* rb_next(const RBNode* node);
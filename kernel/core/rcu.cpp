@@ -0,0 +1,144 @@
+#include "rcu.h"
+#include "spinlock.h"
+#include "waitqueue.h"
+#include "process.h"
+#include "panic.h"
+#include "softirq.h"
+
+volatile uint32_t rcu_read_nesting = 0;
+
+// ============================================================================
+// Callback Lists
+// ============================================================================
+// Callbacks move through three segments:
+//   next - queued, waiting for a grace period to start
+//   wait - waiting for the current grace period to end
+//   done - grace period over; invoked from the RCU softirq
+// A grace period starts at one quiescent state and ends at the next, so
+// every read-side section that was running when a callback was queued has
+// finished before the callback runs. With more CPUs, "the next quiescent
+// state" becomes "every CPU has passed through one".
+// ============================================================================
+
+struct RcuList {
+    RcuHead* head;
+    RcuHead** tail;
+};
+
+static RcuList next_list = {nullptr, &next_list.head};
+static RcuList wait_list = {nullptr, &wait_list.head};
+static RcuList done_list = {nullptr, &done_list.head};
+
+static bool gp_active = false;
+static uint64_t gp_seq = 0;
+
+static inline void list_append(RcuList* dst, RcuList* src) {
+    if (!src->head) return;
+    *dst->tail = src->head;
+    dst->tail = src->tail;
+    src->head = nullptr;
+    src->tail = &src->head;
+}
+
+// Interrupts must be disabled
+static void rcu_quiescent_state() {
+    if (gp_active) {
+        gp_active = false;
+        gp_seq++;
+        list_append(&done_list, &wait_list);
+    }
+    if (next_list.head) {
+        list_append(&wait_list, &next_list);
+        gp_active = true;
+    }
+}
+
+void call_rcu(RcuHead* head, void (*func)(RcuHead* head)) {
+    head->func = func;
+    head->next = nullptr;
+
+    uint64_t flags = interrupts_save_disable();
+    *next_list.tail = head;
+    next_list.tail = &head->next;
+    interrupts_restore(flags);
+}
+
+void rcu_note_context_switch() {
+    // A task can't keep a read-side section across a switch: the next
+    // task would inherit the nesting count
+    if (rcu_read_nesting) {
+        panic("Context switch inside RCU read-side critical section");
+    }
+    rcu_quiescent_state();
+}
+
+void rcu_tick() {
+    // The tick interrupted code outside any read-side section
+    if (!rcu_read_nesting) {
+        rcu_quiescent_state();
+    }
+
+    // Callbacks run after the interrupt, outside the hard IRQ path
+    if (done_list.head) {
+        raise_softirq(SOFTIRQ_RCU);
+    }
+}
+
+static void rcu_process_callbacks() {
+    uint64_t flags = interrupts_save_disable();
+    RcuHead* head = done_list.head;
+    done_list.head = nullptr;
+    done_list.tail = &done_list.head;
+    interrupts_restore(flags);
+
+    while (head) {
+        RcuHead* next = head->next;
+        head->func(head);
+        head = next;
+    }
+}
+
+void rcu_init() {
+    open_softirq(SOFTIRQ_RCU, rcu_process_callbacks);
+}
+
+uint64_t rcu_get_gp_seq() {
+    return gp_seq;
+}
+
+// ============================================================================
+// synchronize_rcu
+// ============================================================================
+
+struct RcuSync {
+    RcuHead head;
+    Spinlock lock;
+    WaitQueue waiters;
+    bool done;
+};
+
+static void rcu_sync_callback(RcuHead* head) {
+    RcuSync* sync = rcu_container_of(head, RcuSync, head);
+    spinlock_acquire(&sync->lock);
+    sync->done = true;
+    wait_queue_wake_all(&sync->waiters);
+    spinlock_release(&sync->lock);
+}
+
+void synchronize_rcu() {
+    // Before the scheduler runs there is nobody to race with
+    if (!process_get_current()) return;
+
+    RcuSync sync;
+    sync.lock = SPINLOCK_INIT;
+    wait_queue_init(&sync.waiters);
+    sync.done = false;
+
+    call_rcu(&sync.head, rcu_sync_callback);
+
+    spinlock_acquire(&sync.lock);
+    while (!sync.done) {
+        wait_queue_sleep(&sync.waiters, &sync.lock, WAIT_FOREVER);
+    }
+    spinlock_release(&sync.lock);
+}
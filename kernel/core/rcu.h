@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "preempt.h"
+
+/**
+ * @file rcu.h
+ * @brief Read-copy-update for read-mostly kernel tables
+ * 
+ * Readers traverse shared data without taking any lock, inside
+ * rcu_read_lock()/rcu_read_unlock(). Writers (serialized by their own lock)
+ * never modify an object a reader may be looking at: they publish a new
+ * version with rcu_assign_pointer() and hand the old one to call_rcu(),
+ * which frees it once every reader that could have seen it has finished.
+ * 
+ * Grace periods are detected at context switches and timer ticks: a CPU
+ * that switches tasks, or takes a tick outside any read-side section, can
+ * no longer hold references from before. Read-side sections therefore
+ * must not sleep, and rcu_read_lock() disables preemption. Code running
+ * with interrupts disabled is implicitly a read-side section.
+ * 
+ * Usage (reader):
+ *   rcu_read_lock();
+ *   Foo* f = rcu_dereference(table[i]);
+ *   if (f) use(f->field);
+ *   rcu_read_unlock();
+ * 
+ * Usage (writer, holding the table's update lock):
+ *   Foo* old = table[i];
+ *   rcu_assign_pointer(table[i], replacement);
+ *   call_rcu(&old->rcu, foo_free_rcu);
+ */
+
+struct RcuHead {
+    RcuHead* next;
+    void (*func)(RcuHead* head);
+};
+
+// Recover the enclosing object from its embedded RcuHead
+#define rcu_container_of(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+// Read-side nesting depth of this CPU (a single CPU for now)
+extern volatile uint32_t rcu_read_nesting;
+
+static inline void rcu_read_lock() {
+    preempt_disable();
+    rcu_read_nesting++;
+    asm volatile("" ::: "memory");
+}
+
+static inline void rcu_read_unlock() {
+    asm volatile("" ::: "memory");
+    rcu_read_nesting--;
+    preempt_enable();
+}
+
+static inline bool rcu_read_lock_held() {
+    return rcu_read_nesting != 0;
+}
+
+// Load an RCU-protected pointer (pairs with rcu_assign_pointer)
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+// Publish a pointer after the object it points to is fully initialized
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+// Invoke func(head) after a grace period. Safe from any context.
+void call_rcu(RcuHead* head, void (*func)(RcuHead* head));
+
+// Block until a full grace period has elapsed (task context only)
+void synchronize_rcu();
+
+// Register the callback softirq (before interrupts are enabled)
+void rcu_init();
+
+// Scheduler hooks
+void rcu_note_context_switch();  // Quiescent state (interrupts disabled)
+void rcu_tick();                 // Timer tick: quiescent check, raise callbacks
+
+// Number of completed grace periods (for diagnostics)
+uint64_t rcu_get_gp_seq();
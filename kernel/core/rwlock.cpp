@@ -0,0 +1,43 @@
+#include "rwlock.h"
+
+void rw_read_lock(RWLock* rw) {
+    spinlock_acquire(&rw->lock);
+    while (rw->writer || rw->writers_waiting) {
+        wait_queue_sleep(&rw->read_waiters, &rw->lock, WAIT_FOREVER);
+    }
+    rw->readers++;
+    spinlock_release(&rw->lock);
+}
+
+void rw_read_unlock(RWLock* rw) {
+    spinlock_acquire(&rw->lock);
+    rw->readers--;
+    // Last reader out hands over to one writer
+    if (rw->readers == 0) {
+        wait_queue_wake_one(&rw->write_waiters);
+    }
+    spinlock_release(&rw->lock);
+}
+
+void rw_write_lock(RWLock* rw) {
+    spinlock_acquire(&rw->lock);
+    rw->writers_waiting++;
+    while (rw->writer || rw->readers) {
+        wait_queue_sleep(&rw->write_waiters, &rw->lock, WAIT_FOREVER);
+    }
+    rw->writers_waiting--;
+    rw->writer = true;
+    spinlock_release(&rw->lock);
+}
+
+void rw_write_unlock(RWLock* rw) {
+    spinlock_acquire(&rw->lock);
+    rw->writer = false;
+    // Prefer the next writer; otherwise let every queued reader in
+    if (rw->writers_waiting) {
+        wait_queue_wake_one(&rw->write_waiters);
+    } else {
+        wait_queue_wake_all(&rw->read_waiters);
+    }
+    spinlock_release(&rw->lock);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "waitqueue.h"
+
+/**
+ * @file rwlock.h
+ * @brief Sleeping reader-writer lock
+ * 
+ * Any number of readers, or a single writer. Writers are preferred: once a
+ * writer is waiting, new readers queue behind it so a steady stream of
+ * readers can't starve writers.
+ * 
+ * Usage:
+ *   RWLock rw = RWLOCK_INIT;
+ *   rw_read_lock(&rw);   ...   rw_read_unlock(&rw);
+ *   rw_write_lock(&rw);  ...   rw_write_unlock(&rw);
+ */
+
+struct RWLock {
+    Spinlock lock;                  // Protects all fields below
+    uint32_t readers;               // Active readers
+    uint32_t writers_waiting;       // Writers queued in rw_write_lock
+    bool writer;                    // A writer holds the lock
+    WaitQueue read_waiters;
+    WaitQueue write_waiters;
+};
+
+#define RWLOCK_INIT {SPINLOCK_INIT, 0, 0, false, WAIT_QUEUE_INIT, WAIT_QUEUE_INIT}
+
+static inline void rwlock_init(RWLock* rw) {
+    spinlock_init(&rw->lock);
+    rw->readers = 0;
+    rw->writers_waiting = 0;
+    rw->writer = false;
+    wait_queue_init(&rw->read_waiters);
+    wait_queue_init(&rw->write_waiters);
+}
+
+void rw_read_lock(RWLock* rw);
+void rw_read_unlock(RWLock* rw);
+void rw_write_lock(RWLock* rw);
+void rw_write_unlock(RWLock* rw);
@@ -5,16 +5,32 @@
 #include "vmm.h"  // For VMM isolation
 #include "debug.h"
 #include "spinlock.h"
+#include "mcslock.h"
 #include "timer.h"
 #include "gdt.h"  // For tss_set_rsp0
 #include "kstring.h"
+#include "io.h"   // For rdtsc
+#include "fpu.h"
+#include "rcu.h"
+#include "softirq.h"
+#include "preempt.h"
+#include "waitqueue.h"
+#include "vfs.h"
+#include "vdso.h"
 #include <stddef.h>
 
-// External assembly function to initialize FPU state
-extern "C" void init_fpu_state(uint8_t* fpu_buffer);
+// First instructions of a cloned thread (usermode.asm)
+extern "C" void thread_start();
+
+// First instructions of a kernel thread with an argument (process.asm)
+extern "C" void kthread_start();
+
+// process.asm addresses Process::sp directly
+static_assert(offsetof(Process, sp) == 64, "process.asm expects Process::sp at offset 64");
 
 // Scheduler lock for thread safety
-static Spinlock scheduler_lock = SPINLOCK_INIT;
+static LockStats scheduler_lock_stats = LOCK_STATS_INIT("scheduler");
+static McsLock scheduler_lock = MCS_LOCK_INIT_STATS(&scheduler_lock_stats);
 
 // KERNEL_STACK_SIZE and KERNEL_STACK_TOP are now defined in vmm.h
 
@@ -22,20 +38,395 @@ static Process* current_process = nullptr;
 static Process* process_list = nullptr;
 static uint64_t next_pid = 1;
 
+// Value currently in IA32_FS_BASE, so switches between tasks with the same
+// TLS pointer (e.g. two kernel tasks) can skip the MSR write
+static uint64_t loaded_fs_base = 0;
+
+// ============================================================================
+// Fair Scheduling (CFS-style)
+// ============================================================================
+// Every runnable task carries a virtual runtime: the TSC cycles it has
+// executed, scaled by NICE_0_WEIGHT / weight. The run queue is a red-black
+// tree ordered by vruntime and the leftmost task (the one that has received
+// the least weighted CPU) runs next. Higher weight (lower nice) makes
+// vruntime advance more slowly, which yields a proportionally larger share.
+//
+// The running task is kept OUT of the tree; it is re-inserted when switched
+// out. SCHED_IDLE tasks live in a separate queue that is only consulted
+// when the fair queue is empty.
+// ============================================================================
+
+#define NICE_0_WEIGHT 1024
+
+// Linux's nice-to-weight table: each nice step is ~10% CPU (factor ~1.25)
+static const uint32_t nice_to_weight[40] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+};
+
+// Tunables, in timer ticks (1ms at 1000Hz)
+#define SCHED_LATENCY_TICKS     6   // Period in which every runnable task runs once
+#define SCHED_MIN_GRAN_TICKS    1   // Minimum slice before tick preemption
+#define SCHED_WAKEUP_GRAN_TICKS 1   // vruntime lead a waker needs to preempt
+
+struct RunQueue {
+    RBRoot root;
+    RBNode* leftmost;       // Cached rb_first()
+    uint32_t nr_running;    // Queued tasks (excludes current)
+    uint64_t load;          // Sum of queued weights
+    uint64_t min_vruntime;  // Monotonic floor for placing new/woken tasks
+};
+
+static RunQueue fair_rq = {RB_ROOT_INIT, nullptr, 0, 0, 0};
+static RunQueue idle_rq = {RB_ROOT_INIT, nullptr, 0, 0, 0};
+
+volatile bool need_resched = false;
+static Process* yield_skip = nullptr;  // Task that asked to step aside once
+
+// Preemption-disable depth of the running task (saved in Process on switch)
+volatile uint32_t preempt_count = 0;
+
+// ============================================================================
+// Scheduling Latency Tracing
+// ============================================================================
+// Wakeup latency: TSC at scheduler_wake() to TSC when the woken task is
+// switched in. Preemption delay: how long a tick-requested switch had to
+// wait for the running code to leave a non-preemptible section.
+// ============================================================================
+
+static SchedLatencyStats lat_stats;
+static uint64_t preempt_deferred_at = 0;  // TSC of the first deferred tick
+
+// TSC cycles per timer tick, calibrated continuously against the PIT
+static uint64_t tsc_per_tick = 0;
+static uint64_t calib_tsc = 0;
+static uint64_t calib_ticks = 0;
+#define TSC_CALIB_INTERVAL 100  // Ticks between recalibrations
+
+static inline RunQueue* rq_of(Process* p) {
+    return (p->policy == SCHED_IDLE) ? &idle_rq : &fair_rq;
+}
+
+// Convert ticks to TSC cycles (falls back to 1 cycle/tick before calibration,
+// which degrades gracefully to "preempt on every tick")
+static inline uint64_t ticks_to_cycles(uint64_t t) {
+    return t * (tsc_per_tick ? tsc_per_tick : 1);
+}
+
+static inline uint64_t calc_delta_fair(uint64_t delta, Process* p) {
+    if (p->weight == NICE_0_WEIGHT) return delta;
+    return delta * NICE_0_WEIGHT / p->weight;
+}
+
+static void update_min_vruntime(RunQueue* rq) {
+    uint64_t vr = rq->min_vruntime;
+    bool have = false;
+
+    if (current_process && rq_of(current_process) == rq &&
+        current_process->state == PROCESS_RUNNING) {
+        vr = current_process->vruntime;
+        have = true;
+    }
+    if (rq->leftmost) {
+        uint64_t left = rb_entry(rq->leftmost, Process, run_node)->vruntime;
+        vr = have ? (left < vr ? left : vr) : left;
+    }
+
+    // Never move backwards
+    if ((int64_t)(vr - rq->min_vruntime) > 0) {
+        rq->min_vruntime = vr;
+    }
+}
+
+static void enqueue_task(Process* p) {
+    if (p->on_rq) return;
+    RunQueue* rq = rq_of(p);
+
+    RBNode** link = &rq->root.node;
+    RBNode* parent = nullptr;
+    bool leftmost = true;
+
+    while (*link) {
+        parent = *link;
+        Process* entry = rb_entry(parent, Process, run_node);
+        // Equal keys go right so tasks with the same vruntime stay FIFO
+        if ((int64_t)(p->vruntime - entry->vruntime) < 0) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    rb_link_node(&p->run_node, parent, link);
+    rb_insert_color(&p->run_node, &rq->root);
+    if (leftmost) rq->leftmost = &p->run_node;
+
+    rq->nr_running++;
+    rq->load += p->weight;
+    p->on_rq = true;
+}
+
+static void dequeue_task(Process* p) {
+    if (!p->on_rq) return;
+    RunQueue* rq = rq_of(p);
+
+    if (rq->leftmost == &p->run_node) {
+        rq->leftmost = rb_next(&p->run_node);
+    }
+    rb_erase(&p->run_node, &rq->root);
+
+    rq->nr_running--;
+    rq->load -= p->weight;
+    p->on_rq = false;
+}
+
+// Charge the running task for the cycles since its last accounting point
+static void update_curr() {
+    Process* curr = current_process;
+    if (!curr) return;
+
+    uint64_t now = rdtsc();
+    uint64_t delta = now - curr->exec_start;
+    curr->exec_start = now;
+
+    curr->sum_exec += delta;
+    curr->vruntime += calc_delta_fair(delta, curr);
+    if (tsc_per_tick) {
+        curr->cpu_time = curr->sum_exec / tsc_per_tick;
+    }
+
+    update_min_vruntime(rq_of(curr));
+}
+
+// Position a new or waking task relative to the queue's min_vruntime.
+// Sleepers get up to half a latency period of credit so interactive tasks
+// (shell, network) run promptly, without letting them bank unbounded credit.
+static void place_task(Process* p, bool initial) {
+    RunQueue* rq = rq_of(p);
+    uint64_t vr = rq->min_vruntime;
+
+    if (initial) {
+        // New tasks start one slice behind so fork storms can't starve others
+        vr += ticks_to_cycles(SCHED_MIN_GRAN_TICKS);
+    } else {
+        vr -= ticks_to_cycles(SCHED_LATENCY_TICKS) / 2;
+    }
+
+    // Never give a task back vruntime it already consumed
+    if ((int64_t)(vr - p->vruntime) > 0) {
+        p->vruntime = vr;
+    }
+}
+
+static Process* pick_next_task() {
+    RunQueue* rq = fair_rq.leftmost ? &fair_rq : &idle_rq;
+    if (!rq->leftmost) return nullptr;
+
+    Process* first = rb_entry(rq->leftmost, Process, run_node);
+    if (first == yield_skip) {
+        RBNode* second = rb_next(rq->leftmost);
+        if (second) first = rb_entry(second, Process, run_node);
+    }
+    return first;
+}
+
+// Called from timer context: has the current task used up its fair slice?
+static bool check_preempt_tick() {
+    Process* curr = current_process;
+
+    // Any fair task beats an idle-class task immediately
+    if (curr->policy == SCHED_IDLE) return fair_rq.nr_running > 0;
+
+    if (fair_rq.nr_running == 0) return false;
+
+    // Without a calibrated TSC, fall back to round-robin on every tick
+    if (!tsc_per_tick) return true;
+
+    uint64_t nr = fair_rq.nr_running + 1;
+    uint64_t period = SCHED_LATENCY_TICKS;
+    if (nr > SCHED_LATENCY_TICKS / SCHED_MIN_GRAN_TICKS) {
+        period = nr * SCHED_MIN_GRAN_TICKS;
+    }
+
+    uint64_t total_load = fair_rq.load + curr->weight;
+    uint64_t ideal = ticks_to_cycles(period) * curr->weight / total_load;
+    uint64_t ran = curr->sum_exec - curr->slice_exec;
+
+    if (ran > ideal) return true;
+    if (ran < ticks_to_cycles(SCHED_MIN_GRAN_TICKS)) return false;
+
+    Process* left = rb_entry(fair_rq.leftmost, Process, run_node);
+    int64_t lead = (int64_t)(curr->vruntime - left->vruntime);
+    return lead > (int64_t)ideal;
+}
+
+static void tsc_calibrate_tick() {
+    uint64_t now_ticks = timer_get_ticks();
+    uint64_t now_tsc = rdtsc();
+
+    if (calib_ticks == 0) {
+        calib_ticks = now_ticks;
+        calib_tsc = now_tsc;
+        return;
+    }
+
+    uint64_t elapsed = now_ticks - calib_ticks;
+    if (elapsed >= TSC_CALIB_INTERVAL) {
+        tsc_per_tick = (now_tsc - calib_tsc) / elapsed;
+        calib_ticks = now_ticks;
+        calib_tsc = now_tsc;
+    }
+}
+
 Process* process_get_current() {
     return current_process;
 }
 
 Process* process_find_by_pid(uint64_t pid) {
-    Process* p = process_list;
-    if (!p) return nullptr;
+    // Lock-free walk: writers publish links with rcu_assign_pointer and
+    // reaped tasks are freed only after a grace period, which can't end
+    // while the caller's read-side section is open
+    Process* head = rcu_dereference(process_list);
+    Process* p = head;
+    if (p) {
+        do {
+            if (p->pid == pid) return p;
+            p = rcu_dereference(p->next);
+        } while (p != head);
+    }
+    return nullptr;
+}
+
+// Link a fully initialized task into the circular list (scheduler_lock held).
+// Its own next pointer is set before it becomes reachable.
+static void process_list_append(Process* p) {
+    Process* last = process_list->prev;
+    p->next = process_list;
+    p->prev = last;
+    rcu_assign_pointer(last->next, p);
+    process_list->prev = p;
+}
+
+// Unlink from the circular list (scheduler_lock held). p->next stays
+// intact so a reader standing on p can still walk back into the list.
+static void process_list_remove(Process* p) {
+    rcu_assign_pointer(p->prev->next, p->next);
+    p->next->prev = p->prev;
+    if (process_list == p) {
+        rcu_assign_pointer(process_list, p->next);
+    }
+}
+
+// Parent/child links (scheduler_lock held)
+static void link_child(Process* parent, Process* child) {
+    child->parent = parent;
+    child->parent_pid = parent ? parent->pid : 0;
+    child->sibling_prev = nullptr;
+    child->sibling_next = parent ? parent->children : nullptr;
+    if (!parent) return;
+    if (parent->children) parent->children->sibling_prev = child;
+    parent->children = child;
+}
+
+static void unlink_child(Process* child) {
+    Process* parent = child->parent;
+    if (!parent) return;
+    if (child->sibling_prev) child->sibling_prev->sibling_next = child->sibling_next;
+    else parent->children = child->sibling_next;
+    if (child->sibling_next) child->sibling_next->sibling_prev = child->sibling_prev;
+    child->sibling_next = child->sibling_prev = nullptr;
+    child->parent = nullptr;
+}
+
+static void process_free_rcu(RcuHead* head) {
+    free(rcu_container_of(head, Process, rcu));
+}
+
+// ============================================================================
+// Reaper
+// ============================================================================
+// Freeing a dead task (kernel stack, address space, FPU state) is handed to
+// the reaper thread, so wait() only unlinks the zombie and returns. Orphans
+// - tasks whose parent exited first - go to the reaper as soon as they die.
+// A queued task has always switched out for good: on one CPU the reaper
+// can't run until the dying task has called scheduler_schedule().
+// ============================================================================
+
+static Spinlock reap_lock = SPINLOCK_INIT;
+static WaitQueue reap_wait = WAIT_QUEUE_INIT;
+static Process* reap_list = nullptr;
+static uint64_t reaped_count = 0;
+
+// Hand an unlinked zombie to the reaper
+static void reaper_queue(Process* p) {
+    spinlock_acquire(&reap_lock);
+    p->reap_next = reap_list;
+    reap_list = p;
+    wait_queue_wake_one(&reap_wait);
+    spinlock_release(&reap_lock);
+}
+
+static void release_task(Process* p) {
+    McsNode node;
     
-    do {
-        if (p->pid == pid) return p;
-        p = p->next;
-    } while (p != process_list);
+    // The address space goes away with the last task using it
+    bool last_user = true;
+    if (p->group) {
+        mcs_acquire(&scheduler_lock, &node);
+        last_user = (--p->group->refcount == 0);
+        mcs_release(&scheduler_lock, &node);
+        if (last_user) free(p->group);
+    }
     
-    return nullptr;
+    if (p->stack_phys) {
+        // VMM-isolated process - free physical stack pages
+        size_t stack_pages = KERNEL_STACK_SIZE / 4096;
+        for (size_t i = 0; i < stack_pages; i++) {
+            pmm_free_frame((void*)(p->stack_phys + i * 4096));
+        }
+    } else if (p->stack_base) {
+        // Kernel task or thread - stack was heap-allocated
+        free(p->stack_base);
+    }
+    
+    if (p->page_table && last_user) {
+        // Free address space (user pages + page tables)
+        vmm_free_address_space(p->page_table);
+    }
+    fpu_release(p);
+    
+    DEBUG_INFO("Reaped PID %d\n", p->pid);
+    call_rcu(&p->rcu, process_free_rcu);
+}
+
+static void reaper_entry() {
+    while (true) {
+        spinlock_acquire(&reap_lock);
+        while (!reap_list) {
+            wait_queue_sleep(&reap_wait, &reap_lock, WAIT_FOREVER);
+        }
+        Process* batch = reap_list;
+        reap_list = nullptr;
+        spinlock_release(&reap_lock);
+        
+        while (batch) {
+            Process* p = batch;
+            batch = p->reap_next;
+            release_task(p);
+            reaped_count++;
+        }
+    }
+}
+
+uint64_t scheduler_get_reaped_count() {
+    return reaped_count;
 }
 
 Process* scheduler_get_process_list() {
@@ -46,8 +437,7 @@ void scheduler_init() {
     DEBUG_INFO("Initializing Scheduler...\n");
     
     // Create a process struct for the current running kernel thread (idle task)
-    // Use aligned_alloc to ensure FPU state is 16-byte aligned for fxsave/fxrstor
-    current_process = (Process*)aligned_alloc(16, sizeof(Process));
+    current_process = (Process*)malloc(sizeof(Process));
     if (!current_process) {
         panic("Failed to allocate initial process!");
     }
@@ -87,27 +477,41 @@ void scheduler_init() {
     current_process->exit_status = 0;
     current_process->wait_for_pid = 0;
     current_process->next = current_process; // Circular list
+    current_process->prev = current_process;
+    
+    // Fair scheduler state: runs immediately, so not queued
+    current_process->policy = SCHED_NORMAL;
+    current_process->nice = 0;
+    current_process->weight = NICE_0_WEIGHT;
+    current_process->exec_start = rdtsc();
     
-    // Initialize FPU state for idle task
-    init_fpu_state(current_process->fpu_state);
-    current_process->fpu_initialized = true;
+    // FPU state is allocated lazily on first use (see fpu.cpp)
+    current_process->fpu_state = nullptr;
+    current_process->fpu_used = false;
     
     process_list = current_process;
     
+    if (!scheduler_create_task(reaper_entry, "reaper")) {
+        panic("Failed to start reaper thread!");
+    }
+    
     DEBUG_INFO("Scheduler Initialized. Initial PID: 0\n");
 }
 
-void scheduler_create_task(void (*entry)(), const char* name) {
+// Build a kernel task whose first switch_to_task "returns" to rip with
+// r12/r13 preloaded (used by kthread_start to pass entry and argument).
+// With a page_table, the task runs on (and owns) that address space.
+static uint64_t create_kernel_task(uint64_t rip, uint64_t r12, uint64_t r13, const char* name,
+                                   uint64_t* page_table = nullptr) {
     // CRITICAL: Disable interrupts to prevent timer IRQ from running scheduler_schedule
     // while we're modifying the process list. This prevents deadlock/corruption.
     uint64_t flags = interrupts_save_disable();
     
-    // Use aligned_alloc to ensure FPU state is 16-byte aligned for fxsave/fxrstor
-    Process* new_process = (Process*)aligned_alloc(16, sizeof(Process));
+    Process* new_process = (Process*)malloc(sizeof(Process));
     if (!new_process) {
         DEBUG_ERROR("Failed to allocate process struct\n");
         interrupts_restore(flags);
-        return;
+        return 0;
     }
     
     // Zero the entire struct first
@@ -115,7 +519,6 @@ void scheduler_create_task(void (*entry)(), const char* name) {
     for (size_t i = 0; i < sizeof(Process); i++) p[i] = 0;
     
     new_process->pid = next_pid++;
-    new_process->parent_pid = current_process ? current_process->pid : 0;
     
     // Copy task name
     int ni = 0;
@@ -128,20 +531,20 @@ void scheduler_create_task(void (*entry)(), const char* name) {
     new_process->state = PROCESS_READY;
     new_process->exit_status = 0;
     new_process->wait_for_pid = 0;
-    new_process->page_table = nullptr;  // Kernel task - no VMM isolation
+    new_process->page_table = page_table;  // nullptr: kernel task, no VMM isolation
     new_process->stack_phys = 0;        // Kernel task - stack is heap-allocated
     
-    // Initialize FPU state for the new task
-    init_fpu_state(new_process->fpu_state);
-    new_process->fpu_initialized = true;
+    // FPU state is allocated lazily on first use (see fpu.cpp)
+    new_process->fpu_state = nullptr;
+    new_process->fpu_used = false;
     
     // Allocate stack (16KB for deep call chains like networking)
     new_process->stack_base = (uint64_t*)malloc(KERNEL_STACK_SIZE);
     if (!new_process->stack_base) {
         DEBUG_ERROR("Failed to allocate stack for PID %d\n", new_process->pid);
-        aligned_free(new_process);  // Must use aligned_free, not free!
+        free(new_process);
         interrupts_restore(flags);
-        return; 
+        return 0;
     }
     
     // Stack sentinel: fill with magic pattern for overflow detection
@@ -157,28 +560,54 @@ void scheduler_create_task(void (*entry)(), const char* name) {
     
     // Set up initial stack for switch_to_task
     stack_top--; *stack_top = 0; // Dummy return
-    stack_top--; *stack_top = (uint64_t)entry; // RIP
+    stack_top--; *stack_top = rip; // RIP
     stack_top--; *stack_top = 0x202; // RFLAGS
     
     // Callee-saved regs
-    for (int i = 0; i < 6; i++) {
-        stack_top--; *stack_top = 0;
-    }
+    stack_top--; *stack_top = 0;    // RBX
+    stack_top--; *stack_top = 0;    // RBP
+    stack_top--; *stack_top = r12;  // R12
+    stack_top--; *stack_top = r13;  // R13
+    stack_top--; *stack_top = 0;    // R14
+    stack_top--; *stack_top = 0;    // R15
     
     new_process->sp = (uint64_t)stack_top;
     
+    new_process->policy = SCHED_NORMAL;
+    new_process->nice = 0;
+    new_process->weight = NICE_0_WEIGHT;
+    
     // Add to list (protected by scheduler lock)
-    spinlock_acquire(&scheduler_lock);
-    Process* last = process_list;
-    while (last->next != process_list) {
-        last = last->next;
-    }
-    last->next = new_process;
-    new_process->next = process_list;
-    spinlock_release(&scheduler_lock);
+    McsNode node;
+    mcs_acquire(&scheduler_lock, &node);
+    process_list_append(new_process);
+    link_child(current_process, new_process);
+    
+    place_task(new_process, true);
+    enqueue_task(new_process);
+    mcs_release(&scheduler_lock, &node);
     
     interrupts_restore(flags);
     DEBUG_INFO("Created Task PID: %d\n", new_process->pid);
+    return new_process->pid;
+}
+
+uint64_t scheduler_create_task(void (*entry)(), const char* name) {
+    return create_kernel_task((uint64_t)entry, 0, 0, name);
+}
+
+// Called by kthread_start on the new task's stack
+extern "C" void kthread_main(void (*entry)(void*), void* arg) {
+    entry(arg);
+    process_exit(0);
+}
+
+uint64_t scheduler_create_kthread(void (*entry)(void*), void* arg, const char* name) {
+    return create_kernel_task((uint64_t)kthread_start, (uint64_t)entry, (uint64_t)arg, name);
+}
+
+uint64_t scheduler_create_user_task(void (*entry)(void*), void* arg, const char* name, uint64_t* page_table) {
+    return create_kernel_task((uint64_t)kthread_start, (uint64_t)entry, (uint64_t)arg, name, page_table);
 }
 
 // Helper: Wake up any sleeping processes whose time has come
@@ -189,12 +618,115 @@ static void wake_sleeping_processes() {
     
     do {
         if (p->state == PROCESS_SLEEPING && now >= p->wake_time) {
-            p->state = PROCESS_READY;
+            scheduler_wake(p);
         }
         p = p->next;
     } while (p != process_list);
 }
 
+void scheduler_wake(Process* p) {
+    if (!p) return;
+    
+    uint64_t flags = interrupts_save_disable();
+    
+    if (p->state == PROCESS_BLOCKED || p->state == PROCESS_SLEEPING ||
+        p->state == PROCESS_WAITING) {
+        p->state = PROCESS_READY;
+        
+        // A task that went to sleep but hasn't switched out yet is still
+        // current; it simply keeps running and must not be queued
+        if (p != current_process) {
+            p->wakeup_tsc = rdtsc();
+            place_task(p, false);
+            enqueue_task(p);
+            
+            // Wakeup preemption: let a woken task with enough vruntime lead
+            // run at the next tick instead of waiting out the current slice
+            Process* curr = current_process;
+            if (curr && rq_of(p) == &fair_rq) {
+                if (curr->policy == SCHED_IDLE ||
+                    (int64_t)(curr->vruntime - p->vruntime) >
+                        (int64_t)ticks_to_cycles(SCHED_WAKEUP_GRAN_TICKS)) {
+                    need_resched = true;
+                }
+            }
+        }
+    }
+    
+    interrupts_restore(flags);
+}
+
+uint64_t scheduler_cycles_to_us(uint64_t cycles) {
+    uint64_t per_sec = tsc_per_tick * timer_get_frequency();
+    if (!per_sec) return 0;
+    return cycles / (per_sec / 1000000 ? per_sec / 1000000 : 1);
+}
+
+static void trace_wakeup_latency(Process* p, uint64_t now) {
+    uint64_t delta = now - p->wakeup_tsc;
+    p->wakeup_tsc = 0;
+    
+    lat_stats.samples++;
+    lat_stats.total_cycles += delta;
+    if (delta > lat_stats.max_cycles) {
+        lat_stats.max_cycles = delta;
+        lat_stats.max_pid = p->pid;
+        kstring::strcpy(lat_stats.max_name, p->name);
+    }
+    
+    // Buckets grow by 4x from 16us: <16, <64, <256, <1024, ... microseconds
+    uint64_t us = scheduler_cycles_to_us(delta);
+    int bucket = 0;
+    uint64_t limit = 16;
+    while (bucket < SCHED_LAT_BUCKETS - 1 && us >= limit) {
+        bucket++;
+        limit *= 4;
+    }
+    lat_stats.hist[bucket]++;
+}
+
+void scheduler_get_latency(SchedLatencyStats* out) {
+    uint64_t flags = interrupts_save_disable();
+    kstring::memcpy(out, &lat_stats, sizeof(lat_stats));
+    interrupts_restore(flags);
+}
+
+void scheduler_reset_latency() {
+    uint64_t flags = interrupts_save_disable();
+    kstring::memset(&lat_stats, 0, sizeof(lat_stats));
+    interrupts_restore(flags);
+}
+
+void preempt_schedule() {
+    if (!preemptible() || !current_process) return;
+    scheduler_schedule();
+}
+
+void scheduler_tick() {
+    tsc_calibrate_tick();
+    vdso_update(tsc_per_tick);
+    wake_sleeping_processes();
+    rcu_tick();
+    
+    if (!current_process) return;
+    
+    update_curr();
+    
+    if (need_resched || check_preempt_tick()) {
+        // The interrupted code is non-preemptible (spinlock, RCU reader,
+        // softirq): leave need_resched set and switch in preempt_enable()
+        if (preempt_count) {
+            need_resched = true;
+            if (!preempt_deferred_at) {
+                preempt_deferred_at = rdtsc();
+                lat_stats.preempt_deferred++;
+            }
+            return;
+        }
+        scheduler_schedule();
+    }
+}
+
 void scheduler_schedule() {
     if (!current_process) return;
     
@@ -212,58 +744,92 @@ void scheduler_schedule() {
     // Note: We don't use spinlock here because we can't hold it across context switch
     uint64_t flags = interrupts_save_disable();
     
-    // Wake up any sleeping processes
-    wake_sleeping_processes();
+    Process* prev = current_process;
+    update_curr();
+    rcu_note_context_switch();
     
-    Process* next = current_process->next;
-    Process* start = next;
+    // A voluntary switch with preemption disabled is a bug in the caller
+    // (sleeping under a spinlock); the count travels with the task, so
+    // the next one still starts clean
+    if (preempt_count) lat_stats.atomic_schedules++;
     
-    // Find next runnable process
-    do {
-        if (next->state == PROCESS_READY || next->state == PROCESS_RUNNING) {
-            break;
-        }
-        next = next->next;
-    } while (next != start);
+    uint64_t now = rdtsc();
+    if (preempt_deferred_at) {
+        uint64_t delay = now - preempt_deferred_at;
+        if (delay > lat_stats.max_preempt_delay) lat_stats.max_preempt_delay = delay;
+        preempt_deferred_at = 0;
+    }
+    
+    // A still-runnable task goes back into the tree before picking, so it
+    // competes on equal terms with everything else
+    if (prev->state == PROCESS_RUNNING || prev->state == PROCESS_READY) {
+        prev->state = PROCESS_READY;
+        enqueue_task(prev);
+    }
+    
+    Process* next = pick_next_task();
+    yield_skip = nullptr;
+    need_resched = false;
     
-    if (next == current_process || 
-        (next->state != PROCESS_READY && next->state != PROCESS_RUNNING)) {
+    if (!next) {
+        // Nothing runnable at all (not even idle) - keep going on this stack
         interrupts_restore(flags);
         return;
     }
     
-    Process* prev = current_process;
-    if (prev->state == PROCESS_RUNNING) {
-        prev->state = PROCESS_READY;
+    dequeue_task(next);
+    next->state = PROCESS_RUNNING;
+    next->slice_exec = next->sum_exec;
+    
+    if (next == prev) {
+        interrupts_restore(flags);
+        return;
     }
     
     current_process = next;
-    current_process->state = PROCESS_RUNNING;
+    next->exec_start = now;
+    if (next->wakeup_tsc) trace_wakeup_latency(next, now);
+    
+    prev->preempt_count = preempt_count;
+    preempt_count = next->preempt_count;
     
     // CRITICAL: Update TSS rsp0 before context switch!
     // When the new task returns to user mode and an interrupt occurs,
     // the CPU reads rsp0 from the TSS to find the kernel stack.
-    // For processes with VMM isolation, use KERNEL_STACK_TOP
-    // For kernel tasks (no page_table), use the HHDM stack address
-    if (current_process->page_table) {
+    // For forked processes (stack pages mapped per address space), use
+    // KERNEL_STACK_TOP. Kernel tasks and cloned threads share a page table
+    // with others, so their stacks live in the HHDM.
+    if (current_process->stack_phys) {
         // Process has its own address space - stack is at fixed virtual address
         tss_set_rsp0(KERNEL_STACK_TOP);
     } else if (current_process->stack_base) {
-        // Kernel task - stack is in HHDM
+        // Kernel task or thread - stack is in HHDM
         uint64_t new_rsp0 = (uint64_t)current_process->stack_base + KERNEL_STACK_SIZE;
         tss_set_rsp0(new_rsp0);
     }
     
-    // Switch address space if the next process has its own page table
+    // Switch address space if the next process has its own page table.
+    // Threads of the same group share it, so the TLB survives the switch.
     if (current_process->page_table) {
-        uint64_t pml4_phys = (uint64_t)current_process->page_table - vmm_get_hhdm_offset();
-        vmm_switch_address_space((uint64_t*)pml4_phys);
+        if (current_process->page_table != prev->page_table) {
+                uint64_t pml4_phys = (uint64_t)current_process->page_table - vmm_get_hhdm_offset();
+            vmm_switch_address_space((uint64_t*)pml4_phys);
+        }
     } else if (prev->page_table) {
         // Switching from user process back to kernel task - restore kernel PML4
         uint64_t kernel_pml4_phys = (uint64_t)vmm_get_kernel_pml4() - vmm_get_hhdm_offset();
         vmm_switch_address_space((uint64_t*)kernel_pml4_phys);
     }
     
+    // Per-thread TLS pointer
+    if (current_process->fs_base != loaded_fs_base) {
+        wrmsr(MSR_FS_BASE, current_process->fs_base);
+        loaded_fs_base = current_process->fs_base;
+    }
+    
+    // Arm CR0.TS unless the next task already owns the FPU registers
+    fpu_switch(current_process);
+    
     switch_to_task(prev, current_process);
     
     // CRITICAL: Restore interrupts after context switch!
@@ -275,35 +841,109 @@ void scheduler_schedule() {
 }
 
 void scheduler_yield() {
+    // Step aside for one pick even if we still have the smallest vruntime,
+    // otherwise polling loops that yield would just re-select themselves
+    uint64_t flags = interrupts_save_disable();
+    yield_skip = current_process;
+    interrupts_restore(flags);
+    
     scheduler_schedule();
 }
 
+bool scheduler_set_nice(uint64_t pid, int nice) {
+    if (nice < NICE_MIN || nice > NICE_MAX) return false;
+    
+    uint64_t flags = interrupts_save_disable();
+    rcu_read_lock();
+    Process* p = process_find_by_pid(pid);
+    if (!p) {
+        rcu_read_unlock();
+        interrupts_restore(flags);
+        return false;
+    }
+    
+    // Queue load tracks the sum of weights, so requeue around the change
+    bool queued = p->on_rq;
+    if (queued) dequeue_task(p);
+    p->nice = (int8_t)nice;
+    p->weight = nice_to_weight[nice - NICE_MIN];
+    if (queued) enqueue_task(p);
+    
+    rcu_read_unlock();
+    interrupts_restore(flags);
+    return true;
+}
+
+bool scheduler_set_policy(uint64_t pid, int policy) {
+    if (policy != SCHED_NORMAL && policy != SCHED_IDLE) return false;
+    
+    uint64_t flags = interrupts_save_disable();
+    rcu_read_lock();
+    Process* p = process_find_by_pid(pid);
+    if (!p) {
+        rcu_read_unlock();
+        interrupts_restore(flags);
+        return false;
+    }
+    
+    bool queued = p->on_rq;
+    if (queued) dequeue_task(p);
+    p->policy = (uint8_t)policy;
+    if (queued) {
+        place_task(p, false);
+        enqueue_task(p);
+    }
+    
+    rcu_read_unlock();
+    interrupts_restore(flags);
+    return true;
+}
+
 // Fork: Create a copy of current process with VMM isolation
 uint64_t process_fork() {
     Process* parent = current_process;
     
-    // Use aligned_alloc to ensure FPU state is 16-byte aligned for fxsave/fxrstor
-    Process* child = (Process*)aligned_alloc(16, sizeof(Process));
+    Process* child = (Process*)malloc(sizeof(Process));
     if (!child) return (uint64_t)-1;
     
     // Zero the child struct first
     uint8_t* p = (uint8_t*)child;
     for (size_t i = 0; i < sizeof(Process); i++) p[i] = 0;
     
-    spinlock_acquire(&scheduler_lock);
+    McsNode node;
+    mcs_acquire(&scheduler_lock, &node);
     child->pid = next_pid++;
-    spinlock_release(&scheduler_lock);
+    mcs_release(&scheduler_lock, &node);
     
     child->parent_pid = parent->pid;
     child->state = PROCESS_READY;
     child->exit_status = 0;
     child->wait_for_pid = 0;
     
-    // Copy parent's FPU state
-    for (size_t i = 0; i < FPU_STATE_SIZE; i++) {
-        child->fpu_state[i] = parent->fpu_state[i];
+    // Child inherits scheduling parameters and starts from parent's vruntime
+    child->policy = parent->policy;
+    child->nice = parent->nice;
+    child->weight = parent->weight;
+    child->vruntime = parent->vruntime;
+    
+    // Child is single-threaded, but keeps the calling thread's TLS pointer
+    child->group = nullptr;
+    child->fs_base = parent->fs_base;
+    
+    // Own descriptor table, sharing the parent's open Files
+    FdTable* parent_files = fd_table_current();
+    child->files = parent_files ? fd_table_clone(parent_files) : nullptr;
+    if (!child->files) {
+        free(child);
+        return (uint64_t)-1;
+    }
+    
+    // Copy parent's FPU state (saving live registers first if needed)
+    if (!fpu_fork(child, parent)) {
+        fd_table_put(child->files);
+        free(child);
+        return (uint64_t)-1;
     }
-    child->fpu_initialized = true;
     
     // === VMM ISOLATION ===
     // Clone parent's address space (or create new if parent is kernel task)
@@ -314,7 +954,9 @@ uint64_t process_fork() {
     }
     
     if (!child->page_table) {
-        aligned_free(child);
+        fpu_release(child);
+        fd_table_put(child->files);
+        free(child);
         return (uint64_t)-1;
     }
     
@@ -323,7 +965,9 @@ uint64_t process_fork() {
     void* stack_phys = pmm_alloc_frames(stack_pages);
     if (!stack_phys) {
         vmm_free_address_space(child->page_table);
-        aligned_free(child);
+        fpu_release(child);
+        fd_table_put(child->files);
+        free(child);
         return (uint64_t)-1;
     }
     child->stack_phys = (uint64_t)stack_phys;
@@ -344,7 +988,7 @@ uint64_t process_fork() {
     // - RBP pointers on stack reference KERNEL_STACK_TOP range, which is valid in BOTH address spaces
     uint64_t* dst = (uint64_t*)(child->stack_phys + vmm_get_hhdm_offset());
     
-    if (parent->page_table) {
+    if (parent->stack_phys) {
         // Parent is isolated - copy from parent's physical stack via HHDM
         // RBP pointers already reference KERNEL_STACK_TOP, no rebasing needed
         uint64_t* src = (uint64_t*)(parent->stack_phys + vmm_get_hhdm_offset());
@@ -354,7 +998,7 @@ uint64_t process_fork() {
         // Child's SP is same as parent's (both use KERNEL_STACK_TOP)
         child->sp = parent->sp;
     } else {
-        // Parent is kernel task (HHDM stack) - copy and REBASE pointers
+        // Parent is kernel task or thread (HHDM stack) - copy and REBASE pointers
         // CRITICAL: RBP values on parent's stack point to HHDM addresses.
         // We must rebase them to point to KERNEL_STACK_TOP range.
         uint64_t* src = parent->stack_base;
@@ -378,92 +1022,224 @@ uint64_t process_fork() {
     }
     
     // Add to list (protected by scheduler lock)
-    spinlock_acquire(&scheduler_lock);
-    Process* last = process_list;
-    while (last->next != process_list) {
-        last = last->next;
-    }
-    last->next = child;
-    child->next = process_list;
-    spinlock_release(&scheduler_lock);
+    mcs_acquire(&scheduler_lock, &node);
+    process_list_append(child);
+    link_child(parent, child);
+    
+    place_task(child, true);
+    enqueue_task(child);
+    mcs_release(&scheduler_lock, &node);
     
     DEBUG_INFO("Forked PID %d -> %d (isolated)\n", parent->pid, child->pid);
     return child->pid;
 }
 
+// Clone: create a thread sharing the current task's address space.
+// The thread starts in user mode at `entry` with RSP = user_stack,
+// RDI = arg and FS base = tls. Returns the new thread's PID (its TID).
+uint64_t process_clone(uint64_t entry, uint64_t user_stack, uint64_t arg, uint64_t tls) {
+    Process* parent = current_process;
+    
+    Process* child = (Process*)malloc(sizeof(Process));
+    if (!child) return (uint64_t)-1;
+    
+    uint8_t* p = (uint8_t*)child;
+    for (size_t i = 0; i < sizeof(Process); i++) p[i] = 0;
+    
+    // Join (or start) the caller's thread group
+    if (!parent->group) {
+        ThreadGroup* group = (ThreadGroup*)malloc(sizeof(ThreadGroup));
+        if (!group) {
+            free(child);
+            return (uint64_t)-1;
+        }
+        group->tgid = parent->pid;
+        group->refcount = 1;
+        parent->group = group;
+    }
+    
+    // Threads can't use the fixed KERNEL_STACK_TOP mapping (it would be the
+    // same page for every thread in the shared page table), so their kernel
+    // stacks come from the heap like kernel tasks
+    child->stack_base = (uint64_t*)malloc(KERNEL_STACK_SIZE);
+    if (!child->stack_base) {
+        free(child);
+        return (uint64_t)-1;
+    }
+    
+    // Threads share the descriptor table
+    child->files = fd_table_current();
+    if (!child->files) {
+        free(child->stack_base);
+        free(child);
+        return (uint64_t)-1;
+    }
+    fd_table_get(child->files);
+    
+    uint64_t* sentinel = child->stack_base;
+    for (size_t i = 0; i < 8; i++) {
+        sentinel[i] = 0xDEADBEEFDEADBEEF;
+    }
+    
+    // Initial frame for switch_to_task: "returns" into thread_start, which
+    // picks entry/stack/arg/tls out of r12-r15
+    uint64_t stack_addr = ((uint64_t)child->stack_base + KERNEL_STACK_SIZE) & ~0xFULL;
+    uint64_t* stack_top = (uint64_t*)stack_addr;
+    stack_top--; *stack_top = 0;                        // Dummy return
+    stack_top--; *stack_top = (uint64_t)thread_start;   // RIP
+    stack_top--; *stack_top = 0x202;                    // RFLAGS
+    stack_top--; *stack_top = 0;                        // RBX
+    stack_top--; *stack_top = 0;                        // RBP
+    stack_top--; *stack_top = entry;                    // R12
+    stack_top--; *stack_top = user_stack;               // R13
+    stack_top--; *stack_top = arg;                      // R14
+    stack_top--; *stack_top = tls;                      // R15
+    child->sp = (uint64_t)stack_top;
+    
+    child->parent_pid = parent->pid;
+    for (int i = 0; i < 32; i++) child->name[i] = parent->name[i];
+    child->state = PROCESS_READY;
+    child->page_table = parent->page_table;  // Shared address space
+    child->stack_phys = 0;
+    child->group = parent->group;
+    child->fs_base = tls;
+    
+    // Threads start with a clean FPU (allocated on first use)
+    child->fpu_state = nullptr;
+    child->fpu_used = false;
+    
+    child->policy = parent->policy;
+    child->nice = parent->nice;
+    child->weight = parent->weight;
+    child->vruntime = parent->vruntime;
+    
+    McsNode node;
+    mcs_acquire(&scheduler_lock, &node);
+    child->pid = next_pid++;
+    child->group->refcount++;
+    
+    process_list_append(child);
+    link_child(parent, child);
+    
+    place_task(child, true);
+    enqueue_task(child);
+    mcs_release(&scheduler_lock, &node);
+    
+    DEBUG_INFO("Cloned thread %d in group %d\n", child->pid, child->group->tgid);
+    return child->pid;
+}
+
+// Thread group ID: what getpid() reports for every thread of a process
+uint64_t process_get_tgid(Process* p) {
+    return p->group ? p->group->tgid : p->pid;
+}
+
+// Set the current task's TLS pointer (arch_prctl ARCH_SET_FS)
+void process_set_fs_base(uint64_t base) {
+    uint64_t flags = interrupts_save_disable();
+    current_process->fs_base = base;
+    wrmsr(MSR_FS_BASE, base);
+    loaded_fs_base = base;
+    interrupts_restore(flags);
+}
+
+// Orphan all of p's children (scheduler_lock held). Zombies among them
+// would never be waited for, so they go straight to the reaper.
+static void reparent_children(Process* p) {
+    Process* child = p->children;
+    while (child) {
+        Process* next = child->sibling_next;
+        child->parent = nullptr;
+        child->parent_pid = 0;
+        child->sibling_next = child->sibling_prev = nullptr;
+        if (child->state == PROCESS_ZOMBIE) {
+            process_list_remove(child);
+            reaper_queue(child);
+        }
+        child = next;
+    }
+    p->children = nullptr;
+}
+
 void process_exit(int32_t status) {
     DEBUG_INFO("Process %d exiting with status %d\n", current_process->pid, status);
     
-    current_process->state = PROCESS_ZOMBIE;
-    current_process->exit_status = status;
+    // Close descriptors now, so pipe readers and sockets see the exit
+    // before the parent reaps us (releasing a File may sleep)
+    if (current_process->files) {
+        FdTable* files = current_process->files;
+        current_process->files = nullptr;
+        fd_table_put(files);
+    }
     
-    // Wake up parent if waiting
-    Process* parent = process_find_by_pid(current_process->parent_pid);
-    if (parent && parent->state == PROCESS_WAITING) {
-        if (parent->wait_for_pid == 0 || parent->wait_for_pid == current_process->pid) {
-            parent->state = PROCESS_READY;
+    McsNode node;
+    mcs_acquire(&scheduler_lock, &node);
+    Process* self = current_process;
+    self->state = PROCESS_ZOMBIE;
+    self->exit_status = status;
+    
+    reparent_children(self);
+    
+    Process* parent = self->parent;
+    if (parent) {
+        // Wake up parent if waiting
+        if (parent->state == PROCESS_WAITING &&
+            (parent->wait_for_pid == 0 || parent->wait_for_pid == self->pid)) {
+            scheduler_wake(parent);
         }
+    } else {
+        // Nobody will wait for us: clean up once we've switched out
+        process_list_remove(self);
+        reaper_queue(self);
     }
+    mcs_release(&scheduler_lock, &node);
     
     scheduler_schedule();
     for(;;);
 }
 
+// Wait for a child to exit: O(children), and the zombie's memory is freed
+// by the reaper rather than here. Returns -1 if there is no such child.
 int64_t process_waitpid(int64_t pid, int32_t* status) {
+    Process* self = current_process;
+    
     while (true) {
-        // Look for zombie child
-        Process* p = process_list;
-        do {
-            if (p->parent_pid == current_process->pid && p->state == PROCESS_ZOMBIE) {
-                if (pid == -1 || (uint64_t)pid == p->pid) {
-                    // Found zombie
-                    if (status) *status = p->exit_status;
-                    uint64_t child_pid = p->pid;
-                    
-                    // Unlink from circular list
-                    // Find the previous node
-                    spinlock_acquire(&scheduler_lock);
-                    Process* prev_node = process_list;
-                    while (prev_node->next != p && prev_node->next != process_list) {
-                        prev_node = prev_node->next;
-                    }
-                    if (prev_node->next == p) {
-                        prev_node->next = p->next;
-                        // If p was process_list head, move head
-                        if (process_list == p) {
-                            process_list = p->next;
-                        }
-                    }
-                    spinlock_release(&scheduler_lock);
-                    
-                    // Free resources
-                    // For VMM-isolated processes, free physical stack and address space
-                    if (p->page_table) {
-                        // Free physical stack pages
-                        if (p->stack_phys) {
-                            size_t stack_pages = KERNEL_STACK_SIZE / 4096;
-                            for (size_t i = 0; i < stack_pages; i++) {
-                                pmm_free_frame((void*)(p->stack_phys + i * 4096));
-                            }
-                        }
-                        // Free address space (user pages + page tables)
-                        vmm_free_address_space(p->page_table);
-                    } else if (p->stack_base) {
-                        // Kernel task - stack was heap-allocated
-                        free(p->stack_base);
-                    }
-                    aligned_free(p);  // Process was allocated with aligned_alloc
-                    
-                    DEBUG_INFO("Reaped zombie PID %d\n", child_pid);
-                    return child_pid;
-                }
+        McsNode node;
+        mcs_acquire(&scheduler_lock, &node);
+        
+        bool have_child = false;
+        Process* zombie = nullptr;
+        for (Process* c = self->children; c; c = c->sibling_next) {
+            if (pid != -1 && c->pid != (uint64_t)pid) continue;
+            have_child = true;
+            if (c->state == PROCESS_ZOMBIE) {
+                zombie = c;
+                break;
             }
-            p = p->next;
-        } while (p != process_list);
+        }
+        
+        if (zombie) {
+            int32_t code = zombie->exit_status;
+            uint64_t child_pid = zombie->pid;
+            unlink_child(zombie);
+            process_list_remove(zombie);
+            reaper_queue(zombie);
+            mcs_release(&scheduler_lock, &node);
+            
+            if (status) *status = code;
+            return child_pid;
+        }
+        
+        if (!have_child) {
+            mcs_release(&scheduler_lock, &node);
+            return -1;
+        }
         
-        // No zombie found, wait
-        current_process->state = PROCESS_WAITING;
-        current_process->wait_for_pid = (pid == -1) ? 0 : pid;
+        // Checked and marked under the lock that process_exit() wakes
+        // under, so an exit can't slip in between
+        self->state = PROCESS_WAITING;
+        self->wait_for_pid = (pid == -1) ? 0 : pid;
+        mcs_release(&scheduler_lock, &node);
         scheduler_schedule();
     }
 }
@@ -3,16 +3,61 @@
 
 struct Process;  // Forward declaration for getter
 
+// Scheduling policies
+#define SCHED_NORMAL 0   // Fair share, weighted by nice level
+#define SCHED_IDLE   1   // Runs only when no SCHED_NORMAL task is runnable
+
+// Nice range (Unix convention: lower is higher priority)
+#define NICE_MIN -20
+#define NICE_MAX 19
+
 void scheduler_init();
-void scheduler_create_task(void (*entry)(), const char* name);
+// Returns the new task's PID, or 0 on failure
+uint64_t scheduler_create_task(void (*entry)(), const char* name);
+// Same, for an entry point taking an argument (e.g. worker threads)
+uint64_t scheduler_create_kthread(void (*entry)(void*), void* arg, const char* name);
+// Same, running on page_table (which the task then owns and frees on exit)
+uint64_t scheduler_create_user_task(void (*entry)(void*), void* arg, const char* name, uint64_t* page_table);
 void scheduler_schedule();
 void scheduler_yield();
 
+// Timer tick hook: accounts runtime and preempts when the slice is used up
+void scheduler_tick();
+
+// Make a blocked/sleeping/waiting process runnable again
+void scheduler_wake(Process* p);
+
+// Adjust scheduling parameters (returns false if PID not found / invalid)
+bool scheduler_set_nice(uint64_t pid, int nice);
+bool scheduler_set_policy(uint64_t pid, int policy);
+
 // Get process list head for inspection (e.g., ps command)
 Process* scheduler_get_process_list();
 
+// Dead tasks freed by the reaper thread so far
+uint64_t scheduler_get_reaped_count();
+
 // Sleep for a number of timer ticks (blocks the current process)
 void scheduler_sleep(uint64_t ticks);
 
 // Sleep for milliseconds (convenience wrapper)
 void scheduler_sleep_ms(uint64_t ms);
+
+// Scheduling latency statistics (see scheduler.cpp)
+#define SCHED_LAT_BUCKETS 8
+
+struct SchedLatencyStats {
+    uint64_t samples;               // Wakeups measured
+    uint64_t total_cycles;          // Sum of wakeup latencies (TSC cycles)
+    uint64_t max_cycles;            // Worst wakeup latency
+    uint64_t max_pid;               // Task that saw it
+    char max_name[32];
+    uint64_t hist[SCHED_LAT_BUCKETS]; // Latency histogram, 4x buckets from 16us
+    uint64_t preempt_deferred;      // Preemptions delayed by preempt_count
+    uint64_t max_preempt_delay;     // Longest such delay (TSC cycles)
+    uint64_t atomic_schedules;      // Voluntary switches with preemption disabled
+};
+
+void scheduler_get_latency(SchedLatencyStats* out);
+void scheduler_reset_latency();
+uint64_t scheduler_cycles_to_us(uint64_t cycles);
@@ -0,0 +1,47 @@
+#include "semaphore.h"
+#include "timer.h"
+
+bool sem_down_timeout(Semaphore* sem, uint64_t timeout_ticks) {
+    uint64_t deadline = timer_get_ticks() + timeout_ticks;
+    bool taken = true;
+
+    spinlock_acquire(&sem->lock);
+    while (sem->count <= 0) {
+        uint64_t wait = WAIT_FOREVER;
+        if (timeout_ticks != WAIT_FOREVER) {
+            uint64_t now = timer_get_ticks();
+            if (now >= deadline) {
+                taken = false;
+                break;
+            }
+            wait = deadline - now;
+        }
+        wait_queue_sleep(&sem->waiters, &sem->lock, wait);
+    }
+    if (taken) sem->count--;
+    spinlock_release(&sem->lock);
+
+    return taken;
+}
+
+void sem_down(Semaphore* sem) {
+    sem_down_timeout(sem, WAIT_FOREVER);
+}
+
+bool sem_try_down(Semaphore* sem) {
+    bool taken = false;
+    spinlock_acquire(&sem->lock);
+    if (sem->count > 0) {
+        sem->count--;
+        taken = true;
+    }
+    spinlock_release(&sem->lock);
+    return taken;
+}
+
+void sem_up(Semaphore* sem) {
+    spinlock_acquire(&sem->lock);
+    sem->count++;
+    wait_queue_wake_one(&sem->waiters);
+    spinlock_release(&sem->lock);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "waitqueue.h"
+
+/**
+ * @file semaphore.h
+ * @brief Counting semaphore
+ * 
+ * sem_down() takes a unit, sleeping while none are available; sem_up()
+ * returns one and wakes a sleeper. Useful for producer/consumer handoff
+ * (e.g. counting filled slots in a ring buffer).
+ * 
+ * Usage:
+ *   Semaphore sem = SEMAPHORE_INIT(0);
+ *   sem_down(&sem);   // consumer
+ *   sem_up(&sem);     // producer
+ */
+
+struct Semaphore {
+    volatile int64_t count;         // Available units
+    Spinlock lock;                  // Protects count and waiters
+    WaitQueue waiters;
+};
+
+#define SEMAPHORE_INIT(n) {(n), SPINLOCK_INIT, WAIT_QUEUE_INIT}
+
+static inline void sem_init(Semaphore* sem, int64_t count) {
+    sem->count = count;
+    spinlock_init(&sem->lock);
+    wait_queue_init(&sem->waiters);
+}
+
+// Take one unit, sleeping until one is available
+void sem_down(Semaphore* sem);
+
+// Take one unit, giving up after timeout_ticks. Returns true if taken.
+bool sem_down_timeout(Semaphore* sem, uint64_t timeout_ticks);
+
+// Take one unit only if immediately available
+bool sem_try_down(Semaphore* sem);
+
+// Return one unit and wake a waiter
+void sem_up(Semaphore* sem);
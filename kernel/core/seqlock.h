@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @file seqlock.h
+ * @brief Sequence counter for data read far more often than written
+ * 
+ * Readers take no lock and never block the writer: they snapshot the data
+ * and retry if a write overlapped. The writer makes the count odd while it
+ * updates and even again when done. Writers must be serialized by the
+ * caller (a lock, or a single writing context such as the timer tick).
+ * 
+ * The counter can live in memory shared with user space; the vDSO reads the
+ * time page with the same protocol (see vdso.asm).
+ * 
+ * Usage:
+ *   uint32_t seq;
+ *   do {
+ *       seq = read_seqcount_begin(&sc);
+ *       ... copy the data ...
+ *   } while (read_seqcount_retry(&sc, seq));
+ */
+
+struct SeqCount {
+    volatile uint32_t sequence;     // Odd while a write is in progress
+};
+
+#define SEQCOUNT_INIT {0}
+
+static inline uint32_t read_seqcount_begin(const SeqCount* sc) {
+    uint32_t seq;
+    while ((seq = sc->sequence) & 1) {
+        asm volatile("pause");
+    }
+    asm volatile("" ::: "memory");  // x86 keeps loads in order; stop the compiler
+    return seq;
+}
+
+static inline bool read_seqcount_retry(const SeqCount* sc, uint32_t start) {
+    asm volatile("" ::: "memory");
+    return sc->sequence != start;
+}
+
+static inline void write_seqcount_begin(SeqCount* sc) {
+    sc->sequence = sc->sequence + 1;
+    asm volatile("" ::: "memory");
+}
+
+static inline void write_seqcount_end(SeqCount* sc) {
+    asm volatile("" ::: "memory");
+    sc->sequence = sc->sequence + 1;
+}
@@ -0,0 +1,113 @@
+#include "softirq.h"
+#include "spinlock.h"
+#include "waitqueue.h"
+#include "scheduler.h"
+#include "debug.h"
+
+// Passes over the pending mask on IRQ exit before the rest is left to
+// ksoftirqd (bounds the time a flood of interrupts can steal from tasks)
+#define MAX_SOFTIRQ_RESTART 10
+
+static SoftirqHandler handlers[NR_SOFTIRQS];
+static uint64_t counts[NR_SOFTIRQS];
+volatile uint32_t softirq_pending = 0;
+static uint64_t deferred = 0;
+
+static const char* names[NR_SOFTIRQS] = {
+    "TIMER", "INPUT", "NET_RX", "RCU"
+};
+
+// ksoftirqd sleeps here until the IRQ-exit path hands it work
+static Spinlock ksoftirqd_lock = SPINLOCK_INIT;
+static WaitQueue ksoftirqd_wait = WAIT_QUEUE_INIT;
+static bool ksoftirqd_started = false;
+
+void open_softirq(uint32_t nr, SoftirqHandler handler) {
+    if (nr < NR_SOFTIRQS) handlers[nr] = handler;
+}
+
+void raise_softirq(uint32_t nr) {
+    __atomic_or_fetch(&softirq_pending, 1u << nr, __ATOMIC_RELEASE);
+}
+
+static void wakeup_ksoftirqd() {
+    if (!ksoftirqd_started) return;
+    spinlock_acquire(&ksoftirqd_lock);
+    wait_queue_wake_one(&ksoftirqd_wait);
+    spinlock_release(&ksoftirqd_lock);
+}
+
+// Process pending vectors. Entered and left with interrupts disabled;
+// handlers themselves run with interrupts enabled but preemption off.
+static void run_softirqs(int max_restart) {
+    preempt_count += SOFTIRQ_OFFSET;
+
+    for (int pass = 0; pass < max_restart; pass++) {
+        uint32_t mask = __atomic_exchange_n(&softirq_pending, 0, __ATOMIC_ACQUIRE);
+        if (!mask) break;
+
+        asm volatile("sti" ::: "memory");
+        for (uint32_t nr = 0; nr < NR_SOFTIRQS; nr++) {
+            if ((mask & (1u << nr)) && handlers[nr]) {
+                handlers[nr]();
+                counts[nr]++;
+            }
+        }
+        asm volatile("cli" ::: "memory");
+    }
+
+    preempt_count -= SOFTIRQ_OFFSET;
+}
+
+void do_softirq() {
+    if (in_interrupt() || !softirq_pending) return;
+
+    uint64_t flags = interrupts_save_disable();
+    if (!in_interrupt()) {
+        run_softirqs(MAX_SOFTIRQ_RESTART);
+
+        // Still busy: let a thread finish the job so tasks get to run
+        if (softirq_pending) {
+            deferred++;
+            wakeup_ksoftirqd();
+        }
+    }
+    interrupts_restore(flags);
+}
+
+static void ksoftirqd_entry() {
+    while (true) {
+        spinlock_acquire(&ksoftirqd_lock);
+        while (!softirq_pending) {
+            wait_queue_sleep(&ksoftirqd_wait, &ksoftirqd_lock, WAIT_FOREVER);
+        }
+        spinlock_release(&ksoftirqd_lock);
+
+        uint64_t flags = interrupts_save_disable();
+        if (!in_interrupt()) run_softirqs(1);
+        interrupts_restore(flags);
+
+        // One pass at a time, competing fairly with other tasks
+        scheduler_yield();
+    }
+}
+
+void softirq_init() {
+    if (scheduler_create_task(ksoftirqd_entry, "ksoftirqd")) {
+        ksoftirqd_started = true;
+    } else {
+        DEBUG_ERROR("Failed to start ksoftirqd");
+    }
+}
+
+const char* softirq_get_name(uint32_t nr) {
+    return nr < NR_SOFTIRQS ? names[nr] : "?";
+}
+
+uint64_t softirq_get_count(uint32_t nr) {
+    return nr < NR_SOFTIRQS ? counts[nr] : 0;
+}
+
+uint64_t softirq_get_deferred_count() {
+    return deferred;
+}
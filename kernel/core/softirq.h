@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include "preempt.h"
+
+/**
+ * @file softirq.h
+ * @brief Softirqs: deferred interrupt work run on IRQ exit
+ * 
+ * An interrupt handler does the minimum (acknowledge the device, grab the
+ * data) and raises a softirq vector. Pending vectors run when the outermost
+ * IRQ handler returns, with interrupts enabled again, so long protocol
+ * processing no longer extends interrupt latency. Work raised repeatedly
+ * while softirqs are running is handed to the ksoftirqd kernel thread
+ * instead of looping on the interrupt path forever.
+ * 
+ * Softirq handlers run in interrupt context: they must not sleep (no
+ * Mutex, Semaphore or scheduler_sleep). Work that needs to block goes to a
+ * workqueue (workqueue.h) instead. Task code that shares data with a
+ * softirq brackets it with local_bh_disable()/local_bh_enable().
+ * 
+ * Usage:
+ *   open_softirq(SOFTIRQ_NET_RX, net_rx_action);   // At init
+ *   raise_softirq(SOFTIRQ_NET_RX);                 // From the ISR
+ */
+
+// Vectors, run in this order (lower number first)
+enum SoftirqVector {
+    SOFTIRQ_TIMER,      // Timer bookkeeping (heartbeat)
+    SOFTIRQ_INPUT,      // USB HID polling
+    SOFTIRQ_NET_RX,     // NIC receive + protocol processing
+    SOFTIRQ_RCU,        // RCU callbacks
+    NR_SOFTIRQS
+};
+
+typedef void (*SoftirqHandler)();
+
+// Run pending softirqs. Called on IRQ exit; does nothing in interrupt
+// context or while softirqs are disabled.
+void do_softirq();
+
+// Bitmask of raised vectors
+extern volatile uint32_t softirq_pending;
+
+// Install the handler for a vector (before interrupts are enabled)
+void open_softirq(uint32_t nr, SoftirqHandler handler);
+
+// Mark a vector pending. Safe from any context, including ISRs.
+void raise_softirq(uint32_t nr);
+
+
+// True while softirqs are running or disabled on this CPU
+static inline bool in_softirq() {
+    return (preempt_count & SOFTIRQ_MASK) != 0;
+}
+
+// Keep softirqs (and preemption) off while task code touches data they
+// share; pending softirqs run when the outermost section ends
+static inline void local_bh_disable() {
+    preempt_count += SOFTIRQ_OFFSET;
+    asm volatile("" ::: "memory");
+}
+
+static inline void local_bh_enable() {
+    asm volatile("" ::: "memory");
+    preempt_count -= SOFTIRQ_OFFSET;
+    if (!in_interrupt() && softirq_pending) do_softirq();
+    if (preempt_count == 0 && need_resched) preempt_schedule();
+}
+
+// Hardware interrupt entry/exit accounting. irq_exit() runs pending
+// softirqs once the outermost handler is done.
+static inline void irq_enter() {
+    preempt_count += HARDIRQ_OFFSET;
+}
+
+static inline void irq_exit() {
+    preempt_count -= HARDIRQ_OFFSET;
+    if (!in_interrupt() && softirq_pending) do_softirq();
+}
+
+// Start the ksoftirqd thread (after scheduler_init)
+void softirq_init();
+
+// Diagnostics
+const char* softirq_get_name(uint32_t nr);
+uint64_t softirq_get_count(uint32_t nr);       // Handler invocations
+uint64_t softirq_get_deferred_count();         // Batches handed to ksoftirqd
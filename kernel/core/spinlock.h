@@ -1,13 +1,21 @@
 #pragma once
 #include <stdint.h>
+#include "lockstat.h"
+#include "preempt.h"
 
 /**
  * @file spinlock.h
  * @brief Interrupt-safe spinlock primitives for kernel synchronization
  * 
  * Spinlocks provide mutual exclusion in the kernel. They disable interrupts
- * to prevent preemption while the lock is held, making them safe to use
- * in interrupt handlers.
+ * and kernel preemption while the lock is held, making them safe to use
+ * in interrupt handlers. Releasing the last lock reschedules if a
+ * higher-priority task became runnable meanwhile (see preempt.h).
+ * 
+ * Spinlock is a ticket lock: each acquirer takes a ticket and waits for
+ * its number to be served, so waiters get the lock in FIFO order and only
+ * read the shared line while spinning. For heavily contended locks see
+ * McsLock (mcslock.h), where each waiter spins on its own cache line.
  * 
  * Usage:
  *   Spinlock lock = SPINLOCK_INIT;
@@ -17,11 +25,14 @@
  */
 
 struct Spinlock {
-    volatile uint32_t locked;   // 0 = unlocked, 1 = locked
+    volatile uint32_t next;     // Next ticket to hand out
+    volatile uint32_t owner;    // Ticket currently holding the lock
     uint64_t saved_flags;       // Saved RFLAGS for interrupt state
+    LockStats* stats;           // Optional instrumentation (nullptr = off)
 };
 
-#define SPINLOCK_INIT {0, 0}
+#define SPINLOCK_INIT {0, 0, 0, nullptr}
+#define SPINLOCK_INIT_STATS(st) {0, 0, 0, (st)}
 
 /**
  * @brief Save interrupt state and disable interrupts
@@ -69,8 +80,10 @@ static inline bool interrupts_enabled() {
  * @param sl Pointer to the spinlock to initialize
  */
 static inline void spinlock_init(Spinlock* sl) {
-    sl->locked = 0;
+    sl->next = 0;
+    sl->owner = 0;
     sl->saved_flags = 0;
+    sl->stats = nullptr;
 }
 
 /**
@@ -84,18 +97,21 @@ static inline void spinlock_init(Spinlock* sl) {
 static inline void spinlock_acquire(Spinlock* sl) {
     // Save flags and disable interrupts first
     uint64_t flags = interrupts_save_disable();
+    preempt_disable();
     
-    // Spin until we acquire the lock
-    while (__sync_lock_test_and_set(&sl->locked, 1)) {
+    // Take a ticket and wait for it to be served
+    uint32_t ticket = __atomic_fetch_add(&sl->next, 1, __ATOMIC_RELAXED);
+    uint64_t spins = 0;
+    while (__atomic_load_n(&sl->owner, __ATOMIC_ACQUIRE) != ticket) {
         // Spin with pause instruction to reduce bus contention
         asm volatile("pause" ::: "memory");
+        spins++;
     }
     
     // Store saved flags
     sl->saved_flags = flags;
     
-    // Memory barrier
-    asm volatile("" ::: "memory");
+    if (sl->stats) lock_stats_acquired(sl->stats, spins);
 }
 
 /**
@@ -107,9 +123,12 @@ static inline void spinlock_acquire(Spinlock* sl) {
 static inline bool spinlock_try_acquire(Spinlock* sl) {
     uint64_t flags = interrupts_save_disable();
     
-    if (__sync_lock_test_and_set(&sl->locked, 1) == 0) {
+    // Only take a ticket if it would be served immediately
+    uint32_t owner = __atomic_load_n(&sl->owner, __ATOMIC_ACQUIRE);
+    if (__sync_bool_compare_and_swap(&sl->next, owner, owner + 1)) {
+        preempt_disable();
         sl->saved_flags = flags;
-        asm volatile("" ::: "memory");
+        if (sl->stats) lock_stats_acquired(sl->stats, 0);
         return true;
     }
     
@@ -121,23 +140,23 @@ static inline bool spinlock_try_acquire(Spinlock* sl) {
 /**
  * @brief Release a spinlock
  * 
- * Releases the lock and restores the interrupt state that was saved
- * when the lock was acquired.
+ * Releases the lock, restores the interrupt state that was saved
+ * when the lock was acquired and re-enables preemption.
  * 
  * @param sl Pointer to the spinlock to release
  */
 static inline void spinlock_release(Spinlock* sl) {
-    // Memory barrier
-    asm volatile("" ::: "memory");
+    if (sl->stats) lock_stats_released(sl->stats);
     
     // Save flags before releasing (so we have them even after unlock)
     uint64_t flags = sl->saved_flags;
     
-    // Release the lock
-    __sync_lock_release(&sl->locked);
+    // Serve the next ticket
+    __atomic_store_n(&sl->owner, sl->owner + 1, __ATOMIC_RELEASE);
     
     // Restore interrupt state
     interrupts_restore(flags);
+    preempt_enable();
 }
 
 /**
@@ -146,5 +165,6 @@ static inline void spinlock_release(Spinlock* sl) {
  * @return true if the lock is held
  */
 static inline bool spinlock_is_locked(Spinlock* sl) {
-    return sl->locked != 0;
+    return __atomic_load_n(&sl->next, __ATOMIC_RELAXED) !=
+           __atomic_load_n(&sl->owner, __ATOMIC_RELAXED);
 }
@@ -2,234 +2,483 @@
 #include "limine.h"
 #include "unifs.h"
 #include "pipe.h"
+#include "shm.h"
 #include "process.h"
+#include "scheduler.h"
 #include "debug.h"
 #include "graphics.h"
 #include "elf.h"
+#include "futex.h"
+#include "vfs.h"
+#include "socket.h"
+#include "uring.h"
+#include "poll.h"
+#include "epoll.h"
+#include "ethernet.h"  // ntohs
+#include "kstring.h"
+#include "gdt.h"
+#include "io.h"
+#include "uaccess.h"
+#include "vmm.h"
+#include "vdso.h"
 #include <stddef.h>
 
 // External assembly function for Ring 3 transition
 extern "C" void enter_user_mode(uint64_t entry_point, uint64_t user_stack);
 
 // ============================================================================
-// User Pointer Validation
+// User Memory
 // ============================================================================
-// User space addresses are in the lower half of the address space (< 0x0000800000000000)
-// Kernel space (HHDM) starts at the higher half (>= 0xFFFF800000000000)
+// Syscalls never dereference user pointers themselves: arguments are moved
+// with copy_from_user/copy_to_user (uaccess.h), and buffers are handed to
+// File backends, which do the same. A bad pointer fails with -EFAULT.
 
-#define USER_SPACE_MAX 0x0000800000000000ULL
+#define EXEC_PATH_MAX 256
 
-/**
- * @brief Validate that a user pointer is actually in user space
- * @param ptr Pointer to validate
- * @param size Size of the memory region (for overflow checking)
- * @return true if pointer is valid user space address, false otherwise
- */
-static bool validate_user_ptr(const void* ptr, size_t size) {
-    uint64_t addr = (uint64_t)ptr;
+static uint64_t efault() {
+    return (uint64_t)(int64_t)-EFAULT;
+}
+
+// ============================================================================
+// File Descriptors
+// ============================================================================
+// Each task has its own descriptor table (see vfs.h); these calls only
+// translate fds to Files and dispatch through the File's backend.
+
+// File behind fd in the caller's table, with a reference (nullptr if the
+// fd isn't open)
+static File* get_file(int fd) {
+    FdTable* fds = fd_table_current();
+    return fds ? fd_get(fds, fd) : nullptr;
+}
+
+// SYS_OPEN: open(filename, flags) -> fd
+static uint64_t sys_open(const char* filename, uint32_t flags) {
+    char path[UNIFS_MAX_PATH + 1];
+    int64_t len = strncpy_from_user(path, filename, sizeof(path));
+    if (len < 0) return efault();
+    if ((uint64_t)len >= sizeof(path)) return (uint64_t)-1;  // Name too long
+    
+    FdTable* fds = fd_table_current();
+    if (!fds) return (uint64_t)-1;
+    
+    File* f = vfs_open(path, flags);
+    if (!f) return (uint64_t)-1;
+    
+    int fd = fd_install(fds, f);
+    if (fd < 0) {
+        file_put(f);
+        return (uint64_t)-1;
+    }
+    return fd;
+}
+
+// SYS_READ: read(fd, buf, count) -> bytes_read
+static uint64_t sys_read(int fd, char* buf, uint64_t count) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
     
-    // Null pointer check
-    if (addr == 0) return false;
+    int64_t n = vfs_read(f, buf, count);
+    file_put(f);
+    return (uint64_t)n;
+}
+
+// SYS_WRITE: write(fd, buf, count) -> bytes_written
+static uint64_t sys_write(int fd, const char* buf, uint64_t count) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
     
-    // User space check - must be in lower half
-    if (addr >= USER_SPACE_MAX) return false;
+    int64_t n = vfs_write(f, buf, count);
+    file_put(f);
+    return (uint64_t)n;
+}
+
+// SYS_PREAD64: pread64(fd, buf, count, offset) -> bytes_read
+// Reads at offset without moving the file position
+static uint64_t sys_pread64(int fd, char* buf, uint64_t count, int64_t offset) {
+    if (offset < 0) return (uint64_t)-1;
     
-    // Overflow check - end of region must not wrap or enter kernel space
-    if (size > 0) {
-        uint64_t end = addr + size - 1;
-        if (end < addr) return false;  // Overflow
-        if (end >= USER_SPACE_MAX) return false;
-    }
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
     
-    return true;
+    int64_t n = vfs_pread(f, buf, count, (uint64_t)offset);
+    file_put(f);
+    return (uint64_t)n;
 }
 
-/**
- * @brief Validate a user string pointer (null-terminated)
- * @param str String pointer to validate
- * @param max_len Maximum length to check
- * @return Length of string, or (size_t)-1 if invalid
- */
-static size_t validate_user_string(const char* str, size_t max_len) {
-    if (!validate_user_ptr(str, 1)) return (size_t)-1;
+// SYS_PWRITE64: pwrite64(fd, buf, count, offset) -> bytes_written
+static uint64_t sys_pwrite64(int fd, const char* buf, uint64_t count, int64_t offset) {
+    if (offset < 0) return (uint64_t)-1;
     
-    // Walk the string, checking each byte
-    for (size_t i = 0; i < max_len; i++) {
-        if (!validate_user_ptr(str + i, 1)) return (size_t)-1;
-        if (str[i] == '\0') return i;
-    }
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
     
-    // String too long
-    return (size_t)-1;
+    int64_t n = vfs_pwrite(f, buf, count, (uint64_t)offset);
+    file_put(f);
+    return (uint64_t)n;
 }
 
-static uint64_t sys_cursor_x = 50;
-static uint64_t sys_cursor_y = 480;
+// The iovec array is copied in batches of this many entries
+#define IOV_BATCH 16
 
-// File descriptor table (simple, single-process for now)
-static FileDescriptor fd_table[MAX_OPEN_FILES];
-static bool fd_initialized = false;
+// One vectored transfer over a batch of iovecs already in kernel memory
+typedef int64_t (*IovBatchFn)(File* f, const IoVec* iov, int count, uint32_t flags);
 
-static void init_fd_table() {
-    if (fd_initialized) return;
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        fd_table[i].in_use = false;
+// Import a user iovec array one batch at a time and hand each batch to
+// fn, stopping where it stops (a short transfer). Returns the bytes
+// transferred, or the first error if there were none.
+static uint64_t do_iov_batches(int fd, const IoVec* user_iov, int iovcnt, IovBatchFn fn, uint32_t flags) {
+    if (iovcnt < 0 || iovcnt > IOV_MAX) return (uint64_t)-1;
+    
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    
+    int64_t total = 0;
+    for (int done = 0; done < iovcnt; done += IOV_BATCH) {
+        int count = iovcnt - done;
+        if (count > IOV_BATCH) count = IOV_BATCH;
+        
+        IoVec iov[IOV_BATCH];
+        if (copy_from_user(iov, user_iov + done, count * sizeof(IoVec)) < 0) {
+            total = total ? total : -EFAULT;
+            break;
+        }
+        
+        uint64_t want = 0;
+        for (int i = 0; i < count; i++) want += iov[i].len;
+        
+        int64_t n = fn(f, iov, count, flags);
+        if (n < 0) {
+            if (!total) total = n;
+            break;
+        }
+        total += n;
+        if ((uint64_t)n < want) break;
     }
-    // Reserve stdin/stdout/stderr
-    fd_table[0].in_use = true; // stdin
-    fd_table[1].in_use = true; // stdout
-    fd_table[2].in_use = true; // stderr
-    fd_initialized = true;
+    
+    file_put(f);
+    return (uint64_t)total;
 }
 
-static int find_free_fd() {
-    for (int i = 3; i < MAX_OPEN_FILES; i++) {
-        if (!fd_table[i].in_use) return i;
-    }
-    return -1;
-}
-
-// Check if a file is currently open in fd_table
-// Used by filesystem to prevent deletion of open files
-bool is_file_open(const char* filename) {
-    if (!filename || !fd_initialized) return false;
-    
-    for (int i = 3; i < MAX_OPEN_FILES; i++) {
-        if (fd_table[i].in_use && fd_table[i].filename) {
-            // Compare filenames
-            const char* a = fd_table[i].filename;
-            const char* b = filename;
-            bool match = true;
-            while (*a && *b) {
-                if (*a++ != *b++) { match = false; break; }
-            }
-            if (match && *a == *b) return true;
-        }
-    }
-    return false;
+static int64_t readv_batch(File* f, const IoVec* iov, int count, uint32_t) {
+    return vfs_readv(f, iov, count);
 }
 
-// SYS_OPEN: open(filename, flags, mode) -> fd
-static uint64_t sys_open(const char* filename) {
-    // Validate user pointer
-    if (validate_user_string(filename, 4096) == (size_t)-1) {
-        return (uint64_t)-1;
-    }
-    
-    init_fd_table();
-    
-    // Use thread-safe version with local buffer to avoid race condition
-    UniFSFile file;
-    if (!unifs_open_into(filename, &file)) {
-        return (uint64_t)-1;
-    }
+static int64_t writev_batch(File* f, const IoVec* iov, int count, uint32_t) {
+    return vfs_writev(f, iov, count);
+}
+
+// SYS_READV: readv(fd, iov, iovcnt) -> total bytes_read
+static uint64_t sys_readv(int fd, const IoVec* iov, int iovcnt) {
+    return do_iov_batches(fd, iov, iovcnt, readv_batch, 0);
+}
+
+// SYS_WRITEV: writev(fd, iov, iovcnt) -> total bytes_written
+static uint64_t sys_writev(int fd, const IoVec* iov, int iovcnt) {
+    return do_iov_batches(fd, iov, iovcnt, writev_batch, 0);
+}
+
+// SYS_LSEEK: lseek(fd, offset, whence) -> new position
+static uint64_t sys_lseek(int fd, int64_t offset, int whence) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    
+    int64_t pos = vfs_seek(f, offset, whence);
+    file_put(f);
+    return (uint64_t)pos;
+}
+
+// SYS_CLOSE: close(fd) -> 0 on success
+static uint64_t sys_close(int fd) {
+    FdTable* fds = fd_table_current();
+    if (!fds) return (uint64_t)-1;
+    return (uint64_t)(int64_t)fd_close(fds, fd);
+}
+
+// Install a File as a new fd, dropping it if the table is full
+static int64_t install_file(File* f) {
+    if (!f) return -1;
     
-    int fd = find_free_fd();
-    if (fd < 0) return (uint64_t)-1;
+    FdTable* fds = fd_table_current();
+    int fd = fds ? fd_install(fds, f) : -1;
+    if (fd < 0) file_put(f);
+    return fd;
+}
+
+// SYS_UNLINK: unlink(path) -> 0
+static uint64_t sys_unlink(const char* user_path) {
+    char path[UNIFS_MAX_PATH + 1];
+    int64_t len = strncpy_from_user(path, user_path, sizeof(path));
+    if (len < 0) return efault();
+    if ((uint64_t)len >= sizeof(path)) return (uint64_t)-1;
+    return (uint64_t)(int64_t)vfs_unlink(path);
+}
+
+// SYS_FTRUNCATE: ftruncate(fd, length) -> 0 (shared memory objects only)
+static uint64_t sys_ftruncate(int fd, int64_t length) {
+    if (length < 0) return (uint64_t)-1;
     
-    // Copy data from local buffer to fd_table (safe, won't be overwritten)
-    fd_table[fd].in_use = true;
-    fd_table[fd].filename = file.name;
-    fd_table[fd].position = 0;
-    fd_table[fd].size = file.size;
-    fd_table[fd].data = file.data;
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
     
-    return fd;
+    int64_t ret = shm_truncate(f, (uint64_t)length);
+    file_put(f);
+    return (uint64_t)ret;
 }
 
-// SYS_READ: read(fd, buf, count) -> bytes_read
-static uint64_t sys_read(int fd, char* buf, uint64_t count) {
-    // Validate user buffer
-    if (count > 0 && !validate_user_ptr(buf, count)) {
-        return (uint64_t)-1;
-    }
+// SYS_MMAP: mmap(addr, length, prot, flags, fd, offset) -> address
+// Only MAP_SHARED mappings of shared memory objects; the kernel picks the
+// address, so addr is ignored and MAP_FIXED refused
+static uint64_t sys_mmap(uint64_t addr, uint64_t length, uint32_t prot, uint32_t flags,
+                         int fd, uint64_t offset) {
+    (void)addr;
+    if (!(flags & MAP_SHARED) || (flags & MAP_FIXED)) return (uint64_t)-1;
+    
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    
+    int64_t ret = shm_map(f, length, prot, offset);
+    file_put(f);
+    return (uint64_t)ret;
+}
+
+// SYS_MUNMAP: munmap(addr, length) -> 0
+static uint64_t sys_munmap(uint64_t addr, uint64_t length) {
+    return (uint64_t)shm_unmap(addr, length);
+}
+
+// SYS_PIPE/SYS_PIPE2: pipe2(fds[2], flags) -> 0, fds[0] = read end, fds[1] = write end
+static uint64_t do_pipe(int32_t* user_fds, uint32_t flags) {
+    if (flags & ~O_NONBLOCK) return (uint64_t)-1;
     
-    init_fd_table();
+    File* read_end;
+    File* write_end;
+    if (!pipe_open_files(&read_end, &write_end, flags)) return (uint64_t)-1;
     
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].in_use) {
+    int64_t rfd = install_file(read_end);
+    if (rfd < 0) {
+        file_put(write_end);
         return (uint64_t)-1;
     }
-    
-    if (fd == STDIN_FD) {
-        // TODO: Read from keyboard
-        return 0;
+    int64_t wfd = install_file(write_end);
+    if (wfd < 0) {
+        fd_close(fd_table_current(), (int)rfd);
+        return (uint64_t)-1;
     }
     
-    FileDescriptor* f = &fd_table[fd];
-    uint64_t remaining = f->size - f->position;
-    uint64_t to_read = (count < remaining) ? count : remaining;
-    
-    for (uint64_t i = 0; i < to_read; i++) {
-        buf[i] = f->data[f->position + i];
+    int32_t fds[2] = {(int32_t)rfd, (int32_t)wfd};
+    if (copy_to_user(user_fds, fds, sizeof(fds)) < 0) {
+        fd_close(fd_table_current(), (int)rfd);
+        fd_close(fd_table_current(), (int)wfd);
+        return efault();
+    }
+    return 0;
+}
+
+// SYS_FCNTL: fcntl(fd, cmd, arg) -> depends on cmd
+static uint64_t sys_fcntl(int fd, int cmd, uint64_t arg) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    
+    int64_t ret;
+    switch (cmd) {
+        case F_GETFL:
+            ret = f->flags;
+            break;
+        case F_SETFL:
+            // Shared by every descriptor referring to the File, as on Linux
+            __atomic_store_n(&f->flags, (f->flags & ~F_SETFL_MASK) | ((uint32_t)arg & F_SETFL_MASK),
+                             __ATOMIC_RELAXED);
+            ret = 0;
+            break;
+        case F_GETPIPE_SZ:
+            ret = pipe_get_size(f);
+            break;
+        case F_SETPIPE_SZ:
+            ret = pipe_set_size(f, arg);
+            break;
+        default:
+            ret = -1;
+            break;
     }
-    f->position += to_read;
     
-    return to_read;
+    file_put(f);
+    return (uint64_t)ret;
 }
 
-// SYS_WRITE: write(fd, buf, count) -> bytes_written
-static uint64_t sys_write(int fd, const char* buf, uint64_t count) {
-    // Validate user buffer
-    if (count > 0 && !validate_user_ptr(buf, count)) {
+// SYS_SPLICE: splice(fd_in, off_in, fd_out, off_out, len, flags) -> bytes moved
+// Pipe to pipe only, so there are no offsets
+static uint64_t sys_splice(int fd_in, const int64_t* off_in, int fd_out, const int64_t* off_out,
+                           uint64_t len, uint32_t flags) {
+    if (off_in || off_out) return (uint64_t)-1;
+    
+    File* in = get_file(fd_in);
+    if (!in) return (uint64_t)-1;
+    File* out = get_file(fd_out);
+    if (!out) {
+        file_put(in);
         return (uint64_t)-1;
     }
     
-    if (fd == STDOUT_FD || fd == STDERR_FD) {
-        for (uint64_t i = 0; i < count && buf[i]; i++) {
-            if (buf[i] == '\n') {
-                sys_cursor_x = 50;
-                sys_cursor_y += 10;
-            } else {
-                gfx_draw_char(sys_cursor_x, sys_cursor_y, buf[i], COLOR_GREEN);
-                sys_cursor_x += 9;
-            }
-        }
-        return count;
-    }
+    int64_t n = pipe_splice(in, out, len, flags);
+    file_put(out);
+    file_put(in);
+    return (uint64_t)n;
+}
+
+// SYS_VMSPLICE: vmsplice(fd, iov, nr_segs, flags) -> bytes queued
+static uint64_t sys_vmsplice(int fd, const IoVec* iov, int iovcnt, uint32_t flags) {
+    return do_iov_batches(fd, iov, iovcnt, pipe_vmsplice, flags);
+}
+
+// Read a user sockaddr_in; returns false if it isn't a valid AF_INET address
+static bool read_sockaddr(const void* addr, uint64_t len, SockAddrIn* out) {
+    if (len < sizeof(SockAddrIn)) return false;
+    if (copy_from_user(out, addr, sizeof(SockAddrIn)) < 0) return false;
+    return out->family == AF_INET;
+}
+
+// SYS_SOCKET: socket(domain, type, protocol) -> fd
+static uint64_t sys_socket(int domain, int type) {
+    if (domain != AF_INET) return (uint64_t)-1;
+    return (uint64_t)install_file(socket_open_file(type));
+}
+
+// SYS_CONNECT: connect(fd, addr, addrlen) -> 0
+static uint64_t sys_connect(int fd, const void* addr, uint64_t len) {
+    SockAddrIn sa;
+    if (!read_sockaddr(addr, len, &sa)) return (uint64_t)-1;
+    
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    int result = socket_connect(f, sa.addr, ntohs(sa.port));
+    file_put(f);
+    return (uint64_t)(int64_t)result;
+}
+
+// SYS_BIND: bind(fd, addr, addrlen) -> 0 (only the port is used)
+static uint64_t sys_bind(int fd, const void* addr, uint64_t len) {
+    SockAddrIn sa;
+    if (!read_sockaddr(addr, len, &sa)) return (uint64_t)-1;
+    
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    int result = socket_bind(f, ntohs(sa.port));
+    file_put(f);
+    return (uint64_t)(int64_t)result;
+}
+
+// SYS_LISTEN: listen(fd, backlog) -> 0
+static uint64_t sys_listen(int fd) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    int result = socket_listen(f);
+    file_put(f);
+    return (uint64_t)(int64_t)result;
+}
+
+// SYS_ACCEPT: accept(fd, addr, addrlen) -> new fd (the peer address is not
+// reported). Doesn't block: -1 until a connection is established.
+static uint64_t sys_accept(int fd) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    File* conn = socket_accept(f);
+    file_put(f);
+    return (uint64_t)install_file(conn);
+}
+
+// ============================================================================
+// Asynchronous I/O Rings
+// ============================================================================
+// See uring.h. The ring region is mapped by setup itself, so its layout is
+// reported straight back through params.
+
+// SYS_IO_URING_SETUP: io_uring_setup(entries, params) -> ring fd
+static uint64_t sys_io_uring_setup(uint32_t entries, UringParams* user_params) {
+    if (!user_range_ok(user_params, sizeof(UringParams))) return efault();
     
-    // File descriptor write support
-    init_fd_table();
-    if (fd >= 3 && fd < MAX_OPEN_FILES && fd_table[fd].in_use) {
-        // Use unifs_write to overwrite file contents
-        // Note: This implements simple overwrite semantics, not append
-        int res = unifs_write(fd_table[fd].filename, buf, count);
-        if (res == 0) {
-            // Update cached size in fd_table
-            fd_table[fd].size = count;
-            fd_table[fd].position = count;
-            return count;
-        }
-        return (uint64_t)-1;
-    }
+    UringParams params;
+    int64_t fd = install_file(uring_open_file(entries, &params));
+    if (fd < 0) return (uint64_t)-1;
     
-    return (uint64_t)-1;
+    if (copy_to_user(user_params, &params, sizeof(UringParams)) < 0) {
+        fd_close(fd_table_current(), (int)fd);
+        return efault();
+    }
+    return (uint64_t)fd;
 }
 
-// SYS_CLOSE: close(fd) -> 0 on success
-static uint64_t sys_close(int fd) {
-    init_fd_table();
+// SYS_IO_URING_ENTER: io_uring_enter(fd, to_submit, min_complete, flags)
+// -> SQEs consumed
+static uint64_t sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    File* f = get_file(fd);
+    if (!f) return (uint64_t)-1;
+    
+    int64_t n = uring_enter(f, to_submit, min_complete, flags);
+    file_put(f);
+    return (uint64_t)n;
+}
+
+// ============================================================================
+// Readiness
+// ============================================================================
+// See poll.h and epoll.h. Waiting tasks sleep on the files' poll queues
+// until a backend reports a change or the timeout passes.
+
+// SYS_POLL: poll(fds, nfds, timeout_ms) -> entries with revents set
+static uint64_t sys_poll(PollFd* user_fds, uint64_t nfds, int32_t timeout_ms) {
+    if (nfds > POLL_MAX_FDS) return (uint64_t)-1;
     
-    if (fd < 3 || fd >= MAX_OPEN_FILES) return (uint64_t)-1;
-    if (!fd_table[fd].in_use) return (uint64_t)-1;
+    PollFd fds[POLL_MAX_FDS];
+    uint64_t size = nfds * sizeof(PollFd);
+    if (copy_from_user(fds, user_fds, size) < 0) return efault();
     
-    fd_table[fd].in_use = false;
-    return 0;
+    int64_t n = poll_fds(fds, (uint32_t)nfds, timeout_ms);
+    if (n >= 0 && copy_to_user(user_fds, fds, size) < 0) return efault();
+    return (uint64_t)n;
+}
+
+// SYS_EPOLL_CREATE1: epoll_create1(flags) -> epoll fd
+static uint64_t sys_epoll_create1(int flags) {
+    if (flags != 0) return (uint64_t)-1;  // No close-on-exec yet
+    return (uint64_t)install_file(epoll_open_file());
+}
+
+// SYS_EPOLL_CTL: epoll_ctl(epfd, op, fd, event) -> 0
+static uint64_t sys_epoll_ctl(int epfd, int op, int fd, const EpollEvent* user_event) {
+    EpollEvent event = {0, 0};
+    if (op != EPOLL_CTL_DEL && copy_from_user(&event, user_event, sizeof(event)) < 0) {
+        return efault();
+    }
+    
+    File* f = get_file(epfd);
+    if (!f) return (uint64_t)-1;
+    int result = epoll_ctl(f, op, fd, &event);
+    file_put(f);
+    return (uint64_t)(int64_t)result;
+}
+
+// SYS_EPOLL_WAIT: epoll_wait(epfd, events, maxevents, timeout_ms) -> events
+static uint64_t sys_epoll_wait(int epfd, EpollEvent* user_events, int maxevents, int32_t timeout_ms) {
+    File* f = get_file(epfd);
+    if (!f) return (uint64_t)-1;
+    int64_t n = epoll_wait(f, user_events, maxevents, timeout_ms);
+    file_put(f);
+    return (uint64_t)n;
 }
 
 // Process ID (simple, single PID for now)
 static uint64_t current_pid = 1;
 
-// User stack location (must match elf_load_user)
-#define USER_STACK_TOP 0x7FFFF000ULL  // Stack grows down from here
-
-// State for the user task wrapper
-static uint64_t g_user_entry = 0;
-static volatile bool g_user_task_done = false;
-static int32_t g_user_exit_status = 0;
+// Where a new user task starts (lives on do_exec's stack, which outlives it)
+struct UserStart {
+    uint64_t entry;
+    uint64_t stack;
+};
 
 // External scheduler functions
-extern void scheduler_create_task(void (*entry)(), const char* name);
 extern void process_exit(int32_t status);
+extern int64_t process_waitpid(int64_t pid, int32_t* status);
 extern void scheduler_yield();
 extern Process* process_get_current();
 
@@ -237,15 +486,12 @@ extern Process* process_get_current();
  * @brief Wrapper function that runs in a kernel task, enters Ring 3, 
  *        and when user code calls SYS_EXIT, properly terminates the task.
  */
-static void user_task_wrapper() {
-    if (g_user_entry != 0) {
-        DEBUG_LOG("user_task: entering Ring 3 at 0x%llx\n", g_user_entry);
-        
-        // Transition to Ring 3 - when user calls SYS_EXIT, we handle it there
-        enter_user_mode(g_user_entry, USER_STACK_TOP);
-        
-        // Should never reach here - SYS_EXIT will call process_exit
-    }
+static void user_task_wrapper(void* arg) {
+    UserStart* start = (UserStart*)arg;
+    DEBUG_LOG("user_task: entering Ring 3 at 0x%llx\n", start->entry);
+    
+    // Transition to Ring 3 - when user calls SYS_EXIT, we handle it there
+    enter_user_mode(start->entry, start->stack);
     
     // Fallback - if enter_user_mode somehow returns
     process_exit(-1);
@@ -257,46 +503,36 @@ static void user_task_wrapper() {
  * @return exit status of user program, or -1 on error
  */
 static int64_t do_exec(const char* path) {
-    // Open the file
-    UniFSFile file;
-    if (!unifs_open_into(path, &file)) {
-        DEBUG_WARN("exec: file not found: %s\n", path);
+    // Every program gets a fresh address space, freed by the reaper
+    uint64_t* pml4 = vmm_create_address_space();
+    if (!pml4) return -1;
+    
+    UserStart start;
+    if (!elf_load_program(pml4, path, &start.entry, &start.stack)) {
+        DEBUG_WARN("exec: failed to load ELF: %s\n", path);
+        vmm_free_address_space(pml4);
         return -1;
     }
     
-    // Validate it's an ELF
-    if (!elf_validate(file.data, file.size)) {
-        DEBUG_WARN("exec: not a valid ELF: %s\n", path);
-        return -1;
-    }
+    // Clocks without syscalls (not fatal: the syscalls still work)
+    if (!vdso_map(pml4)) DEBUG_WARN("exec: vDSO not mapped\n");
     
-    DEBUG_LOG("exec: loading ELF '%s' (%llu bytes)\n", path, file.size);
+    DEBUG_LOG("exec: '%s' entry = 0x%llx, stack = 0x%llx\n", path, start.entry, start.stack);
     
-    // Load the ELF into user memory space
-    uint64_t entry = elf_load_user(file.data, file.size);
-    if (entry == 0) {
-        DEBUG_WARN("exec: failed to load ELF\n");
+    // Create a new task that will run the user program
+    uint64_t pid = scheduler_create_user_task(user_task_wrapper, &start, "user", pml4);
+    if (!pid) {
+        vmm_free_address_space(pml4);
         return -1;
     }
     
-    DEBUG_LOG("exec: entry point = 0x%llx\n", entry);
-    
-    // Set up globals for the wrapper task
-    g_user_entry = entry;
-    g_user_task_done = false;
-    g_user_exit_status = 0;
-    
-    // Create a new task that will run the user program
-    scheduler_create_task(user_task_wrapper, "user");
-    
-    // Wait for the user task to complete
-    // The user task will set g_user_task_done when it exits
-    while (!g_user_task_done) {
-        scheduler_yield();
-    }
+    // Sleep until the user task exits, then collect its status (the
+    // reaper frees it)
+    int32_t status = -1;
+    process_waitpid((int64_t)pid, &status);
     
-    DEBUG_LOG("exec: user program exited with status %d\n", g_user_exit_status);
-    return g_user_exit_status;
+    DEBUG_LOG("exec: user program exited with status %d\n", status);
+    return status;
 }
 
 // Kernel-mode exec wrapper (for shell to call)
@@ -304,7 +540,123 @@ int64_t kernel_exec(const char* path) {
     return do_exec(path);
 }
 
-extern "C" uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
+// SYS_EXEC: exec(path) -> exit status of the program
+static uint64_t sys_exec(const char* user_path) {
+    char path[EXEC_PATH_MAX];
+    int64_t len = strncpy_from_user(path, user_path, sizeof(path));
+    if (len < 0) return efault();
+    if ((uint64_t)len >= sizeof(path)) return (uint64_t)-1;
+    return (uint64_t)do_exec(path);
+}
+
+// SYS_WAIT4: wait4(pid, status, options, rusage) -> pid of the reaped child
+static uint64_t sys_wait4(int64_t pid, int32_t* user_status) {
+    if (user_status && !user_range_ok(user_status, sizeof(int32_t))) return efault();
+    
+    int32_t status = 0;
+    int64_t result = process_waitpid(pid, user_status ? &status : nullptr);
+    if (result >= 0 && user_status && copy_to_user(user_status, &status, sizeof(int32_t)) < 0) {
+        return efault();
+    }
+    return (uint64_t)result;
+}
+
+// SYS_CLONE: clone(entry, stack, arg, tls) -> tid
+// Creates a thread sharing the caller's address space and fd table.
+// It starts at `entry` with RSP = stack and RDI = arg.
+static uint64_t sys_clone(uint64_t entry, uint64_t stack, uint64_t arg, uint64_t tls) {
+    if (!user_range_ok((void*)entry, 1)) return (uint64_t)-1;
+    if (!user_range_ok((void*)(stack - 8), 8)) return (uint64_t)-1;
+    if (tls >= USER_SPACE_MAX) return (uint64_t)-1;
+    return process_clone(entry, stack, arg, tls);
+}
+
+// SYS_FUTEX: futex(uaddr, op, val) -> 0/woken count, -1 on error
+static uint64_t sys_futex(uint32_t* uaddr, int op, uint32_t val) {
+    if (((uint64_t)uaddr & 3) || !user_range_ok(uaddr, sizeof(uint32_t))) {
+        return (uint64_t)-1;
+    }
+    switch (op) {
+        case FUTEX_WAIT: return (uint64_t)futex_wait(uaddr, val);
+        case FUTEX_WAKE: return (uint64_t)futex_wake(uaddr, val);
+        default:         return (uint64_t)-1;
+    }
+}
+
+// SYS_ARCH_PRCTL: arch_prctl(code, addr) - get/set the TLS (FS base) pointer
+static uint64_t sys_arch_prctl(int code, uint64_t addr) {
+    Process* p = process_get_current();
+    switch (code) {
+        case ARCH_SET_FS:
+            if (addr >= USER_SPACE_MAX) return (uint64_t)-1;
+            process_set_fs_base(addr);
+            return 0;
+        case ARCH_GET_FS:
+            if (copy_to_user((void*)addr, &p->fs_base, sizeof(uint64_t)) < 0) return efault();
+            return 0;
+        default:
+            return (uint64_t)-1;
+    }
+}
+
+// SYS_CLOCK_GETTIME: clock_gettime(clock, ts) - the vDSO answers the
+// common clocks without coming here
+static uint64_t sys_clock_gettime(int clock, Timespec* user_ts) {
+    uint64_t ns;
+    if (!vdso_clock_ns(clock, &ns)) return (uint64_t)-1;
+    
+    Timespec ts = {(int64_t)(ns / NSEC_PER_SEC), (int64_t)(ns % NSEC_PER_SEC)};
+    if (copy_to_user(user_ts, &ts, sizeof(ts)) < 0) return efault();
+    return 0;
+}
+
+// SYS_GETTIMEOFDAY: gettimeofday(tv, tz) - the timezone is always UTC
+static uint64_t sys_gettimeofday(Timeval* user_tv, uint64_t* user_tz) {
+    uint64_t ns;
+    if (user_tv) {
+        if (!vdso_clock_ns(CLOCK_REALTIME, &ns)) return (uint64_t)-1;
+        Timeval tv = {(int64_t)(ns / NSEC_PER_SEC), (int64_t)(ns % NSEC_PER_SEC / 1000)};
+        if (copy_to_user(user_tv, &tv, sizeof(tv)) < 0) return efault();
+    }
+    if (user_tz) {
+        uint64_t utc = 0;
+        if (copy_to_user(user_tz, &utc, sizeof(utc)) < 0) return efault();
+    }
+    return 0;
+}
+
+// Fast entry point in interrupts.asm
+extern "C" void syscall_entry();
+
+#define EFER_SCE (1ULL << 0)    // SYSCALL/SYSRET enable
+
+// RFLAGS bits cleared on SYSCALL entry
+#define RFLAGS_TF (1ULL << 8)
+#define RFLAGS_IF (1ULL << 9)
+#define RFLAGS_DF (1ULL << 10)
+#define RFLAGS_NT (1ULL << 14)
+#define RFLAGS_AC (1ULL << 18)
+
+void syscall_init() {
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_SCE);
+    
+    // STAR[47:32]: SYSCALL loads CS = base, SS = base + 8 (kernel code/data).
+    // STAR[63:48]: SYSRET loads SS = base + 8, CS = base + 16, both with
+    // RPL 3 - so base is the slot just below user data.
+    uint64_t sysret_base = (GDT_USER_DATA & ~3ULL) - 8;
+    wrmsr(MSR_STAR, (sysret_base << 48) | ((uint64_t)GDT_KERNEL_CODE << 32));
+    wrmsr(MSR_LSTAR, (uint64_t)syscall_entry);
+    
+    // Enter with interrupts off (like the int 0x80 interrupt gate), a clean
+    // direction flag and no single-stepping
+    wrmsr(MSR_FMASK, RFLAGS_TF | RFLAGS_IF | RFLAGS_DF | RFLAGS_NT | RFLAGS_AC);
+    
+    // swapgs in syscall_entry exchanges the user GS base with this
+    wrmsr(MSR_KERNEL_GS_BASE, (uint64_t)percpu_get());
+}
+
+extern "C" uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                    uint64_t arg4, uint64_t arg5, uint64_t arg6) {
     // DEBUG_LOG("Syscall: %d\n", syscall_num); // Uncomment for verbose logging
     
     switch (syscall_num) {
@@ -313,52 +665,92 @@ extern "C" uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_
         case SYS_WRITE:
             return sys_write((int)arg1, (const char*)arg2, arg3);
         case SYS_OPEN:
-            return sys_open((const char*)arg1);
+            return sys_open((const char*)arg1, (uint32_t)arg2);
         case SYS_CLOSE:
             return sys_close((int)arg1);
+        case SYS_LSEEK:
+            return sys_lseek((int)arg1, (int64_t)arg2, (int)arg3);
+        case SYS_PREAD64:
+            return sys_pread64((int)arg1, (char*)arg2, arg3, (int64_t)arg4);
+        case SYS_PWRITE64:
+            return sys_pwrite64((int)arg1, (const char*)arg2, arg3, (int64_t)arg4);
+        case SYS_READV:
+            return sys_readv((int)arg1, (const IoVec*)arg2, (int)arg3);
+        case SYS_WRITEV:
+            return sys_writev((int)arg1, (const IoVec*)arg2, (int)arg3);
+        case SYS_UNLINK:
+            return sys_unlink((const char*)arg1);
+        case SYS_FTRUNCATE:
+            return sys_ftruncate((int)arg1, (int64_t)arg2);
+        case SYS_MMAP:
+            return sys_mmap(arg1, arg2, (uint32_t)arg3, (uint32_t)arg4, (int)arg5, arg6);
+        case SYS_MUNMAP:
+            return sys_munmap(arg1, arg2);
         case SYS_PIPE:
-            return pipe_create();
+            return do_pipe((int32_t*)arg1, 0);
+        case SYS_PIPE2:
+            return do_pipe((int32_t*)arg1, (uint32_t)arg2);
+        case SYS_FCNTL:
+            return sys_fcntl((int)arg1, (int)arg2, arg3);
+        case SYS_SPLICE:
+            return sys_splice((int)arg1, (const int64_t*)arg2, (int)arg3, (const int64_t*)arg4,
+                              arg5, (uint32_t)arg6);
+        case SYS_VMSPLICE:
+            return sys_vmsplice((int)arg1, (const IoVec*)arg2, (int)arg3, (uint32_t)arg4);
+        case SYS_SOCKET:
+            return sys_socket((int)arg1, (int)arg2);
+        case SYS_CONNECT:
+            return sys_connect((int)arg1, (const void*)arg2, arg3);
+        case SYS_ACCEPT:
+            return sys_accept((int)arg1);
+        case SYS_BIND:
+            return sys_bind((int)arg1, (const void*)arg2, arg3);
+        case SYS_LISTEN:
+            return sys_listen((int)arg1);
+        case SYS_POLL:
+            return sys_poll((PollFd*)arg1, arg2, (int32_t)arg3);
+        case SYS_EPOLL_CREATE1:
+            return sys_epoll_create1((int)arg1);
+        case SYS_EPOLL_CTL:
+            return sys_epoll_ctl((int)arg1, (int)arg2, (int)arg3, (const EpollEvent*)arg4);
+        case SYS_EPOLL_WAIT:
+            return sys_epoll_wait((int)arg1, (EpollEvent*)arg2, (int)arg3, (int32_t)arg4);
+        case SYS_IO_URING_SETUP:
+            return sys_io_uring_setup((uint32_t)arg1, (UringParams*)arg2);
+        case SYS_IO_URING_ENTER:
+            return sys_io_uring_enter((int)arg1, (uint32_t)arg2, (uint32_t)arg3, (uint32_t)arg4);
         case SYS_GETPID: {
             extern Process* process_get_current();
+            Process* p = process_get_current();
+            return p ? process_get_tgid(p) : 1;
+        }
+        case SYS_GETTID: {
             Process* p = process_get_current();
             return p ? p->pid : 1;
         }
+        case SYS_CLONE:
+            return sys_clone(arg1, arg2, arg3, arg4);
+        case SYS_FUTEX:
+            return sys_futex((uint32_t*)arg1, (int)arg2, (uint32_t)arg3);
+        case SYS_ARCH_PRCTL:
+            return sys_arch_prctl((int)arg1, arg2);
+        case SYS_CLOCK_GETTIME:
+            return sys_clock_gettime((int)arg1, (Timespec*)arg2);
+        case SYS_GETTIMEOFDAY:
+            return sys_gettimeofday((Timeval*)arg1, (uint64_t*)arg2);
         case SYS_FORK: {
             extern uint64_t process_fork();
             return process_fork();
         }
-        case SYS_EXIT: {
-            // Signal to the waiting shell that the user program has exited
-            g_user_exit_status = (int32_t)arg1;
-            g_user_task_done = true;
-            
-            // Mark this process as zombie
-            Process* p = process_get_current();
-            if (p) {
-                p->state = PROCESS_ZOMBIE;
-            }
-            
-            // Enable interrupts so timer can fire, then halt
-            asm volatile("sti; hlt" ::: "memory");
-            
-            // Loop forever
-            for(;;) { asm volatile("hlt"); }
-        }
-        case SYS_EXEC: {
-            // Validate path pointer
-            if (validate_user_string((const char*)arg1, 256) == (size_t)-1) {
-                return (uint64_t)-1;
-            }
-            return do_exec((const char*)arg1);
-        }
-        case SYS_WAIT4: {
-            // Validate status pointer if provided
-            if (arg2 != 0 && !validate_user_ptr((void*)arg2, sizeof(int32_t))) {
-                return (uint64_t)-1;
-            }
-            extern int64_t process_waitpid(int64_t pid, int32_t* status);
-            return process_waitpid((int64_t)arg1, (int32_t*)arg2);
-        }
+        case SYS_EXIT:
+            // Threads, forked children and the exec'd program alike become
+            // zombies; whoever waits for them collects the status
+            process_exit((int32_t)arg1);
+            return 0;
+        case SYS_EXEC:
+            return sys_exec((const char*)arg1);
+        case SYS_WAIT4:
+            return sys_wait4((int64_t)arg1, (int32_t*)arg2);
         default:
             DEBUG_WARN("Unknown syscall: %d\n", syscall_num);
             return (uint64_t)-1;
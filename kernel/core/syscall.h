@@ -6,34 +6,57 @@
 #define SYS_WRITE  1
 #define SYS_OPEN   2
 #define SYS_CLOSE  3
+#define SYS_POLL   7
+#define SYS_LSEEK  8
+#define SYS_MMAP   9
+#define SYS_MUNMAP 11
+#define SYS_PREAD64  17
+#define SYS_PWRITE64 18
+#define SYS_READV  19
+#define SYS_WRITEV 20
 #define SYS_PIPE   22
 #define SYS_GETPID 39
+#define SYS_SOCKET  41
+#define SYS_CONNECT 42
+#define SYS_ACCEPT  43
+#define SYS_BIND    49
+#define SYS_LISTEN  50
+#define SYS_FCNTL  72
+#define SYS_FTRUNCATE 77
+#define SYS_UNLINK 87
+#define SYS_GETTIMEOFDAY 96
+#define SYS_CLONE  56
 #define SYS_FORK   57
 #define SYS_EXEC   59
 #define SYS_EXIT   60
 #define SYS_WAIT4  61
+#define SYS_ARCH_PRCTL 158
+#define SYS_GETTID 186
+#define SYS_FUTEX  202
+#define SYS_CLOCK_GETTIME 228
+#define SYS_EPOLL_WAIT 232
+#define SYS_EPOLL_CTL  233
+#define SYS_SPLICE 275
+#define SYS_VMSPLICE 278
+#define SYS_EPOLL_CREATE1 291
+#define SYS_PIPE2  293
+#define SYS_IO_URING_SETUP 425
+#define SYS_IO_URING_ENTER 426
 
-// File descriptor constants
-#define STDIN_FD   0
-#define STDOUT_FD  1
-#define STDERR_FD  2
+// arch_prctl codes
+#define ARCH_SET_FS 0x1002
+#define ARCH_GET_FS 0x1003
 
-// Max open files per process
-#define MAX_OPEN_FILES 16
+// File descriptors, open flags and per-process fd tables live in vfs.h
 
-// File descriptor entry
-struct FileDescriptor {
-    bool in_use;
-    const char* filename;
-    uint64_t position;
-    uint64_t size;
-    const uint8_t* data;
-};
+// Common dispatcher for both entry paths (int 0x80 and SYSCALL). Arguments
+// follow the Linux x86-64 ABI: up to six, in RDI, RSI, RDX, R10, R8, R9.
+extern "C" uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                    uint64_t arg4, uint64_t arg5, uint64_t arg6);
 
-extern "C" uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3);
+// Program the SYSCALL/SYSRET MSRs (call after gdt_init)
+void syscall_init();
 
 // Kernel-mode exec (for shell to call directly)
 int64_t kernel_exec(const char* path);
 
-// Check if a file is currently open (for use by filesystem)
-bool is_file_open(const char* filename);
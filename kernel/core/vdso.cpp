@@ -0,0 +1,126 @@
+#include "vdso.h"
+#include "rtc.h"
+#include "timer.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "io.h"
+#include "kstring.h"
+#include "debug.h"
+#include "spinlock.h"  // interrupts_save_disable
+
+// vDSO code bounds (linker.ld)
+extern "C" const uint8_t __vdso_start[];
+extern "C" const uint8_t __vdso_end[];
+
+static VdsoTimePage* time_page = nullptr;   // HHDM view
+static uint64_t time_page_phys = 0;
+static uint64_t text_phys[VDSO_TEXT_MAX_PAGES];
+static uint64_t text_pages = 0;
+
+// (delta * mult) >> 32 without overflowing 64 bits
+static inline uint64_t scale_tsc(uint64_t delta, uint64_t mult) {
+    return (uint64_t)(((unsigned __int128)delta * mult) >> 32);
+}
+
+static uint64_t mono_now(const VdsoTimePage* tp) {
+    return tp->mono_base_ns + scale_tsc(rdtsc() - tp->tsc_base, tp->tsc_mult);
+}
+
+void vdso_init() {
+    void* frame = pmm_alloc_frame();
+    if (!frame) {
+        DEBUG_ERROR("vdso: no memory for the time page");
+        return;
+    }
+    time_page_phys = (uint64_t)frame;
+    VdsoTimePage* tp = (VdsoTimePage*)vmm_phys_to_virt(time_page_phys);
+    kstring::memset(tp, 0, 4096);
+    
+    tp->tick_hz = timer_get_frequency();
+    tp->ticks = timer_get_ticks();
+    tp->tsc_base = rdtsc();
+    tp->mono_base_ns = tp->ticks * (NSEC_PER_SEC / tp->tick_hz);
+    tp->wall_offset_ns = rtc_get_epoch_seconds() * NSEC_PER_SEC - tp->mono_base_ns;
+    
+    uint64_t start = (uint64_t)__vdso_start;
+    text_pages = ((uint64_t)__vdso_end - start) / 4096;
+    if (text_pages == 0 || text_pages > VDSO_TEXT_MAX_PAGES) {
+        DEBUG_ERROR("vdso: code is %llu pages", text_pages);
+        return;
+    }
+    for (uint64_t i = 0; i < text_pages; i++) {
+        text_phys[i] = vmm_virt_to_phys(start + i * 4096);
+    }
+    
+    // Publish last: the tick starts updating the page from here on
+    time_page = tp;
+}
+
+void vdso_update(uint64_t tsc_per_tick) {
+    VdsoTimePage* tp = time_page;
+    if (!tp) return;
+    
+    // The tick is the only writer, but it may run with interrupts enabled
+    uint64_t flags = interrupts_save_disable();
+    uint64_t now_tsc = rdtsc();
+    uint64_t ticks = timer_get_ticks();
+    
+    // Carry the clock on from where the old parameters put it, so a new
+    // calibration never makes it jump backwards
+    uint64_t mono;
+    if (tp->tsc_mult) {
+        mono = tp->mono_base_ns + scale_tsc(now_tsc - tp->tsc_base, tp->tsc_mult);
+    } else {
+        mono = ticks * (NSEC_PER_SEC / tp->tick_hz);
+        if (mono < tp->mono_base_ns) mono = tp->mono_base_ns;
+    }
+    
+    // 1e9 << 32 fits in 64 bits, so no 128-bit division is needed
+    uint64_t tsc_hz = tsc_per_tick * tp->tick_hz;
+    
+    write_seqcount_begin(&tp->seq);
+    tp->ticks = ticks;
+    tp->tsc_base = now_tsc;
+    tp->mono_base_ns = mono;
+    tp->tsc_hz = tsc_hz;
+    tp->tsc_mult = tsc_hz ? (NSEC_PER_SEC << 32) / tsc_hz : 0;
+    write_seqcount_end(&tp->seq);
+    interrupts_restore(flags);
+}
+
+bool vdso_map(uint64_t* pml4) {
+    if (!time_page) return false;
+    
+    uint64_t flags = PTE_PRESENT | PTE_USER | PTE_SHARED;
+    if (!vmm_map_range_in(pml4, VDSO_DATA_BASE, time_page_phys, 1, flags)) return false;
+    for (uint64_t i = 0; i < text_pages; i++) {
+        if (!vmm_map_range_in(pml4, VDSO_TEXT_BASE + i * 4096, text_phys[i], 1, flags)) return false;
+    }
+    return true;
+}
+
+bool vdso_clock_ns(int clock, uint64_t* ns) {
+    const VdsoTimePage* tp = time_page;
+    if (!tp) return false;
+    
+    uint64_t mono, wall_offset;
+    uint32_t seq;
+    do {
+        seq = read_seqcount_begin(&tp->seq);
+        mono = mono_now(tp);
+        wall_offset = tp->wall_offset_ns;
+    } while (read_seqcount_retry(&tp->seq, seq));
+    
+    switch (clock) {
+        case CLOCK_REALTIME:
+            *ns = mono + wall_offset;
+            return true;
+        case CLOCK_MONOTONIC:
+        case CLOCK_MONOTONIC_RAW:
+        case CLOCK_BOOTTIME:
+            *ns = mono;
+            return true;
+        default:
+            return false;
+    }
+}
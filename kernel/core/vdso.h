@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include "seqlock.h"
+
+// ============================================================================
+// vDSO - User-Space Time Without a Syscall
+// ============================================================================
+// The kernel keeps the current time in one page (VdsoTimePage) and updates
+// it on every timer tick under a sequence counter. Every exec'd program gets
+// that page mapped read-only at VDSO_DATA_BASE, plus the vDSO code
+// (vdso.asm) at VDSO_TEXT_BASE. Calling an entry point reads the page and
+// the TSC directly, so a timestamp costs a few nanoseconds instead of a trap.
+//
+// CLOCK_MONOTONIC = mono_base_ns + ((rdtsc - tsc_base) * tsc_mult >> 32)
+// CLOCK_REALTIME  = CLOCK_MONOTONIC + wall_offset_ns
+//
+// Until the TSC is calibrated against the PIT tsc_mult is 0, and the clock
+// advances once per tick.
+// ============================================================================
+
+// User addresses (identical in every process)
+#define VDSO_DATA_BASE  0x00007FFFFFFF0000ULL   // VdsoTimePage, read-only
+#define VDSO_TEXT_BASE  0x00007FFFFFFF1000ULL   // Entry points below
+#define VDSO_TEXT_MAX_PAGES 4
+
+// Entry points (System V calling convention, Linux semantics):
+//   int clock_gettime(int clock, struct timespec* ts)
+//   int gettimeofday(struct timeval* tv, struct timezone* tz)
+#define VDSO_CLOCK_GETTIME  (VDSO_TEXT_BASE + 0x00)
+#define VDSO_GETTIMEOFDAY   (VDSO_TEXT_BASE + 0x10)
+
+// Clock IDs
+#define CLOCK_REALTIME       0
+#define CLOCK_MONOTONIC      1
+#define CLOCK_MONOTONIC_RAW  4   // Same as CLOCK_MONOTONIC here
+#define CLOCK_BOOTTIME       7   // Same as CLOCK_MONOTONIC (no suspend)
+
+#define NSEC_PER_SEC 1000000000ULL
+
+// Layout is shared with vdso.asm (TP_* offsets) - keep them in sync
+struct VdsoTimePage {
+    SeqCount seq;               // 0
+    uint32_t tick_hz;           // 4: Timer frequency
+    uint64_t ticks;             // 8: Timer ticks at the last update
+    uint64_t tsc_base;          // 16: TSC at the last update
+    uint64_t mono_base_ns;      // 24: CLOCK_MONOTONIC at tsc_base
+    uint64_t tsc_mult;          // 32: ns per TSC cycle, 32.32 fixed point
+    uint64_t wall_offset_ns;    // 40: CLOCK_REALTIME - CLOCK_MONOTONIC
+    uint64_t tsc_hz;            // 48: Calibrated TSC frequency (0 = not yet)
+};
+
+struct Timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+struct Timeval {
+    int64_t tv_sec;
+    int64_t tv_usec;
+};
+
+// Allocate the time page, take the wall-clock base from the RTC and locate
+// the vDSO code (after timer_init and rtc_init)
+void vdso_init();
+
+// Timer tick: publish the tick count and the current TSC calibration
+void vdso_update(uint64_t tsc_per_tick);
+
+// Map the time page and the vDSO code into a new address space. The pages
+// are shared (PTE_SHARED): fork maps the same frames, exit doesn't free them.
+bool vdso_map(uint64_t* pml4);
+
+// The kernel's own view of the clocks. Returns false for an unknown clock.
+bool vdso_clock_ns(int clock, uint64_t* ns);
@@ -0,0 +1,74 @@
+#include "waitqueue.h"
+#include "scheduler.h"
+#include "timer.h"
+
+static void wq_append(WaitQueue* wq, WaitQueueEntry* e) {
+    e->next = nullptr;
+    e->prev = wq->tail;
+    if (wq->tail) wq->tail->next = e;
+    else wq->head = e;
+    wq->tail = e;
+}
+
+static void wq_remove(WaitQueue* wq, WaitQueueEntry* e) {
+    if (e->prev) e->prev->next = e->next;
+    else wq->head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else wq->tail = e->prev;
+    e->prev = e->next = nullptr;
+}
+
+bool wait_queue_sleep(WaitQueue* wq, Spinlock* guard, uint64_t timeout_ticks) {
+    if (timeout_ticks == 0) return false;  // Polling: already timed out
+
+    Process* current = process_get_current();
+
+    WaitQueueEntry entry;
+    entry.task = current;
+    entry.woken = false;
+    wq_append(wq, &entry);
+
+    // Mark ourselves asleep before dropping the guard: a wakeup that lands
+    // between the release and scheduler_schedule() just flips us back to
+    // READY and the schedule call returns promptly
+    if (timeout_ticks != WAIT_FOREVER) {
+        current->wake_time = timer_get_ticks() + timeout_ticks;
+        current->state = PROCESS_SLEEPING;
+    } else {
+        current->state = PROCESS_BLOCKED;
+    }
+
+    uint64_t outer_flags = guard->saved_flags;
+    spinlock_release(guard);
+
+    scheduler_schedule();
+
+    spinlock_acquire(guard);
+    guard->saved_flags = outer_flags;
+
+    // Timed out (or woken by something else): take ourselves off the queue
+    if (!entry.woken) {
+        wq_remove(wq, &entry);
+        current->state = PROCESS_RUNNING;
+        return false;
+    }
+    return true;
+}
+
+bool wait_queue_wake_one(WaitQueue* wq) {
+    WaitQueueEntry* e = wq->head;
+    if (!e) return false;
+
+    // Entry lives on the sleeper's stack: don't touch it after `woken`
+    Process* task = e->task;
+    wq_remove(wq, e);
+    e->woken = true;
+    scheduler_wake(task);
+    return true;
+}
+
+uint32_t wait_queue_wake_all(WaitQueue* wq) {
+    uint32_t n = 0;
+    while (wait_queue_wake_one(wq)) n++;
+    return n;
+}
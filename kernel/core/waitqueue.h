@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "process.h"
+
+/**
+ * @file waitqueue.h
+ * @brief Wait queues: the sleeping primitive behind Mutex, Semaphore,
+ *        CondVar and RWLock
+ * 
+ * A wait queue is a FIFO of sleeping tasks. Each sleeper links in through
+ * its own WaitQueueEntry (on its kernel stack), never through Process::next,
+ * which belongs to the scheduler's process ring.
+ * 
+ * A wait queue has no lock of its own: every call must be made while
+ * holding the spinlock that protects the condition being waited for. This
+ * closes the lost-wakeup window - a waker changes the condition and wakes
+ * under the same lock the sleeper checked it under.
+ * 
+ * Usage:
+ *   spinlock_acquire(&lock);
+ *   while (!condition)
+ *       wait_queue_sleep(&wq, &lock, WAIT_FOREVER);
+ *   spinlock_release(&lock);
+ * 
+ *   // Waker
+ *   spinlock_acquire(&lock);
+ *   condition = true;
+ *   wait_queue_wake_one(&wq);
+ *   spinlock_release(&lock);
+ */
+
+#define WAIT_FOREVER (~0ULL)   // Timeout value meaning "no timeout"
+
+struct WaitQueueEntry {
+    Process* task;
+    WaitQueueEntry* prev;
+    WaitQueueEntry* next;
+    volatile bool woken;      // Set by the waker (vs. timeout)
+};
+
+struct WaitQueue {
+    WaitQueueEntry* head;
+    WaitQueueEntry* tail;
+};
+
+#define WAIT_QUEUE_INIT {nullptr, nullptr}
+
+static inline void wait_queue_init(WaitQueue* wq) {
+    wq->head = nullptr;
+    wq->tail = nullptr;
+}
+
+static inline bool wait_queue_empty(WaitQueue* wq) {
+    return wq->head == nullptr;
+}
+
+// Sleep until woken or until timeout_ticks elapse (WAIT_FOREVER = no limit,
+// 0 = don't sleep). `guard` must be held; it is dropped while sleeping and
+// re-acquired before returning. Returns false on timeout. Callers re-check
+// their condition.
+bool wait_queue_sleep(WaitQueue* wq, Spinlock* guard, uint64_t timeout_ticks);
+
+// Wake the longest waiter. Returns true if a task was woken.
+bool wait_queue_wake_one(WaitQueue* wq);
+
+// Wake every waiter. Returns the number of tasks woken.
+uint32_t wait_queue_wake_all(WaitQueue* wq);
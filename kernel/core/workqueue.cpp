@@ -0,0 +1,108 @@
+#include "workqueue.h"
+#include "scheduler.h"
+#include "heap.h"
+#include "debug.h"
+
+static Workqueue* system_wq = nullptr;
+static Workqueue* wq_list = nullptr;
+
+static void worker_entry(void* arg) {
+    Workqueue* wq = (Workqueue*)arg;
+
+    spinlock_acquire(&wq->lock);
+    while (true) {
+        while (!wq->head) {
+            wait_queue_sleep(&wq->worker_wait, &wq->lock, WAIT_FOREVER);
+        }
+
+        WorkItem* work = wq->head;
+        wq->head = work->next;
+        if (!wq->head) wq->tail = nullptr;
+        work->next = nullptr;
+        // Cleared before running so the handler (or an ISR) can requeue it
+        work->pending = false;
+        spinlock_release(&wq->lock);
+
+        work->func(work);
+
+        spinlock_acquire(&wq->lock);
+        wq->completed++;
+        wait_queue_wake_all(&wq->flush_wait);
+    }
+}
+
+Workqueue* workqueue_create(const char* name) {
+    Workqueue* wq = (Workqueue*)malloc(sizeof(Workqueue));
+    if (!wq) return nullptr;
+
+    wq->name = name;
+    spinlock_init(&wq->lock);
+    wq->head = nullptr;
+    wq->tail = nullptr;
+    wait_queue_init(&wq->worker_wait);
+    wait_queue_init(&wq->flush_wait);
+    wq->queued = 0;
+    wq->completed = 0;
+
+    wq->worker_pid = scheduler_create_kthread(worker_entry, wq, name);
+    if (!wq->worker_pid) {
+        free(wq);
+        return nullptr;
+    }
+
+    uint64_t flags = interrupts_save_disable();
+    wq->next = wq_list;
+    wq_list = wq;
+    interrupts_restore(flags);
+    return wq;
+}
+
+bool queue_work(Workqueue* wq, WorkItem* work) {
+    if (!wq) return false;
+
+    spinlock_acquire(&wq->lock);
+    if (work->pending) {
+        spinlock_release(&wq->lock);
+        return false;
+    }
+
+    work->pending = true;
+    work->next = nullptr;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wq->queued++;
+
+    wait_queue_wake_one(&wq->worker_wait);
+    spinlock_release(&wq->lock);
+    return true;
+}
+
+bool schedule_work(WorkItem* work) {
+    return queue_work(system_wq, work);
+}
+
+void flush_workqueue(Workqueue* wq) {
+    if (!wq) return;
+
+    spinlock_acquire(&wq->lock);
+    uint64_t target = wq->queued;
+    while (wq->completed < target) {
+        wait_queue_sleep(&wq->flush_wait, &wq->lock, WAIT_FOREVER);
+    }
+    spinlock_release(&wq->lock);
+}
+
+void workqueue_init() {
+    system_wq = workqueue_create("kworker");
+    if (!system_wq) {
+        DEBUG_ERROR("Failed to create system workqueue");
+    }
+}
+
+Workqueue* workqueue_get_list() {
+    return wq_list;
+}
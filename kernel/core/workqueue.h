@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "waitqueue.h"
+
+/**
+ * @file workqueue.h
+ * @brief Workqueues: deferred work run by kernel worker threads
+ * 
+ * A WorkItem is a function queued for a worker thread to call later in
+ * ordinary task context, where it may sleep, take mutexes and run as long
+ * as it likes (it is preempted like any other task). Use a workqueue for
+ * deferred work that can block; use a softirq for short non-blocking work
+ * that must run soon after an interrupt.
+ * 
+ * Queueing is safe from interrupt and softirq context. A work item that
+ * is already pending is not queued twice, so an ISR can queue on every
+ * interrupt and the handler runs once per batch.
+ * 
+ * Usage:
+ *   static void refill(WorkItem* work) { ... }
+ *   static WorkItem refill_work = WORK_INIT(refill);
+ *   schedule_work(&refill_work);        // On the system workqueue
+ */
+
+struct WorkItem;
+typedef void (*WorkFunc)(WorkItem* work);
+
+struct WorkItem {
+    WorkItem* next;
+    WorkFunc func;
+    volatile bool pending;      // Queued and not yet started
+};
+
+#define WORK_INIT(fn) {nullptr, (fn), false}
+
+static inline void work_init(WorkItem* work, WorkFunc func) {
+    work->next = nullptr;
+    work->func = func;
+    work->pending = false;
+}
+
+struct Workqueue {
+    const char* name;
+    Spinlock lock;              // Protects the queue and both wait queues
+    WorkItem* head;
+    WorkItem* tail;
+    WaitQueue worker_wait;      // Worker sleeps here while the queue is empty
+    WaitQueue flush_wait;       // flush_workqueue() callers
+    uint64_t queued;            // Items ever queued
+    uint64_t completed;         // Items ever run
+    uint64_t worker_pid;
+    Workqueue* next;            // Registry link
+};
+
+// Create a workqueue with its own worker thread. Returns nullptr on failure.
+Workqueue* workqueue_create(const char* name);
+
+// Queue work. Returns false if it was already pending.
+bool queue_work(Workqueue* wq, WorkItem* work);
+
+// Queue on the shared system workqueue
+bool schedule_work(WorkItem* work);
+
+// Wait until everything queued before the call has run (task context)
+void flush_workqueue(Workqueue* wq);
+
+// Create the system workqueue (after scheduler_init)
+void workqueue_init();
+
+// Registered workqueues (for diagnostics)
+Workqueue* workqueue_get_list();
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file xxhash.h
+ * @brief xxHash64 non-cryptographic hashing
+ *
+ * A fast 64-bit hash with good dispersion, for keying tables by content.
+ * It detects nothing on purpose - use CRC-32C (crc32c.h) for checksums -
+ * and equal hashes still need their data compared.
+ *
+ * Usage:
+ *   uint64_t h = xxh64(data, len, 0);
+ */
+
+// Hash len bytes with the given seed
+uint64_t xxh64(const void* data, size_t len, uint64_t seed);
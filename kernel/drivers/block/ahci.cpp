@@ -0,0 +1,415 @@
+#include "ahci.h"
+#include "block.h"
+#include "pci.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "io.h"
+#include "heap.h"
+#include "debug.h"
+
+#include "kstring.h"
+using kstring::memset;
+
+#define PAGE_SIZE 4096
+
+// Spin limits, in io_wait() calls (~1us each). block_init() runs before
+// interrupts are enabled, so the timer can't be used here.
+#define AHCI_STOP_SPINS     500000
+#define AHCI_READY_SPINS    1000000
+#define AHCI_CMD_SPINS      5000000
+
+struct AhciPort {
+    volatile uint8_t* abar;
+    volatile uint8_t* regs;
+    uint32_t port;
+    bool ncq;
+
+    AhciCmdHeader* cmd_list;
+    uint8_t* tables[32];            // Command table per usable slot
+    uint32_t slots;                 // Usable slots (the device's queue depth)
+
+    uint32_t issued;                // Slots the HBA owns
+    uint32_t pending;               // Built but not yet issued (see ahci_kick)
+    uint32_t pending_queued;        // ... of which NCQ, for PxSACT
+    bool non_queued;                // A non-NCQ command is outstanding
+    BlockRequest* reqs[32];
+
+    BlockDevice dev;
+};
+
+static uint32_t disk_count = 0;
+
+static inline uint32_t port_read(AhciPort* p, uint32_t reg) {
+    return mmio_read32(p->regs + reg);
+}
+
+static inline void port_write(AhciPort* p, uint32_t reg, uint32_t value) {
+    mmio_write32(p->regs + reg, value);
+}
+
+// Spin until (reg & mask) == value. Returns false on timeout.
+static bool port_wait(AhciPort* p, uint32_t reg, uint32_t mask, uint32_t value, uint32_t spins) {
+    while ((port_read(p, reg) & mask) != value) {
+        if (spins-- == 0) return false;
+        io_wait();
+    }
+    return true;
+}
+
+// ============================================================================
+// Port control
+// ============================================================================
+
+// Stop command processing and FIS reception. Clears PxCI and PxSACT.
+static bool port_stop(AhciPort* p) {
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) & ~AHCI_CMD_ST);
+    if (!port_wait(p, AHCI_PxCMD, AHCI_CMD_CR, 0, AHCI_STOP_SPINS)) return false;
+
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) & ~AHCI_CMD_FRE);
+    return port_wait(p, AHCI_PxCMD, AHCI_CMD_FR, 0, AHCI_STOP_SPINS);
+}
+
+static bool port_start(AhciPort* p) {
+    port_write(p, AHCI_PxSERR, 0xFFFFFFFF);
+    port_write(p, AHCI_PxIS, 0xFFFFFFFF);
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_CMD_FRE);
+
+    if (!port_wait(p, AHCI_PxTFD, AHCI_TFD_BSY | AHCI_TFD_DRQ, 0, AHCI_READY_SPINS)) {
+        return false;
+    }
+
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_CMD_ST);
+    return true;
+}
+
+// Reset the link (COMRESET) to get a wedged device out of BSY
+static bool port_comreset(AhciPort* p) {
+    uint32_t sctl = port_read(p, AHCI_PxSCTL) & ~0xFu;
+    port_write(p, AHCI_PxSCTL, sctl | 1);
+    for (int i = 0; i < 2000; i++) io_wait();  // DET=1 for at least 1 ms
+    port_write(p, AHCI_PxSCTL, sctl);
+
+    return port_wait(p, AHCI_PxSSTS, 0xF, AHCI_DET_PRESENT, AHCI_READY_SPINS);
+}
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+// Fill the slot's command header and return its (zeroed) command FIS
+static FisRegH2D* slot_setup(AhciPort* p, uint32_t slot, bool write, uint32_t prds) {
+    AhciCmdHeader* header = &p->cmd_list[slot];
+    header->flags = (sizeof(FisRegH2D) / 4) | (write ? AHCI_CMDH_WRITE : 0);
+    header->prdtl = prds;
+    header->prdbc = 0;
+
+    FisRegH2D* fis = (FisRegH2D*)p->tables[slot];
+    memset(fis, 0, sizeof(FisRegH2D));
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->flags = FIS_H2D_COMMAND;
+    return fis;
+}
+
+static void fis_set_lba(FisRegH2D* fis, uint64_t lba) {
+    fis->lba0 = lba;
+    fis->lba1 = lba >> 8;
+    fis->lba2 = lba >> 16;
+    fis->lba3 = lba >> 24;
+    fis->lba4 = lba >> 32;
+    fis->lba5 = lba >> 40;
+    fis->device = 0x40;  // LBA mode
+}
+
+// Build the PRDT for req's segments, joining physically adjacent ones
+static uint32_t build_prdt(AhciPort* p, uint32_t slot, const BlockRequest* req) {
+    AhciPrd* prdt = (AhciPrd*)(p->tables[slot] + AHCI_CT_PRDT);
+    uint32_t prds = 0;
+
+    for (const Bio* bio = req->first; bio; bio = bio->next) {
+        for (uint32_t i = 0; i < bio->seg_count; i++) {
+            const BlockSegment* seg = &bio->segs[i];
+            if (prds > 0) {
+                AhciPrd* last = &prdt[prds - 1];
+                uint32_t len = (last->dbc & 0x3FFFFF) + 1;
+                if (last->dba + len == seg->phys && len + seg->len <= 0x400000) {
+                    last->dbc = len + seg->len - 1;
+                    continue;
+                }
+            }
+            prdt[prds].dba = seg->phys;
+            prdt[prds].reserved = 0;
+            prdt[prds].dbc = seg->len - 1;
+            prds++;
+        }
+    }
+    return prds;
+}
+
+static bool ahci_submit(BlockDevice* dev, BlockRequest* req) {
+    AhciPort* p = (AhciPort*)dev->priv;
+    bool queued = p->ncq && req->op != BLOCK_FLUSH;
+    uint32_t busy = p->issued | p->pending;
+
+    // NCQ and non-NCQ commands can't be outstanding together
+    if (busy && (!queued || p->non_queued)) return false;
+
+    uint32_t slot = 0;
+    while (slot < p->slots && (busy & (1u << slot))) slot++;
+    if (slot == p->slots) return false;
+
+    uint32_t prds = req->op == BLOCK_FLUSH ? 0 : build_prdt(p, slot, req);
+    FisRegH2D* fis = slot_setup(p, slot, req->op == BLOCK_WRITE, prds);
+
+    if (req->op == BLOCK_FLUSH) {
+        fis->command = ATA_CMD_FLUSH_EXT;
+    } else if (queued) {
+        // FPDMA: sector count in the features field, tag in the count field
+        fis->command = req->op == BLOCK_WRITE ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+        fis_set_lba(fis, req->sector);
+        fis->feature_lo = req->sectors;
+        fis->feature_hi = req->sectors >> 8;
+        fis->count_lo = slot << 3;
+    } else {
+        fis->command = req->op == BLOCK_WRITE ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        fis_set_lba(fis, req->sector);
+        fis->count_lo = req->sectors;
+        fis->count_hi = req->sectors >> 8;
+    }
+
+    req->tag = slot;
+    p->reqs[slot] = req;
+    p->pending |= 1u << slot;
+    if (queued) p->pending_queued |= 1u << slot;
+    else p->non_queued = true;
+    return true;
+}
+
+// Issue everything built since the last kick with one PxCI write
+static void ahci_kick(BlockDevice* dev) {
+    AhciPort* p = (AhciPort*)dev->priv;
+    if (!p->pending) return;
+
+    if (p->pending_queued) port_write(p, AHCI_PxSACT, p->pending_queued);
+    port_write(p, AHCI_PxCI, p->pending);
+
+    p->issued |= p->pending;
+    p->pending = p->pending_queued = 0;
+}
+
+static void complete_slots(AhciPort* p, uint32_t slots, int status) {
+    for (uint32_t slot = 0; slots; slot++) {
+        uint32_t bit = 1u << slot;
+        if (!(slots & bit)) continue;
+        slots &= ~bit;
+        p->issued &= ~bit;
+        block_complete(&p->dev, p->reqs[slot], status);
+        p->reqs[slot] = nullptr;
+    }
+    if (!p->issued) p->non_queued = false;
+}
+
+// A command failed: everything the device still holds is failed and the
+// port is restarted (a task file error stops it)
+static void port_recover(AhciPort* p) {
+    DEBUG_WARN("AHCI: %s error (TFD %x, SERR %x), restarting port", p->dev.name,
+               port_read(p, AHCI_PxTFD), port_read(p, AHCI_PxSERR));
+
+    port_stop(p);
+    complete_slots(p, p->issued, -1);
+
+    if (!port_start(p) && !(port_comreset(p) && port_start(p))) {
+        DEBUG_ERROR("AHCI: %s did not recover", p->dev.name);
+    }
+}
+
+static void ahci_reap(BlockDevice* dev) {
+    AhciPort* p = (AhciPort*)dev->priv;
+
+    // Port status first, then the HBA's summary bit for this port
+    uint32_t is = port_read(p, AHCI_PxIS);
+    port_write(p, AHCI_PxIS, is);
+    mmio_write32(p->abar + AHCI_IS, 1u << p->port);
+
+    if (!p->issued) return;
+
+    // A finished command's bit is clear in both PxCI and PxSACT; a failed
+    // one's stays set
+    uint32_t active = port_read(p, AHCI_PxCI) | port_read(p, AHCI_PxSACT);
+    complete_slots(p, p->issued & ~active, 0);
+
+    if (is & AHCI_IS_ERROR) port_recover(p);
+}
+
+static const BlockDriverOps ahci_ops = {ahci_submit, ahci_kick, ahci_reap};
+
+// ============================================================================
+// Probe
+// ============================================================================
+
+static bool alloc_table(AhciPort* p, uint32_t slot) {
+    uint64_t phys = (uint64_t)pmm_alloc_frame();
+    if (!phys) return false;
+
+    p->tables[slot] = (uint8_t*)vmm_phys_to_virt(phys);
+    memset(p->tables[slot], 0, PAGE_SIZE);
+    p->cmd_list[slot].ctba = phys;
+    return true;
+}
+
+// IDENTIFY DEVICE on slot 0, polled
+static bool port_identify(AhciPort* p, uint64_t buffer_phys) {
+    AhciPrd* prd = (AhciPrd*)(p->tables[0] + AHCI_CT_PRDT);
+    prd->dba = buffer_phys;
+    prd->reserved = 0;
+    prd->dbc = 512 - 1;
+
+    FisRegH2D* fis = slot_setup(p, 0, false, 1);
+    fis->command = ATA_CMD_IDENTIFY;
+    port_write(p, AHCI_PxCI, 1);
+
+    uint32_t spins = AHCI_CMD_SPINS;
+    while (port_read(p, AHCI_PxCI) & 1) {
+        if ((port_read(p, AHCI_PxIS) & AHCI_IS_TFES) || spins-- == 0) return false;
+        io_wait();
+    }
+    port_write(p, AHCI_PxIS, 0xFFFFFFFF);
+    return !(port_read(p, AHCI_PxTFD) & AHCI_TFD_ERR);
+}
+
+static void probe_port(volatile uint8_t* abar, uint32_t port, uint32_t cap, uint8_t irq) {
+    volatile uint8_t* regs = abar + AHCI_PORT_BASE(port);
+    uint32_t ssts = mmio_read32(regs + AHCI_PxSSTS);
+    if (AHCI_SSTS_DET(ssts) != AHCI_DET_PRESENT || AHCI_SSTS_IPM(ssts) != AHCI_IPM_ACTIVE) return;
+    if (mmio_read32(regs + AHCI_PxSIG) != AHCI_SIG_ATA) return;  // ATAPI, port multiplier
+
+    AhciPort* p = (AhciPort*)malloc(sizeof(AhciPort));
+    if (!p) return;
+    memset(p, 0, sizeof(AhciPort));
+    p->abar = abar;
+    p->regs = regs;
+    p->port = port;
+
+    uint64_t identify_phys = 0;
+    uint16_t* id = nullptr;
+
+    if (!port_stop(p)) {
+        DEBUG_WARN("AHCI: Port %u won't stop", port);
+        goto fail;
+    }
+
+    {
+        // Command list (1 KB) and received FIS area (256 bytes) share a frame
+        uint64_t base = (uint64_t)pmm_alloc_frame();
+        if (!base) goto fail;
+        memset((void*)vmm_phys_to_virt(base), 0, PAGE_SIZE);
+        p->cmd_list = (AhciCmdHeader*)vmm_phys_to_virt(base);
+
+        port_write(p, AHCI_PxCLB, (uint32_t)base);
+        port_write(p, AHCI_PxCLB + 4, (uint32_t)(base >> 32));
+        port_write(p, AHCI_PxFB, (uint32_t)(base + 1024));
+        port_write(p, AHCI_PxFB + 4, (uint32_t)((base + 1024) >> 32));
+    }
+
+    identify_phys = (uint64_t)pmm_alloc_frame();
+    if (!identify_phys || !alloc_table(p, 0) || !port_start(p)) goto fail;
+
+    if (!port_identify(p, identify_phys)) {
+        DEBUG_WARN("AHCI: IDENTIFY failed on port %u", port);
+        goto fail;
+    }
+
+    id = (uint16_t*)vmm_phys_to_virt(identify_phys);
+    if (!(id[83] & (1u << 10))) {
+        DEBUG_WARN("AHCI: Port %u disk lacks LBA48, ignoring", port);
+        goto fail;
+    }
+
+    p->dev.sectors = (uint64_t)id[100] | ((uint64_t)id[101] << 16) |
+                     ((uint64_t)id[102] << 32) | ((uint64_t)id[103] << 48);
+    p->dev.write_cache = id[85] & (1u << 5);
+    p->ncq = (cap & AHCI_CAP_SNCQ) && (id[76] & (1u << 8));
+    p->slots = 1;
+    if (p->ncq) {
+        p->slots = (id[75] & 0x1F) + 1;
+        if (p->slots > AHCI_CAP_NCS(cap)) p->slots = AHCI_CAP_NCS(cap);
+    }
+    for (uint32_t slot = 1; slot < p->slots; slot++) {
+        if (!alloc_table(p, slot)) {
+            p->slots = slot;
+            break;
+        }
+    }
+    pmm_free_frame((void*)identify_phys);
+
+    block_make_name(&p->dev, "sata", disk_count++);
+    p->dev.max_segments = AHCI_MAX_PRDS;
+    p->dev.max_sectors = AHCI_MAX_PRDS * (PAGE_SIZE / BLOCK_SECTOR_SIZE);
+    p->dev.depth = p->slots;
+    p->dev.irq = irq;
+    p->dev.ops = &ahci_ops;
+    p->dev.priv = p;
+
+    if (irq != BLOCK_NO_IRQ) {
+        port_write(p, AHCI_PxIE, AHCI_IS_DHRS | AHCI_IS_PSS | AHCI_IS_DSS |
+                                 AHCI_IS_SDBS | AHCI_IS_ERROR);
+    }
+
+    DEBUG_INFO("AHCI: Port %u: %s, %s", port, p->dev.name,
+               p->ncq ? "NCQ" : "no NCQ");
+    block_register(&p->dev);
+    return;
+
+fail:
+    // Frames already handed to the port stay with it; it is left stopped
+    port_stop(p);
+    if (identify_phys) pmm_free_frame((void*)identify_phys);
+    free(p);
+}
+
+void ahci_init() {
+    PciDevice pci;
+    if (!pci_find_device_by_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, PCI_PROGIF_AHCI, &pci)) {
+        return;
+    }
+
+    pci_enable_memory_space(&pci);
+    pci_enable_bus_mastering(&pci);
+
+    uint64_t abar_size = 0;
+    uint64_t abar_phys = pci_get_bar(&pci, 5, &abar_size);
+    if (!abar_phys || !pci_bar_is_mmio(&pci, 5)) {
+        DEBUG_WARN("AHCI: No ABAR");
+        return;
+    }
+    volatile uint8_t* abar = (volatile uint8_t*)vmm_map_mmio(abar_phys, abar_size);
+    if (!abar) return;
+
+    mmio_write32(abar + AHCI_GHC, mmio_read32(abar + AHCI_GHC) | AHCI_GHC_AE);
+
+    uint32_t cap = mmio_read32(abar + AHCI_CAP);
+    if (!(cap & AHCI_CAP_S64A)) {
+        // Buffers are wherever the caller's frames are
+        DEBUG_WARN("AHCI: Controller lacks 64-bit DMA, ignoring");
+        return;
+    }
+
+    // A shared line would need every driver on it to clear its device's
+    // interrupt; poll instead
+    uint8_t irq = BLOCK_NO_IRQ;
+    if (pci.irq_line > 2 && pci.irq_line < 16 && !pci_irq_line_shared(&pci)) {
+        irq = pci.irq_line;
+        pci_enable_interrupts(&pci);
+    } else {
+        pci_disable_interrupts(&pci);
+    }
+
+    uint32_t implemented = mmio_read32(abar + AHCI_PI);
+    for (uint32_t port = 0; port < AHCI_MAX_PORTS; port++) {
+        if (implemented & (1u << port)) probe_port(abar, port, cap, irq);
+    }
+
+    if (irq != BLOCK_NO_IRQ) {
+        mmio_write32(abar + AHCI_IS, 0xFFFFFFFF);
+        mmio_write32(abar + AHCI_GHC, mmio_read32(abar + AHCI_GHC) | AHCI_GHC_IE);
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+
+// AHCI (Serial ATA) host controller driver. Each SATA disk becomes a block
+// device ("sata0", ...). Disks that support NCQ get one tagged command per
+// command slot; others are driven one command at a time.
+
+// HBA registers (relative to ABAR, PCI BAR5)
+#define AHCI_CAP            0x00
+#define AHCI_GHC            0x04
+#define AHCI_IS             0x08
+#define AHCI_PI             0x0C
+
+#define AHCI_CAP_NCS(x)     ((((x) >> 8) & 0x1F) + 1)  // Command slots per port
+#define AHCI_CAP_SNCQ       (1u << 30)
+#define AHCI_CAP_S64A       (1u << 31)
+
+#define AHCI_GHC_IE         (1u << 1)
+#define AHCI_GHC_AE         (1u << 31)
+
+// Port registers (relative to ABAR + 0x100 + port * 0x80)
+#define AHCI_PORT_BASE(p)   (0x100 + (p) * 0x80)
+#define AHCI_PxCLB          0x00
+#define AHCI_PxFB           0x08
+#define AHCI_PxIS           0x10
+#define AHCI_PxIE           0x14
+#define AHCI_PxCMD          0x18
+#define AHCI_PxTFD          0x20
+#define AHCI_PxSIG          0x24
+#define AHCI_PxSSTS         0x28
+#define AHCI_PxSCTL         0x2C
+#define AHCI_PxSERR         0x30
+#define AHCI_PxSACT         0x34
+#define AHCI_PxCI           0x38
+
+#define AHCI_CMD_ST         (1u << 0)
+#define AHCI_CMD_FRE        (1u << 4)
+#define AHCI_CMD_FR         (1u << 14)
+#define AHCI_CMD_CR         (1u << 15)
+
+#define AHCI_TFD_ERR        (1u << 0)
+#define AHCI_TFD_DRQ        (1u << 3)
+#define AHCI_TFD_BSY        (1u << 7)
+
+// PxIS / PxIE
+#define AHCI_IS_DHRS        (1u << 0)   // D2H register FIS (non-queued done)
+#define AHCI_IS_PSS         (1u << 1)   // PIO setup FIS
+#define AHCI_IS_DSS         (1u << 2)   // DMA setup FIS
+#define AHCI_IS_SDBS        (1u << 3)   // Set device bits FIS (NCQ done)
+#define AHCI_IS_IFS         (1u << 27)
+#define AHCI_IS_HBDS        (1u << 28)
+#define AHCI_IS_HBFS        (1u << 29)
+#define AHCI_IS_TFES        (1u << 30)
+#define AHCI_IS_ERROR       (AHCI_IS_IFS | AHCI_IS_HBDS | AHCI_IS_HBFS | AHCI_IS_TFES)
+
+#define AHCI_SSTS_DET(x)    ((x) & 0xF)
+#define AHCI_SSTS_IPM(x)    (((x) >> 8) & 0xF)
+#define AHCI_DET_PRESENT    3
+#define AHCI_IPM_ACTIVE     1
+#define AHCI_SIG_ATA        0x00000101
+
+#define AHCI_MAX_PORTS      32
+
+// Command list entry (32 bytes)
+struct AhciCmdHeader {
+    uint16_t flags;         // CFL (FIS length in dwords) 4:0, W 6
+    uint16_t prdtl;         // PRDT entries
+    volatile uint32_t prdbc;
+    uint64_t ctba;          // Command table, 128-byte aligned
+    uint32_t reserved[4];
+} __attribute__((packed));
+
+#define AHCI_CMDH_WRITE     (1u << 6)
+
+// Physical region descriptor
+struct AhciPrd {
+    uint64_t dba;
+    uint32_t reserved;
+    uint32_t dbc;           // Byte count - 1 (bits 21:0), I 31
+} __attribute__((packed));
+
+// Host to device register FIS
+struct FisRegH2D {
+    uint8_t type;           // FIS_TYPE_REG_H2D
+    uint8_t flags;          // C (command) 7
+    uint8_t command;
+    uint8_t feature_lo;
+    uint8_t lba0, lba1, lba2;
+    uint8_t device;
+    uint8_t lba3, lba4, lba5;
+    uint8_t feature_hi;
+    uint8_t count_lo;
+    uint8_t count_hi;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed));
+
+#define FIS_TYPE_REG_H2D    0x27
+#define FIS_H2D_COMMAND     0x80
+
+// Command table: FIS, then the PRDT. One page per slot.
+#define AHCI_CT_PRDT        0x80
+#define AHCI_MAX_PRDS       ((4096 - AHCI_CT_PRDT) / sizeof(AhciPrd))
+
+// ATA commands
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_READ_FPDMA      0x60
+#define ATA_CMD_WRITE_FPDMA     0x61
+#define ATA_CMD_FLUSH_EXT       0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+
+// Find AHCI controllers and register their SATA disks
+void ahci_init();
@@ -0,0 +1,316 @@
+#include "block.h"
+#include "ahci.h"
+#include "virtio_blk.h"
+#include "pic.h"
+#include "heap.h"
+#include "debug.h"
+
+// Ticks block_wait() sleeps before polling the device itself: a backstop
+// for a lost interrupt on IRQ-driven disks, the poll interval otherwise
+#define BLOCK_IRQ_BACKSTOP  10
+#define BLOCK_POLL_TICKS    1
+
+static BlockDevice* devices[BLOCK_MAX_DEVICES];
+static uint32_t device_count = 0;
+
+// ============================================================================
+// Registration
+// ============================================================================
+
+void block_init() {
+    ahci_init();
+    virtio_blk_init();
+
+    if (device_count == 0) {
+        DEBUG_INFO("Block: No disks found");
+    }
+}
+
+bool block_register(BlockDevice* dev) {
+    if (device_count >= BLOCK_MAX_DEVICES) {
+        DEBUG_WARN("Block: Too many disks, ignoring %s", dev->name);
+        return false;
+    }
+
+    spinlock_init(&dev->lock);
+    wait_queue_init(&dev->waiters);
+    dev->queue = nullptr;
+    dev->spare = nullptr;
+    dev->in_flight = 0;
+    dev->head = 0;
+    dev->bios = dev->merges = dev->requests = 0;
+    dev->sectors_read = dev->sectors_written = dev->errors = 0;
+
+    devices[device_count++] = dev;
+
+    if (dev->irq != BLOCK_NO_IRQ) {
+        pic_clear_mask(dev->irq);
+        if (dev->irq >= 8) pic_clear_mask(2);  // Cascade
+    }
+
+    DEBUG_INFO("Block: %s %lu MB, queue depth %u, %s", dev->name,
+               dev->sectors / (1024 * 1024 / BLOCK_SECTOR_SIZE), dev->depth,
+               dev->irq != BLOCK_NO_IRQ ? "IRQ-driven" : "polled");
+    return true;
+}
+
+void block_make_name(BlockDevice* dev, const char* prefix, uint32_t index) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + index % 10;
+        index /= 10;
+    } while (index && n < 10);
+
+    uint32_t len = 0;
+    while (*prefix && len < sizeof(dev->name) - 1) dev->name[len++] = *prefix++;
+    while (n > 0 && len < sizeof(dev->name) - 1) dev->name[len++] = digits[--n];
+    dev->name[len] = '\0';
+}
+
+uint32_t block_get_device_count() {
+    return device_count;
+}
+
+BlockDevice* block_get_device(uint32_t index) {
+    return index < device_count ? devices[index] : nullptr;
+}
+
+// ============================================================================
+// Request queue (dev->lock held)
+// ============================================================================
+
+static void finish_bio(Bio* bio, int status) {
+    bio->status = status;
+    __atomic_store_n(&bio->done, true, __ATOMIC_RELEASE);
+}
+
+static bool bio_valid(BlockDevice* dev, const Bio* bio) {
+    if (bio->op == BLOCK_FLUSH) return bio->sectors == 0 && bio->seg_count == 0;
+    if (bio->op != BLOCK_READ && bio->op != BLOCK_WRITE) return false;
+
+    return bio->sectors != 0 && bio->seg_count != 0 &&
+           bio->sectors <= dev->max_sectors &&
+           bio->seg_count <= dev->max_segments &&
+           bio->sector < dev->sectors &&
+           bio->sectors <= dev->sectors - bio->sector;
+}
+
+static BlockRequest* alloc_request(BlockDevice* dev) {
+    BlockRequest* req = dev->spare;
+    if (req) {
+        dev->spare = req->next;
+        return req;
+    }
+    // The heap lock masks interrupts too, so this is safe under dev->lock
+    return (BlockRequest*)malloc(sizeof(BlockRequest));
+}
+
+// Fold bio into a waiting request it continues or precedes. Merging is
+// only tried against the neighbours in sector order, which are the only
+// requests it can be contiguous with.
+static bool try_merge(BlockDevice* dev, BlockRequest* req, Bio* bio) {
+    if (!req || req->op != bio->op || bio->op == BLOCK_FLUSH) return false;
+    if (req->sectors + bio->sectors > dev->max_sectors) return false;
+    if (req->seg_count + bio->seg_count > dev->max_segments) return false;
+
+    if (req->sector + req->sectors == bio->sector) {
+        req->last->next = bio;
+        req->last = bio;
+    } else if (bio->sector + bio->sectors == req->sector) {
+        bio->next = req->first;
+        req->first = bio;
+        req->sector = bio->sector;
+    } else {
+        return false;
+    }
+
+    req->sectors += bio->sectors;
+    req->seg_count += bio->seg_count;
+    dev->merges++;
+    return true;
+}
+
+static void enqueue(BlockDevice* dev, Bio* bio) {
+    dev->bios++;
+
+    if (!bio_valid(dev, bio)) {
+        dev->errors++;
+        finish_bio(bio, -1);
+        return;
+    }
+    if (bio->op == BLOCK_FLUSH && !dev->write_cache) {
+        finish_bio(bio, 0);  // Writes are durable once they complete
+        return;
+    }
+
+    // Find the insertion point: prev is the last request below bio
+    BlockRequest* prev = nullptr;
+    BlockRequest* next = dev->queue;
+    while (next && next->sector < bio->sector) {
+        prev = next;
+        next = next->next;
+    }
+
+    if (try_merge(dev, prev, bio) || try_merge(dev, next, bio)) return;
+
+    BlockRequest* req = alloc_request(dev);
+    if (!req) {
+        dev->errors++;
+        finish_bio(bio, -1);
+        return;
+    }
+
+    req->op = bio->op;
+    req->sector = bio->sector;
+    req->sectors = bio->sectors;
+    req->seg_count = bio->seg_count;
+    req->first = req->last = bio;
+    req->tag = 0;
+    req->next = next;
+    if (prev) prev->next = req;
+    else dev->queue = req;
+}
+
+// Hand waiting requests to the driver in C-LOOK order until it's full
+static void dispatch(BlockDevice* dev) {
+    bool started = false;
+
+    while (dev->queue && dev->in_flight < dev->depth) {
+        BlockRequest* prev = nullptr;
+        BlockRequest* req = dev->queue;
+        while (req && req->sector < dev->head) {
+            prev = req;
+            req = req->next;
+        }
+        if (!req) {
+            prev = nullptr;
+            req = dev->queue;
+        }
+
+        BlockRequest** link = prev ? &prev->next : &dev->queue;
+        *link = req->next;
+
+        if (!dev->ops->submit(dev, req)) {
+            req->next = *link;
+            *link = req;
+            break;
+        }
+
+        dev->in_flight++;
+        dev->requests++;
+        dev->head = req->sector + req->sectors;
+        started = true;
+    }
+
+    if (started && dev->ops->kick) dev->ops->kick(dev);
+}
+
+void block_complete(BlockDevice* dev, BlockRequest* req, int status) {
+    if (status != 0) dev->errors++;
+    else if (req->op == BLOCK_READ) dev->sectors_read += req->sectors;
+    else if (req->op == BLOCK_WRITE) dev->sectors_written += req->sectors;
+
+    // The waiter may reuse a bio as soon as it's done
+    Bio* bio = req->first;
+    while (bio) {
+        Bio* next = bio->next;
+        finish_bio(bio, status);
+        bio = next;
+    }
+
+    dev->in_flight--;
+    req->next = dev->spare;
+    dev->spare = req;
+    wait_queue_wake_all(&dev->waiters);
+}
+
+void block_irq(uint8_t irq) {
+    for (uint32_t i = 0; i < device_count; i++) {
+        BlockDevice* dev = devices[i];
+        if (dev->irq != irq) continue;
+
+        spinlock_acquire(&dev->lock);
+        dev->ops->reap(dev);
+        dispatch(dev);
+        spinlock_release(&dev->lock);
+    }
+}
+
+// ============================================================================
+// Submission
+// ============================================================================
+
+void block_submit(BlockDevice* dev, Bio* bio, BlockPlug* plug) {
+    bio->next = nullptr;
+    bio->done = false;
+    bio->status = 0;
+
+    if (plug) {
+        if (plug->last) plug->last->next = bio;
+        else plug->first = bio;
+        plug->last = bio;
+        return;
+    }
+
+    spinlock_acquire(&dev->lock);
+    enqueue(dev, bio);
+    dispatch(dev);
+    spinlock_release(&dev->lock);
+}
+
+void block_plug(BlockPlug* plug) {
+    plug->first = plug->last = nullptr;
+}
+
+void block_unplug(BlockDevice* dev, BlockPlug* plug) {
+    Bio* bio = plug->first;
+    plug->first = plug->last = nullptr;
+    if (!bio) return;
+
+    spinlock_acquire(&dev->lock);
+    while (bio) {
+        Bio* next = bio->next;
+        bio->next = nullptr;
+        enqueue(dev, bio);
+        bio = next;
+    }
+    dispatch(dev);
+    spinlock_release(&dev->lock);
+}
+
+int block_wait(BlockDevice* dev, Bio* bio) {
+    uint64_t timeout = dev->irq != BLOCK_NO_IRQ ? BLOCK_IRQ_BACKSTOP : BLOCK_POLL_TICKS;
+
+    spinlock_acquire(&dev->lock);
+    while (!__atomic_load_n(&bio->done, __ATOMIC_ACQUIRE)) {
+        if (!wait_queue_sleep(&dev->waiters, &dev->lock, timeout)) {
+            dev->ops->reap(dev);
+            dispatch(dev);
+        }
+    }
+    spinlock_release(&dev->lock);
+    return bio->status;
+}
+
+int block_rw(BlockDevice* dev, uint8_t op, uint64_t sector, const BlockSegment* segs, uint32_t seg_count) {
+    Bio bio = {};
+    bio.op = op;
+    bio.sector = sector;
+    bio.segs = segs;
+    bio.seg_count = seg_count;
+    for (uint32_t i = 0; i < seg_count; i++) {
+        bio.sectors += segs[i].len / BLOCK_SECTOR_SIZE;
+    }
+
+    block_submit(dev, &bio, nullptr);
+    return block_wait(dev, &bio);
+}
+
+int block_flush(BlockDevice* dev) {
+    Bio bio = {};
+    bio.op = BLOCK_FLUSH;
+
+    block_submit(dev, &bio, nullptr);
+    return block_wait(dev, &bio);
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "waitqueue.h"
+
+/**
+ * @file block.h
+ * @brief Block layer: request queues between filesystems and disk drivers
+ *
+ * Callers describe I/O as Bios: a run of sectors and the physical pages
+ * holding them, so data moves by DMA straight to or from the caller's
+ * frames. Each device keeps its waiting requests sorted by sector. A bio
+ * that continues (or precedes) a waiting request of the same kind is
+ * merged into it, so a stream of small sequential bios reaches the disk as
+ * a few large commands. Requests are handed to the driver in elevator
+ * order (C-LOOK: upward from the last dispatched sector, then back to the
+ * lowest) until its queue depth is full, and complete from the device's
+ * interrupt, which dispatches the next ones.
+ *
+ * Plugging batches a burst: bios submitted between block_plug() and
+ * block_unplug() are held back, then queued under one lock acquisition and
+ * dispatched together, so they merge with each other and the driver
+ * notifies the device once.
+ *
+ * Reads and writes of the same sectors that are in flight together may
+ * complete in either order; callers that care wait in between. A flush
+ * makes every write that completed before it durable.
+ *
+ * Usage:
+ *   BlockPlug plug;
+ *   block_plug(&plug);
+ *   for (...) block_submit(dev, &bios[i], &plug);
+ *   block_unplug(dev, &plug);
+ *   for (...) block_wait(dev, &bios[i]);
+ */
+
+#define BLOCK_SECTOR_SIZE   512
+#define BLOCK_MAX_DEVICES   8
+#define BLOCK_NO_IRQ        0xFF    // BlockDevice::irq: poll for completions
+
+// Bio::op
+#define BLOCK_READ          0
+#define BLOCK_WRITE         1
+#define BLOCK_FLUSH         2       // No data: make completed writes durable
+
+// A physically contiguous piece of a bio's buffer. len is a multiple of
+// the sector size and the piece doesn't cross a page boundary.
+struct BlockSegment {
+    uint64_t phys;
+    uint32_t len;
+};
+
+struct Bio {
+    uint8_t op;
+    uint64_t sector;            // First sector
+    uint32_t sectors;           // Sum of the segment lengths, in sectors
+    const BlockSegment* segs;   // Caller's, left alone until done
+    uint32_t seg_count;
+
+    // Block layer
+    Bio* next;                  // In a plug or a request
+    volatile bool done;
+    int status;                 // 0, or -1 on error (valid once done)
+};
+
+// Merged bios, sent to the driver as one command
+struct BlockRequest {
+    uint8_t op;
+    uint64_t sector;
+    uint32_t sectors;
+    uint32_t seg_count;
+    Bio* first;                 // In sector order
+    Bio* last;
+    BlockRequest* next;         // Device queue, sorted by sector
+    uint32_t tag;               // Driver's command slot
+};
+
+struct BlockDevice;
+
+// Driver entry points, all called with dev->lock held
+struct BlockDriverOps {
+    // Start req on the hardware. Returns false if no command slot is free;
+    // the request then stays queued.
+    bool (*submit)(BlockDevice* dev, BlockRequest* req);
+    // Tell the device about everything submitted since the last kick
+    // (nullptr if submit already did)
+    void (*kick)(BlockDevice* dev);
+    // Acknowledge the device's interrupt and block_complete() every
+    // finished request. Also called to poll.
+    void (*reap)(BlockDevice* dev);
+};
+
+struct BlockDevice {
+    char name[8];               // "sata0", "vblk0"
+    uint64_t sectors;           // Capacity
+    uint32_t max_sectors;       // Per request
+    uint32_t max_segments;      // Per request
+    uint32_t depth;             // Requests the driver takes at once
+    uint8_t irq;                // Legacy IRQ line, or BLOCK_NO_IRQ
+    bool write_cache;           // Needs BLOCK_FLUSH (else flushes complete at once)
+    const BlockDriverOps* ops;
+    void* priv;                 // Driver's
+
+    // Block layer
+    Spinlock lock;
+    BlockRequest* queue;        // Waiting requests, sorted by sector
+    uint32_t in_flight;
+    uint64_t head;              // Sector after the last dispatched request
+    WaitQueue waiters;          // Tasks in block_wait()
+    BlockRequest* spare;        // Finished requests, reused before allocating
+
+    // Statistics
+    uint64_t bios;
+    uint64_t merges;            // Bios folded into an existing request
+    uint64_t requests;          // Commands dispatched
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+    uint64_t errors;
+};
+
+struct BlockPlug {
+    Bio* first;
+    Bio* last;
+};
+
+// Probe for AHCI and virtio-blk disks (after pci_init)
+void block_init();
+
+// Add a disk found by a driver. Fills the block layer fields of dev.
+bool block_register(BlockDevice* dev);
+
+// Set dev->name to prefix followed by index ("sata0")
+void block_make_name(BlockDevice* dev, const char* prefix, uint32_t index);
+
+uint32_t block_get_device_count();
+BlockDevice* block_get_device(uint32_t index);
+
+// Queue bio, or hold it on plug until block_unplug() when plug isn't
+// nullptr. A bio the device can't take (past the end, or larger than
+// max_sectors/max_segments) completes at once with an error.
+void block_submit(BlockDevice* dev, Bio* bio, BlockPlug* plug);
+
+void block_plug(BlockPlug* plug);
+void block_unplug(BlockDevice* dev, BlockPlug* plug);
+
+// Sleep until bio is done. Returns its status.
+int block_wait(BlockDevice* dev, Bio* bio);
+
+// Synchronous helpers. Return 0 or -1.
+int block_rw(BlockDevice* dev, uint8_t op, uint64_t sector, const BlockSegment* segs, uint32_t seg_count);
+int block_flush(BlockDevice* dev);
+
+// Driver side: req finished (dev->lock held). Frees req.
+void block_complete(BlockDevice* dev, BlockRequest* req, int status);
+
+// From the IRQ dispatcher: reap every disk on this line
+void block_irq(uint8_t irq);
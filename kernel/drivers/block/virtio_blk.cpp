@@ -0,0 +1,258 @@
+#include "virtio_blk.h"
+#include "block.h"
+#include "pci.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "io.h"
+#include "heap.h"
+#include "debug.h"
+
+#include "kstring.h"
+using kstring::memset;
+
+#define PAGE_SIZE 4096
+
+// Per-slot page: indirect descriptor table, then the header and status
+#define VBLK_HEADER_OFFSET  2048
+#define VBLK_STATUS_OFFSET  (VBLK_HEADER_OFFSET + sizeof(VirtioBlkHeader))
+#define VBLK_MAX_SEGS       (VBLK_HEADER_OFFSET / sizeof(VirtqDesc) - 2)
+#define VBLK_MAX_DEPTH      32
+
+struct VirtioBlk {
+    uint16_t io;
+    uint16_t queue_size;
+
+    VirtqDesc* desc;
+    VirtqAvail* avail;
+    VirtqUsed* used;
+    uint16_t avail_idx;         // Next avail entry (published by kick)
+    uint16_t used_idx;          // Next used entry to reap
+
+    uint8_t* slot_page[VBLK_MAX_DEPTH];
+    uint64_t slot_phys[VBLK_MAX_DEPTH];
+    BlockRequest* reqs[VBLK_MAX_DEPTH];
+    uint32_t busy;              // Slots on the ring
+
+    BlockDevice dev;
+};
+
+static uint32_t disk_count = 0;
+
+// ============================================================================
+// Queue
+// ============================================================================
+
+// Build slot's indirect table: header, data segments, status
+static uint32_t build_table(VirtioBlk* v, uint32_t slot, const BlockRequest* req) {
+    VirtqDesc* table = (VirtqDesc*)v->slot_page[slot];
+    uint64_t phys = v->slot_phys[slot];
+    uint16_t data_flags = req->op == BLOCK_READ ? VIRTQ_DESC_F_WRITE : 0;
+
+    table[0].addr = phys + VBLK_HEADER_OFFSET;
+    table[0].len = sizeof(VirtioBlkHeader);
+    table[0].flags = 0;
+    uint32_t n = 1;
+
+    for (const Bio* bio = req->first; bio; bio = bio->next) {
+        for (uint32_t i = 0; i < bio->seg_count; i++) {
+            const BlockSegment* seg = &bio->segs[i];
+            VirtqDesc* last = &table[n - 1];
+            if (n > 1 && last->addr + last->len == seg->phys) {
+                last->len += seg->len;  // Physically adjacent: one descriptor
+                continue;
+            }
+            table[n].addr = seg->phys;
+            table[n].len = seg->len;
+            table[n].flags = data_flags;
+            n++;
+        }
+    }
+
+    table[n].addr = phys + VBLK_STATUS_OFFSET;
+    table[n].len = 1;
+    table[n].flags = VIRTQ_DESC_F_WRITE;
+    n++;
+
+    // Chain them in order
+    for (uint32_t i = 0; i + 1 < n; i++) {
+        table[i].flags |= VIRTQ_DESC_F_NEXT;
+        table[i].next = i + 1;
+    }
+    return n;
+}
+
+static bool vblk_submit(BlockDevice* dev, BlockRequest* req) {
+    VirtioBlk* v = (VirtioBlk*)dev->priv;
+
+    uint32_t slot = 0;
+    while (slot < dev->depth && (v->busy & (1u << slot))) slot++;
+    if (slot == dev->depth) return false;
+
+    VirtioBlkHeader* header = (VirtioBlkHeader*)(v->slot_page[slot] + VBLK_HEADER_OFFSET);
+    header->type = req->op == BLOCK_READ ? VIRTIO_BLK_T_IN :
+                   req->op == BLOCK_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_FLUSH;
+    header->reserved = 0;
+    header->sector = req->op == BLOCK_FLUSH ? 0 : req->sector;
+    v->slot_page[slot][VBLK_STATUS_OFFSET] = 0xFF;
+
+    uint32_t entries = build_table(v, slot, req);
+
+    // Ring descriptor i always belongs to slot i
+    v->desc[slot].addr = v->slot_phys[slot];
+    v->desc[slot].len = entries * sizeof(VirtqDesc);
+    v->desc[slot].flags = VIRTQ_DESC_F_INDIRECT;
+    v->desc[slot].next = 0;
+
+    v->avail->ring[v->avail_idx % v->queue_size] = slot;
+    v->avail_idx++;
+
+    req->tag = slot;
+    v->reqs[slot] = req;
+    v->busy |= 1u << slot;
+    return true;
+}
+
+// Publish the new avail entries and notify the device once
+static void vblk_kick(BlockDevice* dev) {
+    VirtioBlk* v = (VirtioBlk*)dev->priv;
+    if (v->avail->idx == v->avail_idx) return;
+
+    asm volatile("mfence" ::: "memory");  // Descriptors before the index
+    v->avail->idx = v->avail_idx;
+    asm volatile("mfence" ::: "memory");  // Index before reading flags
+
+    if (!(v->used->flags & VIRTQ_USED_F_NO_NOTIFY)) {
+        outw(v->io + VIRTIO_REG_QUEUE_NOTIFY, 0);
+    }
+}
+
+static void vblk_reap(BlockDevice* dev) {
+    VirtioBlk* v = (VirtioBlk*)dev->priv;
+    inb(v->io + VIRTIO_REG_ISR);  // Reading acknowledges the interrupt
+
+    while (v->used_idx != v->used->idx) {
+        asm volatile("" ::: "memory");  // Entry after the index (x86: loads ordered)
+        uint32_t slot = v->used->ring[v->used_idx % v->queue_size].id;
+        v->used_idx++;
+        if (slot >= dev->depth || !(v->busy & (1u << slot))) continue;
+
+        uint8_t status = v->slot_page[slot][VBLK_STATUS_OFFSET];
+        v->busy &= ~(1u << slot);
+        block_complete(dev, v->reqs[slot], status == VIRTIO_BLK_S_OK ? 0 : -1);
+        v->reqs[slot] = nullptr;
+    }
+}
+
+static const BlockDriverOps vblk_ops = {vblk_submit, vblk_kick, vblk_reap};
+
+// ============================================================================
+// Probe
+// ============================================================================
+
+static bool vblk_probe(const PciDevice* pci) {
+    pci_enable_io_space(pci);
+    pci_enable_bus_mastering(pci);
+
+    uint64_t bar0 = pci_get_bar(pci, 0, nullptr);
+    if (!bar0 || pci_bar_is_mmio(pci, 0)) return false;
+    uint16_t io = (uint16_t)bar0;
+
+    // Reset, then acknowledge
+    outb(io + VIRTIO_REG_STATUS, 0);
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK);
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+
+    uint32_t features = inl(io + VIRTIO_REG_HOST_FEATURES);
+    if (!(features & VIRTIO_F_INDIRECT_DESC)) {
+        DEBUG_WARN("virtio-blk: No indirect descriptors, ignoring");
+        outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    features &= VIRTIO_F_INDIRECT_DESC | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_FLUSH;
+    outl(io + VIRTIO_REG_GUEST_FEATURES, features);
+
+    outw(io + VIRTIO_REG_QUEUE_SEL, 0);
+    uint16_t queue_size = inw(io + VIRTIO_REG_QUEUE_NUM);
+    if (queue_size == 0) {
+        outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    // Legacy layout: descriptors and avail ring, then the used ring on the
+    // next page boundary
+    uint64_t avail_end = queue_size * sizeof(VirtqDesc) + 6 + 2 * queue_size;
+    uint64_t used_offset = (avail_end + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t ring_bytes = used_offset + 6 + sizeof(VirtqUsedElem) * queue_size;
+    DMAAllocation ring = vmm_alloc_dma((ring_bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+
+    VirtioBlk* v = (VirtioBlk*)malloc(sizeof(VirtioBlk));
+    if (!ring.phys || !v) {
+        if (v) free(v);
+        outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    memset(v, 0, sizeof(VirtioBlk));
+    memset((void*)ring.virt, 0, ring.size);
+
+    v->io = io;
+    v->queue_size = queue_size;
+    v->desc = (VirtqDesc*)ring.virt;
+    v->avail = (VirtqAvail*)(ring.virt + queue_size * sizeof(VirtqDesc));
+    v->used = (VirtqUsed*)(ring.virt + used_offset);
+
+    uint32_t depth = queue_size < VBLK_MAX_DEPTH ? queue_size : VBLK_MAX_DEPTH;
+    for (uint32_t slot = 0; slot < depth; slot++) {
+        uint64_t phys = (uint64_t)pmm_alloc_frame();
+        if (!phys) {
+            depth = slot;
+            break;
+        }
+        v->slot_phys[slot] = phys;
+        v->slot_page[slot] = (uint8_t*)vmm_phys_to_virt(phys);
+    }
+    if (depth == 0) {
+        outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return false;  // The ring and v stay allocated; the device is dead
+    }
+
+    uint32_t max_segs = VBLK_MAX_SEGS;
+    if (features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t seg_max = inl(io + VIRTIO_REG_CONFIG + VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max && seg_max < max_segs) max_segs = seg_max;
+    }
+
+    // Shared lines are polled, as for AHCI
+    uint8_t irq = BLOCK_NO_IRQ;
+    if (pci->irq_line > 2 && pci->irq_line < 16 && !pci_irq_line_shared(pci)) {
+        irq = pci->irq_line;
+        pci_enable_interrupts(pci);
+    } else {
+        v->avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+        pci_disable_interrupts(pci);
+    }
+
+    outl(io + VIRTIO_REG_QUEUE_PFN, (uint32_t)(ring.phys / PAGE_SIZE));
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+    uint32_t cap_lo = inl(io + VIRTIO_REG_CONFIG + VIRTIO_BLK_CFG_CAPACITY);
+    uint32_t cap_hi = inl(io + VIRTIO_REG_CONFIG + VIRTIO_BLK_CFG_CAPACITY + 4);
+
+    block_make_name(&v->dev, "vblk", disk_count++);
+    v->dev.sectors = ((uint64_t)cap_hi << 32) | cap_lo;
+    v->dev.max_segments = max_segs;
+    v->dev.max_sectors = max_segs * (PAGE_SIZE / BLOCK_SECTOR_SIZE);
+    v->dev.depth = depth;
+    v->dev.irq = irq;
+    v->dev.write_cache = features & VIRTIO_BLK_F_FLUSH;
+    v->dev.ops = &vblk_ops;
+    v->dev.priv = v;
+
+    return block_register(&v->dev);
+}
+
+void virtio_blk_init() {
+    PciDevice pci;
+    for (uint32_t i = 0; pci_find_device_by_id(VIRTIO_VENDOR_ID, VIRTIO_DEV_BLOCK_LEGACY, i, &pci); i++) {
+        vblk_probe(&pci);
+    }
+}
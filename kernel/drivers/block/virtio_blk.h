@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+
+// virtio block device driver (legacy/transitional PCI interface, as QEMU's
+// -drive if=virtio provides). Each device becomes "vblkN". Every request
+// takes one ring descriptor pointing to an indirect table, so the queue
+// depth is the ring size, not the ring size over the segment count.
+
+#define VIRTIO_VENDOR_ID        0x1AF4
+#define VIRTIO_DEV_BLOCK_LEGACY 0x1001
+
+// Legacy I/O registers (relative to BAR0)
+#define VIRTIO_REG_HOST_FEATURES    0x00
+#define VIRTIO_REG_GUEST_FEATURES   0x04
+#define VIRTIO_REG_QUEUE_PFN        0x08
+#define VIRTIO_REG_QUEUE_NUM        0x0C
+#define VIRTIO_REG_QUEUE_SEL        0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY     0x10
+#define VIRTIO_REG_STATUS           0x12
+#define VIRTIO_REG_ISR              0x13
+#define VIRTIO_REG_CONFIG           0x14    // Without MSI-X
+
+// Block device config (relative to VIRTIO_REG_CONFIG)
+#define VIRTIO_BLK_CFG_CAPACITY     0x00    // u64, in 512-byte sectors
+#define VIRTIO_BLK_CFG_SEG_MAX      0x0C    // u32
+
+#define VIRTIO_STATUS_ACK           1
+#define VIRTIO_STATUS_DRIVER        2
+#define VIRTIO_STATUS_DRIVER_OK     4
+#define VIRTIO_STATUS_FAILED        128
+
+#define VIRTIO_BLK_F_SEG_MAX        (1u << 2)
+#define VIRTIO_BLK_F_FLUSH          (1u << 9)
+#define VIRTIO_F_INDIRECT_DESC      (1u << 28)
+
+struct VirtqDesc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+#define VIRTQ_DESC_F_NEXT       1
+#define VIRTQ_DESC_F_WRITE      2   // Device writes (else reads)
+#define VIRTQ_DESC_F_INDIRECT   4
+
+struct VirtqAvail {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed));
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1
+
+struct VirtqUsedElem {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed));
+
+struct VirtqUsed {
+    volatile uint16_t flags;
+    volatile uint16_t idx;
+    VirtqUsedElem ring[];
+} __attribute__((packed));
+
+#define VIRTQ_USED_F_NO_NOTIFY      1
+
+// Request header, device-readable
+struct VirtioBlkHeader {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_T_FLUSH      4
+
+#define VIRTIO_BLK_S_OK         0
+
+// Find virtio block devices and register them
+void virtio_blk_init();
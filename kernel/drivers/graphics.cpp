@@ -3,6 +3,7 @@
 #include "heap.h"
 #include "pmm.h"
 #include "vmm.h"
+#include "fpu.h"
 
 static struct limine_framebuffer* framebuffer = nullptr;
 static uint32_t* backbuffer = nullptr;   // The RAM buffer (allocated after heap_init)
@@ -115,6 +116,11 @@ void gfx_swap_buffers() {
     uint32_t copy_width = x2 - x1 + 1;
     if (copy_width == 0) return;
 
+    // Interrupt handlers may have cut into an SSE section: copy with plain
+    // stores there
+    bool sse = kernel_fpu_usable();
+    if (sse) kernel_fpu_begin();
+
     // FAST PATH: If copying full width rows, use bulk transfer (skip row-by-row overhead)
     // This is critical for scroll performance - avoids 1080 loop iterations
     if (x1 == 0 && copy_width == width) {
@@ -129,7 +135,7 @@ void gfx_swap_buffers() {
         }
         
         // Bulk SSE2 non-temporal copy: 32 bytes per iteration
-        while (total_u32 >= 8) {
+        while (sse && total_u32 >= 8) {
             asm volatile(
                 "prefetchnta 256(%0)\n\t"
                 "movdqu   (%0), %%xmm0\n\t"
@@ -164,7 +170,7 @@ void gfx_swap_buffers() {
             }
 
             // Unrolled SSE2 loop: Process 32 bytes (8 pixels) per iteration
-            while (count >= 8) {
+            while (sse && count >= 8) {
                 asm volatile(
                     "prefetchnta 128(%0)\n\t"
                     "movdqu   (%0), %%xmm0\n\t"
@@ -181,7 +187,7 @@ void gfx_swap_buffers() {
             }
 
             // Handle remaining 4 pixels
-            if (count >= 4) {
+            if (sse && count >= 4) {
                 asm volatile(
                     "movdqu (%0), %%xmm0\n\t"
                     "movntdq %%xmm0, (%1)\n\t"
@@ -202,7 +208,10 @@ void gfx_swap_buffers() {
     }
 
     // Memory fence to ensure all WC buffers are flushed to VRAM
-    asm volatile("sfence" ::: "memory");
+    if (sse) {
+        asm volatile("sfence" ::: "memory");
+        kernel_fpu_end();
+    }
 
     // Reset dirty tracking for next frame
     dirty_min_x = width;   // Inverted bounds to detect first write
@@ -239,6 +248,8 @@ void gfx_clear(uint32_t color) {
     // Create 128-bit color pattern (4 pixels)
     uint32_t color_arr[4] __attribute__((aligned(16))) = {color, color, color, color};
     
+    bool sse = kernel_fpu_usable();  // Plain stores in interrupt handlers
+    if (sse) kernel_fpu_begin();
     for (uint64_t y = 0; y < height; y++) {
         uint32_t* row = target_buffer + y * pitch_u32;
         uint64_t count = width;
@@ -250,7 +261,7 @@ void gfx_clear(uint32_t color) {
         }
         
         // SSE2 fill: 8 pixels per iteration with prefetching
-        while (count >= 8) {
+        while (sse && count >= 8) {
             asm volatile(
                 "movdqa (%0), %%xmm0\n\t"     // Load color pattern
                 "movdqu %%xmm0,   (%1)\n\t"   // Store 4 pixels
@@ -268,6 +279,7 @@ void gfx_clear(uint32_t color) {
             *row++ = color;
         }
     }
+    if (sse) kernel_fpu_end();
     
     // Mark entire screen as needing redraw
     full_redraw_needed = true;
@@ -466,8 +478,11 @@ void gfx_scroll_up(int pixels, uint32_t fill_color) {
     uint32_t* src = target_buffer + (pixels * pitch);
     uint64_t total_u32 = rows_to_move * pitch;  // Total uint32_t elements to copy
     
+    bool sse = kernel_fpu_usable();  // Plain stores in interrupt handlers
+    if (sse) kernel_fpu_begin();
+
     // SSE2 bulk copy: 8 uint32_t (32 bytes) per iteration
-    while (total_u32 >= 8) {
+    while (sse && total_u32 >= 8) {
         asm volatile(
             "prefetchnta 256(%0)\n\t"   // Prefetch ahead for streaming
             "movdqu   (%0), %%xmm0\n\t"
@@ -495,7 +510,7 @@ void gfx_scroll_up(int pixels, uint32_t fill_color) {
     uint32_t color_arr[4] __attribute__((aligned(16))) = {fill_color, fill_color, fill_color, fill_color};
     
     // SSE2 bulk fill: 8 pixels per iteration
-    while (fill_count >= 8) {
+    while (sse && fill_count >= 8) {
         asm volatile(
             "movdqa (%0), %%xmm0\n\t"
             "movdqu %%xmm0,   (%1)\n\t"
@@ -512,6 +527,7 @@ void gfx_scroll_up(int pixels, uint32_t fill_color) {
     while (fill_count--) {
         *fill_start++ = fill_color;
     }
+    if (sse) kernel_fpu_end();
     
     // Mark entire visible area as dirty instead of full_redraw_needed
     // This allows multiple scrolls to accumulate without redundant full copies
@@ -5,6 +5,7 @@
 #include "usb_hid.h"
 #include "xhci.h"
 #include "graphics.h"
+#include "softirq.h"
 
 // =============================================================================
 // Unified Input Subsystem Implementation
@@ -46,6 +47,10 @@ void input_init() {
 // -----------------------------------------------------------------------------
 
 void input_poll() {
+    // Called from the INPUT softirq and from loops that want fresh input;
+    // softirqs stay off so the two never walk the xHCI event ring at once
+    local_bh_disable();
+    
     // Poll xHCI controller for events (USB transfers, port changes)
     if (xhci_is_initialized()) {
         xhci_poll_events();
@@ -55,6 +60,8 @@ void input_poll() {
     usb_hid_poll();
     
     // Note: PS/2 keyboard/mouse are interrupt-driven, no polling needed
+    
+    local_bh_enable();
 }
 
 // -----------------------------------------------------------------------------
@@ -161,6 +161,55 @@ bool pci_find_hda(PciDevice* out) {
     return false;
 }
 
+// Find the index'th function (0 = first) with the given IDs
+bool pci_find_device_by_id(uint16_t vendor_id, uint16_t device_id, uint32_t index, PciDevice* out) {
+    for (uint16_t bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (uint8_t dev = 0; dev < PCI_MAX_DEVICE; dev++) {
+            if (!pci_device_exists(bus, dev, 0)) continue;
+
+            uint8_t header_type = pci_config_read8(bus, dev, 0, PCI_HEADER_TYPE);
+            uint8_t max_func = (header_type & 0x80) ? PCI_MAX_FUNC : 1;
+
+            for (uint8_t func = 0; func < max_func; func++) {
+                if (!pci_device_exists(bus, dev, func)) continue;
+
+                if (pci_config_read16(bus, dev, func, PCI_VENDOR_ID) == vendor_id &&
+                    pci_config_read16(bus, dev, func, PCI_DEVICE_ID) == device_id &&
+                    index-- == 0) {
+                    pci_enum_function(bus, dev, func, out);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Level-triggered lines are shared: a function that asserts INTx while
+// its driver polls would keep the line busy for everyone on it
+bool pci_irq_line_shared(const PciDevice* dev) {
+    for (uint16_t bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (uint8_t d = 0; d < PCI_MAX_DEVICE; d++) {
+            if (!pci_device_exists(bus, d, 0)) continue;
+
+            uint8_t header_type = pci_config_read8(bus, d, 0, PCI_HEADER_TYPE);
+            uint8_t max_func = (header_type & 0x80) ? PCI_MAX_FUNC : 1;
+
+            for (uint8_t func = 0; func < max_func; func++) {
+                if (!pci_device_exists(bus, d, func)) continue;
+                if (bus == dev->bus && d == dev->device && func == dev->function) continue;
+
+                if (pci_config_read8(bus, d, func, PCI_INTERRUPT_PIN) != 0 &&
+                    pci_config_read8(bus, d, func, PCI_INTERRUPT_LINE) == dev->irq_line &&
+                    !(pci_config_read16(bus, d, func, PCI_COMMAND) & PCI_COMMAND_INT_DISABLE)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
 // Get BAR value and optionally size
 uint64_t pci_get_bar(const PciDevice* dev, int bar_num, uint64_t* size_out) {
     if (bar_num < 0 || bar_num > 5) return 0;
@@ -41,6 +41,10 @@
 #define PCI_SUBCLASS_AC97       0x01
 #define PCI_SUBCLASS_HDA        0x03
 
+#define PCI_CLASS_STORAGE       0x01
+#define PCI_SUBCLASS_SATA       0x06
+#define PCI_PROGIF_AHCI         0x01
+
 #define PCI_PROGIF_UHCI         0x00
 #define PCI_PROGIF_OHCI         0x10
 #define PCI_PROGIF_EHCI         0x20
@@ -89,6 +93,10 @@ bool pci_find_device_by_class(uint8_t class_code, uint8_t subclass, uint8_t prog
 bool pci_find_xhci(PciDevice* out);
 bool pci_find_ac97(PciDevice* out);
 bool pci_find_hda(PciDevice* out);
+bool pci_find_device_by_id(uint16_t vendor_id, uint16_t device_id, uint32_t index, PciDevice* out);
+
+// Whether another function with INTx enabled shares dev's IRQ line
+bool pci_irq_line_shared(const PciDevice* dev);
 
 // BAR handling
 uint64_t pci_get_bar(const PciDevice* dev, int bar_num, uint64_t* size_out);
@@ -96,6 +96,24 @@ void rtc_get_time(RTCTime* time) {
     time->weekday = weekday;
 }
 
+// Days from 1970-01-01 to a civil date (proleptic Gregorian calendar)
+static uint64_t days_from_civil(uint32_t year, uint32_t month, uint32_t day) {
+    // Count years from March so the leap day falls at the end
+    if (month <= 2) year--;
+    uint32_t era = year / 400;
+    uint32_t yoe = year - era * 400;                                    // [0, 399]
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;  // [0, 365]
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;               // [0, 146096]
+    return (uint64_t)era * 146097 + doe - 719468;
+}
+
+uint64_t rtc_get_epoch_seconds() {
+    RTCTime t;
+    rtc_get_time(&t);
+    uint64_t days = days_from_civil(t.year, t.month, t.day);
+    return days * 86400 + t.hour * 3600 + t.minute * 60 + t.second;
+}
+
 uint64_t rtc_get_uptime_seconds() {
     uint64_t current = timer_get_ticks();
     uint64_t elapsed = current - boot_ticks;
@@ -18,5 +18,8 @@ void rtc_init();
 // Read current time from CMOS RTC
 void rtc_get_time(RTCTime* time);
 
+// Current RTC time as seconds since 1970-01-01 00:00 (RTC assumed UTC)
+uint64_t rtc_get_epoch_seconds();
+
 // Get uptime in seconds
 uint64_t rtc_get_uptime_seconds();
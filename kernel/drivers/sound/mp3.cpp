@@ -23,6 +23,8 @@ bool mp3_open(const char* filename, uint8_t** data, uint32_t* data_size, uint32_
     *sample_rate = buffer.sample_rate;
     *channels = buffer.channels;
 
+    unifs_close_into(&file);
+
     // TO-DO: investigate mp3 decoding problems.
     return false;
 }
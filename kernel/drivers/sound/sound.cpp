@@ -17,6 +17,10 @@ static bool hda_available = false;
 static uint8_t preferred_sound_card = SOUND_HD_AUDIO;
 static uint8_t used_sound_card = SOUND_NONE;
 
+// The file the card streams from. It is kept open until the next file is
+// played, so a RAM file's snapshot outlives the playback.
+static UniFSFile sound_file = {};
+
 bool sound_is_initialized() {
     return sound_available;
 }
@@ -122,6 +126,20 @@ void sound_set_sample_rate(uint32_t sample_rate) {
     return used_sound_card == SOUND_HD_AUDIO ? hda_set_sample_rate(sample_rate) : ac97_set_sample_rate(sample_rate);
 }
 
+// Play data from an open file, which becomes sound_file. A card still busy
+// with the previous file refuses it, so it is closed again.
+static void sound_play_file(UniFSFile* file, uint8_t* data, uint32_t size) {
+    if (sound_is_playing()) {
+        sound_play(data, size);
+        unifs_close_into(file);
+        return;
+    }
+
+    unifs_close_into(&sound_file);
+    sound_file = *file;
+    sound_play(data, size);
+}
+
 void sound_play_mp3_file(const char* filename) {
     if (!sound_available) {
         DEBUG_ERROR("sound card not found. audio is not available");
@@ -170,7 +188,8 @@ void sound_play_wav_file(const char* filename) {
     uint32_t channels;
 
     // Try to open WAV file.
-    if (!wav_open(filename, &data_ptr, &data_size, &sample_rate, &channels)) {
+    UniFSFile file;
+    if (!wav_open(filename, &file, &data_ptr, &data_size, &sample_rate, &channels)) {
         DEBUG_ERROR("wav_open failed");
         return;
     }
@@ -185,7 +204,7 @@ void sound_play_wav_file(const char* filename) {
     sound_set_sample_rate(sample_rate);
 
     // Play it!
-    sound_play(data_ptr, data_size);
+    sound_play_file(&file, data_ptr, data_size);
 }
 
 void sound_play_pcm_file(const char* filename) {
@@ -213,7 +232,7 @@ void sound_play_pcm_file(const char* filename) {
     sound_set_sample_rate(22050);
 
     // Play it!
-    sound_play(data_ptr, data_size);
+    sound_play_file(&file, data_ptr, data_size);
 }
 
 void sound_play(uint8_t* data, uint32_t size) {
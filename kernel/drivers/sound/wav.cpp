@@ -2,21 +2,17 @@
 #include "debug.h"
 #include "unifs.h"
 
-bool wav_open(const char* filename, uint8_t** data, uint32_t* data_size, uint32_t* sample_rate, uint32_t* channels) {
-    UniFSFile file;
-    if (!unifs_open_into(filename, &file)) {
-        DEBUG_ERROR("%s: unifs_open_into failed", filename);
-        return false;
-    }
+static bool wav_parse(const char* filename, const UniFSFile* file, uint8_t** data, uint32_t* data_size, uint32_t* sample_rate, uint32_t* channels) {
+    (void)filename; // Only used by debug output
 
-    if (file.size <= 0xFF) {
+    if (file->size <= 0xFF) {
         DEBUG_ERROR("%s: invalid or corrupted wav file", filename);
         return false;
     }
 
     WavHeader wav_header;
-    wav_header.riff_descriptor = (WavRiffDescriptor*)(uint64_t)file.data;
-    wav_header.fmt_chunk = (WavFmtChunk*)((uint64_t)file.data + sizeof(WavRiffDescriptor));
+    wav_header.riff_descriptor = (WavRiffDescriptor*)(uint64_t)file->data;
+    wav_header.fmt_chunk = (WavFmtChunk*)((uint64_t)file->data + sizeof(WavRiffDescriptor));
 
     char* wave = (char*)wav_header.riff_descriptor->wave;
     if (wave[0] != 'W' || wave[1] != 'A' || wave[2] != 'V' || wave[3] != 'E') {
@@ -67,3 +63,16 @@ bool wav_open(const char* filename, uint8_t** data, uint32_t* data_size, uint32_
 
     return true;
 }
+
+bool wav_open(const char* filename, UniFSFile* file, uint8_t** data, uint32_t* data_size, uint32_t* sample_rate, uint32_t* channels) {
+    if (!unifs_open_into(filename, file)) {
+        DEBUG_ERROR("%s: unifs_open_into failed", filename);
+        return false;
+    }
+
+    if (!wav_parse(filename, file, data, data_size, sample_rate, channels)) {
+        unifs_close_into(file);
+        return false;
+    }
+    return true;
+}
@@ -32,4 +32,8 @@ struct WavHeader {
     WavDataChunk* data_chunk;
 };
 
-bool wav_open(const char* filename, uint8_t** data, uint32_t* data_size, uint32_t* sample_rate, uint32_t* channels);
+struct UniFSFile;
+
+// Open and parse a WAV file. *data points into file, which the caller
+// releases with unifs_close_into() once playback is done with it.
+bool wav_open(const char* filename, UniFSFile* file, uint8_t** data, uint32_t* data_size, uint32_t* sample_rate, uint32_t* channels);
@@ -3,6 +3,7 @@
 #include "io.h"
 #include "scheduler.h"
 #include "graphics.h"
+#include "softirq.h"
 
 static volatile uint64_t ticks = 0;
 static uint32_t tick_frequency = 0;
@@ -11,8 +12,11 @@ static uint32_t tick_frequency = 0;
 static uint64_t last_heartbeat_tick = 0;
 static bool heartbeat_on = false;
 
+static void timer_softirq();
+
 void timer_init(uint32_t frequency) {
     tick_frequency = frequency;
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
     
     // PIT runs at 1193182 Hz
     // divisor = 1193182 / desired_frequency
@@ -39,7 +43,11 @@ uint32_t timer_get_frequency() {
 
 void timer_handler() {
     ticks++;
-    
+    raise_softirq(SOFTIRQ_TIMER);
+}
+
+// Tick work that doesn't need to hold off other interrupts
+static void timer_softirq() {
     // Heartbeat: toggle pixel every 500ms (tick_frequency/2 ticks at 1000Hz)
     // This provides visual confirmation that interrupts are still working
     // SAFETY: Only start after 3 seconds to ensure graphics is fully initialized
@@ -48,7 +56,7 @@ void timer_handler() {
         last_heartbeat_tick = ticks;
         heartbeat_on = !heartbeat_on;
         
-        // Draw directly to buffer - safer than calling gfx_put_pixel in IRQ context
+        // Draw directly to buffer - safer than calling gfx_put_pixel from softirq context
         uint32_t* buf = gfx_get_buffer();
         uint64_t w = gfx_get_width();
         if (buf && w > 10) {
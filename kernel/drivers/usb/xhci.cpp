@@ -43,7 +43,8 @@ static XhciController xhci;
 static bool xhci_initialized = false;
 
 // xHCI lock for thread safety during control transfers
-static Spinlock xhci_control_lock = SPINLOCK_INIT;
+static LockStats xhci_control_lock_stats = LOCK_STATS_INIT("xhci_control");
+static Spinlock xhci_control_lock = SPINLOCK_INIT_STATS(&xhci_control_lock_stats);
 
 // Debug flag for verbose logging
 static bool xhci_debug = false;
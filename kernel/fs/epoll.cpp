@@ -0,0 +1,412 @@
+#include "epoll.h"
+#include "poll.h"
+#include "vfs.h"
+#include "mutex.h"
+#include "spinlock.h"
+#include "waitqueue.h"
+#include "timer.h"
+#include "heap.h"
+#include "uaccess.h"
+
+struct Epoll;
+
+// One watched descriptor
+struct EpollItem {
+    EpollItem* next;        // All items of the set
+    EpollItem* file_next;   // All items watching the same File (watch_lock)
+    EpollItem* ready_next;  // Ready list link
+    bool ready;             // On the ready list, or being scanned
+    bool kicked;            // Hook fired while being scanned
+    bool armed;             // False after a ONESHOT event, until MOD
+    Epoll* ep;
+    int fd;
+    File* file;             // Not pinned: file_put() removes the item first
+    uint32_t events;        // EPOLL* interest and flags
+    uint64_t data;          // Returned with each event
+    PollHook hook;          // In file's PollQueue
+};
+
+struct Epoll {
+    Mutex mutex;            // Serializes ctl/wait: protects items and the files
+    Spinlock lock;          // Protects the ready list and waiters (taken by hooks)
+    EpollItem* items;
+    EpollItem* ready_head;
+    EpollItem* ready_tail;
+    WaitQueue waiters;      // Tasks in epoll_wait()
+    PollQueue poll;         // For poll()ing the set itself
+};
+
+// Held while a closing File ends its watches, so the sets they belong to
+// can't be freed under it. Taken before any set's mutex.
+static Mutex epoll_mutex = MUTEX_INIT;
+
+// Protects every File's epoll_items list
+static Spinlock watch_lock = SPINLOCK_INIT;
+
+static void epoll_release(File* f);
+
+// ============================================================================
+// Ready List (ep->lock held)
+// ============================================================================
+
+static void ready_append(Epoll* ep, EpollItem* item) {
+    item->ready = true;
+    item->ready_next = nullptr;
+    if (ep->ready_tail) ep->ready_tail->ready_next = item;
+    else ep->ready_head = item;
+    ep->ready_tail = item;
+}
+
+static void ready_unlink(Epoll* ep, EpollItem* item) {
+    if (!item->ready) return;
+
+    EpollItem** link = &ep->ready_head;
+    EpollItem* prev = nullptr;
+    while (*link != item) {
+        prev = *link;
+        link = &(*link)->ready_next;
+    }
+    *link = item->ready_next;
+    if (ep->ready_tail == item) ep->ready_tail = prev;
+    item->ready = false;
+}
+
+// Queue an item for the next scan and wake the waiters
+static void mark_ready(EpollItem* item) {
+    Epoll* ep = item->ep;
+    bool queued = false;
+
+    spinlock_acquire(&ep->lock);
+    if (item->ready) {
+        item->kicked = true;    // harvest() decides once it's done with it
+    } else if (item->armed) {
+        ready_append(ep, item);
+        wait_queue_wake_all(&ep->waiters);
+        queued = true;
+    }
+    spinlock_release(&ep->lock);
+
+    if (queued) poll_notify(&ep->poll, POLLIN);
+}
+
+// Hook callback: the watched file's readiness changed
+static void item_wake(PollHook* hook, uint32_t) {
+    mark_ready((EpollItem*)hook->priv);
+}
+
+// ============================================================================
+// Items (ep->mutex held)
+// ============================================================================
+
+static EpollItem* find_item(Epoll* ep, int fd) {
+    for (EpollItem* item = ep->items; item; item = item->next) {
+        if (item->fd == fd) return item;
+    }
+    return nullptr;
+}
+
+static void hook_item(EpollItem* item) {
+    item->hook.prev = item->hook.next = nullptr;
+    item->hook.queue = nullptr;
+    item->hook.events = item->events & (EPOLLIN | EPOLLOUT);
+    item->hook.wake = item_wake;
+    item->hook.priv = item;
+
+    PollQueue* q = vfs_poll_queue(item->file);
+    if (q) poll_hook_add(q, &item->hook);
+}
+
+static void link_watch(EpollItem* item) {
+    spinlock_acquire(&watch_lock);
+    item->file_next = item->file->epoll_items;
+    __atomic_store_n(&item->file->epoll_items, item, __ATOMIC_RELEASE);
+    spinlock_release(&watch_lock);
+}
+
+static void unlink_watch(EpollItem* item) {
+    spinlock_acquire(&watch_lock);
+    EpollItem** link = &item->file->epoll_items;
+    while (*link != item) link = &(*link)->file_next;
+    *link = item->file_next;
+    spinlock_release(&watch_lock);
+}
+
+static void destroy_item(Epoll* ep, EpollItem* item) {
+    poll_hook_remove(&item->hook);
+
+    spinlock_acquire(&ep->lock);
+    ready_unlink(ep, item);
+    spinlock_release(&ep->lock);
+
+    unlink_watch(item);
+    free(item);
+}
+
+// f is the caller's reference to the file open on fd
+static int ctl_add(Epoll* ep, int fd, File* f, const EpollEvent* event) {
+    if (find_item(ep, fd)) return -1;
+
+    // Sets watching sets could form cycles of locks and wakeups
+    if (f->ops->release == epoll_release) return -1;
+
+    EpollItem* item = (EpollItem*)malloc(sizeof(EpollItem));
+    if (!item) return -1;
+    item->ep = ep;
+    item->fd = fd;
+    item->file = f;
+    item->events = event->events;
+    item->data = event->data;
+    item->ready = false;
+    item->kicked = false;
+    item->armed = true;
+    item->next = ep->items;
+    ep->items = item;
+    link_watch(item);
+
+    // Hook first, then queue for a first look, so no change is missed
+    hook_item(item);
+    mark_ready(item);
+    return 0;
+}
+
+static int ctl_mod(Epoll* ep, int fd, const EpollEvent* event) {
+    EpollItem* item = find_item(ep, fd);
+    if (!item) return -1;
+
+    poll_hook_remove(&item->hook);
+    item->events = event->events;
+    item->data = event->data;
+    hook_item(item);
+
+    spinlock_acquire(&ep->lock);
+    item->armed = true;
+    spinlock_release(&ep->lock);
+    mark_ready(item);
+    return 0;
+}
+
+static int ctl_del(Epoll* ep, int fd) {
+    for (EpollItem** link = &ep->items; *link; link = &(*link)->next) {
+        EpollItem* item = *link;
+        if (item->fd == fd) {
+            *link = item->next;
+            destroy_item(ep, item);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Move a detached chain onto the ready list
+static void ready_splice(Epoll* ep, EpollItem* chain) {
+    while (chain) {
+        EpollItem* next = chain->ready_next;
+        ready_append(ep, chain);
+        chain = next;
+    }
+}
+
+// Take events off the ready list. Level-triggered items that are still
+// ready go back on the end, so busy descriptors take turns. Items being
+// scanned keep `ready` set, so hooks only mark them kicked instead of
+// relinking them under our feet.
+static int harvest(Epoll* ep, EpollEvent* out, int max) {
+    spinlock_acquire(&ep->lock);
+    EpollItem* list = ep->ready_head;
+    ep->ready_head = ep->ready_tail = nullptr;
+    for (EpollItem* item = list; item; item = item->ready_next) item->kicked = false;
+    spinlock_release(&ep->lock);
+
+    int n = 0;
+    EpollItem* requeue = nullptr;
+    EpollItem** requeue_tail = &requeue;
+    EpollItem* dropped = nullptr;
+
+    while (list) {
+        EpollItem* item = list;
+        list = item->ready_next;
+
+        // Full: put the rest back, unchecked
+        bool keep = n == max;
+        if (!keep) {
+            uint32_t want = (item->events & (EPOLLIN | EPOLLOUT)) | EPOLLERR | EPOLLHUP;
+            uint32_t revents = item->armed ? vfs_poll(item->file) & want : 0;
+            if (revents) {
+                out[n].events = revents;
+                out[n].data = item->data;
+                n++;
+
+                if (item->events & EPOLLONESHOT) item->armed = false;
+                keep = !(item->events & (EPOLLONESHOT | EPOLLET));
+            }
+        }
+
+        if (keep) {
+            *requeue_tail = item;
+            requeue_tail = &item->ready_next;
+        } else {
+            item->ready_next = dropped;
+            dropped = item;
+        }
+    }
+    *requeue_tail = nullptr;
+
+    // Requeued items go ahead of ones hooks queued meanwhile; dropped ones
+    // only come back if their file changed while we looked
+    spinlock_acquire(&ep->lock);
+    EpollItem* fresh = ep->ready_head;
+    ep->ready_head = ep->ready_tail = nullptr;
+    ready_splice(ep, requeue);
+    while (dropped) {
+        EpollItem* next = dropped->ready_next;
+        if (dropped->kicked && dropped->armed) ready_append(ep, dropped);
+        else dropped->ready = false;
+        dropped = next;
+    }
+    ready_splice(ep, fresh);
+    if (ep->ready_head) wait_queue_wake_all(&ep->waiters);
+    spinlock_release(&ep->lock);
+    return n;
+}
+
+// ============================================================================
+// File Backend
+// ============================================================================
+
+static uint32_t epoll_poll(File* f) {
+    Epoll* ep = (Epoll*)f->priv;
+    return ep->ready_head ? POLLIN : 0;
+}
+
+static PollQueue* epoll_poll_queue(File* f) {
+    return &((Epoll*)f->priv)->poll;
+}
+
+static void epoll_release(File* f) {
+    Epoll* ep = (Epoll*)f->priv;
+
+    mutex_lock(&epoll_mutex);
+    while (ep->items) {
+        EpollItem* item = ep->items;
+        ep->items = item->next;
+        destroy_item(ep, item);
+    }
+    mutex_unlock(&epoll_mutex);
+    free(ep);
+}
+
+static const FileOps epoll_ops = {
+    nullptr,        // Only epoll_ctl/epoll_wait
+    nullptr,
+    nullptr,
+    nullptr,
+    epoll_poll,
+    epoll_poll_queue,
+    epoll_release,
+};
+
+File* epoll_open_file() {
+    Epoll* ep = (Epoll*)malloc(sizeof(Epoll));
+    if (!ep) return nullptr;
+
+    mutex_init(&ep->mutex);
+    spinlock_init(&ep->lock);
+    wait_queue_init(&ep->waiters);
+    poll_queue_init(&ep->poll);
+    ep->items = nullptr;
+    ep->ready_head = ep->ready_tail = nullptr;
+
+    File* f = file_alloc(&epoll_ops, ep, O_RDWR);
+    if (!f) free(ep);
+    return f;
+}
+
+void epoll_file_release(File* f) {
+    mutex_lock(&epoll_mutex);
+    for (;;) {
+        spinlock_acquire(&watch_lock);
+        EpollItem* first = f->epoll_items;
+        Epoll* ep = first ? first->ep : nullptr;
+        spinlock_release(&watch_lock);
+        if (!ep) break;
+
+        // The item may go away before we hold the set's mutex; whatever
+        // of the set still watches f is found again under it
+        mutex_lock(&ep->mutex);
+        EpollItem** link = &ep->items;
+        while (*link) {
+            EpollItem* item = *link;
+            if (item->file == f) {
+                *link = item->next;
+                destroy_item(ep, item);
+            } else {
+                link = &item->next;
+            }
+        }
+        mutex_unlock(&ep->mutex);
+    }
+    mutex_unlock(&epoll_mutex);
+}
+
+int epoll_ctl(File* epf, int op, int fd, const EpollEvent* event) {
+    if (epf->ops != &epoll_ops) return -1;
+    Epoll* ep = (Epoll*)epf->priv;
+
+    // Taken outside the mutex: if this turns out to be the last reference,
+    // putting it ends the watch, which needs the mutex
+    File* f = nullptr;
+    if (op == EPOLL_CTL_ADD) {
+        FdTable* table = fd_table_current();
+        f = table ? fd_get(table, fd) : nullptr;
+        if (!f) return -1;
+    }
+
+    mutex_lock(&ep->mutex);
+
+    int ret;
+    switch (op) {
+        case EPOLL_CTL_ADD: ret = ctl_add(ep, fd, f, event); break;
+        case EPOLL_CTL_MOD: ret = ctl_mod(ep, fd, event); break;
+        case EPOLL_CTL_DEL: ret = ctl_del(ep, fd); break;
+        default:            ret = -1; break;
+    }
+
+    mutex_unlock(&ep->mutex);
+    if (f) file_put(f);
+    return ret;
+}
+
+int64_t epoll_wait(File* epf, EpollEvent* user_events, int maxevents, int64_t timeout_ms) {
+    if (epf->ops != &epoll_ops || maxevents <= 0) return -1;
+    Epoll* ep = (Epoll*)epf->priv;
+
+    if (maxevents > EPOLL_MAX_EVENTS) maxevents = EPOLL_MAX_EVENTS;
+    if (!user_range_ok(user_events, maxevents * sizeof(EpollEvent))) return -EFAULT;
+
+    EpollEvent events[EPOLL_MAX_EVENTS];
+    uint64_t deadline = timer_get_ticks() + poll_ms_to_ticks(timeout_ms);
+    int n;
+
+    for (;;) {
+        mutex_lock(&ep->mutex);
+        n = harvest(ep, events, maxevents);
+        mutex_unlock(&ep->mutex);
+        if (n > 0 || timeout_ms == 0) break;
+
+        uint64_t left = WAIT_FOREVER;
+        if (timeout_ms > 0) {
+            uint64_t now = timer_get_ticks();
+            if (now >= deadline) break;
+            left = deadline - now;
+        }
+
+        // Hooks queue items and wake under ep->lock, so checking the list
+        // under it can't miss one
+        spinlock_acquire(&ep->lock);
+        if (!ep->ready_head) wait_queue_sleep(&ep->waiters, &ep->lock, left);
+        spinlock_release(&ep->lock);
+    }
+
+    if (n > 0 && copy_to_user(user_events, events, n * sizeof(EpollEvent)) < 0) return -EFAULT;
+    return n;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================================
+// epoll - Readiness Interest Sets
+// ============================================================================
+// An epoll set is a File holding a list of watched descriptors. Each watch
+// hooks the watched file's PollQueue (see poll.h); when the file changes,
+// the hook puts the watch on the set's ready list and wakes any
+// epoll_wait() caller. epoll_wait() then only looks at ready watches,
+// however many descriptors the set holds.
+//
+// Triggering:
+//   level (default) - a watch stays on the ready list while vfs_poll()
+//                     still reports the event, so it is returned again
+//   EPOLLET         - returned once per change; the program must drain it
+//   EPOLLONESHOT    - returned once, then disarmed until EPOLL_CTL_MOD
+//
+// As on Linux, a watch doesn't keep its File open: each File lists the
+// watches on it, and when its last reference goes they are removed before
+// the backend releases it. Closing one of several descriptors for a File
+// leaves the watch in place. An epoll set can't watch another epoll set.
+// ============================================================================
+
+// Events (same values as POLL*)
+#define EPOLLIN       0x001
+#define EPOLLOUT      0x004
+#define EPOLLERR      0x008
+#define EPOLLHUP      0x010
+#define EPOLLONESHOT  (1u << 30)
+#define EPOLLET       (1u << 31)
+
+// epoll_ctl operations
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_MAX_EVENTS 32     // Most events returned by one epoll_wait()
+
+// Linux struct epoll_event (packed on x86-64)
+struct EpollEvent {
+    uint32_t events;
+    uint64_t data;
+} __attribute__((packed));
+
+struct File;
+
+// New, empty set. Returns nullptr on OOM.
+File* epoll_open_file();
+
+// Add, change or remove the watch on fd (in the calling task's table).
+// event is a kernel copy (ignored for DEL). Returns 0 or -1.
+int epoll_ctl(File* epf, int op, int fd, const EpollEvent* event);
+
+// The last reference to f is gone: remove every watch on it (file_put()
+// calls this before releasing f)
+void epoll_file_release(File* f);
+
+// Wait for ready watches and copy up to maxevents of them to the user
+// array. timeout_ms: 0 = just check, negative = forever. Returns the
+// number of events, 0 on timeout, -1 or -EFAULT.
+int64_t epoll_wait(File* epf, EpollEvent* user_events, int maxevents, int64_t timeout_ms);
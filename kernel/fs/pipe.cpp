@@ -1,99 +1,602 @@
 #include "pipe.h"
+#include "vfs.h"
+#include "uaccess.h"
+#include "uring.h"
+#include "process.h"
+#include "heap.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "kstring.h"
 #include <stddef.h>
 
-static Pipe pipes[MAX_PIPES];
-static bool pipes_initialized = false;
+#define PAGE_SIZE 4096
 
-void pipe_init() {
-    if (pipes_initialized) return;
-    for (int i = 0; i < MAX_PIPES; i++) {
-        pipes[i].in_use = false;
+static void pipe_file_release_read(File* f);
+static void pipe_file_release_write(File* f);
+
+// ============================================================================
+// Pages
+// ============================================================================
+
+static uint8_t* page_ptr(uint64_t phys) {
+    return (uint8_t*)(phys + vmm_get_hhdm_offset());
+}
+
+// A page for new data: the spare if there is one
+static uint64_t page_get(Pipe* p) {
+    uint64_t page = p->spare;
+    if (page) {
+        p->spare = 0;
+        return page;
     }
-    pipes_initialized = true;
-}
-
-int pipe_create() {
-    pipe_init();
-    
-    for (int i = 0; i < MAX_PIPES; i++) {
-        if (!pipes[i].in_use) {
-            pipes[i].in_use = true;
-            pipes[i].read_pos = 0;
-            pipes[i].write_pos = 0;
-            pipes[i].count = 0;
-            pipes[i].write_closed = false;
-            pipes[i].read_closed = false;
-            return i;
+    return (uint64_t)pmm_alloc_frame();
+}
+
+// Keep one drained page for the next write, free the rest
+static void page_put(Pipe* p, uint64_t page) {
+    if (!p->spare) p->spare = page;
+    else pmm_free_frame((void*)page);
+}
+
+// Slot i counted from the head
+static PipeBuf* slot(Pipe* p, uint32_t i) {
+    return &p->bufs[(p->head + i) % p->slots];
+}
+
+static PipeBuf* tail_buf(Pipe* p) {
+    return p->used ? slot(p, p->used - 1) : nullptr;
+}
+
+// Bytes a write could add without waiting
+static uint64_t pipe_room(Pipe* p) {
+    uint64_t room = (uint64_t)(p->slots - p->used) * PAGE_SIZE;
+    PipeBuf* t = tail_buf(p);
+    if (t) room += PAGE_SIZE - (t->offset + t->len);
+    return room;
+}
+
+// Start a new tail slot holding `page` (a slot must be free)
+static PipeBuf* push_buf(Pipe* p, uint64_t page, uint32_t offset, uint32_t len) {
+    PipeBuf* b = slot(p, p->used);
+    b->page = page;
+    b->offset = offset;
+    b->len = len;
+    p->used++;
+    p->bytes += len;
+    return b;
+}
+
+// Drop the (drained or moved-out) head slot
+static void pop_buf(Pipe* p) {
+    p->head = (p->head + 1) % p->slots;
+    p->used--;
+}
+
+// ============================================================================
+// Page Moves
+// ============================================================================
+// Only whole 4KB pages the task owns outright can change hands: not shared
+// ones (vDSO, fork-shared), and not I/O ring pages, which their ring frees
+// itself.
+
+static uint64_t* user_pml4() {
+    Process* p = process_get_current();
+    return p ? p->page_table : nullptr;
+}
+
+static bool page_movable(uint64_t* pml4, uint64_t addr) {
+    if (addr & (PAGE_SIZE - 1)) return false;
+    if (addr >= URING_MAP_BASE && addr < URING_MAP_BASE + URING_MAP_SLOTS * URING_MAP_STRIDE) {
+        return false;
+    }
+
+    uint64_t pte = vmm_get_pte_in(pml4, addr);
+    uint64_t need = PTE_PRESENT | PTE_WRITABLE | PTE_USER;
+    return (pte & need) == need && !(pte & PTE_SHARED);
+}
+
+// Put `page` at addr in place of what was there. Returns the old frame.
+static uint64_t swap_page(uint64_t* pml4, uint64_t addr, uint64_t page) {
+    uint64_t flags = vmm_get_pte_in(pml4, addr) & (PTE_PRESENT | PTE_WRITABLE | PTE_USER | PTE_NX);
+    uint64_t old = vmm_unmap_page_in(pml4, addr);
+    vmm_map_page_in(pml4, addr, page, flags);
+    return old;
+}
+
+// vmsplice gift: take the user page at addr as a full slot, leaving a
+// zeroed page in its place. A slot must be free.
+static bool gift_page(Pipe* p, uint64_t addr) {
+    uint64_t* pml4 = user_pml4();
+    if (!pml4 || !page_movable(pml4, addr)) return false;
+
+    uint64_t fresh = page_get(p);
+    if (!fresh) return false;
+    kstring::memset(page_ptr(fresh), 0, PAGE_SIZE);
+
+    push_buf(p, swap_page(pml4, addr, fresh), 0, PAGE_SIZE);
+    return true;
+}
+
+// read() of a full head page into a page-aligned buffer: map the page
+// there instead of copying it. The reader's old page becomes the spare.
+static bool flip_page(Pipe* p, PipeBuf* b, uint64_t addr) {
+    if (b->offset != 0 || b->len != PAGE_SIZE) return false;
+
+    uint64_t* pml4 = user_pml4();
+    if (!pml4 || !page_movable(pml4, addr)) return false;
+
+    page_put(p, swap_page(pml4, addr, b->page));
+    return true;
+}
+
+// ============================================================================
+// Copies (pipe->lock held)
+// ============================================================================
+
+// Append up to n bytes from user memory, filling the tail page before
+// starting new ones. Returns bytes appended (short when full), or -EFAULT.
+static int64_t append_user(Pipe* p, const uint8_t* src, uint64_t n) {
+    uint64_t done = 0;
+    while (done < n) {
+        PipeBuf* t = tail_buf(p);
+        if (!t || t->offset + t->len == PAGE_SIZE) {
+            if (p->used == p->slots) break;
+            uint64_t page = page_get(p);
+            if (!page) break;
+            t = push_buf(p, page, 0, 0);
         }
+
+        uint32_t at = t->offset + t->len;
+        uint64_t chunk = PAGE_SIZE - at;
+        if (chunk > n - done) chunk = n - done;
+
+        if (copy_from_user(page_ptr(t->page) + at, src + done, chunk) < 0) {
+            if (t->len == 0) {
+                p->used--;
+                page_put(p, t->page);
+            }
+            return done ? (int64_t)done : -EFAULT;
+        }
+        t->len += chunk;
+        p->bytes += chunk;
+        done += chunk;
     }
-    return -1;
+    return done;
 }
 
-int64_t pipe_read(int pipe_id, char* buf, uint64_t count) {
-    if (pipe_id < 0 || pipe_id >= MAX_PIPES || !pipes[pipe_id].in_use) {
-        return -1;
+// Take up to n bytes into user memory from the head. Returns bytes taken,
+// or -EFAULT.
+static int64_t drain_user(Pipe* p, uint8_t* dst, uint64_t n) {
+    uint64_t done = 0;
+    while (done < n && p->used) {
+        PipeBuf* b = slot(p, 0);
+
+        if (n - done >= PAGE_SIZE && flip_page(p, b, (uint64_t)(dst + done))) {
+            done += PAGE_SIZE;
+            p->bytes -= PAGE_SIZE;
+            pop_buf(p);
+            continue;
+        }
+
+        uint64_t chunk = b->len;
+        if (chunk > n - done) chunk = n - done;
+        if (copy_to_user(dst + done, page_ptr(b->page) + b->offset, chunk) < 0) {
+            return done ? (int64_t)done : -EFAULT;
+        }
+        b->offset += chunk;
+        b->len -= chunk;
+        p->bytes -= chunk;
+        done += chunk;
+
+        if (b->len == 0) {
+            page_put(p, b->page);
+            pop_buf(p);
+        }
     }
-    
-    Pipe* p = &pipes[pipe_id];
-    
-    // If no data and write end closed, return 0 (EOF)
-    if (p->count == 0 && p->write_closed) {
-        return 0;
+    return done;
+}
+
+// ============================================================================
+// Waiting (pipe->lock held)
+// ============================================================================
+
+static void wake_readers(Pipe* p) {
+    cond_broadcast(&p->readable);
+    poll_notify(&p->poll, POLLIN);
+}
+
+static void wake_writers(Pipe* p) {
+    cond_broadcast(&p->writable);
+    poll_notify(&p->poll, POLLOUT);
+}
+
+// Sleep until space frees up. False if the caller must stop instead: it
+// can't wait, or the reader is gone. Data already written is handed to
+// readers first, or a writer bigger than the pipe would wait forever.
+static bool wait_for_room(Pipe* p, bool nowait, bool wrote) {
+    if (nowait || p->read_closed) return false;
+    if (wrote) wake_readers(p);
+    cond_wait(&p->writable, &p->lock);
+    return true;
+}
+
+// ============================================================================
+// VFS Backend
+// ============================================================================
+// File::priv points at the Pipe; each end has its own ops table.
+
+static Pipe* pipe_of(File* f) {
+    return (Pipe*)f->priv;
+}
+
+static bool is_read_end(File* f) {
+    return f->ops->release == pipe_file_release_read;
+}
+
+static bool is_write_end(File* f) {
+    return f->ops->release == pipe_file_release_write;
+}
+
+static void pipe_free(Pipe* p) {
+    for (uint32_t i = 0; i < p->used; i++) {
+        pmm_free_frame((void*)slot(p, i)->page);
     }
-    
-    // Read available data
-    uint64_t to_read = (count < p->count) ? count : p->count;
-    
-    for (uint64_t i = 0; i < to_read; i++) {
-        buf[i] = p->buffer[p->read_pos];
-        p->read_pos = (p->read_pos + 1) % PIPE_BUFFER_SIZE;
+    if (p->spare) pmm_free_frame((void*)p->spare);
+    free(p->bufs);
+    free(p);
+}
+
+static int64_t pipe_file_read(File* f, void* buf, uint64_t count, uint64_t*, uint32_t io) {
+    if (count == 0) return 0;
+    if (!user_range_ok(buf, count)) return -EFAULT;
+
+    Pipe* p = pipe_of(f);
+    mutex_lock(&p->lock);
+
+    while (p->bytes == 0) {
+        if (p->write_closed || (io & IO_NOWAIT)) {
+            mutex_unlock(&p->lock);
+            return p->write_closed ? 0 : -1;  // EOF / would block
+        }
+        cond_wait(&p->readable, &p->lock);
     }
-    p->count -= to_read;
-    
-    return to_read;
+
+    int64_t n = drain_user(p, (uint8_t*)buf, count);
+    if (n > 0) wake_writers(p);
+
+    mutex_unlock(&p->lock);
+    return n;
 }
 
-int64_t pipe_write(int pipe_id, const char* buf, uint64_t count) {
-    if (pipe_id < 0 || pipe_id >= MAX_PIPES || !pipes[pipe_id].in_use) {
-        return -1;
+static int64_t pipe_file_write(File* f, const void* buf, uint64_t count, uint64_t*, uint32_t io) {
+    if (count == 0) return 0;
+
+    Pipe* p = pipe_of(f);
+    const uint8_t* src = (const uint8_t*)buf;
+    uint64_t done = 0;
+    int64_t err = -1;
+
+    mutex_lock(&p->lock);
+    while (done < count && !p->read_closed) {
+        // Up to PIPE_BUF bytes go in at once or not at all
+        uint64_t room = pipe_room(p);
+        if (room == 0 || (count <= PIPE_BUF && room < count)) {
+            if (!wait_for_room(p, io & IO_NOWAIT, done > 0)) break;
+            continue;
+        }
+
+        int64_t n = append_user(p, src + done, count - done);
+        if (n <= 0) {
+            if (n < 0) err = n;
+            break;  // Fault, or out of pages
+        }
+        done += n;
+    }
+
+    if (done) wake_readers(p);
+    mutex_unlock(&p->lock);
+    return done ? (int64_t)done : err;
+}
+
+static uint32_t pipe_file_poll(File* f) {
+    Pipe* p = pipe_of(f);
+    uint32_t events = 0;
+    if (is_read_end(f)) {
+        if (p->bytes > 0) events |= POLLIN;
+        if (p->write_closed) events |= POLLHUP;
+    } else {
+        if (p->used < p->slots) events |= POLLOUT;  // Room for PIPE_BUF bytes
+        if (p->read_closed) events |= POLLERR;
     }
-    
-    Pipe* p = &pipes[pipe_id];
-    
-    // If read end closed, return error
-    if (p->read_closed) {
+    return events;
+}
+
+static PollQueue* pipe_file_poll_queue(File* f) {
+    return &pipe_of(f)->poll;
+}
+
+// Whichever end closes second frees the pipe
+static void pipe_file_release_read(File* f) {
+    Pipe* p = pipe_of(f);
+    mutex_lock(&p->lock);
+    p->read_closed = true;
+    cond_broadcast(&p->writable);
+    poll_notify(&p->poll, POLLERR);  // Writers now fail
+    bool last = p->write_closed;
+    mutex_unlock(&p->lock);
+    if (last) pipe_free(p);
+}
+
+static void pipe_file_release_write(File* f) {
+    Pipe* p = pipe_of(f);
+    mutex_lock(&p->lock);
+    p->write_closed = true;
+    cond_broadcast(&p->readable);
+    poll_notify(&p->poll, POLLHUP);  // Readers now see EOF
+    bool last = p->read_closed;
+    mutex_unlock(&p->lock);
+    if (last) pipe_free(p);
+}
+
+static const FileOps pipe_read_ops = {
+    pipe_file_read, nullptr, nullptr, nullptr, pipe_file_poll, pipe_file_poll_queue,
+    pipe_file_release_read,
+};
+
+static const FileOps pipe_write_ops = {
+    nullptr, pipe_file_write, nullptr, nullptr, pipe_file_poll, pipe_file_poll_queue,
+    pipe_file_release_write,
+};
+
+static Pipe* pipe_create() {
+    Pipe* p = (Pipe*)malloc(sizeof(Pipe));
+    if (!p) return nullptr;
+    p->bufs = (PipeBuf*)malloc(PIPE_DEFAULT_PAGES * sizeof(PipeBuf));
+    if (!p->bufs) {
+        free(p);
+        return nullptr;
+    }
+
+    mutex_init(&p->lock);
+    cond_init(&p->readable);
+    cond_init(&p->writable);
+    poll_queue_init(&p->poll);
+    p->slots = PIPE_DEFAULT_PAGES;
+    p->head = 0;
+    p->used = 0;
+    p->bytes = 0;
+    p->spare = 0;
+    p->write_closed = false;
+    p->read_closed = false;
+    return p;
+}
+
+bool pipe_open_files(File** read_end, File** write_end, uint32_t flags) {
+    Pipe* p = pipe_create();
+    if (!p) return false;
+
+    flags &= O_NONBLOCK;
+    File* r = file_alloc(&pipe_read_ops, p, O_RDONLY | flags);
+    File* w = file_alloc(&pipe_write_ops, p, O_WRONLY | flags);
+    if (!r || !w) {
+        // Mark the missing end closed, so releasing the other frees the pipe
+        p->read_closed = !r;
+        p->write_closed = !w;
+        if (r) file_put(r);
+        if (w) file_put(w);
+        if (!r && !w) pipe_free(p);
+        return false;
+    }
+
+    *read_end = r;
+    *write_end = w;
+    return true;
+}
+
+bool pipe_is_pipe(File* f) {
+    return is_read_end(f) || is_write_end(f);
+}
+
+// ============================================================================
+// Capacity
+// ============================================================================
+
+int64_t pipe_get_size(File* f) {
+    if (!pipe_is_pipe(f)) return -1;
+    return (int64_t)pipe_of(f)->slots * PAGE_SIZE;
+}
+
+int64_t pipe_set_size(File* f, uint64_t size) {
+    if (!pipe_is_pipe(f)) return -1;
+
+    uint64_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages == 0) pages = 1;
+    if (pages > PIPE_MAX_PAGES) return -1;
+
+    PipeBuf* bufs = (PipeBuf*)malloc(pages * sizeof(PipeBuf));
+    if (!bufs) return -1;
+
+    Pipe* p = pipe_of(f);
+    mutex_lock(&p->lock);
+    if (p->used > pages) {
+        mutex_unlock(&p->lock);
+        free(bufs);
         return -1;
     }
-    
-    // Write as much as possible
-    uint64_t space = PIPE_BUFFER_SIZE - p->count;
-    uint64_t to_write = (count < space) ? count : space;
-    
-    for (uint64_t i = 0; i < to_write; i++) {
-        p->buffer[p->write_pos] = buf[i];
-        p->write_pos = (p->write_pos + 1) % PIPE_BUFFER_SIZE;
+
+    // Re-pack the ring at the start of the new array
+    for (uint32_t i = 0; i < p->used; i++) bufs[i] = *slot(p, i);
+    PipeBuf* old = p->bufs;
+    p->bufs = bufs;
+    p->slots = (uint32_t)pages;
+    p->head = 0;
+    wake_writers(p);
+    mutex_unlock(&p->lock);
+
+    free(old);
+    return (int64_t)pages * PAGE_SIZE;
+}
+
+// ============================================================================
+// vmsplice / splice
+// ============================================================================
+
+int64_t pipe_vmsplice(File* f, const IoVec* iov, int iovcnt, uint32_t flags) {
+    if (!is_write_end(f)) return -1;
+
+    Pipe* p = pipe_of(f);
+    bool nowait = (flags & SPLICE_F_NONBLOCK) || (f->flags & O_NONBLOCK);
+    bool gift = flags & SPLICE_F_GIFT;
+    uint64_t done = 0;
+    int64_t err = -1;
+
+    mutex_lock(&p->lock);
+    for (int i = 0; i < iovcnt && !p->read_closed; i++) {
+        uint64_t addr = (uint64_t)iov[i].base;
+        uint64_t left = iov[i].len;
+        if (!user_range_ok((const void*)addr, left)) {
+            err = -EFAULT;
+            break;
+        }
+
+        while (left && !p->read_closed) {
+            if (gift && left >= PAGE_SIZE && !(addr & (PAGE_SIZE - 1))) {
+                if (p->used == p->slots) {
+                    if (!wait_for_room(p, nowait, done > 0)) goto out;
+                    continue;
+                }
+                if (gift_page(p, addr)) {
+                    addr += PAGE_SIZE;
+                    left -= PAGE_SIZE;
+                    done += PAGE_SIZE;
+                    continue;
+                }
+            }
+
+            // Copy, up to the next page boundary when later pages may be
+            // gifted whole
+            uint64_t chunk = left;
+            if (gift) {
+                uint64_t to_boundary = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+                if (chunk > to_boundary) chunk = to_boundary;
+            }
+            if (pipe_room(p) == 0) {
+                if (!wait_for_room(p, nowait, done > 0)) goto out;
+                continue;
+            }
+
+            int64_t n = append_user(p, (const uint8_t*)addr, chunk);
+            if (n <= 0) {
+                if (n < 0) err = n;
+                goto out;
+            }
+            addr += n;
+            left -= n;
+            done += n;
+        }
     }
-    p->count += to_write;
-    
-    return to_write;
-}
-
-void pipe_close_read(int pipe_id) {
-    if (pipe_id < 0 || pipe_id >= MAX_PIPES) return;
-    pipes[pipe_id].read_closed = true;
-    
-    // If both ends closed, free the pipe
-    if (pipes[pipe_id].write_closed) {
-        pipes[pipe_id].in_use = false;
+
+out:
+    if (done) wake_readers(p);
+    mutex_unlock(&p->lock);
+    return done ? (int64_t)done : err;
+}
+
+// Move up to len bytes from in to out (both locked). Whole slots change
+// pipes without copying; a partial slot is copied.
+static uint64_t move_bufs(Pipe* in, Pipe* out, uint64_t len) {
+    uint64_t moved = 0;
+    while (moved < len && in->used) {
+        PipeBuf* b = slot(in, 0);
+        uint64_t want = len - moved;
+
+        if (b->len <= want && out->used < out->slots) {
+            push_buf(out, b->page, b->offset, b->len);
+            moved += b->len;
+            in->bytes -= b->len;
+            pop_buf(in);
+            continue;
+        }
+
+        // Copy into the tail page of out, or a fresh one
+        PipeBuf* t = tail_buf(out);
+        if (!t || t->offset + t->len == PAGE_SIZE) {
+            if (out->used == out->slots) break;
+            uint64_t page = page_get(out);
+            if (!page) break;
+            t = push_buf(out, page, 0, 0);
+        }
+
+        uint32_t at = t->offset + t->len;
+        uint64_t chunk = PAGE_SIZE - at;
+        if (chunk > b->len) chunk = b->len;
+        if (chunk > want) chunk = want;
+        kstring::memcpy(page_ptr(t->page) + at, page_ptr(b->page) + b->offset, chunk);
+        t->len += chunk;
+        out->bytes += chunk;
+
+        b->offset += chunk;
+        b->len -= chunk;
+        in->bytes -= chunk;
+        moved += chunk;
+        if (b->len == 0) {
+            page_put(in, b->page);
+            pop_buf(in);
+        }
     }
+    return moved;
 }
 
-void pipe_close_write(int pipe_id) {
-    if (pipe_id < 0 || pipe_id >= MAX_PIPES) return;
-    pipes[pipe_id].write_closed = true;
-    
-    // If both ends closed, free the pipe
-    if (pipes[pipe_id].read_closed) {
-        pipes[pipe_id].in_use = false;
+int64_t pipe_splice(File* in_file, File* out_file, uint64_t len, uint32_t flags) {
+    if (!is_read_end(in_file) || !is_write_end(out_file)) return -1;
+
+    Pipe* in = pipe_of(in_file);
+    Pipe* out = pipe_of(out_file);
+    if (in == out) return -1;
+    if (len == 0) return 0;
+
+    bool nowait = (flags & SPLICE_F_NONBLOCK) ||
+                  ((in_file->flags | out_file->flags) & O_NONBLOCK);
+
+    // Two pipes can't wait on both condition variables at once, so wait on
+    // both poll queues instead
+    PollWaiter waiter;
+    PollHook in_hook, out_hook;
+    poll_waiter_init(&waiter);
+    poll_waiter_attach(&waiter, &in_hook, &in->poll, POLLIN);
+    poll_waiter_attach(&waiter, &out_hook, &out->poll, POLLOUT);
+
+    // Lock in address order, so two opposite splices can't deadlock
+    Pipe* first = in < out ? in : out;
+    Pipe* second = in < out ? out : in;
+    int64_t result;
+
+    for (;;) {
+        mutex_lock(&first->lock);
+        mutex_lock(&second->lock);
+
+        uint64_t moved = 0;
+        if (out->read_closed) {
+            result = -1;
+        } else if (in->bytes == 0 && in->write_closed) {
+            result = 0;  // EOF
+        } else {
+            moved = move_bufs(in, out, len);
+            result = moved ? (int64_t)moved : -1;
+        }
+
+        if (moved) {
+            wake_writers(in);
+            wake_readers(out);
+        }
+        mutex_unlock(&second->lock);
+        mutex_unlock(&first->lock);
+
+        if (result >= 0 || out->read_closed || nowait) break;
+        poll_waiter_sleep(&waiter, WAIT_FOREVER);
     }
+
+    poll_hook_remove(&in_hook);
+    poll_hook_remove(&out_hook);
+    return result;
 }
@@ -1,22 +1,86 @@
 #pragma once
 #include <stdint.h>
+#include "mutex.h"
+#include "condvar.h"
+#include "poll.h"
 
-#define PIPE_BUFFER_SIZE 512
-#define MAX_PIPES 8
+// ============================================================================
+// Pipes
+// ============================================================================
+// A pipe is a ring of page buffers. Each slot holds one physical page and
+// the unread span inside it. write() appends to the last page while it has
+// room and starts a new slot when it doesn't; read() drains from the
+// first. Capacity is counted in slots, so it is page-granular and can be
+// changed with fcntl(F_SETPIPE_SZ).
+//
+// Because data lives in whole pages, large transfers can move pages
+// instead of bytes:
+//   vmsplice(SPLICE_F_GIFT) - page-aligned user pages are taken out of the
+//                             writer's address space into the pipe (a zeroed
+//                             page takes their place)
+//   splice()                - pipe to pipe moves slots
+//   read()                  - a full page headed for a page-aligned user
+//                             buffer is mapped there instead of copied
+//
+// Readers sleep while the pipe is empty and writers while it is full,
+// unless O_NONBLOCK / IO_NOWAIT. Writes of up to PIPE_BUF bytes are atomic.
+// ============================================================================
+
+#define PIPE_BUF             4096   // Atomic write limit (POSIX)
+#define PIPE_DEFAULT_PAGES   16     // 64 KB, as on Linux
+#define PIPE_MAX_PAGES       256    // 1 MB
+
+// fcntl commands (Linux values; F_GETFL/F_SETFL are in vfs.h)
+#define F_SETPIPE_SZ         1031
+#define F_GETPIPE_SZ         1032
+
+// vmsplice/splice flags
+#define SPLICE_F_NONBLOCK    0x02
+#define SPLICE_F_GIFT        0x08
+
+struct PipeBuf {
+    uint64_t page;       // Physical frame
+    uint32_t offset;     // First unread byte
+    uint32_t len;        // Unread bytes
+};
 
 struct Pipe {
-    bool in_use;
-    uint8_t buffer[PIPE_BUFFER_SIZE];
-    uint64_t read_pos;
-    uint64_t write_pos;
-    uint64_t count;      // Bytes in buffer
+    Mutex lock;          // Protects everything below
+    CondVar readable;    // Signaled when data arrives or the writer closes
+    CondVar writable;    // Signaled when space frees up or the reader closes
+    PipeBuf* bufs;       // Ring of `slots` entries
+    uint32_t slots;      // Capacity in pages
+    uint32_t head;       // First used slot
+    uint32_t used;       // Slots holding data
+    uint64_t bytes;      // Unread bytes in all slots
+    uint64_t spare;      // One drained page kept for the next write (0 = none)
     bool write_closed;
     bool read_closed;
+    PollQueue poll;      // Both ends' readiness changes
 };
 
-void pipe_init();
-int pipe_create();  // Returns pipe ID, or -1 on error
-int64_t pipe_read(int pipe_id, char* buf, uint64_t count);
-int64_t pipe_write(int pipe_id, const char* buf, uint64_t count);
-void pipe_close_read(int pipe_id);
-void pipe_close_write(int pipe_id);
+struct File;
+struct IoVec;
+
+// Create a pipe and a File for each end (flags: O_NONBLOCK or 0). Closing
+// the last reference to an end closes that end. Returns false on failure.
+bool pipe_open_files(File** read_end, File** write_end, uint32_t flags);
+
+// Whether f is either end of a pipe
+bool pipe_is_pipe(File* f);
+
+// Capacity in bytes, or -1 if f isn't a pipe
+int64_t pipe_get_size(File* f);
+
+// Resize to at least `size` bytes (rounded up to pages, capped at
+// PIPE_MAX_PAGES). Fails if the data already queued wouldn't fit. Returns
+// the new capacity or -1.
+int64_t pipe_set_size(File* f, uint64_t size);
+
+// vmsplice: feed user buffers (kernel copy of the iovec array) into the
+// write end. Returns bytes queued, or -1 / -EFAULT.
+int64_t pipe_vmsplice(File* f, const IoVec* iov, int iovcnt, uint32_t flags);
+
+// splice: move up to len bytes from one pipe's read end to another's
+// write end. Returns bytes moved, 0 at EOF, or -1.
+int64_t pipe_splice(File* in, File* out, uint64_t len, uint32_t flags);
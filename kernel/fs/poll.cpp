@@ -0,0 +1,161 @@
+#include "poll.h"
+#include "vfs.h"
+#include "timer.h"
+#include "heap.h"
+
+// ============================================================================
+// Queues
+// ============================================================================
+
+void poll_hook_add(PollQueue* q, PollHook* hook) {
+    spinlock_acquire(&q->lock);
+    hook->queue = q;
+    hook->prev = nullptr;
+    hook->next = q->head;
+    if (q->head) q->head->prev = hook;
+    q->head = hook;
+    spinlock_release(&q->lock);
+}
+
+void poll_hook_remove(PollHook* hook) {
+    PollQueue* q = hook->queue;
+    if (!q) return;
+
+    spinlock_acquire(&q->lock);
+    if (hook->prev) hook->prev->next = hook->next;
+    else q->head = hook->next;
+    if (hook->next) hook->next->prev = hook->prev;
+    hook->prev = hook->next = nullptr;
+    hook->queue = nullptr;
+    spinlock_release(&q->lock);
+}
+
+void poll_notify(PollQueue* q, uint32_t events) {
+    spinlock_acquire(&q->lock);
+    for (PollHook* h = q->head; h; ) {
+        PollHook* next = h->next;
+        if (events & (h->events | POLLERR | POLLHUP)) {
+            h->wake(h, events);
+        }
+        h = next;
+    }
+    spinlock_release(&q->lock);
+}
+
+// ============================================================================
+// Sleeping on Hooks
+// ============================================================================
+
+static void waiter_wake(PollHook* hook, uint32_t) {
+    PollWaiter* w = (PollWaiter*)hook->priv;
+    spinlock_acquire(&w->lock);
+    w->triggered = true;
+    wait_queue_wake_all(&w->wq);
+    spinlock_release(&w->lock);
+}
+
+void poll_waiter_init(PollWaiter* w) {
+    spinlock_init(&w->lock);
+    wait_queue_init(&w->wq);
+    w->triggered = false;
+}
+
+void poll_waiter_attach(PollWaiter* w, PollHook* hook, PollQueue* q, uint32_t events) {
+    hook->prev = hook->next = nullptr;
+    hook->queue = nullptr;
+    hook->events = events;
+    hook->wake = waiter_wake;
+    hook->priv = w;
+    if (q) poll_hook_add(q, hook);
+}
+
+bool poll_waiter_sleep(PollWaiter* w, uint64_t timeout_ticks) {
+    spinlock_acquire(&w->lock);
+    bool woken = true;
+    if (!w->triggered) {
+        woken = wait_queue_sleep(&w->wq, &w->lock, timeout_ticks);
+    }
+    w->triggered = false;
+    spinlock_release(&w->lock);
+    return woken;
+}
+
+uint64_t poll_ms_to_ticks(int64_t ms) {
+    if (ms < 0) return WAIT_FOREVER;
+    uint64_t hz = timer_get_frequency();
+    return ((uint64_t)ms * hz + 999) / 1000;   // 0 stays 0: don't wait
+}
+
+// ============================================================================
+// poll()
+// ============================================================================
+
+// Fill in revents for every entry. Returns how many are set.
+static int64_t scan_fds(PollFd* fds, File** files, uint32_t nfds) {
+    int64_t ready = 0;
+    for (uint32_t i = 0; i < nfds; i++) {
+        uint32_t revents = 0;
+        if (fds[i].fd < 0) {
+            revents = 0;            // Negative fds are skipped (Linux)
+        } else if (!files[i]) {
+            revents = POLLNVAL;
+        } else {
+            uint32_t want = (uint16_t)fds[i].events | POLLERR | POLLHUP;
+            revents = vfs_poll(files[i]) & want;
+        }
+        fds[i].revents = (int16_t)revents;
+        if (revents) ready++;
+    }
+    return ready;
+}
+
+int64_t poll_fds(PollFd* fds, uint32_t nfds, int64_t timeout_ms) {
+    if (nfds > POLL_MAX_FDS) return -1;
+
+    FdTable* table = fd_table_current();
+    if (!table && nfds) return -1;
+
+    File** files = nullptr;
+    PollHook* hooks = nullptr;
+    if (nfds) {
+        files = (File**)malloc(nfds * sizeof(File*));
+        hooks = (PollHook*)malloc(nfds * sizeof(PollHook));
+        if (!files || !hooks) {
+            free(files);
+            free(hooks);
+            return -1;
+        }
+    }
+
+    // Hook every file before the first scan, so a change between the scan
+    // and the sleep still wakes us
+    PollWaiter waiter;
+    poll_waiter_init(&waiter);
+    for (uint32_t i = 0; i < nfds; i++) {
+        files[i] = fds[i].fd >= 0 ? fd_get(table, fds[i].fd) : nullptr;
+        PollQueue* q = files[i] ? vfs_poll_queue(files[i]) : nullptr;
+        poll_waiter_attach(&waiter, &hooks[i], q, (uint16_t)fds[i].events);
+    }
+
+    uint64_t timeout = poll_ms_to_ticks(timeout_ms);
+    uint64_t deadline = timer_get_ticks() + timeout;
+    int64_t ready;
+
+    while ((ready = scan_fds(fds, files, nfds)) == 0 && timeout_ms != 0) {
+        uint64_t left = WAIT_FOREVER;
+        if (timeout_ms > 0) {
+            uint64_t now = timer_get_ticks();
+            if (now >= deadline) break;
+            left = deadline - now;
+        }
+        poll_waiter_sleep(&waiter, left);
+    }
+
+    for (uint32_t i = 0; i < nfds; i++) {
+        poll_hook_remove(&hooks[i]);
+        if (files[i]) file_put(files[i]);
+    }
+    free(files);
+    free(hooks);
+    return ready;
+}
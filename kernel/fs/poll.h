@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include "spinlock.h"
+#include "waitqueue.h"
+#include "vfs.h"      // POLLIN/POLLOUT/POLLERR/POLLHUP
+
+// ============================================================================
+// Poll - Readiness Notification
+// ============================================================================
+// Every object whose readiness can change (a pipe, a TCP or UDP socket, an
+// I/O ring, an epoll set) owns a PollQueue, and its File exposes it through
+// FileOps::poll_queue. Whoever wants to hear about changes links a PollHook
+// into the queue; the object calls poll_notify() after it gains data,
+// space or a hangup, and each interested hook's wake function runs.
+//
+// A PollWaiter turns hooks into sleeping: poll() hooks one per descriptor,
+// all pointing at the same waiter, and sleeps until any of them fires. The
+// kernel's own waits (TCP connect, DNS) use the same pattern on a single
+// socket. Hooks only say "look again": readiness itself always comes from
+// vfs_poll(), so a spurious wakeup is harmless.
+//
+// Locking: wake functions run under the queue's lock with interrupts off,
+// possibly from the NET_RX softirq. They must not sleep and may only take
+// locks that are never held while calling poll_notify().
+// ============================================================================
+
+// More poll events
+#define POLLNVAL   0x020    // Not an open descriptor (poll() only)
+
+#define POLL_MAX_FDS 64     // Most descriptors accepted by one poll()
+
+struct PollQueue;
+struct PollHook;
+
+typedef void (*PollWakeFn)(PollHook* hook, uint32_t events);
+
+struct PollHook {
+    PollHook* prev;
+    PollHook* next;
+    PollQueue* queue;         // Queue it is linked into (nullptr = none)
+    uint32_t events;          // Interest: POLLERR/POLLHUP are always included
+    PollWakeFn wake;
+    void* priv;               // For the wake function
+};
+
+struct PollQueue {
+    Spinlock lock;
+    PollHook* head;
+};
+
+#define POLL_QUEUE_INIT {SPINLOCK_INIT, nullptr}
+
+static inline void poll_queue_init(PollQueue* q) {
+    spinlock_init(&q->lock);
+    q->head = nullptr;
+}
+
+// Link / unlink a hook (unlinking an unlinked hook does nothing). Once
+// poll_hook_remove() returns, the wake function won't run again.
+void poll_hook_add(PollQueue* q, PollHook* hook);
+void poll_hook_remove(PollHook* hook);
+
+// Tell every hook interested in `events` that the object changed
+void poll_notify(PollQueue* q, uint32_t events);
+
+// ============================================================================
+// Sleeping on Hooks
+// ============================================================================
+
+struct PollWaiter {
+    Spinlock lock;
+    WaitQueue wq;
+    bool triggered;           // A hook fired since the last sleep
+};
+
+void poll_waiter_init(PollWaiter* w);
+
+// Point hook at w (with the given interest) and link it into q, if any
+void poll_waiter_attach(PollWaiter* w, PollHook* hook, PollQueue* q, uint32_t events);
+
+// Sleep until a hook of w fires or timeout_ticks pass (WAIT_FOREVER = no
+// limit). Returns at once if one fired since the previous call. Returns
+// false on timeout.
+bool poll_waiter_sleep(PollWaiter* w, uint64_t timeout_ticks);
+
+// Milliseconds to timer ticks, rounded up (negative = WAIT_FOREVER, 0 = 0)
+uint64_t poll_ms_to_ticks(int64_t ms);
+
+// ============================================================================
+// poll()
+// ============================================================================
+
+// Linux struct pollfd
+struct PollFd {
+    int32_t fd;
+    int16_t events;
+    int16_t revents;
+};
+
+// Wait until one of fds (in the calling task's table) is ready, filling
+// in revents. timeout_ms: 0 = just check, negative = forever. Returns the
+// number of entries with revents set, 0 on timeout, or -1.
+int64_t poll_fds(PollFd* fds, uint32_t nfds, int64_t timeout_ms);
@@ -1,452 +1,2426 @@
 #include "unifs.h"
 #include "kstring.h"
 #include "heap.h"
-#include "syscall.h"  // For is_file_open()
+#include "mutex.h"
+#include "spinlock.h"
+#include "rcu.h"
+#include "vfs.h"
+#include "uaccess.h"
+#include "crc32c.h"
+#include "xxhash.h"
+#include "lz4.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "block.h"
+#include "debug.h"
+
+#define PAGE_SIZE 4096
 
 // ============================================================================
 // uniFS Implementation
 // ============================================================================
 // The filesystem has two parts:
 // 1. Boot files: Read from Limine module at boot (read-only)
-// 2. RAM files: Created at runtime (read-write, lost on reboot)
+// 2. RAM files: Created at runtime (read-write, saved to disk by unifs_sync)
+//
+// Both live in one tree of nodes. Each directory indexes its entries in a
+// hash table of dentries keyed by name, so resolving a path costs one hash
+// probe per component however many files exist. The tree is built from the
+// boot entries at mount and always holds the whole namespace, so it is
+// also the dentry cache: a path walk never misses.
+//
+// Lookups run lock-free under rcu_read_lock(). Updates serialize on
+// fs_lock and publish with rcu_assign_pointer(): a new dentry goes at the
+// head of its chain, a removed dentry or node is freed after a grace
+// period, and a table that grows is rebuilt off to the side and swapped in
+// whole. A RAM file's contents are an RCU-protected RAMFile: a tree of
+// pages that writes fill in place, replaced whole only when the file is
+// emptied or rewritten (see RAM File Contents).
+//
+// Open Files (see vfs.h) pin their node and re-read its contents under RCU
+// on every access, so writes never invalidate them. A file with open Files
+// can't be deleted.
+//
+// A v2 boot file's checksum is verified the first time it is opened rather
+// than at mount, so booting doesn't read the whole image. Compressed boot
+// files are inflated a block at a time into a page cache as they are read
+// (see Compressed Boot Files).
 // ============================================================================
 
 // Boot filesystem (read-only, from boot module)
 static uint8_t* fs_start = nullptr;
-static UniFSHeader* boot_header = nullptr;
-static UniFSEntry* boot_entries = nullptr;
+static uint64_t fs_size = 0;
+static int fs_version = 0;      // Image format (1 or 2)
 static bool mounted = false;
 
-// RAM filesystem (read-write)
+struct RamFlat;
+
+// Contents of a RAM file: a radix tree of page frames, shaped like a page
+// table. Each level is one frame of RAM_FANOUT entries indexed by RAM_SHIFT
+// bits of the page number; the bottom level points at the data pages.
+// Entries are physical addresses, 0 for a hole (reads as zeros); a data
+// page entry may carry RAM_SHARED (see Shared Pages). The root word is the
+// top entry plus the tree's height in its low bits, so readers always
+// load a root and height that belong together.
 struct RAMFile {
-    char name[64];        // Filename
-    uint8_t* data;        // File data (heap allocated)
+    uint64_t root;        // Top entry | height (RAM_HEIGHT_MASK), 0 if empty
     uint64_t size;        // File size
-    uint64_t capacity;    // Allocated capacity
-    bool used;            // Slot in use
+    uint64_t pages;       // Frames in the tree, nodes included
+    RamFlat* flat;        // Contiguous copy for unifs_open_into(), or nullptr
+    RcuHead rcu;          // Deferred free after replacement/deletion
+};
+
+#define RAM_SHIFT        9
+#define RAM_FANOUT       (1u << RAM_SHIFT)
+#define RAM_HEIGHT_MASK  0x7FFULL
+#define RAM_SHARED       0x800ULL   // Data page entry: the page is in the share index
+
+struct UnifsNode;
+struct BootLz4;
+
+// One name in a directory's hash table
+struct Dentry {
+    Dentry* next;         // Hash chain
+    uint32_t hash;
+    UnifsNode* node;
+    RcuHead rcu;
+};
+
+struct DirTable {
+    uint32_t mask;        // Buckets - 1 (a power of two)
+    RcuHead rcu;
+    Dentry* buckets[];
 };
 
-static RAMFile ram_files[UNIFS_MAX_FILES];
+struct UnifsNode {
+    char name[UNIFS_MAX_FILENAME + 1];
+    UnifsNode* parent;    // The root is its own parent
+    bool is_dir;
+    bool boot;            // Boot file: contents never change or move
+
+    // Entry list of the parent, in creation order (for listing)
+    UnifsNode* sib_next;  // Followed by readers
+    UnifsNode* sib_prev;  // fs_lock only
+
+    // Directory
+    DirTable* table;      // Allocated on the first entry
+    UnifsNode* first_child;
+    UnifsNode* last_child;
+    uint64_t child_count;
+
+    // File
+    const uint8_t* boot_data;
+    uint64_t boot_size;
+    const uint8_t* boot_stored;   // Bytes in the image (== boot_data unless compressed)
+    uint64_t boot_stored_size;
+    uint32_t boot_crc;    // Expected CRC32C of boot_stored (v2)
+    uint8_t boot_state;   // BOOT_* (checksum verified yet?)
+    BootLz4* lz4;         // Compressed: boot_data is a page cache window
+    RAMFile* ram;         // RAM file contents
+    uint32_t open_count;  // Open Files (fs_lock)
+
+    RcuHead rcu;          // Deferred free after removal
+};
+
+#define DIR_MIN_BUCKETS 8
+
+// UnifsNode::boot_state
+#define BOOT_UNCHECKED  0
+#define BOOT_GOOD       1
+#define BOOT_CORRUPT    2
+
+static UnifsNode root_dir;          // Linked to itself by unifs_init()
+static Mutex fs_lock = MUTEX_INIT;  // Serializes namespace and RAM file updates
+
+// Totals (fs_lock)
+static uint64_t boot_file_count = 0;
+static uint64_t boot_bytes = 0;
 static uint64_t ram_file_count = 0;
+static uint64_t ram_bytes = 0;
 
 // ELF magic bytes
 static const uint8_t ELF_MAGIC[] = {0x7F, 'E', 'L', 'F'};
 
 // ============================================================================
-// Internal Helpers
+// Directory Index
 // ============================================================================
 
-// Find entry in boot files (returns nullptr if not found)
-static UniFSEntry* find_boot_entry(const char* name) {
-    if (!mounted || !name) return nullptr;
-    
-    for (uint64_t i = 0; i < boot_header->file_count; i++) {
-        if (kstring::strcmp(boot_entries[i].name, name) == 0) {
-            return &boot_entries[i];
-        }
+// FNV-1a
+static uint32_t name_hash(const char* name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
     }
-    return nullptr;
+    return h;
 }
 
-// Find entry in RAM files (returns nullptr if not found)
-static RAMFile* find_ram_file(const char* name) {
-    if (!name) return nullptr;
-    
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        if (ram_files[i].used && kstring::strcmp(ram_files[i].name, name) == 0) {
-            return &ram_files[i];
+static bool name_is(const UnifsNode* node, const char* name, size_t len) {
+    return kstring::strncmp(node->name, name, len) == 0 && node->name[len] == '\0';
+}
+
+static DirTable* table_alloc(uint32_t buckets) {
+    DirTable* t = (DirTable*)malloc(sizeof(DirTable) + buckets * sizeof(Dentry*));
+    if (!t) return nullptr;
+    t->mask = buckets - 1;
+    for (uint32_t i = 0; i < buckets; i++) t->buckets[i] = nullptr;
+    return t;
+}
+
+static void table_free(DirTable* t) {
+    for (uint32_t i = 0; i <= t->mask; i++) {
+        Dentry* d = t->buckets[i];
+        while (d) {
+            Dentry* next = d->next;
+            free(d);
+            d = next;
         }
     }
-    return nullptr;
+    free(t);
 }
 
-// Find free RAM file slot
-static RAMFile* find_free_slot() {
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        if (!ram_files[i].used) {
-            return &ram_files[i];
-        }
+static void table_free_rcu(RcuHead* head) {
+    table_free(rcu_container_of(head, DirTable, rcu));
+}
+
+static void dentry_free_rcu(RcuHead* head) {
+    free(rcu_container_of(head, Dentry, rcu));
+}
+
+// Entry `name` of dir (RCU read side or fs_lock held)
+static UnifsNode* dir_lookup(UnifsNode* dir, const char* name, size_t len) {
+    DirTable* t = rcu_dereference(dir->table);
+    if (!t) return nullptr;
+
+    uint32_t h = name_hash(name, len);
+    for (Dentry* d = rcu_dereference(t->buckets[h & t->mask]); d; d = rcu_dereference(d->next)) {
+        if (d->hash == h && name_is(d->node, name, len)) return d->node;
     }
     return nullptr;
 }
 
-// Check if file content looks like text
-static bool is_text_content(const uint8_t* data, uint64_t size) {
-    uint64_t check_size = (size < 256) ? size : 256;
-    
-    for (uint64_t i = 0; i < check_size; i++) {
-        uint8_t c = data[i];
-        if (c < 32 && c != '\n' && c != '\r' && c != '\t') {
-            return false;
-        }
-        if (c > 126 && c < 160) {
-            return false;
+// Double the buckets (fs_lock held). Readers keep using the old table -
+// with its own dentries - until it is retired.
+static void dir_grow(UnifsNode* dir) {
+    DirTable* old = dir->table;
+    DirTable* t = table_alloc((old->mask + 1) * 2);
+    if (!t) return;  // Longer chains, still correct
+
+    for (uint32_t i = 0; i <= old->mask; i++) {
+        for (Dentry* d = old->buckets[i]; d; d = d->next) {
+            Dentry* copy = (Dentry*)malloc(sizeof(Dentry));
+            if (!copy) {
+                table_free(t);
+                return;
+            }
+            copy->hash = d->hash;
+            copy->node = d->node;
+            copy->next = t->buckets[d->hash & t->mask];
+            t->buckets[d->hash & t->mask] = copy;
         }
     }
+
+    rcu_assign_pointer(dir->table, t);
+    call_rcu(&old->rcu, table_free_rcu);
+}
+
+// Link node into dir (fs_lock held). False on OOM.
+static bool dir_insert(UnifsNode* dir, UnifsNode* node) {
+    if (!dir->table) {
+        DirTable* t = table_alloc(DIR_MIN_BUCKETS);
+        if (!t) return false;
+        rcu_assign_pointer(dir->table, t);
+    } else if (dir->child_count > dir->table->mask) {
+        dir_grow(dir);  // Keep chains about one entry long
+    }
+
+    Dentry* d = (Dentry*)malloc(sizeof(Dentry));
+    if (!d) return false;
+
+    DirTable* t = dir->table;
+    d->hash = name_hash(node->name, kstring::strlen(node->name));
+    d->node = node;
+    d->next = t->buckets[d->hash & t->mask];
+
+    node->parent = dir;
+    node->sib_next = nullptr;
+    node->sib_prev = dir->last_child;
+
+    rcu_assign_pointer(t->buckets[d->hash & t->mask], d);
+    if (dir->last_child) rcu_assign_pointer(dir->last_child->sib_next, node);
+    else rcu_assign_pointer(dir->first_child, node);
+    dir->last_child = node;
+    dir->child_count++;
     return true;
 }
 
+// Unlink node from its directory (fs_lock held). Readers already on it
+// can still follow sib_next; the caller frees it after a grace period.
+static void dir_remove(UnifsNode* node) {
+    UnifsNode* dir = node->parent;
+    DirTable* t = dir->table;
+    uint32_t h = name_hash(node->name, kstring::strlen(node->name));
+
+    for (Dentry** link = &t->buckets[h & t->mask]; *link; link = &(*link)->next) {
+        Dentry* d = *link;
+        if (d->node == node) {
+            rcu_assign_pointer(*link, d->next);
+            call_rcu(&d->rcu, dentry_free_rcu);
+            break;
+        }
+    }
+
+    if (node->sib_prev) rcu_assign_pointer(node->sib_prev->sib_next, node->sib_next);
+    else rcu_assign_pointer(dir->first_child, node->sib_next);
+    if (node->sib_next) node->sib_next->sib_prev = node->sib_prev;
+    else dir->last_child = node->sib_prev;
+    dir->child_count--;
+}
+
 // ============================================================================
-// Read API Implementation
+// Nodes
 // ============================================================================
 
-void unifs_init(void* start_addr) {
-    // Initialize RAM files
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        ram_files[i].used = false;
-        ram_files[i].data = nullptr;
-        ram_files[i].size = 0;
-        ram_files[i].capacity = 0;
-    }
-    ram_file_count = 0;
-    
-    if (!start_addr) {
-        mounted = false;
+static UnifsNode* node_alloc(const char* name, size_t len, bool is_dir) {
+    UnifsNode* node = (UnifsNode*)malloc(sizeof(UnifsNode));
+    if (!node) return nullptr;
+
+    kstring::memset(node, 0, sizeof(UnifsNode));
+    kstring::memcpy(node->name, name, len);
+    node->name[len] = '\0';
+    node->is_dir = is_dir;
+    return node;
+}
+
+static uint64_t* ram_frame(uint64_t phys) {
+    return (uint64_t*)(phys + vmm_get_hhdm_offset());
+}
+
+static void share_put(uint64_t phys, bool retire);
+
+// Free a subtree of the given height
+static void ram_tree_free(uint64_t entry, uint32_t height) {
+    if (entry & RAM_SHARED) {
+        share_put(entry & ~RAM_SHARED, false);
         return;
     }
-    
-    fs_start = (uint8_t*)start_addr;
-    boot_header = (UniFSHeader*)fs_start;
-    boot_entries = (UniFSEntry*)(fs_start + sizeof(UniFSHeader));
-    
-    // Verify magic
-    if (kstring::memcmp(boot_header->magic, UNIFS_MAGIC, 8) != 0) {
-        mounted = false;
-        return;
+    if (height > 0) {
+        uint64_t* slots = ram_frame(entry);
+        for (uint32_t i = 0; i < RAM_FANOUT; i++) {
+            if (slots[i]) ram_tree_free(slots[i], height - 1);
+        }
     }
-    
-    mounted = true;
+    pmm_free_frame((void*)entry);
 }
 
-bool unifs_is_mounted() {
-    return mounted;
-}
+static void ram_flat_put(RamFlat* flat);
 
-// Thread-safe version: fills caller-provided buffer
-bool unifs_open_into(const char* name, UniFSFile* out_file) {
-    if (!out_file) return false;
-    
-    // Check RAM files first (they can shadow boot files)
-    RAMFile* ram = find_ram_file(name);
-    if (ram) {
-        out_file->name = ram->name;
-        out_file->size = ram->size;
-        out_file->data = ram->data;
-        return true;
-    }
-    
-    // Check boot files
-    UniFSEntry* entry = find_boot_entry(name);
-    if (entry) {
-        out_file->name = entry->name;
-        out_file->size = entry->size;
-        out_file->data = fs_start + entry->offset;
-        return true;
+static void ram_file_free(RAMFile* file) {
+    if (file->root) {
+        ram_tree_free(file->root & ~RAM_HEIGHT_MASK, file->root & RAM_HEIGHT_MASK);
     }
-    
-    return false;
+    if (file->flat) ram_flat_put(file->flat);
+    free(file);
 }
 
-bool unifs_file_exists(const char* name) {
-    return find_ram_file(name) != nullptr || find_boot_entry(name) != nullptr;
+static void ram_file_free_rcu(RcuHead* head) {
+    ram_file_free(rcu_container_of(head, RAMFile, rcu));
 }
 
-uint64_t unifs_get_file_size(const char* name) {
-    RAMFile* ram = find_ram_file(name);
-    if (ram) return ram->size;
-    
-    UniFSEntry* entry = find_boot_entry(name);
-    return entry ? entry->size : 0;
+// An unlinked node, once no reader can see it. Its table is empty.
+static void node_free_rcu(RcuHead* head) {
+    UnifsNode* node = rcu_container_of(head, UnifsNode, rcu);
+    if (node->table) free(node->table);
+    free(node);
 }
 
-int unifs_get_file_type(const char* name) {
-    const uint8_t* data = nullptr;
-    uint64_t size = 0;
-    
-    RAMFile* ram = find_ram_file(name);
-    if (ram) {
-        data = ram->data;
-        size = ram->size;
-    } else {
-        UniFSEntry* entry = find_boot_entry(name);
-        if (!entry) return UNIFS_TYPE_UNKNOWN;
-        data = fs_start + entry->offset;
-        size = entry->size;
+static uint64_t ram_size(RAMFile* file) {
+    return __atomic_load_n(&file->size, __ATOMIC_ACQUIRE);
+}
+
+// Size of a node (RCU read side or fs_lock held)
+static uint64_t node_size(UnifsNode* node) {
+    if (node->is_dir) return 0;
+    if (node->boot) return node->boot_size;
+    return ram_size(rcu_dereference(node->ram));
+}
+
+// ============================================================================
+// Path Walk
+// ============================================================================
+
+// Take the next component off *path (skipping slashes). Returns its length,
+// 0 at the end.
+static size_t next_component(const char** path, const char** comp) {
+    const char* p = *path;
+    while (*p == '/') p++;
+    *comp = p;
+    while (*p && *p != '/') p++;
+    *path = p;
+    return p - *comp;
+}
+
+static bool is_dot(const char* comp, size_t len) {
+    return len == 1 && comp[0] == '.';
+}
+
+static bool is_dotdot(const char* comp, size_t len) {
+    return len == 2 && comp[0] == '.' && comp[1] == '.';
+}
+
+// Step from dir to its entry comp. Returns nullptr (with *err set) if that
+// isn't possible.
+static UnifsNode* step(UnifsNode* dir, const char* comp, size_t len, int* err) {
+    if (!dir->is_dir) {
+        *err = UNIFS_ERR_NOT_DIR;
+        return nullptr;
     }
-    
-    if (size >= 4 && kstring::memcmp(data, ELF_MAGIC, 4) == 0) {
-        return UNIFS_TYPE_ELF;
+    if (is_dot(comp, len)) return dir;
+    if (is_dotdot(comp, len)) return dir->parent;
+    if (len > UNIFS_MAX_FILENAME) {
+        *err = UNIFS_ERR_NAME_TOO_LONG;
+        return nullptr;
     }
-    
-    if (is_text_content(data, size)) {
-        return UNIFS_TYPE_TEXT;
+
+    UnifsNode* node = dir_lookup(dir, comp, len);
+    if (!node) *err = UNIFS_ERR_NOT_FOUND;
+    return node;
+}
+
+// The node at path, or nullptr (RCU read side or fs_lock held)
+static UnifsNode* resolve(const char* path) {
+    if (!path) return nullptr;
+
+    UnifsNode* node = &root_dir;
+    const char* comp;
+    size_t len;
+    int err;
+    while (node && (len = next_component(&path, &comp)) > 0) {
+        node = step(node, comp, len, &err);
     }
-    
-    return UNIFS_TYPE_BINARY;
+    return node;
 }
 
-uint64_t unifs_get_file_count() {
-    // Count boot files (excluding those shadowed by RAM files)
-    uint64_t count = 0;
-    if (mounted) {
-        for (uint64_t i = 0; i < boot_header->file_count; i++) {
-            if (!find_ram_file(boot_entries[i].name)) {
-                count++;
-            }
-        }
+// Resolve everything but the last component of path, which is copied to
+// name (fs_lock held). Returns UNIFS_OK or an error code.
+static int resolve_parent(const char* path, UnifsNode** dir, char* name) {
+    if (!path) return UNIFS_ERR_NOT_FOUND;
+    if (kstring::strlen(path) > UNIFS_MAX_PATH) return UNIFS_ERR_NAME_TOO_LONG;
+
+    UnifsNode* node = &root_dir;
+    const char* comp;
+    size_t len = next_component(&path, &comp);
+    if (len == 0) return UNIFS_ERR_EXISTS;  // The root
+
+    for (;;) {
+        const char* next;
+        size_t next_len = next_component(&path, &next);
+        if (next_len == 0) break;
+
+        int err;
+        node = step(node, comp, len, &err);
+        if (!node) return err;
+        comp = next;
+        len = next_len;
     }
-    // Add RAM files
-    count += ram_file_count;
-    return count;
+
+    if (!node->is_dir) return UNIFS_ERR_NOT_DIR;
+    if (is_dot(comp, len) || is_dotdot(comp, len)) return UNIFS_ERR_EXISTS;
+    if (len > UNIFS_MAX_FILENAME) return UNIFS_ERR_NAME_TOO_LONG;
+
+    kstring::memcpy(name, comp, len);
+    name[len] = '\0';
+    *dir = node;
+    return UNIFS_OK;
 }
 
-const char* unifs_get_file_name(uint64_t index) {
-    // Boot files first (skip files shadowed by RAM files)
-    uint64_t visible_idx = 0;
-    if (mounted) {
-        for (uint64_t i = 0; i < boot_header->file_count; i++) {
-            // Skip if this boot file is shadowed by a RAM file
-            if (find_ram_file(boot_entries[i].name)) continue;
-            
-            if (visible_idx == index) {
-                return boot_entries[i].name;
-            }
-            visible_idx++;
-        }
+// ============================================================================
+// RAM File Contents
+// ============================================================================
+// Readers walk the page tree under RCU; writers hold fs_lock. A published
+// tree only ever gains frames, and bytes past the size stay zero, so a
+// write fills its pages in place and then publishes any new size: an
+// append costs only the bytes appended. Overwriting visible bytes is done
+// in place too, as on Linux, so a concurrent reader may see part of it.
+// The pages a write fills are then shared with identical ones (see Shared
+// Pages). A tree is freed whole, after a grace period, when its file is
+// emptied, rewritten or deleted.
+
+// A RAM file's contents as one buffer (see unifs_open_into). Held by the
+// file until it next changes and by each UniFSFile handed out; the last
+// reference frees it.
+struct RamFlat {
+    uint32_t refs;
+    uint8_t data[];
+};
+
+// What a hole reads as (page-aligned, so it can also be written to disk)
+static const uint8_t zero_page[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE))) = {};
+
+// Shared Pages (below)
+static bool ram_unshare(RAMFile* file, uint64_t* slot);
+static void ram_share_range(RAMFile* file, uint64_t first, uint64_t last);
+static void ram_retire_flush();
+
+static uint64_t pages_for(uint64_t bytes) {
+    return (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+static uint32_t ram_height(uint64_t root) {
+    return root & RAM_HEIGHT_MASK;
+}
+
+// Bytes a tree of this height covers
+static uint64_t ram_span(uint32_t height) {
+    return (uint64_t)PAGE_SIZE << (RAM_SHIFT * height);
+}
+
+// Frame holding page `index`, 0 for a hole (RCU read side or fs_lock held)
+static uint64_t ram_page(RAMFile* file, uint64_t index) {
+    uint64_t root = __atomic_load_n(&file->root, __ATOMIC_ACQUIRE);
+    uint32_t height = ram_height(root);
+    if (index >= ram_span(height) / PAGE_SIZE) return 0;
+
+    uint64_t entry = root & ~RAM_HEIGHT_MASK;
+    for (uint32_t level = height; level > 0 && entry; level--) {
+        uint32_t slot = (index >> (RAM_SHIFT * (level - 1))) & (RAM_FANOUT - 1);
+        entry = __atomic_load_n(&ram_frame(entry)[slot], __ATOMIC_ACQUIRE);
     }
-    
-    // Then RAM files (index is now relative to visible boot files)
-    uint64_t ram_index = index - visible_idx;
-    uint64_t found = 0;
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        if (ram_files[i].used) {
-            if (found == ram_index) {
-                return ram_files[i].name;
-            }
-            found++;
+    return entry & ~RAM_SHARED;
+}
+
+// Copy n bytes at pos (within the file) out to a kernel or a user buffer.
+// Returns false on a fault.
+static bool ram_copy_out(RAMFile* file, uint64_t pos, void* dst, uint64_t n, bool user) {
+    uint8_t* out = (uint8_t*)dst;
+
+    while (n > 0) {
+        uint64_t offset = pos % PAGE_SIZE;
+        uint64_t chunk = PAGE_SIZE - offset;
+        if (chunk > n) chunk = n;
+
+        uint64_t page = ram_page(file, pos / PAGE_SIZE);
+        const uint8_t* src = page ? (const uint8_t*)ram_frame(page) + offset : zero_page + offset;
+        if (user) {
+            if (copy_to_user(out, src, chunk) < 0) return false;
+        } else {
+            kstring::memcpy(out, src, chunk);
         }
+        out += chunk;
+        pos += chunk;
+        n -= chunk;
     }
-    
-    return nullptr;
+    return true;
 }
 
-uint64_t unifs_get_file_size_by_index(uint64_t index) {
-    // Boot files first
-    if (mounted && index < boot_header->file_count) {
-        return boot_entries[index].size;
-    }
-    
-    // Then RAM files
-    uint64_t ram_index = mounted ? index - boot_header->file_count : index;
-    uint64_t found = 0;
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        if (ram_files[i].used) {
-            if (found == ram_index) {
-                return ram_files[i].size;
-            }
-            found++;
-        }
+// Allocate an unpublished, empty RAMFile
+static RAMFile* ram_file_alloc() {
+    RAMFile* file = (RAMFile*)malloc(sizeof(RAMFile));
+    if (file) kstring::memset(file, 0, sizeof(RAMFile));
+    return file;
+}
+
+// Swap a new version into node and retire the old one (fs_lock held)
+static void ram_file_replace(UnifsNode* node, RAMFile* file) {
+    RAMFile* old = node->ram;
+    if (old) ram_bytes -= old->size;
+    if (file) ram_bytes += file->size;
+
+    rcu_assign_pointer(node->ram, file);
+    if (old) call_rcu(&old->rcu, ram_file_free_rcu);
+}
+
+static void ram_flat_put(RamFlat* flat) {
+    if (__atomic_sub_fetch(&flat->refs, 1, __ATOMIC_ACQ_REL) == 0) free(flat);
+}
+
+// A new reference to the contents as one buffer, built on first use and
+// kept until the file next changes. nullptr if out of memory. (fs_lock held)
+static RamFlat* ram_flatten(RAMFile* file) {
+    if (!file->flat) {
+        RamFlat* flat = (RamFlat*)malloc(sizeof(RamFlat) + file->size);
+        if (!flat) return nullptr;
+        flat->refs = 1;
+        ram_copy_out(file, 0, flat->data, file->size, false);
+        file->flat = flat;
     }
-    
-    return 0;
+    __atomic_add_fetch(&file->flat->refs, 1, __ATOMIC_RELAXED);
+    return file->flat;
 }
 
-// ============================================================================
-// Write API Implementation (RAM-only)
-// ============================================================================
+// The file is about to change: drop its contiguous copy (fs_lock held)
+static void ram_flat_drop(RAMFile* file) {
+    RamFlat* flat = file->flat;
+    if (!flat) return;
+    file->flat = nullptr;
+    ram_flat_put(flat);
+}
 
-int unifs_create(const char* name) {
-    if (!name) return UNIFS_ERR_NOT_FOUND;
-    
-    // Check name length
-    if (kstring::strlen(name) > UNIFS_MAX_FILENAME) {
-        return UNIFS_ERR_NAME_TOO_LONG;
-    }
-    
-    // Check if file already exists
-    if (unifs_file_exists(name)) {
-        return UNIFS_ERR_EXISTS;
-    }
-    
-    // Find free slot
-    RAMFile* slot = find_free_slot();
-    if (!slot) {
-        return UNIFS_ERR_FULL;
-    }
-    
-    // Initialize new file
-    kstring::strcpy(slot->name, name);
-    slot->data = nullptr;
-    slot->size = 0;
-    slot->capacity = 0;
-    slot->used = true;
-    ram_file_count++;
-    
-    return UNIFS_OK;
+// A zeroed frame for the tree, or 0 (fs_lock held)
+static uint64_t ram_frame_alloc(RAMFile* file) {
+    uint64_t phys = (uint64_t)pmm_alloc_frame();
+    if (!phys) return 0;
+    kstring::memset(ram_frame(phys), 0, PAGE_SIZE);
+    file->pages++;
+    return phys;
 }
 
-int unifs_write(const char* name, const void* data, uint64_t size) {
-    if (!name) return UNIFS_ERR_NOT_FOUND;
-    if (size > UNIFS_MAX_FILE_SIZE) return UNIFS_ERR_NO_MEMORY;
-    
-    // Check if it's a boot file (read-only)
-    if (find_boot_entry(name) && !find_ram_file(name)) {
-        return UNIFS_ERR_READONLY;
-    }
-    
-    // Find or create RAM file
-    RAMFile* file = find_ram_file(name);
-    if (!file) {
-        int result = unifs_create(name);
-        if (result != UNIFS_OK) return result;
-        file = find_ram_file(name);
-    } else {
-        // Prevent modifying files currently open via fd (prevents use-after-free)
-        if (is_file_open(name)) {
-            return UNIFS_ERR_IN_USE;
+// Make the tree tall enough for `size` bytes. The old top becomes the
+// first entry of the new one. (fs_lock held)
+static bool ram_grow(RAMFile* file, uint64_t size) {
+    uint64_t root = file->root;
+    uint32_t height = ram_height(root);
+
+    while (size > ram_span(height)) {
+        uint64_t top = 0;
+        if (root & ~RAM_HEIGHT_MASK) {
+            top = ram_frame_alloc(file);
+            if (!top) return false;
+            ram_frame(top)[0] = root & ~RAM_HEIGHT_MASK;
         }
+        height++;
+        root = top | height;
+        __atomic_store_n(&file->root, root, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+// Frame for page `index`, ready to be written: allocates it and any
+// missing levels above it, and unshares it. The tree must be tall enough
+// already. Returns 0 if out of memory. (fs_lock held)
+static uint64_t ram_page_get(RAMFile* file, uint64_t index) {
+    uint64_t root = file->root;
+    uint32_t height = ram_height(root);
+    if (!(root & ~RAM_HEIGHT_MASK)) {
+        uint64_t top = ram_frame_alloc(file);
+        if (!top) return 0;
+        root = top | height;
+        __atomic_store_n(&file->root, root, __ATOMIC_RELEASE);
     }
-    
-    // Allocate/reallocate buffer if needed
-    if (size > file->capacity) {
-        if (file->data) {
-            free(file->data);
+
+    // At height 0 the root is the page's entry (its height bits are 0)
+    uint64_t* slot = &file->root;
+    for (uint32_t level = height; level > 0; level--) {
+        uint64_t* frame = ram_frame(*slot & ~RAM_HEIGHT_MASK);
+        slot = &frame[(index >> (RAM_SHIFT * (level - 1))) & (RAM_FANOUT - 1)];
+        if (!*slot) {
+            uint64_t page = ram_frame_alloc(file);
+            if (!page) return 0;
+            __atomic_store_n(slot, page, __ATOMIC_RELEASE);
         }
-        file->data = (uint8_t*)malloc(size);
-        if (!file->data) {
-            file->size = 0;
-            file->capacity = 0;
-            return UNIFS_ERR_NO_MEMORY;
+    }
+    if ((*slot & RAM_SHARED) && !ram_unshare(file, slot)) return 0;
+    return *slot;
+}
+
+// Zero [pos, end) wherever it has pages (fs_lock held)
+static void ram_zero(RAMFile* file, uint64_t pos, uint64_t end) {
+    while (pos < end) {
+        uint64_t offset = pos % PAGE_SIZE;
+        uint64_t chunk = PAGE_SIZE - offset;
+        if (chunk > end - pos) chunk = end - pos;
+
+        uint64_t page = ram_page(file, pos / PAGE_SIZE);
+        if (page) kstring::memset((uint8_t*)ram_frame(page) + offset, 0, chunk);
+        pos += chunk;
+    }
+}
+
+// Copy file contents in from a kernel or a user buffer
+static bool copy_in(void* dst, const void* src, uint64_t size, bool user) {
+    if (user) return copy_from_user(dst, src, size) == 0;
+    kstring::memcpy(dst, src, size);
+    return true;
+}
+
+// Write data at pos, growing the file as needed. Only the pages the write
+// covers are touched; skipped ranges stay holes. The pages it fills to
+// the end are then shared. `user` says data is a user address, which may
+// fault (UNIFS_ERR_FAULT). On failure the size is unchanged, though bytes
+// overwritten before the failure stay written. (fs_lock held)
+static int ram_write(RAMFile* file, uint64_t pos, const void* data, uint64_t size, bool user) {
+    uint64_t end = pos + size;
+    if (end < pos || end > UNIFS_MAX_FILE_SIZE) return UNIFS_ERR_NO_MEMORY;
+    if (size == 0) return UNIFS_OK;
+    if (!ram_grow(file, end)) return UNIFS_ERR_NO_MEMORY;
+    ram_flat_drop(file);
+
+    const uint8_t* in = (const uint8_t*)data;
+    uint64_t at = pos;
+    int result = UNIFS_OK;
+    while (at < end) {
+        uint64_t offset = at % PAGE_SIZE;
+        uint64_t chunk = PAGE_SIZE - offset;
+        if (chunk > end - at) chunk = end - at;
+
+        uint64_t page = ram_page_get(file, at / PAGE_SIZE);
+        if (!page) {
+            result = UNIFS_ERR_NO_MEMORY;
+            break;
+        }
+        if (!copy_in((uint8_t*)ram_frame(page) + offset, in, chunk, user)) {
+            result = UNIFS_ERR_FAULT;
+            at += chunk;    // May be partly copied
+            break;
         }
-        file->capacity = size;
+        in += chunk;
+        at += chunk;
     }
-    
-    // Copy data
-    if (data && size > 0) {
-        kstring::memcpy(file->data, data, size);
+
+    if (result != UNIFS_OK) {
+        // Keep what lies past the size zero for later holes
+        if (at > file->size) ram_zero(file, (pos > file->size) ? pos : file->size, at);
+        ram_retire_flush();     // Pages unshared so far
+        return result;
     }
-    file->size = size;
-    
+
+    if (end > file->size) __atomic_store_n(&file->size, end, __ATOMIC_RELEASE);
+    ram_share_range(file, pos / PAGE_SIZE, end / PAGE_SIZE);
     return UNIFS_OK;
 }
 
-int unifs_append(const char* name, const void* data, uint64_t size) {
-    if (!name || !data || size == 0) return UNIFS_ERR_NOT_FOUND;
-    
-    // Check if it's a boot file (read-only)
-    if (find_boot_entry(name) && !find_ram_file(name)) {
-        return UNIFS_ERR_READONLY;
-    }
-    
-    // Find or create RAM file
-    RAMFile* file = find_ram_file(name);
-    if (!file) {
-        int result = unifs_create(name);
-        if (result != UNIFS_OK) return result;
-        file = find_ram_file(name);
-    } else {
-        // Prevent modifying files currently open via fd (prevents use-after-free)
-        if (is_file_open(name)) {
-            return UNIFS_ERR_IN_USE;
-        }
-    }
-    
-    uint64_t new_size = file->size + size;
-    if (new_size > UNIFS_MAX_FILE_SIZE) return UNIFS_ERR_NO_MEMORY;
-    
-    // Reallocate if needed
-    if (new_size > file->capacity) {
-        uint64_t new_capacity = new_size * 2;  // Grow by 2x
-        if (new_capacity > UNIFS_MAX_FILE_SIZE) new_capacity = UNIFS_MAX_FILE_SIZE;
-        
-        uint8_t* new_data = (uint8_t*)malloc(new_capacity);
-        if (!new_data) return UNIFS_ERR_NO_MEMORY;
-        
-        if (file->data && file->size > 0) {
-            kstring::memcpy(new_data, file->data, file->size);
-            free(file->data);
-        }
-        file->data = new_data;
-        file->capacity = new_capacity;
-    }
-    
-    // Append data
-    kstring::memcpy(file->data + file->size, data, size);
-    file->size = new_size;
-    
-    return UNIFS_OK;
+// ram_write() to a published file
+static int ram_write_at(UnifsNode* node, uint64_t pos, const void* data, uint64_t size, bool user) {
+    RAMFile* file = node->ram;
+    uint64_t old_size = file->size;
+    int result = ram_write(file, pos, data, size, user);
+    ram_bytes += file->size - old_size;
+    return result;
 }
 
-int unifs_delete(const char* name) {
-    if (!name) return UNIFS_ERR_NOT_FOUND;
-    
-    // Cannot delete boot files
-    if (find_boot_entry(name) && !find_ram_file(name)) {
-        return UNIFS_ERR_READONLY;
-    }
-    
-    // Find RAM file
-    RAMFile* file = find_ram_file(name);
-    if (!file) {
-        return UNIFS_ERR_NOT_FOUND;
-    }
-    
-    // Check if file is currently open (prevent use-after-free)
-    // is_file_open() is declared in syscall.h
-    if (is_file_open(name)) {
-        return UNIFS_ERR_IN_USE;
-    }
-    
-    // Free memory and mark slot as unused
-    if (file->data) {
-        free(file->data);
+// Check if file content looks like text
+static bool is_text_content(const uint8_t* data, uint64_t size) {
+    uint64_t check_size = (size < 256) ? size : 256;
+
+    for (uint64_t i = 0; i < check_size; i++) {
+        uint8_t c = data[i];
+        if (c < 32 && c != '\n' && c != '\r' && c != '\t') {
+            return false;
+        }
+        if (c > 126 && c < 160) {
+            return false;
+        }
     }
-    file->data = nullptr;
-    file->size = 0;
-    file->capacity = 0;
-    file->used = false;
-    ram_file_count--;
-    
-    return UNIFS_OK;
+    return true;
+}
+
+// Whether [offset, offset + size) lies inside the image
+static bool in_image(uint64_t offset, uint64_t size) {
+    return offset <= fs_size && size <= fs_size - offset;
 }
 
 // ============================================================================
-// Stats
+// Shared Pages
 // ============================================================================
+// RAM file pages are indexed by content, so identical pages are kept once.
+// A page a write fills is hashed (xxHash64). If the index holds a page
+// with the same bytes, the tree points at that page instead, and the
+// write's frame is freed after a grace period, since readers may still be
+// copying from it. Otherwise the page joins the index. Rewritten and
+// loaded files share their last, partial page too, as bytes past the
+// size are zero. Verified v2 boot files add their pages, so a RAM copy of
+// a boot file lives in the module's pages.
+//
+// An entry with RAM_SHARED set points at an indexed page. Writing through
+// it copies the page first, unless this tree is its only user, in which
+// case the page just leaves the index. If the copy turns out to have been
+// the last user, the old page is also freed after a grace period. The
+// index has its own spinlock, because trees are freed from RCU callbacks.
 
-uint64_t unifs_get_total_size() {
-    uint64_t total = 0;
-    
-    // Boot files
-    if (mounted) {
-        for (uint64_t i = 0; i < boot_header->file_count; i++) {
-            total += boot_entries[i].size;
+struct SharedPage {
+    uint64_t hash;          // xxHash64 of the page
+    uint64_t phys;
+    uint64_t refs;          // Entries pointing here
+    bool boot;              // In the boot module: never written or freed
+    SharedPage* hash_next;  // Bucket chains
+    SharedPage* phys_next;
+};
+
+#define SHARE_MIN_BUCKETS   256
+#define RETIRE_BATCH        62
+
+// Frames swapped for shared twins, freed after a grace period
+struct RetiredFrames {
+    RcuHead rcu;
+    uint64_t count;
+    uint64_t frames[RETIRE_BATCH];
+};
+
+// Index (share_lock)
+static Spinlock share_lock = SPINLOCK_INIT;
+static SharedPage** share_by_hash = nullptr;
+static SharedPage** share_by_phys = nullptr;
+static uint64_t share_mask = 0;         // Buckets - 1
+static uint64_t share_pages = 0;        // Indexed pages
+static uint64_t share_boot_pages = 0;   // ... of which in the boot module
+static uint64_t share_refs = 0;         // Entries pointing at indexed pages
+
+static RetiredFrames* retiring = nullptr;   // Batch being filled (fs_lock)
+
+static uint64_t phys_bucket(uint64_t phys) {
+    return ((phys / PAGE_SIZE) * 0x9E3779B97F4A7C15ULL >> 32) & share_mask;
+}
+
+static void share_link(SharedPage* sp) {
+    SharedPage** hash_head = &share_by_hash[sp->hash & share_mask];
+    SharedPage** phys_head = &share_by_phys[phys_bucket(sp->phys)];
+    sp->hash_next = *hash_head;
+    *hash_head = sp;
+    sp->phys_next = *phys_head;
+    *phys_head = sp;
+}
+
+static void share_unlink(SharedPage* sp) {
+    SharedPage** link = &share_by_hash[sp->hash & share_mask];
+    while (*link != sp) link = &(*link)->hash_next;
+    *link = sp->hash_next;
+
+    link = &share_by_phys[phys_bucket(sp->phys)];
+    while (*link != sp) link = &(*link)->phys_next;
+    *link = sp->phys_next;
+
+    share_pages--;
+    if (sp->boot) share_boot_pages--;
+}
+
+// Double the buckets. False if out of memory. (share_lock held)
+static bool share_grow() {
+    uint64_t buckets = share_by_hash ? (share_mask + 1) * 2 : SHARE_MIN_BUCKETS;
+    SharedPage** by_hash = (SharedPage**)malloc(buckets * sizeof(SharedPage*));
+    SharedPage** by_phys = (SharedPage**)malloc(buckets * sizeof(SharedPage*));
+    if (!by_hash || !by_phys) {
+        if (by_hash) free(by_hash);
+        if (by_phys) free(by_phys);
+        return false;
+    }
+    kstring::memset(by_hash, 0, buckets * sizeof(SharedPage*));
+    kstring::memset(by_phys, 0, buckets * sizeof(SharedPage*));
+
+    SharedPage** old_hash = share_by_hash;
+    SharedPage** old_phys = share_by_phys;
+    uint64_t old_buckets = old_hash ? share_mask + 1 : 0;
+    share_by_hash = by_hash;
+    share_by_phys = by_phys;
+    share_mask = buckets - 1;
+
+    for (uint64_t i = 0; i < old_buckets; i++) {
+        SharedPage* sp = old_hash[i];
+        while (sp) {
+            SharedPage* next = sp->hash_next;
+            share_link(sp);
+            sp = next;
         }
     }
-    
-    // RAM files
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        if (ram_files[i].used) {
-            total += ram_files[i].size;
+    if (old_hash) {
+        free(old_hash);
+        free(old_phys);
+    }
+    return true;
+}
+
+// Index the page at phys. A RAM page starts with its one user; a boot
+// page with none. nullptr if out of memory. (share_lock held)
+static SharedPage* share_add(uint64_t hash, uint64_t phys, bool boot) {
+    if (!share_by_hash || share_pages > share_mask) {
+        if (!share_grow() && !share_by_hash) return nullptr;  // Else just longer chains
+    }
+
+    SharedPage* sp = (SharedPage*)malloc(sizeof(SharedPage));
+    if (!sp) return nullptr;
+    sp->hash = hash;
+    sp->phys = phys;
+    sp->refs = boot ? 0 : 1;
+    sp->boot = boot;
+    share_link(sp);
+
+    share_pages++;
+    if (boot) share_boot_pages++;
+    share_refs += sp->refs;
+    return sp;
+}
+
+// The indexed page holding these bytes, or nullptr (share_lock held)
+static SharedPage* share_find(uint64_t hash, const uint8_t* data) {
+    if (!share_by_hash) return nullptr;
+    for (SharedPage* sp = share_by_hash[hash & share_mask]; sp; sp = sp->hash_next) {
+        if (sp->hash == hash && kstring::memcmp(ram_frame(sp->phys), data, PAGE_SIZE) == 0) {
+            return sp;
         }
     }
-    
-    return total;
+    return nullptr;
 }
 
-uint64_t unifs_get_used_size() {
-    return unifs_get_total_size();  // Same as total for now
+// The index entry for the page at phys, or nullptr (share_lock held)
+static SharedPage* share_find_phys(uint64_t phys) {
+    if (!share_by_phys) return nullptr;
+    for (SharedPage* sp = share_by_phys[phys_bucket(phys)]; sp; sp = sp->phys_next) {
+        if (sp->phys == phys) return sp;
+    }
+    return nullptr;
 }
 
-uint64_t unifs_get_free_slots() {
-    uint64_t used = 0;
-    for (int i = 0; i < UNIFS_MAX_FILES; i++) {
-        if (ram_files[i].used) used++;
+static void retired_free_rcu(RcuHead* head) {
+    RetiredFrames* batch = rcu_container_of(head, RetiredFrames, rcu);
+    for (uint64_t i = 0; i < batch->count; i++) {
+        pmm_free_frame((void*)batch->frames[i]);
     }
-    return UNIFS_MAX_FILES - used;
+    free(batch);
 }
 
-uint64_t unifs_get_boot_file_count() {
-    return mounted ? boot_header->file_count : 0;
+static void ram_retire_flush() {
+    if (!retiring) return;
+    call_rcu(&retiring->rcu, retired_free_rcu);
+    retiring = nullptr;
+}
+
+// Make sure a batch has room for one more frame. False if out of memory.
+// (fs_lock held)
+static bool ram_retire_reserve() {
+    if (!retiring) {
+        retiring = (RetiredFrames*)malloc(sizeof(RetiredFrames));
+        if (!retiring) return false;
+        retiring->count = 0;
+    }
+    return true;
+}
+
+// Free a frame readers may still be copying from after a grace period
+// (fs_lock held, room reserved)
+static void ram_retire(uint64_t phys) {
+    retiring->frames[retiring->count++] = phys;
+    if (retiring->count == RETIRE_BATCH) ram_retire_flush();
+}
+
+// Drop an entry's reference to an indexed page, freeing the page with the
+// last one. From RCU callbacks the page is freed at once; with `retire`
+// (fs_lock held, room reserved) it goes to the retire batch, since a
+// concurrent reader may still be on it.
+static void share_put(uint64_t phys, bool retire) {
+    spinlock_acquire(&share_lock);
+    SharedPage* sp = share_find_phys(phys);
+    bool last = false;
+    if (sp) {
+        sp->refs--;
+        share_refs--;
+        last = !sp->boot && sp->refs == 0;
+        if (last) share_unlink(sp);
+    }
+    spinlock_release(&share_lock);
+
+    if (last) {
+        free(sp);
+        if (retire) ram_retire(phys);
+        else pmm_free_frame((void*)phys);
+    }
+}
+
+// Make the shared page at *slot private before it is written. Returns
+// false if out of memory. (fs_lock held)
+static bool ram_unshare(RAMFile* file, uint64_t* slot) {
+    uint64_t phys = *slot & ~RAM_SHARED;
+
+    // Only this tree uses it: take it out of the index
+    spinlock_acquire(&share_lock);
+    SharedPage* sp = share_find_phys(phys);
+    if (sp && !sp->boot && sp->refs == 1) {
+        share_unlink(sp);
+        share_refs--;
+        spinlock_release(&share_lock);
+        free(sp);
+        __atomic_store_n(slot, phys, __ATOMIC_RELEASE);
+        return true;
+    }
+    spinlock_release(&share_lock);
+
+    // Other users may drop theirs from RCU callbacks meanwhile, leaving
+    // this one the last: the old page is then retired, not freed
+    if (!ram_retire_reserve()) return false;
+    uint64_t copy = (uint64_t)pmm_alloc_frame();
+    if (!copy) return false;
+    kstring::memcpy(ram_frame(copy), ram_frame(phys), PAGE_SIZE);
+    file->pages++;
+    __atomic_store_n(slot, copy, __ATOMIC_RELEASE);
+    share_put(phys, true);
+    return true;
 }
 
+// Entry of page `index`, or nullptr if a level above it is missing
+// (fs_lock held)
+static uint64_t* ram_slot(RAMFile* file, uint64_t index) {
+    uint32_t height = ram_height(file->root);
+    if (index >= ram_span(height) / PAGE_SIZE) return nullptr;
+
+    uint64_t* slot = &file->root;
+    for (uint32_t level = height; level > 0; level--) {
+        uint64_t entry = *slot & ~RAM_HEIGHT_MASK;
+        if (!entry) return nullptr;
+        slot = &ram_frame(entry)[(index >> (RAM_SHIFT * (level - 1))) & (RAM_FANOUT - 1)];
+    }
+    return slot;
+}
+
+// Share page `index`: point at an identical indexed page, or index this
+// one. Out of memory leaves it private. (fs_lock held)
+static void ram_share(RAMFile* file, uint64_t index) {
+    uint64_t* slot = ram_slot(file, index);
+    if (!slot || !*slot || (*slot & RAM_SHARED)) return;
+
+    uint64_t phys = *slot;
+    const uint8_t* data = (const uint8_t*)ram_frame(phys);
+    uint64_t hash = xxh64(data, PAGE_SIZE, 0);
+
+    if (!ram_retire_reserve()) return;
+
+    spinlock_acquire(&share_lock);
+    SharedPage* twin = share_find(hash, data);
+    if (twin) {
+        twin->refs++;
+        share_refs++;
+        __atomic_store_n(slot, twin->phys | RAM_SHARED, __ATOMIC_RELEASE);
+    } else if (share_add(hash, phys, false)) {
+        __atomic_store_n(slot, phys | RAM_SHARED, __ATOMIC_RELEASE);
+    }
+    spinlock_release(&share_lock);
+
+    if (twin) ram_retire(phys);
+}
+
+// Share pages [first, last) of a file (fs_lock held)
+static void ram_share_range(RAMFile* file, uint64_t first, uint64_t last) {
+    for (uint64_t index = first; index < last; index++) {
+        ram_share(file, index);
+    }
+    ram_retire_flush();
+}
+
+// Index the pages of a boot file whose checksum just passed. Only v2
+// files qualify: their data is page-aligned and zero-padded to a whole
+// page. Compressed files are skipped, as their pages are page cache.
+static void share_boot_file(const UnifsNode* node) {
+    if (fs_version != 2 || node->lz4) return;
+
+    uint64_t offset = node->boot_stored - fs_start;
+    uint64_t span = pages_for(node->boot_size) * PAGE_SIZE;
+    if (offset % PAGE_SIZE || !in_image(offset, span)) return;
+
+    for (uint64_t pos = 0; pos < span; pos += PAGE_SIZE) {
+        const uint8_t* data = node->boot_stored + pos;
+        uint64_t phys = vmm_virt_to_phys((uint64_t)data);
+        if (!phys) return;
+        uint64_t hash = xxh64(data, PAGE_SIZE, 0);
+
+        spinlock_acquire(&share_lock);
+        bool indexed = share_find(hash, data) || share_add(hash, phys, true);
+        spinlock_release(&share_lock);
+        if (!indexed) return;
+    }
+}
+
+// ============================================================================
+// Compressed Boot Files
+// ============================================================================
+// A compressed file is a run of LZ4 blocks (UniFSLz4Header). At mount it
+// is given a window of kernel address space in the page cache region, and
+// boot_data points there - but nothing backs the window yet. The first
+// access to a block maps fresh frames under it and inflates the block into
+// them; the present bitmap records finished blocks. Files that are never
+// read cost no memory. Pages stay cached for good, so boot_data is as
+// stable as an uncompressed file's (and page-aligned, for exec).
+
+#define LZ4_MAX_BLOCK (1024 * 1024)
+
+struct BootLz4 {
+    const uint32_t* block_end;  // End of each stored block, relative to blocks
+    const uint8_t* blocks;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint64_t present[];         // Inflated blocks (bit per block)
+};
+
+static Mutex cache_lock = MUTEX_INIT;           // Serializes inflation
+static uint64_t cache_next = PAGE_CACHE_BASE;   // Window allocator (mount only)
+static uint64_t cache_pages = 0;                // Frames holding inflated data
+
+// Stored size of a compressed entry, or 0 if its header or block table is
+// malformed
+static uint64_t lz4_stored_size(const UniFSEntryV2* entry) {
+    if (!in_image(entry->offset, sizeof(UniFSLz4Header)) || entry->size == 0) return 0;
+    const UniFSLz4Header* hdr = (const UniFSLz4Header*)(fs_start + entry->offset);
+
+    uint32_t bs = hdr->block_size;
+    if (bs < PAGE_SIZE || bs > LZ4_MAX_BLOCK || (bs & (bs - 1))) return 0;
+    if (hdr->block_count != (entry->size + bs - 1) / bs) return 0;
+
+    uint64_t table = sizeof(UniFSLz4Header) + (uint64_t)hdr->block_count * sizeof(uint32_t);
+    if (!in_image(entry->offset, table)) return 0;
+
+    const uint32_t* block_end = (const uint32_t*)(hdr + 1);
+    for (uint32_t i = 1; i < hdr->block_count; i++) {
+        if (block_end[i] < block_end[i - 1]) return 0;
+    }
+
+    uint64_t stored = table + block_end[hdr->block_count - 1];
+    return in_image(entry->offset, stored) ? stored : 0;
+}
+
+// Reserve a window for a compressed file and set up its block state
+// (fs_lock held, at mount)
+static bool lz4_attach(UnifsNode* file) {
+    const UniFSLz4Header* hdr = (const UniFSLz4Header*)file->boot_stored;
+    uint64_t window = (file->boot_size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    if (window > PAGE_CACHE_BASE + PAGE_CACHE_SIZE - cache_next) return false;
+
+    uint64_t words = (hdr->block_count + 63) / 64;
+    BootLz4* z = (BootLz4*)malloc(sizeof(BootLz4) + words * sizeof(uint64_t));
+    if (!z) return false;
+    z->block_end = (const uint32_t*)(hdr + 1);
+    z->blocks = (const uint8_t*)(z->block_end + hdr->block_count);
+    z->block_size = hdr->block_size;
+    z->block_count = hdr->block_count;
+    for (uint64_t i = 0; i < words; i++) z->present[i] = 0;
+
+    file->lz4 = z;
+    file->boot_data = (const uint8_t*)cache_next;
+    cache_next += window;
+    return true;
+}
+
+static bool block_present(BootLz4* z, uint64_t block) {
+    return __atomic_load_n(&z->present[block / 64], __ATOMIC_ACQUIRE) & (1ULL << (block % 64));
+}
+
+// Back one block with frames and inflate it (cache_lock held)
+static bool fill_block(UnifsNode* node, uint64_t block) {
+    BootLz4* z = node->lz4;
+    uint8_t* dst = (uint8_t*)node->boot_data + block * z->block_size;
+    uint64_t len = node->boot_size - block * z->block_size;
+    if (len > z->block_size) len = z->block_size;
+    uint64_t span = (len + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+    // Frames survive a failed attempt and are reused by the next
+    for (uint64_t off = 0; off < span; off += PAGE_SIZE) {
+        uint64_t va = (uint64_t)dst + off;
+        if (vmm_virt_to_phys(va)) continue;
+        void* frame = pmm_alloc_frame();
+        if (!frame) return false;
+        vmm_map_page(va, (uint64_t)frame, PTE_PRESENT | PTE_WRITABLE);
+        cache_pages++;
+    }
+
+    // A block that didn't shrink is stored raw
+    uint32_t start = block ? z->block_end[block - 1] : 0;
+    uint32_t stored = z->block_end[block] - start;
+    if (stored == len) {
+        kstring::memcpy(dst, z->blocks + start, len);
+    } else if (lz4_decompress(z->blocks + start, stored, dst, len) != (int64_t)len) {
+        DEBUG_ERROR("%s: block %lu is corrupt", node->name, block);
+        return false;
+    }
+    if (len < span) kstring::memset(dst + len, 0, span - len);
+
+    __atomic_or_fetch(&z->present[block / 64], 1ULL << (block % 64), __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool boot_intact(UnifsNode* node);
+
+// Make [pos, pos + len) of a boot file readable: inflates the blocks it
+// covers if the file is compressed. May sleep. False on corruption or OOM.
+static bool boot_fill(UnifsNode* node, uint64_t pos, uint64_t len) {
+    BootLz4* z = node->lz4;
+    if (!z || len == 0) return true;
+    if (!boot_intact(node)) return false;
+
+    uint64_t last = (pos + len - 1) / z->block_size;
+    for (uint64_t block = pos / z->block_size; block <= last; block++) {
+        if (block_present(z, block)) continue;
+
+        mutex_lock(&cache_lock);
+        bool ok = block_present(z, block) || fill_block(node, block);
+        mutex_unlock(&cache_lock);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Mount
+// ============================================================================
+
+// Add a boot entry, creating the directories its path implies. file holds
+// the boot_* fields of a file entry, nullptr for a directory. Returns
+// false if the entry clashes with an earlier one (or on OOM).
+static bool mount_boot_entry(const char* path, const UnifsNode* file) {
+    bool is_dir = !file;
+    UnifsNode* dir = &root_dir;
+    const char* comp;
+    size_t len = next_component(&path, &comp);
+
+    while (len > 0) {
+        if (is_dot(comp, len) || is_dotdot(comp, len)) return false;
+        if (len > UNIFS_MAX_FILENAME) return false;
+
+        const char* next;
+        size_t next_len = next_component(&path, &next);
+        UnifsNode* node = dir_lookup(dir, comp, len);
+
+        if (next_len == 0 && !is_dir) {
+            if (node) return false;
+            node = node_alloc(comp, len, false);
+            if (!node) return false;
+            node->boot = true;
+            node->boot_data = file->boot_data;
+            node->boot_size = file->boot_size;
+            node->boot_stored = file->boot_stored;
+            node->boot_stored_size = file->boot_stored_size;
+            node->boot_crc = file->boot_crc;
+            node->boot_state = file->boot_state;
+            node->lz4 = file->lz4;
+            if (!dir_insert(dir, node)) {
+                free(node);
+                return false;
+            }
+            boot_file_count++;
+            boot_bytes += file->boot_size;
+            return true;
+        }
+
+        if (!node) {
+            node = node_alloc(comp, len, true);
+            if (!node) return false;
+            if (!dir_insert(dir, node)) {
+                free(node);
+                return false;
+            }
+        } else if (!node->is_dir) {
+            return false;
+        }
+        dir = node;
+        comp = next;
+        len = next_len;
+    }
+    return is_dir;
+}
+
+static bool mount_v1() {
+    if (fs_size < sizeof(UniFSHeader)) return false;
+    const UniFSHeader* header = (const UniFSHeader*)fs_start;
+    const UniFSEntry* entries = (const UniFSEntry*)(fs_start + sizeof(UniFSHeader));
+    if (header->file_count > (fs_size - sizeof(UniFSHeader)) / sizeof(UniFSEntry)) return false;
+
+    for (uint64_t i = 0; i < header->file_count; i++) {
+        const UniFSEntry* entry = &entries[i];
+        if (!in_image(entry->offset, entry->size)) continue;
+
+        char path[sizeof(entry->name)];
+        kstring::memcpy(path, entry->name, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+
+        UnifsNode file = {};
+        file.boot_data = file.boot_stored = fs_start + entry->offset;
+        file.boot_size = file.boot_stored_size = entry->size;
+        file.boot_state = BOOT_GOOD;  // No checksums
+        mount_boot_entry(path, &file);
+    }
+    return true;
+}
+
+// The header and index of the v2 image at base, if they are intact. size
+// bounds the image; at least the header and index must be in memory.
+static const UniFSEntryV2* v2_index(const uint8_t* base, uint64_t size, const UniFSHeaderV2** out_header) {
+    if (size < sizeof(UniFSHeaderV2)) return nullptr;
+    const UniFSHeaderV2* header = (const UniFSHeaderV2*)base;
+
+    if (crc32c(header, offsetof(UniFSHeaderV2, header_crc)) != header->header_crc) return nullptr;
+    if (header->image_size > size || header->image_size < sizeof(UniFSHeaderV2)) return nullptr;
+    if (header->entry_count > (header->image_size - sizeof(UniFSHeaderV2)) / sizeof(UniFSEntryV2)) {
+        return nullptr;
+    }
+
+    const UniFSEntryV2* entries = (const UniFSEntryV2*)(base + sizeof(UniFSHeaderV2));
+    if (crc32c(entries, header->entry_count * sizeof(UniFSEntryV2)) != header->index_crc) return nullptr;
+
+    *out_header = header;
+    return entries;
+}
+
+static bool mount_v2() {
+    const UniFSHeaderV2* header;
+    const UniFSEntryV2* entries = v2_index(fs_start, fs_size, &header);
+    if (!entries) return false;
+
+    // Sorted: every directory is created before the entries inside it
+    for (uint64_t i = 0; i < header->entry_count; i++) {
+        const UniFSEntryV2* entry = &entries[i];
+        if (entry->path[UNIFS_V2_PATH - 1] != '\0') continue;
+
+        if (entry->type == UNIFS_V2_DIR) {
+            mount_boot_entry(entry->path, nullptr);
+            continue;
+        }
+
+        UnifsNode file = {};
+        file.boot_size = entry->size;
+        file.boot_crc = entry->crc;
+        file.boot_state = BOOT_UNCHECKED;
+        file.boot_stored = fs_start + entry->offset;
+
+        if (entry->type == UNIFS_V2_FILE && in_image(entry->offset, entry->size)) {
+            file.boot_data = file.boot_stored;
+            file.boot_stored_size = entry->size;
+            mount_boot_entry(entry->path, &file);
+        } else if (entry->type == (UNIFS_V2_FILE | UNIFS_V2_LZ4)) {
+            file.boot_stored_size = lz4_stored_size(entry);
+            if (!file.boot_stored_size || !lz4_attach(&file)) continue;
+            if (!mount_boot_entry(entry->path, &file)) free(file.lz4);
+        }
+    }
+    return true;
+}
+
+// Verify a boot file's checksum the first time it is used, and share its
+// pages if it is intact. Boot nodes are never freed, so this may run
+// outside RCU and fs_lock; racing callers compute the same answer, and
+// the one that records it does the rest.
+static bool boot_intact(UnifsNode* node) {
+    uint8_t state = __atomic_load_n(&node->boot_state, __ATOMIC_ACQUIRE);
+    if (state == BOOT_UNCHECKED) {
+        uint32_t crc = crc32c(node->boot_stored, node->boot_stored_size);
+        state = (crc == node->boot_crc) ? BOOT_GOOD : BOOT_CORRUPT;
+
+        uint8_t expected = BOOT_UNCHECKED;
+        if (__atomic_compare_exchange_n(&node->boot_state, &expected, state, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            if (state == BOOT_CORRUPT) DEBUG_ERROR("%s: checksum mismatch", node->name);
+            else share_boot_file(node);
+        }
+    }
+    return state == BOOT_GOOD;
+}
+
+// ============================================================================
+// Read API Implementation
+// ============================================================================
+
+void unifs_init(void* start_addr, uint64_t size) {
+    root_dir.parent = &root_dir;
+    root_dir.is_dir = true;
+    mounted = false;
+    if (!start_addr || size < 8) return;
+
+    fs_start = (uint8_t*)start_addr;
+    fs_size = size;
+
+    // Verify magic
+    if (kstring::memcmp(fs_start, UNIFS_MAGIC, 8) == 0) {
+        fs_version = 1;
+    } else if (kstring::memcmp(fs_start, UNIFS_MAGIC_V2, 8) == 0) {
+        fs_version = 2;
+    } else {
+        return;
+    }
+
+    mutex_lock(&fs_lock);
+    bool ok = (fs_version == 1) ? mount_v1() : mount_v2();
+    mutex_unlock(&fs_lock);
+
+    if (!ok) DEBUG_ERROR("uniFS v%d image is damaged, not mounted", fs_version);
+    mounted = ok;
+}
+
+bool unifs_is_mounted() {
+    return mounted;
+}
+
+// Thread-safe version: fills caller-provided buffer
+bool unifs_open_into(const char* name, UniFSFile* out_file) {
+    if (!out_file) return false;
+
+    // Boot nodes are never freed, so one may be used after the walk
+    rcu_read_lock();
+    UnifsNode* node = resolve(name);
+    bool boot = node && node->boot;
+    if (boot) {
+        kstring::strncpy(out_file->name, node->name, sizeof(out_file->name));
+        out_file->data = node->boot_data;
+        out_file->size = node->boot_size;
+        out_file->immutable = true;
+        out_file->flat = nullptr;
+    }
+    rcu_read_unlock();
+
+    if (boot) return boot_intact(node) && boot_fill(node, 0, out_file->size);
+
+    // A RAM file's pages are scattered: hand out a reference to a
+    // contiguous copy, which outlives any later write or delete
+    mutex_lock(&fs_lock);
+    node = resolve(name);
+    RamFlat* flat = (node && !node->is_dir) ? ram_flatten(node->ram) : nullptr;
+    if (flat) {
+        kstring::strncpy(out_file->name, node->name, sizeof(out_file->name));
+        out_file->data = flat->data;
+        out_file->size = node->ram->size;
+        out_file->immutable = false;
+        out_file->flat = flat;
+    }
+    mutex_unlock(&fs_lock);
+    return flat != nullptr;
+}
+
+void unifs_close_into(UniFSFile* file) {
+    if (!file || !file->flat) return;
+    ram_flat_put(file->flat);
+    file->flat = nullptr;
+    file->data = nullptr;
+}
+
+bool unifs_file_exists(const char* name) {
+    rcu_read_lock();
+    bool found = resolve(name) != nullptr;
+    rcu_read_unlock();
+    return found;
+}
+
+bool unifs_is_dir(const char* path) {
+    rcu_read_lock();
+    UnifsNode* node = resolve(path);
+    bool dir = node && node->is_dir;
+    rcu_read_unlock();
+    return dir;
+}
+
+uint64_t unifs_get_file_size(const char* name) {
+    rcu_read_lock();
+    UnifsNode* node = resolve(name);
+    uint64_t size = node ? node_size(node) : 0;
+    rcu_read_unlock();
+    return size;
+}
+
+int unifs_get_file_type(const char* name) {
+    rcu_read_lock();
+    UnifsNode* node = resolve(name);
+    if (!node) {
+        rcu_read_unlock();
+        return UNIFS_TYPE_UNKNOWN;
+    }
+    if (node->is_dir) {
+        rcu_read_unlock();
+        return UNIFS_TYPE_DIR;
+    }
+    if (node->lz4) {
+        // Inflate what the checks below look at. Boot nodes are never
+        // freed, so the node outlives the unlock.
+        rcu_read_unlock();
+        uint64_t head = (node->boot_size < 256) ? node->boot_size : 256;
+        if (!boot_fill(node, 0, head)) return UNIFS_TYPE_UNKNOWN;
+        rcu_read_lock();
+    }
+
+    uint64_t size = node_size(node);
+    const uint8_t* data;
+    uint8_t head[256];
+    if (node->boot) {
+        data = node->boot_data;
+    } else {
+        // The checks below look at the first 256 bytes at most
+        if (size > sizeof(head)) size = sizeof(head);
+        ram_copy_out(rcu_dereference(node->ram), 0, head, size, false);
+        data = head;
+    }
+
+    int type = UNIFS_TYPE_BINARY;
+    if (size >= 4 && kstring::memcmp(data, ELF_MAGIC, 4) == 0) {
+        type = UNIFS_TYPE_ELF;
+    } else if (is_text_content(data, size)) {
+        type = UNIFS_TYPE_TEXT;
+    }
+    rcu_read_unlock();
+
+    return type;
+}
+
+uint64_t unifs_get_file_count() {
+    return __atomic_load_n(&root_dir.child_count, __ATOMIC_RELAXED);
+}
+
+// Entry `index` of the root directory (RCU read side)
+static UnifsNode* root_entry(uint64_t index) {
+    UnifsNode* node = rcu_dereference(root_dir.first_child);
+    while (node && index--) node = rcu_dereference(node->sib_next);
+    return node;
+}
+
+const char* unifs_get_file_name(uint64_t index) {
+    rcu_read_lock();
+    UnifsNode* node = root_entry(index);
+    rcu_read_unlock();
+    return node ? node->name : nullptr;
+}
+
+uint64_t unifs_get_file_size_by_index(uint64_t index) {
+    rcu_read_lock();
+    UnifsNode* node = root_entry(index);
+    uint64_t size = node ? node_size(node) : 0;
+    rcu_read_unlock();
+    return size;
+}
+
+int64_t unifs_read_dir(const char* path, uint64_t index, UnifsDirEntry* out, uint64_t max) {
+    rcu_read_lock();
+    UnifsNode* dir = resolve(path);
+    if (!dir || !dir->is_dir) {
+        rcu_read_unlock();
+        return dir ? UNIFS_ERR_NOT_DIR : UNIFS_ERR_NOT_FOUND;
+    }
+
+    UnifsNode* node = rcu_dereference(dir->first_child);
+    while (node && index--) node = rcu_dereference(node->sib_next);
+
+    uint64_t n = 0;
+    for (; node && n < max; node = rcu_dereference(node->sib_next), n++) {
+        kstring::strcpy(out[n].name, node->name);
+        out[n].size = node_size(node);
+        out[n].is_dir = node->is_dir;
+    }
+    rcu_read_unlock();
+    return (int64_t)n;
+}
+
+// ============================================================================
+// Write API Implementation (RAM-only)
+// ============================================================================
+
+// Create an empty RAM file or directory (fs_lock held)
+static int create_locked(const char* path, bool is_dir, UnifsNode** out) {
+    UnifsNode* dir;
+    char name[UNIFS_MAX_FILENAME + 1];
+    int result = resolve_parent(path, &dir, name);
+    if (result != UNIFS_OK) return result;
+
+    size_t len = kstring::strlen(name);
+    if (dir_lookup(dir, name, len)) return UNIFS_ERR_EXISTS;
+
+    UnifsNode* node = node_alloc(name, len, is_dir);
+    if (!node) return UNIFS_ERR_NO_MEMORY;
+    if (!is_dir) {
+        node->ram = ram_file_alloc();
+        if (!node->ram) {
+            free(node);
+            return UNIFS_ERR_NO_MEMORY;
+        }
+    }
+    if (!dir_insert(dir, node)) {
+        if (node->ram) ram_file_free(node->ram);
+        free(node);
+        return UNIFS_ERR_NO_MEMORY;
+    }
+
+    if (!is_dir) ram_file_count++;
+    if (out) *out = node;
+    return UNIFS_OK;
+}
+
+int unifs_create(const char* name) {
+    mutex_lock(&fs_lock);
+    int result = create_locked(name, false, nullptr);
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+int unifs_mkdir(const char* path) {
+    mutex_lock(&fs_lock);
+    int result = create_locked(path, true, nullptr);
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+// Find or create the RAM file for a write (fs_lock held)
+static int open_for_write(const char* name, UnifsNode** out) {
+    UnifsNode* node = resolve(name);
+    if (!node) return create_locked(name, false, out);
+
+    if (node->is_dir) return UNIFS_ERR_IS_DIR;
+    if (node->boot) return UNIFS_ERR_READONLY;
+    *out = node;
+    return UNIFS_OK;
+}
+
+int unifs_write(const char* name, const void* data, uint64_t size) {
+    if (size > UNIFS_MAX_FILE_SIZE) return UNIFS_ERR_NO_MEMORY;
+
+    mutex_lock(&fs_lock);
+
+    UnifsNode* node;
+    int result = open_for_write(name, &node);
+    if (result != UNIFS_OK) {
+        mutex_unlock(&fs_lock);
+        return result;
+    }
+
+    // Readers may be scanning the current contents, so build the new
+    // version off to the side and swap it in
+    RAMFile* file = ram_file_alloc();
+    result = file ? ram_write(file, 0, data, size, false) : UNIFS_ERR_NO_MEMORY;
+    if (result != UNIFS_OK) {
+        if (file) ram_file_free(file);
+        mutex_unlock(&fs_lock);
+        return result;
+    }
+    ram_share_range(file, size / PAGE_SIZE, pages_for(size));  // The partial last page
+    ram_file_replace(node, file);
+
+    mutex_unlock(&fs_lock);
+    return UNIFS_OK;
+}
+
+int unifs_append(const char* name, const void* data, uint64_t size) {
+    if (!data || size == 0) return UNIFS_ERR_NOT_FOUND;
+
+    mutex_lock(&fs_lock);
+
+    UnifsNode* node;
+    int result = open_for_write(name, &node);
+    if (result == UNIFS_OK) result = ram_write_at(node, node->ram->size, data, size, false);
+
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+int unifs_delete(const char* name) {
+    mutex_lock(&fs_lock);
+
+    UnifsNode* node = resolve(name);
+    int result = UNIFS_OK;
+    if (!node) {
+        result = UNIFS_ERR_NOT_FOUND;
+    } else if (node->is_dir) {
+        result = UNIFS_ERR_IS_DIR;
+    } else if (node->boot) {
+        result = UNIFS_ERR_READONLY;  // Cannot delete boot files
+    } else if (node->open_count > 0) {
+        result = UNIFS_ERR_IN_USE;    // Open Files still refer to it
+    }
+
+    if (result == UNIFS_OK) {
+        // Unpublish the name; memory is freed once readers are done
+        dir_remove(node);
+        ram_file_replace(node, nullptr);
+        call_rcu(&node->rcu, node_free_rcu);
+        ram_file_count--;
+    }
+
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+int unifs_rmdir(const char* path) {
+    mutex_lock(&fs_lock);
+
+    UnifsNode* node = resolve(path);
+    int result = UNIFS_OK;
+    if (!node) {
+        result = UNIFS_ERR_NOT_FOUND;
+    } else if (!node->is_dir) {
+        result = UNIFS_ERR_NOT_DIR;
+    } else if (node == &root_dir) {
+        result = UNIFS_ERR_READONLY;
+    } else if (node->child_count > 0) {
+        result = UNIFS_ERR_NOT_EMPTY;
+    }
+
+    if (result == UNIFS_OK) {
+        dir_remove(node);
+        call_rcu(&node->rcu, node_free_rcu);
+    }
+
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+// ============================================================================
+// VFS Backend
+// ============================================================================
+
+struct UnifsHandle {
+    UnifsNode* node;            // RAM file, or nullptr for a boot file
+    UnifsNode* boot;            // Boot file (never freed; contents never move)
+};
+
+// Current size of an open file
+static uint64_t handle_size(UnifsHandle* h) {
+    if (h->boot) return h->boot->boot_size;
+
+    rcu_read_lock();
+    uint64_t size = node_size(h->node);
+    rcu_read_unlock();
+    return size;
+}
+
+static int64_t unifs_file_read(File* f, void* buf, uint64_t count, uint64_t* pos, uint32_t) {
+    UnifsHandle* h = (UnifsHandle*)f->priv;
+    uint64_t n = 0;
+
+    if (h->boot && *pos < h->boot->boot_size) {
+        uint64_t want = h->boot->boot_size - *pos;
+        if (!boot_fill(h->boot, *pos, (want < count) ? want : count)) return -1;
+    }
+
+    rcu_read_lock();
+    UnifsNode* node = h->boot ? h->boot : h->node;
+    uint64_t size = node_size(node);
+    bool fault = false;
+    if (*pos < size) {
+        n = size - *pos;
+        if (n > count) n = count;
+        if (h->boot) {
+            fault = copy_to_user(buf, node->boot_data + *pos, n) < 0;
+        } else {
+            fault = !ram_copy_out(rcu_dereference(node->ram), *pos, buf, n, true);
+        }
+    }
+    rcu_read_unlock();
+
+    if (fault) return -EFAULT;
+    *pos += n;
+    return n;
+}
+
+static int64_t unifs_file_write(File* f, const void* buf, uint64_t count, uint64_t* pos, uint32_t) {
+    UnifsHandle* h = (UnifsHandle*)f->priv;
+    if (!h->node) return -1;  // Boot files are read-only
+
+    mutex_lock(&fs_lock);
+    uint64_t at = (f->flags & O_APPEND) ? h->node->ram->size : *pos;
+    int result = ram_write_at(h->node, at, buf, count, true);
+    mutex_unlock(&fs_lock);
+
+    if (result == UNIFS_ERR_FAULT) return -EFAULT;
+    if (result != UNIFS_OK) return -1;
+    *pos = at + count;
+    return count;
+}
+
+static int64_t unifs_file_seek(File* f, int64_t offset, int whence) {
+    return vfs_seek_in(f, offset, whence, handle_size((UnifsHandle*)f->priv));
+}
+
+// Only boot files have contents that never move
+static const void* unifs_file_mmap(File* f, uint64_t offset, uint64_t length) {
+    UnifsHandle* h = (UnifsHandle*)f->priv;
+    UnifsNode* boot = h->boot;
+    if (!boot || offset > boot->boot_size || length > boot->boot_size - offset) {
+        return nullptr;
+    }
+    if (!boot_fill(boot, offset, length)) return nullptr;
+    return boot->boot_data + offset;
+}
+
+static void unifs_file_release(File* f) {
+    UnifsHandle* h = (UnifsHandle*)f->priv;
+    if (h->node) {
+        mutex_lock(&fs_lock);
+        h->node->open_count--;
+        mutex_unlock(&fs_lock);
+    }
+    free(h);
+}
+
+static const FileOps unifs_file_ops = {
+    unifs_file_read,
+    unifs_file_write,
+    unifs_file_seek,
+    unifs_file_mmap,
+    nullptr,            // Always ready
+    nullptr,
+    unifs_file_release,
+};
+
+File* unifs_open_file(const char* name, uint32_t flags) {
+    if (!name) return nullptr;
+
+    UnifsHandle* h = (UnifsHandle*)malloc(sizeof(UnifsHandle));
+    if (!h) return nullptr;
+    h->node = nullptr;
+    h->boot = nullptr;
+
+    bool writable = (flags & O_ACCMODE) != O_RDONLY;
+
+    mutex_lock(&fs_lock);
+
+    UnifsNode* node = resolve(name);
+    if (!node && (flags & O_CREAT) && create_locked(name, false, &node) != UNIFS_OK) {
+        node = nullptr;
+    }
+    if (!node || node->is_dir || (node->boot && writable)) {
+        // Missing, a directory, or a write to a read-only boot file
+        mutex_unlock(&fs_lock);
+        free(h);
+        return nullptr;
+    }
+
+    if (node->boot && !boot_intact(node)) {
+        mutex_unlock(&fs_lock);
+        free(h);
+        return nullptr;
+    }
+
+    if (node->boot) {
+        h->boot = node;
+    } else {
+        if (writable && (flags & O_TRUNC) && node->ram->size > 0) {
+            RAMFile* empty = ram_file_alloc();
+            if (!empty) {
+                mutex_unlock(&fs_lock);
+                free(h);
+                return nullptr;
+            }
+            ram_file_replace(node, empty);
+        }
+        h->node = node;
+        node->open_count++;
+    }
+
+    mutex_unlock(&fs_lock);
+
+    File* f = file_alloc(&unifs_file_ops, h, flags);
+    if (!f) {
+        File tmp = {&unifs_file_ops, 0, flags, 0, h, nullptr};
+        unifs_file_release(&tmp);
+        return nullptr;
+    }
+    return f;
+}
+
+// ============================================================================
+// Check
+// ============================================================================
+
+static uint64_t fsck_v1(void (*report)(const char*, const char*)) {
+    uint64_t problems = 0;
+    if (fs_size < sizeof(UniFSHeader)) {
+        report("", "image truncated");
+        return 1;
+    }
+    const UniFSHeader* header = (const UniFSHeader*)fs_start;
+    const UniFSEntry* entries = (const UniFSEntry*)(fs_start + sizeof(UniFSHeader));
+    if (header->file_count > (fs_size - sizeof(UniFSHeader)) / sizeof(UniFSEntry)) {
+        report("", "entry count exceeds image");
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < header->file_count; i++) {
+        char path[sizeof(entries[i].name)];
+        kstring::memcpy(path, entries[i].name, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        if (!in_image(entries[i].offset, entries[i].size)) {
+            report(path, "data outside image");
+            problems++;
+        }
+    }
+    return problems;  // v1 has no checksums
+}
+
+static uint64_t fsck_v2(void (*report)(const char*, const char*)) {
+    const UniFSHeaderV2* header;
+    const UniFSEntryV2* entries = v2_index(fs_start, fs_size, &header);
+    if (!entries) {
+        report("", "header or index checksum mismatch");
+        return 1;
+    }
+
+    uint64_t problems = 0;
+    const char* prev = nullptr;
+    for (uint64_t i = 0; i < header->entry_count; i++) {
+        const UniFSEntryV2* entry = &entries[i];
+        if (entry->path[UNIFS_V2_PATH - 1] != '\0' || entry->path[0] == '\0') {
+            report("", "bad path");
+            problems++;
+            continue;
+        }
+        const char* path = entry->path;
+
+        if (prev && kstring::strcmp(prev, path) >= 0) {
+            report(path, "index out of order or duplicate");
+            problems++;
+        }
+        prev = path;
+
+        if (entry->type == UNIFS_V2_DIR) {
+            if (entry->size != 0) {
+                report(path, "directory with data");
+                problems++;
+            }
+            continue;
+        }
+        if (entry->type != UNIFS_V2_FILE && entry->type != (UNIFS_V2_FILE | UNIFS_V2_LZ4)) {
+            report(path, "unknown entry type");
+            problems++;
+            continue;
+        }
+
+        // Bytes as stored
+        uint64_t stored = entry->size;
+        if (entry->type & UNIFS_V2_LZ4) {
+            stored = lz4_stored_size(entry);
+            if (!stored) {
+                report(path, "bad LZ4 block table");
+                problems++;
+                continue;
+            }
+        }
+
+        if (entry->offset % UNIFS_V2_ALIGN) {
+            report(path, "data not page-aligned");
+            problems++;
+        } else if (!in_image(entry->offset, stored) ||
+                   entry->offset + stored > header->image_size) {
+            report(path, "data outside image");
+            problems++;
+        } else if (crc32c(fs_start + entry->offset, stored) != entry->crc) {
+            report(path, "checksum mismatch");
+            problems++;
+        }
+    }
+    return problems;
+}
+
+uint64_t unifs_fsck(void (*report)(const char* path, const char* problem)) {
+    if (!fs_start) {
+        report("", "no boot image");
+        return 1;
+    }
+    if (fs_version == 0) {
+        report("", "unknown image format");
+        return 1;
+    }
+    return (fs_version == 2) ? fsck_v2(report) : fsck_v1(report);
+}
+
+// ============================================================================
+// Disk Store
+// ============================================================================
+// unifs_sync() saves the RAM files and directories as a v2 image, the
+// boot image's format, and unifs_store_init() loads them back. Sector 0
+// holds the superblock; the rest of the disk is two image areas. A sync
+// writes the area the superblock doesn't point at, flushes, then repoints
+// the superblock and flushes again, so a crash mid-sync leaves the
+// previous image in place.
+//
+// Each file page is a page of the image, so pages move by DMA straight
+// between a RAM file's frames and the disk - holes are written from the
+// zero page - in batches of large, plugged, sequential bios.
+
+#define STORE_AREA_START    8       // Sectors (the superblock's page)
+#define STORE_MIN_SECTORS   2048    // 1 MB
+#define STORE_BIO_PAGES     32      // Pages per bio
+#define STORE_BATCH         16      // Bios per plug
+#define SECTORS_PER_PAGE    (PAGE_SIZE / BLOCK_SECTOR_SIZE)
+
+// Store state (fs_lock)
+static BlockDevice* store_dev = nullptr;
+static uint64_t store_generation = 0;   // 0: no image yet
+static uint64_t store_image_sector = 0;
+static uint64_t store_image_size = 0;
+
+// Sectors in each image area, a whole number of pages
+static uint64_t store_area_sectors(BlockDevice* dev) {
+    return ((dev->sectors - STORE_AREA_START) / 2) & ~(uint64_t)(SECTORS_PER_PAGE - 1);
+}
+
+// Move count pages between frames and the disk from sector on. Returns
+// false on a disk error.
+static bool store_io(BlockDevice* dev, uint8_t op, uint64_t sector, const uint64_t* pages, uint64_t count) {
+    uint64_t per_bio = STORE_BIO_PAGES;
+    if (per_bio > dev->max_segments) per_bio = dev->max_segments;
+    if (per_bio > dev->max_sectors / SECTORS_PER_PAGE) per_bio = dev->max_sectors / SECTORS_PER_PAGE;
+
+    Bio* bios = (Bio*)malloc(STORE_BATCH * sizeof(Bio));
+    BlockSegment* segs = (BlockSegment*)malloc(STORE_BATCH * STORE_BIO_PAGES * sizeof(BlockSegment));
+    bool ok = bios && segs;
+
+    uint64_t done = 0;
+    while (ok && done < count) {
+        BlockPlug plug;
+        block_plug(&plug);
+
+        uint32_t n = 0;
+        for (; n < STORE_BATCH && done < count; n++) {
+            uint64_t chunk = (count - done < per_bio) ? count - done : per_bio;
+            BlockSegment* seg = &segs[n * STORE_BIO_PAGES];
+            for (uint64_t i = 0; i < chunk; i++) {
+                seg[i].phys = pages[done + i];
+                seg[i].len = PAGE_SIZE;
+            }
+
+            Bio* bio = &bios[n];
+            bio->op = op;
+            bio->sector = sector + done * SECTORS_PER_PAGE;
+            bio->sectors = chunk * SECTORS_PER_PAGE;
+            bio->segs = seg;
+            bio->seg_count = chunk;
+            block_submit(dev, bio, &plug);
+            done += chunk;
+        }
+
+        block_unplug(dev, &plug);
+        for (uint32_t i = 0; i < n; i++) {
+            if (block_wait(dev, &bios[i]) != 0) ok = false;
+        }
+    }
+
+    if (bios) free(bios);
+    if (segs) free(segs);
+    return ok;
+}
+
+static bool store_super_valid(BlockDevice* dev, const UniFSStoreSuper* super) {
+    if (kstring::memcmp(super->magic, UNIFS_STORE_MAGIC, 8) != 0) return false;
+    if (crc32c(super, offsetof(UniFSStoreSuper, crc)) != super->crc) return false;
+
+    uint64_t area = store_area_sectors(dev);
+    return (super->image_sector == STORE_AREA_START ||
+            super->image_sector == STORE_AREA_START + area) &&
+           super->image_size >= sizeof(UniFSHeaderV2) &&
+           super->image_size <= area * BLOCK_SECTOR_SIZE;
+}
+
+static bool page_is_zero(const uint8_t* page) {
+    for (uint64_t i = 0; i < PAGE_SIZE; i++) {
+        if (page[i]) return false;
+    }
+    return true;
+}
+
+// Scratch frames for metadata; false (with none left allocated) on OOM
+static bool frames_alloc(uint64_t* frames, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        frames[i] = (uint64_t)pmm_alloc_frame();
+        if (!frames[i]) {
+            while (i--) pmm_free_frame((void*)frames[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void frames_free(const uint64_t* frames, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) pmm_free_frame((void*)frames[i]);
+}
+
+// CRC32C of a RAM file's bytes, holes as zeros
+static uint32_t ram_crc(RAMFile* file) {
+    uint32_t crc = CRC32C_INIT;
+    for (uint64_t pos = 0; pos < file->size; pos += PAGE_SIZE) {
+        uint64_t chunk = (file->size - pos < PAGE_SIZE) ? file->size - pos : PAGE_SIZE;
+        uint64_t page = ram_page(file, pos / PAGE_SIZE);
+        crc = crc32c_update(crc, page ? (const uint8_t*)ram_frame(page) : zero_page, chunk);
+    }
+    return crc32c_final(crc);
+}
+
+struct StoreItem {
+    UnifsNode* node;
+    UniFSEntryV2 entry;
+};
+
+// Record every directory and RAM file below dir in items (or just count
+// them if items is nullptr). path holds dir's path, len bytes ("" for the
+// root). Paths too long for a v2 entry are counted in *skipped.
+// (fs_lock held)
+static uint64_t store_collect(UnifsNode* dir, char* path, size_t len,
+                              StoreItem* items, uint64_t n, uint64_t* skipped) {
+    for (UnifsNode* node = dir->first_child; node; node = node->sib_next) {
+        if (node->boot) continue;  // Already in the boot image
+
+        size_t name_len = kstring::strlen(node->name);
+        size_t child_len = len + (len ? 1 : 0) + name_len;
+        if (child_len >= UNIFS_V2_PATH) {
+            (*skipped)++;
+            continue;
+        }
+        if (len) path[len] = '/';
+        kstring::memcpy(path + child_len - name_len, node->name, name_len + 1);
+
+        if (items) {
+            StoreItem* item = &items[n];
+            kstring::memset(&item->entry, 0, sizeof(UniFSEntryV2));
+            kstring::memcpy(item->entry.path, path, child_len + 1);
+            item->entry.type = node->is_dir ? UNIFS_V2_DIR : UNIFS_V2_FILE;
+            item->node = node;
+        }
+        n++;
+
+        if (node->is_dir) n = store_collect(node, path, child_len, items, n, skipped);
+        path[len] = '\0';
+    }
+    return n;
+}
+
+// Heapsort by path: v2 indexes are sorted, so parents precede children
+static void store_sift(StoreItem** order, uint64_t root, uint64_t n) {
+    for (;;) {
+        uint64_t child = 2 * root + 1;
+        if (child >= n) return;
+        if (child + 1 < n && kstring::strcmp(order[child]->entry.path, order[child + 1]->entry.path) < 0) {
+            child++;
+        }
+        if (kstring::strcmp(order[root]->entry.path, order[child]->entry.path) >= 0) return;
+
+        StoreItem* tmp = order[root];
+        order[root] = order[child];
+        order[child] = tmp;
+        root = child;
+    }
+}
+
+static void store_sort(StoreItem** order, uint64_t n) {
+    for (uint64_t i = n / 2; i-- > 0;) store_sift(order, i, n);
+    for (uint64_t end = n; end-- > 1;) {
+        StoreItem* tmp = order[0];
+        order[0] = order[end];
+        order[end] = tmp;
+        store_sift(order, 0, end);
+    }
+}
+
+// Write the image (index pages, then file pages) and repoint the
+// superblock at it (fs_lock held)
+static int store_write(StoreItem** order, uint64_t count, uint64_t meta_pages, uint64_t total_pages) {
+    BlockDevice* dev = store_dev;
+    uint64_t area = store_area_sectors(dev);
+    uint64_t target = STORE_AREA_START;
+    if (store_generation && store_image_sector == STORE_AREA_START) target += area;
+
+    uint64_t* pages = (uint64_t*)malloc(total_pages * sizeof(uint64_t));
+    uint8_t* meta = (uint8_t*)malloc(meta_pages * PAGE_SIZE);
+    uint64_t super_frame = (uint64_t)pmm_alloc_frame();
+    if (!pages || !meta || !super_frame || !frames_alloc(pages, meta_pages)) {
+        if (pages) free(pages);
+        if (meta) free(meta);
+        if (super_frame) pmm_free_frame((void*)super_frame);
+        return UNIFS_ERR_NO_MEMORY;
+    }
+
+    // Index
+    kstring::memset(meta, 0, meta_pages * PAGE_SIZE);
+    UniFSHeaderV2* header = (UniFSHeaderV2*)meta;
+    UniFSEntryV2* entries = (UniFSEntryV2*)(meta + sizeof(UniFSHeaderV2));
+    kstring::memcpy(header->magic, UNIFS_MAGIC_V2, 8);
+    header->entry_count = count;
+    header->image_size = total_pages * PAGE_SIZE;
+    for (uint64_t i = 0; i < count; i++) {
+        kstring::memcpy(&entries[i], &order[i]->entry, sizeof(UniFSEntryV2));
+    }
+    header->index_crc = crc32c(entries, count * sizeof(UniFSEntryV2));
+    header->header_crc = crc32c(header, offsetof(UniFSHeaderV2, header_crc));
+    for (uint64_t i = 0; i < meta_pages; i++) {
+        kstring::memcpy(ram_frame(pages[i]), meta + i * PAGE_SIZE, PAGE_SIZE);
+    }
+
+    // File pages straight from the trees
+    uint64_t zero_phys = vmm_virt_to_phys((uint64_t)zero_page);
+    for (uint64_t i = 0; i < count; i++) {
+        UnifsNode* node = order[i]->node;
+        if (node->is_dir) continue;
+        uint64_t first = order[i]->entry.offset / PAGE_SIZE;
+        uint64_t n = pages_for(node->ram->size);
+        for (uint64_t p = 0; p < n; p++) {
+            uint64_t page = ram_page(node->ram, p);
+            pages[first + p] = page ? page : zero_phys;
+        }
+    }
+
+    bool ok = store_io(dev, BLOCK_WRITE, target, pages, total_pages) && block_flush(dev) == 0;
+
+    if (ok) {
+        UniFSStoreSuper* super = (UniFSStoreSuper*)ram_frame(super_frame);
+        kstring::memset(super, 0, PAGE_SIZE);
+        kstring::memcpy(super->magic, UNIFS_STORE_MAGIC, 8);
+        super->generation = store_generation + 1;
+        super->image_sector = target;
+        super->image_size = total_pages * PAGE_SIZE;
+        super->crc = crc32c(super, offsetof(UniFSStoreSuper, crc));
+        ok = store_io(dev, BLOCK_WRITE, 0, &super_frame, 1) && block_flush(dev) == 0;
+    }
+
+    if (ok) {
+        store_generation++;
+        store_image_sector = target;
+        store_image_size = total_pages * PAGE_SIZE;
+    }
+
+    frames_free(pages, meta_pages);
+    pmm_free_frame((void*)super_frame);
+    free(meta);
+    free(pages);
+    return ok ? UNIFS_OK : UNIFS_ERR_IO;
+}
+
+// (fs_lock held)
+static int sync_locked() {
+    char path[UNIFS_V2_PATH];
+    path[0] = '\0';
+    uint64_t skipped = 0;
+    uint64_t count = store_collect(&root_dir, path, 0, nullptr, 0, &skipped);
+    if (skipped) DEBUG_WARN("uniFS: %lu paths too long to save", skipped);
+
+    StoreItem* items = (StoreItem*)malloc((count ? count : 1) * sizeof(StoreItem));
+    StoreItem** order = (StoreItem**)malloc((count ? count : 1) * sizeof(StoreItem*));
+    if (!items || !order) {
+        if (items) free(items);
+        if (order) free(order);
+        return UNIFS_ERR_NO_MEMORY;
+    }
+    store_collect(&root_dir, path, 0, items, 0, &skipped);
+    for (uint64_t i = 0; i < count; i++) order[i] = &items[i];
+    store_sort(order, count);
+
+    // Lay out: the index, then each file from a page boundary
+    uint64_t meta_pages = pages_for(sizeof(UniFSHeaderV2) + count * sizeof(UniFSEntryV2));
+    uint64_t total_pages = meta_pages;
+    for (uint64_t i = 0; i < count; i++) {
+        UnifsNode* node = order[i]->node;
+        if (node->is_dir) continue;
+        order[i]->entry.offset = total_pages * PAGE_SIZE;
+        order[i]->entry.size = node->ram->size;
+        order[i]->entry.crc = ram_crc(node->ram);
+        total_pages += pages_for(node->ram->size);
+    }
+
+    int result = UNIFS_ERR_NO_SPACE;
+    if (total_pages * SECTORS_PER_PAGE <= store_area_sectors(store_dev)) {
+        result = store_write(order, count, meta_pages, total_pages);
+    }
+
+    free(order);
+    free(items);
+    return result;
+}
+
+int unifs_sync() {
+    mutex_lock(&fs_lock);
+    int result = store_dev ? sync_locked() : UNIFS_ERR_NOT_FOUND;
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+// Read the current image's index into a heap buffer (fs_lock held)
+static uint8_t* store_read_index(uint64_t* out_meta_pages) {
+    uint64_t first = (uint64_t)pmm_alloc_frame();
+    if (!first) return nullptr;
+
+    // The header says how long the index is
+    uint64_t meta_pages = 0;
+    if (store_io(store_dev, BLOCK_READ, store_image_sector, &first, 1)) {
+        const UniFSHeaderV2* header = (const UniFSHeaderV2*)ram_frame(first);
+        if (kstring::memcmp(header->magic, UNIFS_MAGIC_V2, 8) == 0 &&
+            header->entry_count <= (store_image_size - sizeof(UniFSHeaderV2)) / sizeof(UniFSEntryV2)) {
+            meta_pages = pages_for(sizeof(UniFSHeaderV2) + header->entry_count * sizeof(UniFSEntryV2));
+        }
+    }
+    pmm_free_frame((void*)first);
+    if (meta_pages == 0) return nullptr;
+
+    uint8_t* meta = (uint8_t*)malloc(meta_pages * PAGE_SIZE);
+    uint64_t* frames = (uint64_t*)malloc(meta_pages * sizeof(uint64_t));
+    bool ok = meta && frames && frames_alloc(frames, meta_pages);
+    if (ok) {
+        ok = store_io(store_dev, BLOCK_READ, store_image_sector, frames, meta_pages);
+        for (uint64_t i = 0; ok && i < meta_pages; i++) {
+            kstring::memcpy(meta + i * PAGE_SIZE, ram_frame(frames[i]), PAGE_SIZE);
+        }
+        frames_free(frames, meta_pages);
+    }
+    if (frames) free(frames);
+    if (!ok) {
+        if (meta) free(meta);
+        return nullptr;
+    }
+
+    *out_meta_pages = meta_pages;
+    return meta;
+}
+
+// Load the current image: build every file's page tree, read all file
+// pages in one pass, then publish what checks out (fs_lock held)
+static void store_load() {
+    uint64_t meta_pages;
+    uint8_t* meta = store_read_index(&meta_pages);
+    const UniFSHeaderV2* header;
+    const UniFSEntryV2* entries = meta ? v2_index(meta, store_image_size, &header) : nullptr;
+    if (!entries) {
+        DEBUG_ERROR("uniFS: Index on %s is damaged, nothing loaded", store_dev->name);
+        if (meta) free(meta);
+        return;
+    }
+
+    uint64_t data_start = meta_pages * PAGE_SIZE;
+    uint64_t data_pages = pages_for(header->image_size) - meta_pages;
+    uint64_t* pages = (uint64_t*)malloc((data_pages ? data_pages : 1) * sizeof(uint64_t));
+    RAMFile** files = (RAMFile**)malloc((header->entry_count ? header->entry_count : 1) * sizeof(RAMFile*));
+    uint64_t scratch = (uint64_t)pmm_alloc_frame();
+    if (!pages || !files || !scratch) {
+        DEBUG_ERROR("uniFS: Out of memory loading %s", store_dev->name);
+        if (pages) free(pages);
+        if (files) free(files);
+        if (scratch) pmm_free_frame((void*)scratch);
+        free(meta);
+        return;
+    }
+    kstring::memset(files, 0, header->entry_count * sizeof(RAMFile*));
+
+    // Gaps in the layout (there are none in images we wrote) read into scratch
+    for (uint64_t i = 0; i < data_pages; i++) pages[i] = scratch;
+
+    for (uint64_t i = 0; i < header->entry_count; i++) {
+        const UniFSEntryV2* entry = &entries[i];
+        if (entry->type != UNIFS_V2_FILE || entry->path[UNIFS_V2_PATH - 1] != '\0') continue;
+        if (entry->offset % PAGE_SIZE || entry->offset < data_start ||
+            entry->offset > header->image_size || entry->size > header->image_size - entry->offset ||
+            entry->size > UNIFS_MAX_FILE_SIZE) {
+            continue;
+        }
+
+        RAMFile* file = ram_file_alloc();
+        bool ok = file && ram_grow(file, entry->size);
+        uint64_t first = (entry->offset - data_start) / PAGE_SIZE;
+        for (uint64_t p = 0; ok && p < pages_for(entry->size); p++) {
+            uint64_t page = ram_page_get(file, p);
+            if (page) pages[first + p] = page;
+            else ok = false;
+        }
+        if (!ok) {
+            if (file) ram_file_free(file);
+            DEBUG_ERROR("uniFS: Out of memory loading %s", entry->path);
+            break;
+        }
+        file->size = entry->size;
+        files[i] = file;
+    }
+
+    bool read = store_io(store_dev, BLOCK_READ, store_image_sector + data_start / BLOCK_SECTOR_SIZE,
+                         pages, data_pages);
+    if (!read) DEBUG_ERROR("uniFS: Read error on %s, nothing loaded", store_dev->name);
+
+    uint64_t loaded = 0;
+    for (uint64_t i = 0; i < header->entry_count; i++) {
+        const UniFSEntryV2* entry = &entries[i];
+        RAMFile* file = files[i];
+
+        if (read && entry->type == UNIFS_V2_DIR && entry->path[UNIFS_V2_PATH - 1] == '\0') {
+            create_locked(entry->path, true, nullptr);  // May exist (boot directories)
+            continue;
+        }
+        if (!file) continue;
+
+        UnifsNode* node;
+        if (!read) {
+            ram_file_free(file);
+        } else if (ram_crc(file) != entry->crc) {
+            DEBUG_ERROR("uniFS: %s: checksum mismatch, not loaded", entry->path);
+            ram_file_free(file);
+        } else if (create_locked(entry->path, false, &node) != UNIFS_OK) {
+            DEBUG_WARN("uniFS: %s clashes with a boot file, not loaded", entry->path);
+            ram_file_free(file);
+        } else {
+            ram_share_range(file, 0, pages_for(file->size));
+            ram_file_replace(node, file);
+            loaded++;
+        }
+    }
+
+    if (read) {
+        DEBUG_INFO("uniFS: Loaded %lu files from %s (sync %lu)", loaded, store_dev->name, store_generation);
+    }
+    pmm_free_frame((void*)scratch);
+    free(files);
+    free(pages);
+    free(meta);
+}
+
+void unifs_store_init() {
+    uint64_t frame = (uint64_t)pmm_alloc_frame();
+    if (!frame) return;
+    const UniFSStoreSuper* super = (const UniFSStoreSuper*)ram_frame(frame);
+    BlockDevice* blank = nullptr;
+
+    mutex_lock(&fs_lock);
+
+    for (uint32_t i = 0; i < block_get_device_count() && !store_dev; i++) {
+        BlockDevice* dev = block_get_device(i);
+        if (dev->sectors < STORE_MIN_SECTORS || dev->max_sectors < SECTORS_PER_PAGE) continue;
+        if (!store_io(dev, BLOCK_READ, 0, &frame, 1)) continue;
+
+        if (store_super_valid(dev, super)) {
+            store_dev = dev;
+            store_generation = super->generation;
+            store_image_sector = super->image_sector;
+            store_image_size = super->image_size;
+        } else if (page_is_zero((const uint8_t*)super)) {
+            if (!blank) blank = dev;
+        } else {
+            DEBUG_INFO("uniFS: %s holds other data, not using it", dev->name);
+        }
+    }
+
+    if (store_dev) {
+        store_load();
+    } else if (blank) {
+        store_dev = blank;
+        DEBUG_INFO("uniFS: Saving files to %s (empty)", store_dev->name);
+    }
+
+    mutex_unlock(&fs_lock);
+    pmm_free_frame((void*)frame);
+}
+
+bool unifs_get_store_info(UnifsStoreInfo* out) {
+    mutex_lock(&fs_lock);
+    bool found = store_dev != nullptr;
+    if (found) {
+        out->device = store_dev->name;
+        out->generation = store_generation;
+        out->image_size = store_image_size;
+    }
+    mutex_unlock(&fs_lock);
+    return found;
+}
+
+// ============================================================================
+// Stats
+// ============================================================================
+
+uint64_t unifs_get_total_size() {
+    return __atomic_load_n(&boot_bytes, __ATOMIC_RELAXED) +
+           __atomic_load_n(&ram_bytes, __ATOMIC_RELAXED);
+}
+
+uint64_t unifs_get_used_size() {
+    return unifs_get_total_size();  // Same as total for now
+}
+
+uint64_t unifs_get_boot_file_count() {
+    return __atomic_load_n(&boot_file_count, __ATOMIC_RELAXED);
+}
+
+uint64_t unifs_get_ram_file_count() {
+    return __atomic_load_n(&ram_file_count, __ATOMIC_RELAXED);
+}
+
+uint64_t unifs_get_cache_size() {
+    return __atomic_load_n(&cache_pages, __ATOMIC_RELAXED) * PAGE_SIZE;
+}
+
+void unifs_get_share_stats(UnifsShareStats* out) {
+    spinlock_acquire(&share_lock);
+    out->pages = share_pages;
+    out->boot_pages = share_boot_pages;
+    out->refs = share_refs;
+    spinlock_release(&share_lock);
+
+    // Each RAM page in the index holds one frame; every other entry
+    // pointing at it, and every entry pointing into the module, is a
+    // frame saved
+    out->saved = (out->refs - (out->pages - out->boot_pages)) * PAGE_SIZE;
+}
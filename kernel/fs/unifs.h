@@ -3,40 +3,65 @@
 #include <stddef.h>
 
 // ============================================================================
-// uniFS - Simple Flat Filesystem for uniOS
+// uniFS - Simple Filesystem for uniOS
 // ============================================================================
-// Format: Header + Entries[] + Data blob
+// Boot image, version 2 (tools/mkunifs.py):
+// - Header:  magic, entry count, image size, CRC32C of the index and of
+//            the header itself
+// - Entries: 128 bytes each - path, offset, size, CRC32C of the data and
+//            type (file or directory) - sorted by path, so the index can
+//            be binary searched and every directory precedes its contents
+// - Data:    each file starts on a page boundary, so a page of a file is a
+//            page of the image and can be mapped without copying. A file
+//            may instead be stored as LZ4 blocks (UNIFS_V2_LZ4), inflated
+//            into the page cache when first read; its CRC covers the
+//            stored bytes.
+//
+// Version 1 images (no alignment, checksums or directory entries) still
+// mount:
 // - Header: 8-byte magic + 8-byte file count
 // - Entry:  64-byte name + 8-byte offset + 8-byte size
 // - Data:   Raw file contents concatenated
 //
-// Note: Runtime file modifications are stored in RAM only.
-// Changes are lost on reboot (no persistent storage driver yet).
+// Entry names are paths relative to the root ("bin/hello"); mounting builds
+// the directories they imply. Every API below takes a path: components
+// are separated by '/', a leading '/' is optional, "." and ".." work.
+//
+// Runtime files (RAM files) and directories live in memory; unifs_sync()
+// saves them to a disk as a v2 image, loaded back at the next boot (see
+// Persistence).
 // ============================================================================
 
-// uniFS magic signature
-#define UNIFS_MAGIC "UNIFS v1"
+// uniFS magic signatures
+#define UNIFS_MAGIC     "UNIFS v1"
+#define UNIFS_MAGIC_V2  "UNIFS v2"
 
 // File type detection (based on extension/content)
 #define UNIFS_TYPE_UNKNOWN  0
 #define UNIFS_TYPE_TEXT     1
 #define UNIFS_TYPE_BINARY   2
 #define UNIFS_TYPE_ELF      3
+#define UNIFS_TYPE_DIR      4
 
 // Error codes
 #define UNIFS_OK            0
 #define UNIFS_ERR_NOT_FOUND -1
 #define UNIFS_ERR_EXISTS    -2
-#define UNIFS_ERR_FULL      -3
 #define UNIFS_ERR_NO_MEMORY -4
 #define UNIFS_ERR_NAME_TOO_LONG -5
 #define UNIFS_ERR_READONLY  -6
 #define UNIFS_ERR_IN_USE    -7  // File is currently open
+#define UNIFS_ERR_FAULT     -8  // Bad user buffer
+#define UNIFS_ERR_NOT_DIR   -9  // A path component is a file
+#define UNIFS_ERR_IS_DIR    -10 // File operation on a directory
+#define UNIFS_ERR_NOT_EMPTY -11 // rmdir of a directory with entries
+#define UNIFS_ERR_IO        -12 // Disk error
+#define UNIFS_ERR_NO_SPACE  -13 // Image doesn't fit on the disk
 
 // Limits
-#define UNIFS_MAX_FILES     64
-#define UNIFS_MAX_FILENAME  63
-#define UNIFS_MAX_FILE_SIZE (1024 * 1024)  // 1 MB per file
+#define UNIFS_MAX_FILENAME  63             // One path component
+#define UNIFS_MAX_PATH      255
+#define UNIFS_MAX_FILE_SIZE (1ULL << 32)   // 4 GB per file
 
 // On-disk structures
 struct UniFSHeader {
@@ -45,32 +70,91 @@ struct UniFSHeader {
 } __attribute__((packed));
 
 struct UniFSEntry {
-    char name[64];        // Null-terminated filename
+    char name[64];        // Null-terminated path ("dir/file")
     uint64_t offset;      // Offset from start of filesystem
     uint64_t size;        // File size in bytes
 } __attribute__((packed));
 
-// In-memory file handle
+// Version 2
+#define UNIFS_V2_ALIGN       4096  // File data alignment
+#define UNIFS_V2_PATH        104   // Path field, including the terminator
+
+#define UNIFS_V2_FILE        0     // UniFSEntryV2::type
+#define UNIFS_V2_DIR         1
+#define UNIFS_V2_LZ4         0x100 // Flag: file stored as LZ4 blocks
+
+struct UniFSHeaderV2 {
+    char magic[8];        // "UNIFS v2"
+    uint64_t entry_count; // Number of entries (files and directories)
+    uint64_t image_size;  // Bytes, including the padding after the last file
+    uint32_t index_crc;   // CRC32C of the entry array
+    uint32_t header_crc;  // CRC32C of the header before this field
+} __attribute__((packed));
+
+struct UniFSEntryV2 {
+    char path[UNIFS_V2_PATH]; // Null-terminated path, no leading '/'
+    uint64_t offset;      // Page-aligned offset from start of image (files)
+    uint64_t size;        // File size in bytes (0 for directories)
+    uint32_t crc;         // CRC32C of the file data
+    uint32_t type;        // UNIFS_V2_FILE or UNIFS_V2_DIR
+} __attribute__((packed));
+
+
+// Stored form of a UNIFS_V2_LZ4 file (at its offset; size is the inflated
+// size). Each block inflates to block_size bytes, the last to the rest; a
+// block whose stored length equals that is stored raw.
+struct UniFSLz4Header {
+    uint32_t block_size;  // Power of two, 4 KB to 1 MB
+    uint32_t block_count;
+    // uint32_t block_end[block_count]: end of each block, from the first
+    // followed by the blocks
+} __attribute__((packed));
+
+// Disk store: superblock in sector 0, then two image areas of equal size.
+// A sync writes a v2 image of the RAM files and directories to the area
+// the superblock doesn't point at, then repoints the superblock.
+#define UNIFS_STORE_MAGIC   "UNIFSSTO"
+
+struct UniFSStoreSuper {
+    char magic[8];        // "UNIFSSTO"
+    uint64_t generation;  // Syncs so far
+    uint64_t image_sector;// Start of the current image
+    uint64_t image_size;  // Bytes
+    uint32_t reserved;
+    uint32_t crc;         // CRC32C of the superblock before this field
+} __attribute__((packed));
+
+struct RamFlat;
+
+// In-memory file handle (release with unifs_close_into)
 struct UniFSFile {
-    const char* name;
+    char name[UNIFS_MAX_FILENAME + 1];
     uint64_t size;
-    const uint8_t* data;
+    const uint8_t* data;  // RAM file: a private snapshot of the contents
+    bool immutable;       // Boot file: data never changes or moves
+    RamFlat* flat;        // RAM file: the snapshot's reference, else nullptr
 };
 
 // ============================================================================
 // Read API
 // ============================================================================
 
-// Initialize filesystem from memory address (typically from Limine module)
-void unifs_init(void* start_addr);
+// Initialize filesystem from a boot image of `size` bytes (typically a
+// Limine module). v2 images with a bad header or index are not mounted;
+// a file whose data fails its checksum is refused when it is opened.
+void unifs_init(void* start_addr, uint64_t size);
 
 // Check if filesystem is mounted and valid
 bool unifs_is_mounted();
 
 // Thread-safe open: fills caller-provided buffer
-// Returns true if file found, false otherwise
+// Returns true if file found, false otherwise. The data stays valid until
+// unifs_close_into(), however the file changes meanwhile.
 bool unifs_open_into(const char* name, UniFSFile* out_file);
 
+// Release what unifs_open_into() handed out
+void unifs_close_into(UniFSFile* file);
+
 // Check if a file exists
 bool unifs_file_exists(const char* name);
 
@@ -80,17 +164,31 @@ uint64_t unifs_get_file_size(const char* name);
 // Get file type (UNIFS_TYPE_*)
 int unifs_get_file_type(const char* name);
 
-// Get total number of files
+// Whether path names a directory
+bool unifs_is_dir(const char* path);
+
+// Number of entries in the root directory
 uint64_t unifs_get_file_count();
 
-// Get filename by index
+// Name of the root directory's entry at index (in creation order)
 const char* unifs_get_file_name(uint64_t index);
 
-// Get file size by index
+// Size of the root directory's entry at index (0 for a directory)
 uint64_t unifs_get_file_size_by_index(uint64_t index);
 
+// One directory entry, as copied out by unifs_read_dir()
+struct UnifsDirEntry {
+    char name[UNIFS_MAX_FILENAME + 1];
+    uint64_t size;
+    bool is_dir;
+};
+
+// Copy up to max entries of the directory at path, starting at entry
+// `index`. Returns the number copied (0 past the end), or a UNIFS_ERR_*.
+int64_t unifs_read_dir(const char* path, uint64_t index, UnifsDirEntry* out, uint64_t max);
+
 // ============================================================================
-// Write API (RAM-only - changes lost on reboot)
+// Write API (RAM files - kept across reboots by unifs_sync)
 // ============================================================================
 
 // Create a new empty file
@@ -105,13 +203,71 @@ int unifs_write(const char* name, const void* data, uint64_t size);
 // Returns: UNIFS_OK on success, or error code
 int unifs_append(const char* name, const void* data, uint64_t size);
 
-// Delete a file
+// Delete a file (fails with UNIFS_ERR_IN_USE while it is open)
 // Returns: UNIFS_OK on success, or error code
 int unifs_delete(const char* name);
 
+// Create an empty directory / remove one
+// Returns: UNIFS_OK on success, or error code
+int unifs_mkdir(const char* path);
+int unifs_rmdir(const char* path);
+
+// ============================================================================
+// VFS Backend
+// ============================================================================
+
+struct File;
+
+// Open a file as a VFS File (O_* flags from vfs.h). Boot files can only be
+// opened read-only; O_CREAT creates a missing RAM file. Returns nullptr on
+// failure.
+File* unifs_open_file(const char* name, uint32_t flags);
+
+// Check the boot image: header, index order, bounds, alignment and every
+// file checksum. Each problem is passed to report (path may be empty for
+// image-wide problems). Returns the number of problems.
+uint64_t unifs_fsck(void (*report)(const char* path, const char* problem));
+
+// ============================================================================
+// Persistence
+// ============================================================================
+// The store is the first disk holding one, or else the first blank (zeroed)
+// disk. A disk holding anything else is never written.
+
+// Find the store and load the files and directories it holds (after
+// unifs_init, with interrupts enabled). Saved files clashing with boot
+// files are skipped.
+void unifs_store_init();
+
+// Save every RAM file and directory to the store. Writers wait until it is
+// done. Returns UNIFS_OK, UNIFS_ERR_NOT_FOUND (no store), UNIFS_ERR_NO_SPACE,
+// UNIFS_ERR_NO_MEMORY or UNIFS_ERR_IO (the previous image is still intact).
+int unifs_sync();
+
+struct UnifsStoreInfo {
+    const char* device;   // Block device name
+    uint64_t generation;  // Syncs so far (0: never synced)
+    uint64_t image_size;  // Bytes of the current image
+};
+
+// Describe the store. Returns false if there is none.
+bool unifs_get_store_info(UnifsStoreInfo* out);
+
 // Get filesystem stats
 uint64_t unifs_get_total_size();
 uint64_t unifs_get_used_size();
-uint64_t unifs_get_free_slots();
 uint64_t unifs_get_boot_file_count();
+uint64_t unifs_get_ram_file_count();
+uint64_t unifs_get_cache_size();  // Bytes of page cache holding inflated boot files
+
+// RAM file pages identical to another RAM or boot file page are stored
+// once, shared copy-on-write
+struct UnifsShareStats {
+    uint64_t pages;       // Distinct pages in the share index
+    uint64_t boot_pages;  // ... of which in the boot image
+    uint64_t refs;        // RAM file pages pointing at them
+    uint64_t saved;       // Bytes of RAM this saves
+};
+
+void unifs_get_share_stats(UnifsShareStats* out);
 
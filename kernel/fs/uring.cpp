@@ -0,0 +1,416 @@
+#include "uring.h"
+#include "vfs.h"
+#include "process.h"
+#include "mutex.h"
+#include "spinlock.h"
+#include "heap.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "kstring.h"
+#include "uaccess.h"
+#include "poll.h"
+
+// Region layout: header, then the SQE array, then the CQE array
+#define SQES_OFFSET 64
+
+// An operation taken off the SQ but not yet completed
+struct UringOp {
+    UringSqe sqe;         // Private copy - the program may reuse the slot
+    File* file;           // Reference held while in flight (nullptr: fails)
+};
+
+struct Uring {
+    Mutex lock;           // Serializes enter() calls on this ring
+    uint64_t* pml4;       // Address space the region is mapped into
+    uint64_t user_base;   // Where it is mapped
+    uint64_t phys;        // Contiguous backing pages
+    uint32_t pages;
+
+    // Kernel (HHDM) view of the shared region
+    UringRings* rings;
+    UringSqe* sqes;
+    UringCqe* cqes;
+
+    // Ring geometry, fixed at setup. The copies in the shared header are
+    // for the program only: it can rewrite them, so they are never read.
+    uint32_t sq_entries;
+    uint32_t sq_mask;
+    uint32_t cq_entries;
+    uint32_t cq_mask;
+
+    // Kernel-private copies of the indices the kernel owns; the shared
+    // ones are only ever written from these, never read back
+    uint32_t sq_head;
+    uint32_t cq_tail;
+
+    UringOp* inflight;    // FIFO, at most sq_entries
+    uint32_t inflight_count;
+
+    PollQueue poll;       // Notified when completions are posted
+};
+
+static Spinlock map_lock = SPINLOCK_INIT;  // Serializes slot selection
+
+static void uring_release(File* f);
+
+// The page table the calling task runs on
+static uint64_t* current_pml4() {
+    Process* p = process_get_current();
+    return (p && p->page_table) ? p->page_table : vmm_get_kernel_pml4();
+}
+
+// ============================================================================
+// Queues
+// ============================================================================
+
+// Completions the program has not consumed yet. False if it corrupted
+// cq_head.
+static bool cq_pending(Uring* r, uint32_t* pending) {
+    uint32_t head = __atomic_load_n(&r->rings->cq_head, __ATOMIC_ACQUIRE);
+    *pending = r->cq_tail - head;
+    return *pending <= r->cq_entries;
+}
+
+static void post_cqe(Uring* r, uint64_t user_data, int32_t res) {
+    UringCqe* cqe = &r->cqes[r->cq_tail & r->cq_mask];
+    cqe->user_data = user_data;
+    cqe->res = res;
+    cqe->flags = 0;
+    r->cq_tail++;
+    __atomic_store_n(&r->rings->cq_tail, r->cq_tail, __ATOMIC_RELEASE);
+    poll_notify(&r->poll, POLLIN);
+}
+
+// Streams (pipes, sockets, the console) have no seek; on them an operation
+// only runs once poll() says it won't block
+static bool stream_ready(File* f, uint32_t want) {
+    if (f->ops->seek) return true;
+    return vfs_poll(f) & (want | POLLHUP | POLLERR);
+}
+
+// Run one operation. Returns false (leaving it in flight) if it would block.
+static bool try_op(UringOp* op, int32_t* res) {
+    const UringSqe* sqe = &op->sqe;
+    File* f = op->file;
+    void* buf = (void*)sqe->addr;
+    int64_t n;
+
+    if (sqe->opcode == URING_OP_NOP) {
+        *res = 0;
+        return true;
+    }
+    if (!f) {
+        *res = -1;
+        return true;
+    }
+
+    switch (sqe->opcode) {
+        case URING_OP_READ:
+        case URING_OP_RECV:
+            if (!stream_ready(f, POLLIN)) return false;
+            if (sqe->opcode == URING_OP_READ && sqe->off != URING_OFF_CURRENT) {
+                n = vfs_pread(f, buf, sqe->len, sqe->off);
+            } else {
+                n = vfs_read_nowait(f, buf, sqe->len);
+            }
+            break;
+        case URING_OP_WRITE:
+        case URING_OP_SEND:
+            if (!stream_ready(f, POLLOUT)) return false;
+            if (sqe->opcode == URING_OP_WRITE && sqe->off != URING_OFF_CURRENT) {
+                n = vfs_pwrite(f, buf, sqe->len, sqe->off);
+            } else {
+                n = vfs_write_nowait(f, buf, sqe->len);
+            }
+            break;
+        default:
+            n = -1;
+            break;
+    }
+
+    *res = n < 0 ? -1 : (int32_t)n;
+    return true;
+}
+
+// Complete whatever in-flight operations can run now. An operation never
+// overtakes an earlier one on the same file, so a stream sees them in
+// submission order.
+static bool run_inflight(Uring* r) {
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < r->inflight_count; i++) {
+        UringOp op = r->inflight[i];
+
+        bool blocked = false;
+        for (uint32_t j = 0; j < kept; j++) {
+            if (r->inflight[j].file == op.file) {
+                blocked = true;
+                break;
+            }
+        }
+
+        uint32_t pending;
+        if (!cq_pending(r, &pending)) return false;
+
+        int32_t res;
+        if (!blocked && pending < r->cq_entries && try_op(&op, &res)) {
+            post_cqe(r, op.sqe.user_data, res);
+            if (op.file) file_put(op.file);
+            continue;
+        }
+        r->inflight[kept++] = op;
+    }
+
+    r->inflight_count = kept;
+    return true;
+}
+
+// Sleep until an in-flight operation's file or the ring itself changes,
+// then complete what can run. The lock is dropped while asleep, so each
+// hooked file is pinned by a reference of its own in case another
+// enter() completes its operation meanwhile. False if the program
+// corrupted the ring or memory ran out. (r->lock held)
+static bool wait_inflight(Uring* r) {
+    uint32_t count = r->inflight_count;
+    PollHook* hooks = (PollHook*)malloc((count + 1) * sizeof(PollHook));
+    File** files = (File**)malloc(count * sizeof(File*));
+    if (!hooks || !files) {
+        free(hooks);
+        free(files);
+        return false;
+    }
+
+    // Other threads' completions show up on the ring's own queue
+    PollWaiter waiter;
+    poll_waiter_init(&waiter);
+    poll_waiter_attach(&waiter, &hooks[count], &r->poll, POLLIN);
+    for (uint32_t i = 0; i < count; i++) {
+        const UringOp* op = &r->inflight[i];
+        uint32_t want = (op->sqe.opcode == URING_OP_READ || op->sqe.opcode == URING_OP_RECV)
+                        ? POLLIN : POLLOUT;
+        files[i] = op->file ? file_get(op->file) : nullptr;
+        poll_waiter_attach(&waiter, &hooks[i], files[i] ? vfs_poll_queue(files[i]) : nullptr, want);
+    }
+
+    // Hooked before this last look, so a change from here on wakes us
+    bool ok = run_inflight(r);
+    if (ok && r->inflight_count == count) {
+        mutex_unlock(&r->lock);
+        poll_waiter_sleep(&waiter, WAIT_FOREVER);
+        mutex_lock(&r->lock);
+        ok = run_inflight(r);
+    }
+
+    for (uint32_t i = 0; i <= count; i++) poll_hook_remove(&hooks[i]);
+    for (uint32_t i = 0; i < count; i++) {
+        if (files[i]) file_put(files[i]);
+    }
+    free(hooks);
+    free(files);
+    return ok;
+}
+
+// Move up to max SQEs into the in-flight list. Returns the number taken,
+// or -1 if the program corrupted sq_tail.
+static int64_t take_sqes(Uring* r, uint32_t max) {
+    FdTable* fds = fd_table_current();
+    uint32_t entries = r->sq_entries;
+    int64_t taken = 0;
+
+    while ((uint32_t)taken < max && r->inflight_count < entries) {
+        uint32_t tail = __atomic_load_n(&r->rings->sq_tail, __ATOMIC_ACQUIRE);
+        if (tail == r->sq_head) break;
+        if (tail - r->sq_head > entries) return -1;
+
+        UringOp* op = &r->inflight[r->inflight_count++];
+        op->sqe = r->sqes[r->sq_head & r->sq_mask];
+        op->file = nullptr;
+        r->sq_head++;
+        __atomic_store_n(&r->rings->sq_head, r->sq_head, __ATOMIC_RELEASE);
+        taken++;
+
+        // Malformed entries keep file == nullptr and complete with -1
+        const UringSqe* sqe = &op->sqe;
+        if (sqe->opcode == URING_OP_NOP || sqe->opcode > URING_OP_SEND) continue;
+        if (sqe->flags != 0 || !user_range_ok((const void*)sqe->addr, sqe->len)) continue;
+
+        File* f = fds ? fd_get(fds, sqe->fd) : nullptr;
+        if (f && f->ops->release == uring_release) {
+            // A ring waiting on itself would never be released
+            file_put(f);
+            f = nullptr;
+        }
+        op->file = f;
+    }
+    return taken;
+}
+
+// ============================================================================
+// File Backend
+// ============================================================================
+
+static uint32_t uring_poll(File* f) {
+    Uring* r = (Uring*)f->priv;
+    uint32_t pending;
+    if (!cq_pending(r, &pending)) return POLLERR;
+    return pending ? POLLIN : 0;
+}
+
+// Drop everything in flight, unmap the region and free the ring
+static void destroy_ring(Uring* r) {
+    for (uint32_t i = 0; i < r->inflight_count; i++) {
+        if (r->inflight[i].file) file_put(r->inflight[i].file);
+    }
+
+    // Normally the owner closes the ring (or exits) while its address space
+    // is active. If a forked child drops the last reference instead, the
+    // pages stay mapped in the owner's space and are freed along with it.
+    if (current_pml4() == r->pml4) {
+        for (uint32_t i = 0; i < r->pages; i++) {
+            uint64_t phys = vmm_unmap_page_in(r->pml4, r->user_base + i * 4096);
+            if (phys) pmm_free_frame((void*)phys);
+        }
+    }
+
+    free(r->inflight);
+    free(r);
+}
+
+static PollQueue* uring_poll_queue(File* f) {
+    return &((Uring*)f->priv)->poll;
+}
+
+static void uring_release(File* f) {
+    destroy_ring((Uring*)f->priv);
+}
+
+static const FileOps uring_ops = {
+    nullptr,        // No read/write: the ring itself is the interface
+    nullptr,
+    nullptr,
+    nullptr,
+    uring_poll,
+    uring_poll_queue,
+    uring_release,
+};
+
+// Map the region at the first free slot of the address space
+static bool map_region(Uring* r) {
+    spinlock_acquire(&map_lock);
+
+    uint64_t base = 0;
+    for (uint64_t slot = 0; slot < URING_MAP_SLOTS; slot++) {
+        uint64_t candidate = URING_MAP_BASE + slot * URING_MAP_STRIDE;
+        if (!vmm_virt_to_phys_in(r->pml4, candidate)) {
+            base = candidate;
+            break;
+        }
+    }
+
+    if (base) {
+        for (uint32_t i = 0; i < r->pages; i++) {
+            vmm_map_page_in(r->pml4, base + i * 4096, r->phys + i * 4096,
+                            PTE_PRESENT | PTE_WRITABLE | PTE_USER);
+        }
+    }
+
+    spinlock_release(&map_lock);
+    r->user_base = base;
+    return base != 0;
+}
+
+File* uring_open_file(uint32_t entries, UringParams* params) {
+    if (entries == 0 || entries > URING_MAX_ENTRIES) return nullptr;
+
+    uint32_t sq_entries = 1;
+    while (sq_entries < entries) sq_entries <<= 1;
+    uint32_t cq_entries = sq_entries * 2;
+
+    uint64_t cqes_offset = (SQES_OFFSET + sq_entries * sizeof(UringSqe) + 15) & ~15ULL;
+    uint64_t size = cqes_offset + cq_entries * sizeof(UringCqe);
+
+    Uring* r = (Uring*)malloc(sizeof(Uring));
+    if (!r) return nullptr;
+    r->inflight = (UringOp*)malloc(sq_entries * sizeof(UringOp));
+    if (!r->inflight) {
+        free(r);
+        return nullptr;
+    }
+
+    mutex_init(&r->lock);
+    poll_queue_init(&r->poll);
+    r->pml4 = current_pml4();
+    r->pages = (uint32_t)((size + 4095) / 4096);
+    r->phys = (uint64_t)pmm_alloc_frames(r->pages);
+    if (!r->phys) {
+        free(r->inflight);
+        free(r);
+        return nullptr;
+    }
+
+    uint8_t* region = (uint8_t*)(r->phys + vmm_get_hhdm_offset());
+    kstring::memset(region, 0, r->pages * 4096);
+
+    r->rings = (UringRings*)region;
+    r->sqes = (UringSqe*)(region + SQES_OFFSET);
+    r->cqes = (UringCqe*)(region + cqes_offset);
+    r->sq_entries = sq_entries;
+    r->sq_mask = sq_entries - 1;
+    r->cq_entries = cq_entries;
+    r->cq_mask = cq_entries - 1;
+    r->rings->sq_mask = r->sq_mask;
+    r->rings->sq_entries = r->sq_entries;
+    r->rings->cq_mask = r->cq_mask;
+    r->rings->cq_entries = r->cq_entries;
+    r->sq_head = 0;
+    r->cq_tail = 0;
+    r->inflight_count = 0;
+
+    if (!map_region(r)) {
+        for (uint32_t i = 0; i < r->pages; i++) pmm_free_frame((void*)(r->phys + i * 4096));
+        free(r->inflight);
+        free(r);
+        return nullptr;
+    }
+
+    File* f = file_alloc(&uring_ops, r, O_RDWR);
+    if (!f) {
+        destroy_ring(r);
+        return nullptr;
+    }
+
+    params->sq_entries = sq_entries;
+    params->cq_entries = cq_entries;
+    params->rings = r->user_base;
+    params->sqes = r->user_base + SQES_OFFSET;
+    params->cqes = r->user_base + cqes_offset;
+    return f;
+}
+
+int64_t uring_enter(File* f, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    if (f->ops->release != uring_release) return -1;
+
+    Uring* r = (Uring*)f->priv;
+
+    // User buffers are only reachable from the ring's own address space
+    if (current_pml4() != r->pml4) return -1;
+
+    mutex_lock(&r->lock);
+
+    int64_t submitted = take_sqes(r, to_submit);
+    bool ok = submitted >= 0 && run_inflight(r);
+
+    if (ok && (flags & URING_ENTER_GETEVENTS)) {
+        if (min_complete > r->cq_entries) min_complete = r->cq_entries;
+
+        // Operations in flight are waiting on pipe or socket readiness
+        uint32_t pending;
+        while ((ok = cq_pending(r, &pending)) && pending < min_complete && r->inflight_count) {
+            ok = wait_inflight(r);
+            if (!ok) break;
+        }
+    }
+
+    mutex_unlock(&r->lock);
+    return ok ? submitted : -1;
+}
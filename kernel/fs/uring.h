@@ -0,0 +1,104 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================================
+// uring - Asynchronous Submission/Completion Rings (io_uring-style)
+// ============================================================================
+// A ring is a region of memory shared between a process and the kernel,
+// holding a submission queue (SQ) of requests and a completion queue (CQ)
+// of results. The program fills SQEs and advances sq_tail; one
+// io_uring_enter() call then lets the kernel drain the whole batch and,
+// optionally, wait until enough completions have been posted. Results are
+// read straight out of the CQ, with no syscall per operation.
+//
+// Both queues are single-producer/single-consumer with free-running 32-bit
+// head/tail counters (index = counter & mask):
+//   SQ: user produces (sq_tail), kernel consumes (sq_head)
+//   CQ: kernel produces (cq_tail), user consumes (cq_head)
+// A producer writes the entry, then publishes it with a release store of
+// its tail; a consumer reads the tail with an acquire load.
+//
+// Differences from Linux io_uring: SQEs are indexed directly (there is no
+// SQ index array), the region is mapped by io_uring_setup() itself (there
+// is no mmap()), and operations that would block - reads on an empty pipe
+// or socket, writes to a full one - stay in flight inside the kernel and
+// are retried by io_uring_enter() rather than completed by interrupt; a
+// waiting enter sleeps until one of their files becomes ready.
+// The ring belongs to the address space that created it; a forked child
+// gets a private copy of the pages and cannot drive the parent's ring.
+// ============================================================================
+
+#define URING_MAX_ENTRIES  256      // SQ size limit (CQ is twice the SQ)
+
+// Where rings are mapped in user space: slot n at BASE + n * STRIDE
+#define URING_MAP_BASE     0x0000600000000000ULL
+#define URING_MAP_STRIDE   0x10000ULL
+#define URING_MAP_SLOTS    64
+
+// Opcodes
+#define URING_OP_NOP    0
+#define URING_OP_READ   1    // read/pread into addr[len] at off
+#define URING_OP_WRITE  2    // write/pwrite from addr[len] at off
+#define URING_OP_RECV   3    // Receive from a socket or pipe
+#define URING_OP_SEND   4    // Send on a socket or pipe
+
+#define URING_OFF_CURRENT  ((uint64_t)-1)   // READ/WRITE at the file position
+
+// io_uring_enter flags
+#define URING_ENTER_GETEVENTS  0x1   // Wait for min_complete completions
+
+// Submission queue entry (written by the program)
+struct UringSqe {
+    uint8_t opcode;
+    uint8_t flags;        // Reserved, must be 0
+    uint16_t reserved;
+    int32_t fd;
+    uint64_t off;         // File offset, or URING_OFF_CURRENT
+    uint64_t addr;        // User buffer
+    uint32_t len;         // Buffer length
+    uint32_t reserved2;
+    uint64_t user_data;   // Copied to the completion untouched
+};
+
+// Completion queue entry (written by the kernel)
+struct UringCqe {
+    uint64_t user_data;
+    int32_t res;          // Bytes transferred, or -1
+    uint32_t flags;
+};
+
+// Ring header at the start of the shared region. The masks and sizes are
+// published for the program; the kernel keeps its own copies.
+struct UringRings {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t cq_mask;
+    uint32_t cq_entries;
+    uint32_t reserved[8];
+};
+
+// Filled in by io_uring_setup(): user addresses of the three arrays
+struct UringParams {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint64_t rings;       // UringRings*
+    uint64_t sqes;        // UringSqe[sq_entries]
+    uint64_t cqes;        // UringCqe[cq_entries]
+};
+
+struct File;
+
+// Create a ring of at least `entries` SQEs (rounded up to a power of two)
+// and map it into the calling task's address space. Returns nullptr on
+// failure; params receives the layout.
+File* uring_open_file(uint32_t entries, UringParams* params);
+
+// Submit up to to_submit SQEs, retry operations still in flight and, with
+// URING_ENTER_GETEVENTS, sleep until min_complete CQEs are waiting. Returns
+// the number of SQEs consumed, or -1 if f is not a ring of this address
+// space or the ring is corrupt.
+int64_t uring_enter(File* f, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
@@ -0,0 +1,327 @@
+#include "vfs.h"
+#include "epoll.h"
+#include "unifs.h"
+#include "shm.h"
+#include "process.h"
+#include "heap.h"
+#include "graphics.h"
+#include "uaccess.h"
+#include "kstring.h"
+
+// ============================================================================
+// File Objects
+// ============================================================================
+
+File* file_alloc(const FileOps* ops, void* priv, uint32_t flags) {
+    File* f = (File*)malloc(sizeof(File));
+    if (!f) return nullptr;
+
+    f->ops = ops;
+    f->refcount = 1;
+    f->flags = flags;
+    f->pos = 0;
+    f->priv = priv;
+    f->epoll_items = nullptr;
+    return f;
+}
+
+File* file_get(File* f) {
+    __atomic_fetch_add(&f->refcount, 1, __ATOMIC_RELAXED);
+    return f;
+}
+
+void file_put(File* f) {
+    if (__atomic_sub_fetch(&f->refcount, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    // Unhook watches before release frees the PollQueue they sit in
+    if (__atomic_load_n(&f->epoll_items, __ATOMIC_ACQUIRE)) epoll_file_release(f);
+    if (f->ops->release) f->ops->release(f);
+    free(f);
+}
+
+static bool can_read(File* f) {
+    return (f->flags & O_ACCMODE) != O_WRONLY && f->ops->read;
+}
+
+static bool can_write(File* f) {
+    return (f->flags & O_ACCMODE) != O_RDONLY && f->ops->write;
+}
+
+// O_NONBLOCK on the File makes every call IO_NOWAIT
+static uint32_t io_flags(File* f) {
+    return (f->flags & O_NONBLOCK) ? IO_NOWAIT : 0;
+}
+
+int64_t vfs_read(File* f, void* buf, uint64_t count) {
+    if (!can_read(f)) return -1;
+    return f->ops->read(f, buf, count, &f->pos, io_flags(f));
+}
+
+int64_t vfs_write(File* f, const void* buf, uint64_t count) {
+    if (!can_write(f)) return -1;
+    return f->ops->write(f, buf, count, &f->pos, io_flags(f));
+}
+
+int64_t vfs_read_nowait(File* f, void* buf, uint64_t count) {
+    if (!can_read(f)) return -1;
+    return f->ops->read(f, buf, count, &f->pos, IO_NOWAIT);
+}
+
+int64_t vfs_write_nowait(File* f, const void* buf, uint64_t count) {
+    if (!can_write(f)) return -1;
+    return f->ops->write(f, buf, count, &f->pos, IO_NOWAIT);
+}
+
+// Positional I/O only makes sense where seeking does
+int64_t vfs_pread(File* f, void* buf, uint64_t count, uint64_t offset) {
+    if (!can_read(f) || !f->ops->seek) return -1;
+    return f->ops->read(f, buf, count, &offset, io_flags(f));
+}
+
+int64_t vfs_pwrite(File* f, const void* buf, uint64_t count, uint64_t offset) {
+    if (!can_write(f) || !f->ops->seek) return -1;
+    return f->ops->write(f, buf, count, &offset, io_flags(f));
+}
+
+int64_t vfs_readv(File* f, const IoVec* iov, int iovcnt) {
+    if (!can_read(f)) return -1;
+    
+    // Only the first buffer may wait for data; the rest take what is there
+    uint32_t flags = io_flags(f);
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0) continue;
+        int64_t n = f->ops->read(f, iov[i].base, iov[i].len, &f->pos, total ? IO_NOWAIT : flags);
+        if (n < 0) return total ? total : n;
+        total += n;
+        if ((uint64_t)n < iov[i].len) break;  // Short read: nothing more now
+    }
+    return total;
+}
+
+int64_t vfs_writev(File* f, const IoVec* iov, int iovcnt) {
+    if (!can_write(f)) return -1;
+    
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0) continue;
+        int64_t n = f->ops->write(f, iov[i].base, iov[i].len, &f->pos, io_flags(f));
+        if (n < 0) return total ? total : n;
+        total += n;
+        if ((uint64_t)n < iov[i].len) break;  // Short write: target is full
+    }
+    return total;
+}
+
+int64_t vfs_seek(File* f, int64_t offset, int whence) {
+    if (!f->ops->seek) return -1;
+    return f->ops->seek(f, offset, whence);
+}
+
+const void* vfs_mmap(File* f, uint64_t offset, uint64_t length) {
+    if (!f->ops->mmap) return nullptr;
+    return f->ops->mmap(f, offset, length);
+}
+
+uint32_t vfs_poll(File* f) {
+    // Backends without poll never block
+    if (!f->ops->poll) return POLLIN | POLLOUT;
+    return f->ops->poll(f);
+}
+
+PollQueue* vfs_poll_queue(File* f) {
+    if (!f->ops->poll_queue) return nullptr;
+    return f->ops->poll_queue(f);
+}
+
+int64_t vfs_seek_in(File* f, int64_t offset, int whence, uint64_t size) {
+    int64_t base;
+    switch (whence) {
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = (int64_t)f->pos; break;
+        case SEEK_END: base = (int64_t)size; break;
+        default: return -1;
+    }
+
+    int64_t pos = base + offset;
+    if (pos < 0) return -1;
+    f->pos = (uint64_t)pos;
+    return pos;
+}
+
+// Paths under SHM_PATH_PREFIX name shared memory objects, the rest uniFS
+// files
+static const char* shm_name(const char* path) {
+    uint64_t n = kstring::strlen(SHM_PATH_PREFIX);
+    return kstring::strncmp(path, SHM_PATH_PREFIX, n) == 0 ? path + n : nullptr;
+}
+
+File* vfs_open(const char* path, uint32_t flags) {
+    const char* shm = shm_name(path);
+    if (shm) return shm_open_file(shm, flags);
+    return unifs_open_file(path, flags);
+}
+
+int vfs_unlink(const char* path) {
+    const char* shm = shm_name(path);
+    if (shm) return shm_unlink(shm);
+    return unifs_delete(path) == UNIFS_OK ? 0 : -1;
+}
+
+// ============================================================================
+// Console Backend
+// ============================================================================
+// Output is drawn straight onto the framebuffer below the shell, as the
+// original write syscall did.
+
+static uint64_t console_x = 50;
+static uint64_t console_y = 480;
+
+static int64_t console_read(File*, void*, uint64_t, uint64_t*, uint32_t) {
+    // TODO: Read from keyboard
+    return 0;
+}
+
+static int64_t console_write(File*, const void* buf, uint64_t count, uint64_t*, uint32_t) {
+    const char* src = (const char*)buf;
+    char chunk[128];
+    
+    for (uint64_t done = 0; done < count; ) {
+        uint64_t n = count - done;
+        if (n > sizeof(chunk)) n = sizeof(chunk);
+        if (copy_from_user(chunk, src + done, n) < 0) return done ? (int64_t)done : -EFAULT;
+        
+        for (uint64_t i = 0; i < n; i++) {
+            if (chunk[i] == '\0') return count;  // Text ends at a NUL
+            if (chunk[i] == '\n') {
+                console_x = 50;
+                console_y += 10;
+            } else {
+                gfx_draw_char(console_x, console_y, chunk[i], COLOR_GREEN);
+                console_x += 9;
+            }
+        }
+        done += n;
+    }
+    return count;
+}
+
+static uint32_t console_poll(File*) {
+    return POLLOUT;  // Never any input yet
+}
+
+static const FileOps console_ops = {
+    console_read,
+    console_write,
+    nullptr,        // Not seekable
+    nullptr,
+    console_poll,
+    nullptr,        // Always writable, never readable: nothing to wait for
+    nullptr,        // Nothing to free
+};
+
+File* console_open_file() {
+    return file_alloc(&console_ops, nullptr, O_RDWR);
+}
+
+// ============================================================================
+// Descriptor Tables
+// ============================================================================
+
+static FdTable* fd_table_alloc() {
+    FdTable* table = (FdTable*)malloc(sizeof(FdTable));
+    if (!table) return nullptr;
+
+    table->refcount = 1;
+    spinlock_init(&table->lock);
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        table->files[i] = nullptr;
+    }
+    return table;
+}
+
+FdTable* fd_table_create() {
+    FdTable* table = fd_table_alloc();
+    if (!table) return nullptr;
+
+    File* console = console_open_file();
+    if (!console) {
+        free(table);
+        return nullptr;
+    }
+
+    // One console File behind stdin, stdout and stderr
+    table->files[STDIN_FD] = console;
+    table->files[STDOUT_FD] = file_get(console);
+    table->files[STDERR_FD] = file_get(console);
+    return table;
+}
+
+FdTable* fd_table_clone(FdTable* table) {
+    FdTable* copy = fd_table_alloc();
+    if (!copy) return nullptr;
+
+    spinlock_acquire(&table->lock);
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        if (table->files[i]) copy->files[i] = file_get(table->files[i]);
+    }
+    spinlock_release(&table->lock);
+    return copy;
+}
+
+void fd_table_get(FdTable* table) {
+    __atomic_fetch_add(&table->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void fd_table_put(FdTable* table) {
+    if (__atomic_sub_fetch(&table->refcount, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    // Last user: nobody else can reach the table any more
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        if (table->files[i]) file_put(table->files[i]);
+    }
+    free(table);
+}
+
+FdTable* fd_table_current() {
+    Process* p = process_get_current();
+    if (!p) return nullptr;
+    if (!p->files) p->files = fd_table_create();
+    return p->files;
+}
+
+int fd_install(FdTable* table, File* f) {
+    spinlock_acquire(&table->lock);
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        if (!table->files[i]) {
+            table->files[i] = f;
+            spinlock_release(&table->lock);
+            return i;
+        }
+    }
+    spinlock_release(&table->lock);
+    return -1;
+}
+
+File* fd_get(FdTable* table, int fd) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES) return nullptr;
+
+    spinlock_acquire(&table->lock);
+    File* f = table->files[fd];
+    if (f) file_get(f);
+    spinlock_release(&table->lock);
+    return f;
+}
+
+int fd_close(FdTable* table, int fd) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES) return -1;
+
+    spinlock_acquire(&table->lock);
+    File* f = table->files[fd];
+    table->files[fd] = nullptr;
+    spinlock_release(&table->lock);
+
+    if (!f) return -1;
+    file_put(f);  // May sleep, so outside the lock
+    return 0;
+}
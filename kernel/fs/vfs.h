@@ -0,0 +1,182 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "spinlock.h"
+
+// ============================================================================
+// VFS - Generic File Objects and Per-Process Descriptor Tables
+// ============================================================================
+// Every open file, pipe end, socket or the console is a File: a refcounted
+// object with a position and a FileOps vtable supplied by its backend.
+// Descriptors are slots in an FdTable that point at Files. fork() copies
+// the table (both tables share the same Files, and thus their positions),
+// clone() shares the table itself. A File is released through its ops when
+// the last descriptor referring to it is closed.
+//
+// Backends:
+//   unifs   - unifs_open_file()   (unifs.cpp)
+//   pipes   - pipe_open_files()   (pipe.cpp)
+//   sockets - socket_open_file()  (socket.cpp)
+//   console - console_open_file() (vfs.cpp)
+//   rings   - uring_open_file()   (uring.cpp)
+//   epoll   - epoll_open_file()   (epoll.cpp)
+//   shm     - shm_open_file()     (shm.cpp)
+// ============================================================================
+
+#define MAX_OPEN_FILES 16
+
+// Standard descriptors
+#define STDIN_FD   0
+#define STDOUT_FD  1
+#define STDERR_FD  2
+
+// Open flags (Linux values)
+#define O_RDONLY   0x000
+#define O_WRONLY   0x001
+#define O_RDWR     0x002
+#define O_ACCMODE  0x003
+#define O_CREAT    0x040
+#define O_EXCL     0x080
+#define O_TRUNC    0x200
+#define O_APPEND   0x400
+#define O_NONBLOCK 0x800
+
+// Per-call I/O flags passed to backend read/write
+#define IO_NOWAIT  0x1    // Return what can be done now (-1 if nothing) instead of sleeping
+
+// fcntl commands (Linux values)
+#define F_GETFL    3
+#define F_SETFL    4
+#define F_SETFL_MASK (O_APPEND | O_NONBLOCK)   // Flags F_SETFL may change
+
+// Seek origins
+#define SEEK_SET   0
+#define SEEK_CUR   1
+#define SEEK_END   2
+
+// Poll events
+#define POLLIN     0x001
+#define POLLOUT    0x004
+#define POLLERR    0x008
+#define POLLHUP    0x010
+
+struct File;
+struct PollQueue;
+struct EpollItem;
+
+// Backend operations. Any entry may be nullptr if unsupported. read/write
+// work at *pos and advance it; it is &File::pos for ordinary I/O and a
+// caller-owned offset for pread/pwrite. Unseekable backends ignore it.
+// Their buffers are user addresses: backends only touch them through
+// copy_to_user/copy_from_user (uaccess.h) and fail with -EFAULT. Backends
+// that can sleep (pipes) honour IO_NOWAIT in io.
+struct FileOps {
+    int64_t (*read)(File* f, void* buf, uint64_t count, uint64_t* pos, uint32_t io);
+    int64_t (*write)(File* f, const void* buf, uint64_t count, uint64_t* pos, uint32_t io);
+    int64_t (*seek)(File* f, int64_t offset, int whence);    // New position, or -1
+    const void* (*mmap)(File* f, uint64_t offset, uint64_t length);  // Stable backing memory
+    uint32_t (*poll)(File* f);                                // POLL* mask
+    PollQueue* (*poll_queue)(File* f);                        // Notified when poll() changes
+    void (*release)(File* f);                                 // Last reference dropped
+};
+
+struct File {
+    const FileOps* ops;
+    uint32_t refcount;    // Descriptors (in any table) referring to this File
+    uint32_t flags;       // O_* flags from open
+    uint64_t pos;         // Current offset (shared by dup'd/inherited fds)
+    void* priv;           // Backend state
+    EpollItem* epoll_items;   // Epoll watches on this File (epoll.cpp)
+};
+
+// One buffer of a readv/writev (Linux struct iovec)
+struct IoVec {
+    void* base;
+    uint64_t len;
+};
+
+#define IOV_MAX 1024    // Most buffers accepted by one readv/writev
+
+struct FdTable {
+    uint32_t refcount;              // Tasks sharing this table (threads)
+    Spinlock lock;                  // Protects files[]
+    File* files[MAX_OPEN_FILES];
+};
+
+// ============================================================================
+// File Objects
+// ============================================================================
+
+// Allocate a File with one reference. Returns nullptr on OOM.
+File* file_alloc(const FileOps* ops, void* priv, uint32_t flags);
+
+// Take / drop a reference. Dropping the last one ends any epoll watches on
+// the File, calls ops->release and frees it, which may sleep.
+File* file_get(File* f);
+void file_put(File* f);
+
+// Dispatch through the vtable (-1 if the backend lacks the operation or the
+// open mode forbids it)
+int64_t vfs_read(File* f, void* buf, uint64_t count);
+int64_t vfs_write(File* f, const void* buf, uint64_t count);
+
+// As vfs_read/vfs_write, but never sleep (asynchronous callers)
+int64_t vfs_read_nowait(File* f, void* buf, uint64_t count);
+int64_t vfs_write_nowait(File* f, const void* buf, uint64_t count);
+int64_t vfs_seek(File* f, int64_t offset, int whence);
+const void* vfs_mmap(File* f, uint64_t offset, uint64_t length);
+uint32_t vfs_poll(File* f);
+
+// Where to hook for changes in vfs_poll(f) (see poll.h). nullptr if the
+// backend's readiness never changes.
+PollQueue* vfs_poll_queue(File* f);
+
+// At an explicit offset, leaving File::pos alone (-1 on unseekable files)
+int64_t vfs_pread(File* f, void* buf, uint64_t count, uint64_t offset);
+int64_t vfs_pwrite(File* f, const void* buf, uint64_t count, uint64_t offset);
+
+// Scatter/gather in buffer order, stopping at the first short transfer.
+// Returns the total bytes moved, or -1 if nothing could be.
+int64_t vfs_readv(File* f, const IoVec* iov, int iovcnt);
+int64_t vfs_writev(File* f, const IoVec* iov, int iovcnt);
+
+// Resolve a new position for a seekable backend of the given size
+int64_t vfs_seek_in(File* f, int64_t offset, int whence, uint64_t size);
+
+// Open a filesystem path: a shared memory object under /dev/shm/ (see
+// shm.h), otherwise a uniFS file
+File* vfs_open(const char* path, uint32_t flags);
+
+// Remove a path (the same two namespaces). Returns 0 or -1.
+int vfs_unlink(const char* path);
+
+// The console: reads return EOF (no keyboard input yet), writes draw text
+File* console_open_file();
+
+// ============================================================================
+// Descriptor Tables
+// ============================================================================
+
+// New table with the console on stdin/stdout/stderr
+FdTable* fd_table_create();
+
+// Copy for fork: same Files, each with an extra reference
+FdTable* fd_table_clone(FdTable* table);
+
+// Share / release a table. Releasing the last reference closes every fd.
+void fd_table_get(FdTable* table);
+void fd_table_put(FdTable* table);
+
+// The calling task's table, created on first use
+FdTable* fd_table_current();
+
+// Install a File in the lowest free slot, consuming the caller's reference.
+// Returns the fd, or -1 if the table is full (the reference is then kept).
+int fd_install(FdTable* table, File* f);
+
+// Look up an fd and take a reference (release with file_put). nullptr if
+// the fd is not open.
+File* fd_get(FdTable* table, int fd);
+
+// Close an fd. Returns 0, or -1 if it wasn't open.
+int fd_close(FdTable* table, int fd);
@@ -2,10 +2,11 @@
 #include "pmm.h"
 #include "vmm.h"
 #include "debug.h"
-#include "spinlock.h"
+#include "mcslock.h"
 
 // Heap lock for thread safety
-static Spinlock heap_lock = SPINLOCK_INIT;
+static LockStats heap_lock_stats = LOCK_STATS_INIT("heap");
+static McsLock heap_lock = MCS_LOCK_INIT_STATS(&heap_lock_stats);
 
 // Bucket allocator implementation
 // Buckets for sizes: 16, 32, 64, 128, 256, 512, 1024, 2048, 4096
@@ -113,9 +114,10 @@ static void* malloc_unlocked(size_t size) {
 }
 
 void* malloc(size_t size) {
-    spinlock_acquire(&heap_lock);
+    McsNode node;
+    mcs_acquire(&heap_lock, &node);
     void* result = malloc_unlocked(size);
-    spinlock_release(&heap_lock);
+    mcs_release(&heap_lock, &node);
     return result;
 }
 
@@ -150,11 +152,12 @@ void aligned_free(void* ptr) {
 void free(void* ptr) {
     if (!ptr) return;
     
-    spinlock_acquire(&heap_lock);
+    McsNode node;
+    mcs_acquire(&heap_lock, &node);
     
     AllocHeader* header = (AllocHeader*)ptr - 1;
     if (header->magic != HEAP_MAGIC) {
-        spinlock_release(&heap_lock);
+        mcs_release(&heap_lock, &node);
         DEBUG_ERROR("Heap corruption detected at %p (magic: %lx)", ptr, header->magic);
         return;
     }
@@ -170,7 +173,7 @@ void free(void* ptr) {
         for (size_t i = 0; i < pages; i++) {
              pmm_free_frame((void*)(phys + i * 4096));
         }
-        spinlock_release(&heap_lock);
+        mcs_release(&heap_lock, &node);
         return;
     }
     
@@ -180,7 +183,7 @@ void free(void* ptr) {
     block->next = buckets[bucket_idx];
     buckets[bucket_idx] = block;
     
-    spinlock_release(&heap_lock);
+    mcs_release(&heap_lock, &node);
 }
 
 void* operator new(size_t size) {
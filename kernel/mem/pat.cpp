@@ -1,19 +1,6 @@
 #include "pat.h"
 #include "debug.h"
-
-// Read MSR
-static inline uint64_t rdmsr(uint32_t msr) {
-    uint32_t low, high;
-    asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
-    return ((uint64_t)high << 32) | low;
-}
-
-// Write MSR
-static inline void wrmsr(uint32_t msr, uint64_t value) {
-    uint32_t low = (uint32_t)value;
-    uint32_t high = (uint32_t)(value >> 32);
-    asm volatile("wrmsr" : : "c"(msr), "a"(low), "d"(high));
-}
+#include "io.h"
 
 // Check CPUID for PAT support
 bool pat_is_supported() {
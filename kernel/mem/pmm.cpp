@@ -2,10 +2,11 @@
 #include "limine.h"
 #include "bitmap.h"
 #include "debug.h"
-#include "spinlock.h"
+#include "mcslock.h"
 
 // PMM lock for thread safety
-static Spinlock pmm_lock = SPINLOCK_INIT;
+static LockStats pmm_lock_stats = LOCK_STATS_INIT("pmm");
+static McsLock pmm_lock = MCS_LOCK_INIT_STATS(&pmm_lock_stats);
 
 // Limine memory map request
 __attribute__((used, section(".requests")))
@@ -78,39 +79,42 @@ void pmm_init() {
 }
 
 void* pmm_alloc_frame() {
-    spinlock_acquire(&pmm_lock);
+    McsNode node;
+    mcs_acquire(&pmm_lock, &node);
     
     size_t frame_idx = pmm_bitmap.find_first_free();
     
     if (frame_idx != (size_t)-1 && frame_idx <= highest_page) {
         pmm_bitmap.set(frame_idx, true);
         free_memory -= 4096;
-        spinlock_release(&pmm_lock);
+        mcs_release(&pmm_lock, &node);
         return (void*)(frame_idx * 4096);
     }
     
-    spinlock_release(&pmm_lock);
+    mcs_release(&pmm_lock, &node);
     return nullptr; // Out of memory
 }
 
 void* pmm_alloc_frames(size_t count) {
-    spinlock_acquire(&pmm_lock);
+    McsNode node;
+    mcs_acquire(&pmm_lock, &node);
     
     size_t frame_idx = pmm_bitmap.find_first_free_sequence(count);
     
     if (frame_idx != (size_t)-1 && (frame_idx + count - 1) <= highest_page) {
         pmm_bitmap.set_range(frame_idx, count, true);
         free_memory -= (4096 * count);
-        spinlock_release(&pmm_lock);
+        mcs_release(&pmm_lock, &node);
         return (void*)(frame_idx * 4096);
     }
     
-    spinlock_release(&pmm_lock);
+    mcs_release(&pmm_lock, &node);
     return nullptr; // Out of memory
 }
 
 void pmm_free_frame(void* frame) {
-    spinlock_acquire(&pmm_lock);
+    McsNode node;
+    mcs_acquire(&pmm_lock, &node);
     
     uint64_t addr = (uint64_t)frame;
     uint64_t frame_idx = addr / 4096;
@@ -123,7 +127,7 @@ void pmm_free_frame(void* frame) {
         }
     }
     
-    spinlock_release(&pmm_lock);
+    mcs_release(&pmm_lock, &node);
 }
 
 uint64_t pmm_get_free_memory() {
@@ -0,0 +1,313 @@
+#include "shm.h"
+#include "vfs.h"
+#include "process.h"
+#include "spinlock.h"
+#include "heap.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "kstring.h"
+#include "uaccess.h"
+
+#define PAGE_SIZE 4096
+
+struct ShmObject {
+    ShmObject* next;
+    char name[SHM_NAME_MAX + 1];
+    bool linked;           // Reachable by name (not unlinked yet)
+    uint64_t phys;         // First frame (0 until sized)
+    uint64_t size;         // Bytes, set once by ftruncate
+    uint64_t refs;         // Name + open Files + mapped page table entries
+};
+
+// All live objects, named or not: page table hooks look frames up here
+static ShmObject* objects = nullptr;
+static Spinlock shm_lock = SPINLOCK_INIT;   // Protects objects, refs and sizes
+static Spinlock map_lock = SPINLOCK_INIT;   // Serializes address selection
+
+static uint64_t size_pages(uint64_t size) {
+    return (size + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+// ============================================================================
+// References (shm_lock held)
+// ============================================================================
+
+static ShmObject* find_name(const char* name) {
+    for (ShmObject* obj = objects; obj; obj = obj->next) {
+        if (obj->linked && kstring::strcmp(obj->name, name) == 0) return obj;
+    }
+    return nullptr;
+}
+
+static ShmObject* find_frame(uint64_t phys) {
+    for (ShmObject* obj = objects; obj; obj = obj->next) {
+        if (obj->phys && phys >= obj->phys && phys < obj->phys + obj->size) return obj;
+    }
+    return nullptr;
+}
+
+// Drop n references. Returns the object if that was the last, unlinked from
+// the list and for the caller to free once the lock is released.
+static ShmObject* put_locked(ShmObject* obj, uint64_t n) {
+    obj->refs -= n;
+    if (obj->refs) return nullptr;
+
+    for (ShmObject** link = &objects; *link; link = &(*link)->next) {
+        if (*link == obj) {
+            *link = obj->next;
+            break;
+        }
+    }
+    return obj;
+}
+
+static void destroy(ShmObject* obj) {
+    for (uint64_t i = 0; i < size_pages(obj->size); i++) {
+        pmm_free_frame((void*)(obj->phys + i * PAGE_SIZE));
+    }
+    free(obj);
+}
+
+static void shm_put(ShmObject* obj, uint64_t n) {
+    spinlock_acquire(&shm_lock);
+    ShmObject* dead = put_locked(obj, n);
+    spinlock_release(&shm_lock);
+    if (dead) destroy(dead);
+}
+
+void shm_page_get(uint64_t phys) {
+    spinlock_acquire(&shm_lock);
+    ShmObject* obj = find_frame(phys);
+    if (obj) obj->refs++;
+    spinlock_release(&shm_lock);
+}
+
+void shm_page_put(uint64_t phys) {
+    spinlock_acquire(&shm_lock);
+    ShmObject* obj = find_frame(phys);
+    ShmObject* dead = obj ? put_locked(obj, 1) : nullptr;
+    spinlock_release(&shm_lock);
+    if (dead) destroy(dead);
+}
+
+// ============================================================================
+// File Backend
+// ============================================================================
+// read/write/lseek work like on a regular file of the object's size.
+
+static ShmObject* object_of(File* f) {
+    return (ShmObject*)f->priv;
+}
+
+static uint64_t object_size(ShmObject* obj) {
+    return __atomic_load_n(&obj->size, __ATOMIC_ACQUIRE);
+}
+
+static int64_t shm_file_read(File* f, void* buf, uint64_t count, uint64_t* pos, uint32_t) {
+    ShmObject* obj = object_of(f);
+    uint64_t size = object_size(obj);
+    if (*pos >= size) return 0;
+
+    uint64_t n = size - *pos;
+    if (n > count) n = count;
+    if (copy_to_user(buf, (uint8_t*)vmm_phys_to_virt(obj->phys) + *pos, n) < 0) return -EFAULT;
+    *pos += n;
+    return n;
+}
+
+static int64_t shm_file_write(File* f, const void* buf, uint64_t count, uint64_t* pos, uint32_t) {
+    ShmObject* obj = object_of(f);
+    uint64_t size = object_size(obj);
+    if (*pos >= size) return count ? -1 : 0;    // Objects don't grow
+
+    uint64_t n = size - *pos;
+    if (n > count) n = count;
+    if (copy_from_user((uint8_t*)vmm_phys_to_virt(obj->phys) + *pos, buf, n) < 0) return -EFAULT;
+    *pos += n;
+    return n;
+}
+
+static int64_t shm_file_seek(File* f, int64_t offset, int whence) {
+    return vfs_seek_in(f, offset, whence, object_size(object_of(f)));
+}
+
+static uint32_t shm_file_poll(File*) {
+    return POLLIN | POLLOUT;
+}
+
+static void shm_file_release(File* f) {
+    shm_put(object_of(f), 1);
+}
+
+static const FileOps shm_ops = {
+    shm_file_read,
+    shm_file_write,
+    shm_file_seek,
+    nullptr,        // Mapped into user space through shm_map() instead
+    shm_file_poll,
+    nullptr,        // Always ready
+    shm_file_release,
+};
+
+bool shm_is_shm(File* f) {
+    return f->ops == &shm_ops;
+}
+
+File* shm_open_file(const char* name, uint32_t flags) {
+    uint64_t len = kstring::strlen(name);
+    if (len == 0 || len > SHM_NAME_MAX) return nullptr;
+    for (uint64_t i = 0; i < len; i++) {
+        if (name[i] == '/') return nullptr;
+    }
+
+    // Allocate up front: creation is decided under the lock
+    ShmObject* fresh = nullptr;
+    if (flags & O_CREAT) {
+        fresh = (ShmObject*)malloc(sizeof(ShmObject));
+        if (!fresh) return nullptr;
+        kstring::strcpy(fresh->name, name);
+        fresh->linked = true;
+        fresh->phys = 0;
+        fresh->size = 0;
+        fresh->refs = 1;    // The name
+    }
+
+    spinlock_acquire(&shm_lock);
+    ShmObject* obj = find_name(name);
+    if (obj && (flags & O_CREAT) && (flags & O_EXCL)) {
+        obj = nullptr;
+    } else if (!obj && fresh) {
+        obj = fresh;
+        fresh = nullptr;
+        obj->next = objects;
+        objects = obj;
+    }
+    if (obj) obj->refs++;   // The File
+    spinlock_release(&shm_lock);
+
+    if (fresh) free(fresh);
+    if (!obj) return nullptr;
+
+    File* f = file_alloc(&shm_ops, obj, flags & O_ACCMODE);
+    if (!f) shm_put(obj, 1);
+    return f;
+}
+
+int shm_unlink(const char* name) {
+    spinlock_acquire(&shm_lock);
+    ShmObject* obj = find_name(name);
+    ShmObject* dead = nullptr;
+    if (obj) {
+        obj->linked = false;
+        dead = put_locked(obj, 1);
+    }
+    spinlock_release(&shm_lock);
+
+    if (dead) destroy(dead);
+    return obj ? 0 : -1;
+}
+
+int64_t shm_truncate(File* f, uint64_t size) {
+    if (!shm_is_shm(f) || (f->flags & O_ACCMODE) == O_RDONLY) return -1;
+    if (size == 0 || size > SHM_MAX_SIZE) return -1;
+
+    ShmObject* obj = object_of(f);
+    if (object_size(obj)) return -1;
+
+    uint64_t pages = size_pages(size);
+    uint64_t phys = (uint64_t)pmm_alloc_frames(pages);
+    if (!phys) return -1;
+    kstring::memset((void*)vmm_phys_to_virt(phys), 0, pages * PAGE_SIZE);
+
+    spinlock_acquire(&shm_lock);
+    bool won = obj->size == 0;
+    if (won) {
+        obj->phys = phys;
+        __atomic_store_n(&obj->size, pages * PAGE_SIZE, __ATOMIC_RELEASE);
+    }
+    spinlock_release(&shm_lock);
+
+    if (!won) {
+        for (uint64_t i = 0; i < pages; i++) pmm_free_frame((void*)(phys + i * PAGE_SIZE));
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// Mappings
+// ============================================================================
+
+static uint64_t* user_pml4() {
+    Process* p = process_get_current();
+    return p ? p->page_table : nullptr;
+}
+
+// First run of `pages` unmapped pages in the window (map_lock held)
+static uint64_t find_free_range(uint64_t* pml4, uint64_t pages) {
+    uint64_t end = SHM_MAP_BASE + SHM_MAP_SIZE;
+    uint64_t base = SHM_MAP_BASE;
+
+    while (base + pages * PAGE_SIZE <= end) {
+        uint64_t i = 0;
+        while (i < pages && !vmm_virt_to_phys_in(pml4, base + i * PAGE_SIZE)) i++;
+        if (i == pages) return base;
+        base += (i + 1) * PAGE_SIZE;    // Skip past the page in the way
+    }
+    return 0;
+}
+
+int64_t shm_map(File* f, uint64_t length, uint32_t prot, uint64_t offset) {
+    if (!shm_is_shm(f) || length == 0) return -1;
+    if (offset & (PAGE_SIZE - 1)) return -1;
+    if ((prot & PROT_WRITE) && (f->flags & O_ACCMODE) == O_RDONLY) return -1;
+
+    ShmObject* obj = object_of(f);
+    uint64_t size = object_size(obj);
+    uint64_t pages = size_pages(length);
+    if (offset >= size || pages > (size - offset) / PAGE_SIZE) return -1;
+
+    uint64_t* pml4 = user_pml4();
+    if (!pml4) return -1;
+
+    uint64_t flags = PTE_PRESENT | PTE_USER | PTE_SHARED | PTE_SHM;
+    if (prot & PROT_WRITE) flags |= PTE_WRITABLE;
+
+    spinlock_acquire(&map_lock);
+    uint64_t base = find_free_range(pml4, pages);
+    if (base) {
+        // The File keeps the object alive until the entries hold it
+        spinlock_acquire(&shm_lock);
+        obj->refs += pages;
+        spinlock_release(&shm_lock);
+
+        uint64_t phys = obj->phys + offset;
+        for (uint64_t i = 0; i < pages; i++) {
+            vmm_map_page_in(pml4, base + i * PAGE_SIZE, phys + i * PAGE_SIZE, flags);
+        }
+    }
+    spinlock_release(&map_lock);
+
+    return base ? (int64_t)base : -1;
+}
+
+int64_t shm_unmap(uint64_t addr, uint64_t length) {
+    if ((addr & (PAGE_SIZE - 1)) || length == 0) return -1;
+    uint64_t pages = size_pages(length);
+    if (addr < SHM_MAP_BASE || addr >= SHM_MAP_BASE + SHM_MAP_SIZE ||
+        pages > (SHM_MAP_BASE + SHM_MAP_SIZE - addr) / PAGE_SIZE) {
+        return -1;
+    }
+
+    uint64_t* pml4 = user_pml4();
+    if (!pml4) return -1;
+
+    spinlock_acquire(&map_lock);
+    for (uint64_t i = 0; i < pages; i++) {
+        uint64_t virt = addr + i * PAGE_SIZE;
+        if (!(vmm_get_pte_in(pml4, virt) & PTE_SHM)) continue;
+        shm_page_put(vmm_unmap_page_in(pml4, virt));
+    }
+    spinlock_release(&map_lock);
+    return 0;
+}
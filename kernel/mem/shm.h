@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================================
+// Shared Memory Objects
+// ============================================================================
+// A shared memory object is a named run of physical frames that any number
+// of processes can map at once. It works like POSIX shm_open():
+//
+//   fd = open("/dev/shm/NAME", O_CREAT | O_RDWR)   create or open by name
+//   ftruncate(fd, size)                            give it its frames
+//   p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+//   munmap(p, size); close(fd); unlink("/dev/shm/NAME")
+//
+// Every mapping points its page table entries at the object's frames, so
+// stores by one process are loads in another with no copy and no syscall.
+// The entries carry PTE_SHARED and PTE_SHM: fork() gives the child the
+// same frames, and the object counts each mapped entry as a reference.
+// The frames are freed once the name is unlinked, every File is closed
+// and every entry is gone - by munmap() or exit.
+//
+// Differences from Linux: an object is sized once (ftruncate on an object
+// that already has frames fails) and its frames are physically contiguous.
+// mmap() picks the address in its own window and only accepts MAP_SHARED
+// objects from here.
+// ============================================================================
+
+#define SHM_PATH_PREFIX  "/dev/shm/"
+#define SHM_NAME_MAX     32
+#define SHM_MAX_SIZE     (16ULL * 1024 * 1024)
+
+// Where objects are mapped in user space
+#define SHM_MAP_BASE     0x0000500000000000ULL
+#define SHM_MAP_SIZE     0x0000010000000000ULL   // 1 TB
+
+// mmap protection and flags (Linux values)
+#define PROT_READ        0x1
+#define PROT_WRITE       0x2
+#define MAP_SHARED       0x01
+#define MAP_FIXED        0x10
+
+struct File;
+
+// Open (or with O_CREAT, create) the object called name - the part of the
+// path after SHM_PATH_PREFIX. O_EXCL fails if it exists. Returns nullptr
+// on failure.
+File* shm_open_file(const char* name, uint32_t flags);
+
+// Remove the name. Existing Files and mappings keep working. Returns 0 or -1.
+int shm_unlink(const char* name);
+
+// Whether f is a shared memory object
+bool shm_is_shm(File* f);
+
+// Give an empty object `size` bytes of zeroed frames. Returns 0 or -1.
+int64_t shm_truncate(File* f, uint64_t size);
+
+// Map length bytes at offset (page-aligned) into the calling process.
+// Returns the user address, or -1.
+int64_t shm_map(File* f, uint64_t length, uint32_t prot, uint64_t offset);
+
+// Unmap every shared memory page in [addr, addr + length) of the calling
+// process. Returns 0 or -1.
+int64_t shm_unmap(uint64_t addr, uint64_t length);
+
+// Page table hooks: a PTE_SHM entry was copied (fork) or dropped (exit)
+void shm_page_get(uint64_t phys);
+void shm_page_put(uint64_t phys);
@@ -0,0 +1,99 @@
+#include "uaccess.h"
+
+// Exception table bounds (linker.ld)
+extern "C" const ExTableEntry __ex_table_start[];
+extern "C" const ExTableEntry __ex_table_end[];
+
+#define CPUID7_EBX_SMAP (1U << 20)
+#define CR4_SMAP        (1ULL << 21)
+
+// Also tested by the int 0x80 entry, which has to clear a user-set AC
+extern "C" { volatile uint8_t smap_enabled = 0; }
+
+void uaccess_init() {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0));
+    if (eax < 7) return;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+    if (!(ebx & CPUID7_EBX_SMAP)) return;
+
+    uint64_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    asm volatile("mov %0, %%cr4" :: "r"(cr4 | CR4_SMAP));
+    smap_enabled = 1;
+}
+
+bool uaccess_smap_enabled() {
+    return smap_enabled;
+}
+
+// Open and close the user-access window (stac/clac are #UD without SMAP)
+static inline void user_access_begin() {
+    if (smap_enabled) asm volatile("stac" ::: "memory");
+}
+
+static inline void user_access_end() {
+    if (smap_enabled) asm volatile("clac" ::: "memory");
+}
+
+// Copy n bytes; returns how many were left uncopied. A fault in the
+// rep movsb lands at label 2 with RCX holding the remainder.
+static inline uint64_t raw_copy(void* dst, const void* src, uint64_t n) {
+    user_access_begin();
+    asm volatile(
+        "1: rep movsb\n"
+        "2:\n"
+        ".pushsection __ex_table, \"a\"\n"
+        ".balign 8\n"
+        ".quad 1b, 2b\n"
+        ".popsection\n"
+        : "+D"(dst), "+S"(src), "+c"(n)
+        :
+        : "memory");
+    user_access_end();
+    return n;
+}
+
+int64_t copy_from_user(void* dst, const void* user_src, uint64_t n) {
+    if (n == 0) return 0;
+    if (!user_range_ok(user_src, n)) return -EFAULT;
+    return raw_copy(dst, user_src, n) ? -EFAULT : 0;
+}
+
+int64_t copy_to_user(void* user_dst, const void* src, uint64_t n) {
+    if (n == 0) return 0;
+    if (!user_range_ok(user_dst, n)) return -EFAULT;
+    return raw_copy(user_dst, src, n) ? -EFAULT : 0;
+}
+
+int64_t strncpy_from_user(char* dst, const char* user_src, uint64_t max) {
+    if (max == 0) return 0;
+    if (!user_range_ok(user_src, 1)) return -EFAULT;
+
+    // Copy in chunks that never cross a page boundary, so reading past
+    // the terminator can't fault on a page the string doesn't use
+    uint64_t len = 0;
+    while (len < max - 1) {
+        uint64_t addr = (uint64_t)user_src + len;
+        uint64_t chunk = 4096 - (addr & 4095);
+        if (chunk > max - 1 - len) chunk = max - 1 - len;
+        if (!user_range_ok((const void*)addr, chunk)) return -EFAULT;
+        if (raw_copy(dst + len, (const void*)addr, chunk)) return -EFAULT;
+
+        for (uint64_t i = 0; i < chunk; i++) {
+            if (dst[len + i] == '\0') return len + i;
+        }
+        len += chunk;
+    }
+
+    dst[len] = '\0';
+    return max;
+}
+
+uint64_t uaccess_fixup(uint64_t rip) {
+    for (const ExTableEntry* e = __ex_table_start; e < __ex_table_end; e++) {
+        if (e->insn == rip) return e->fixup;
+    }
+    return 0;
+}
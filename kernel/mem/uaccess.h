@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================================
+// User Memory Access
+// ============================================================================
+// The only sanctioned way for the kernel to touch user memory. Each copy
+// checks that the range lies in the user half, then moves it with a single
+// `rep movsb`. If a page turns out to be missing, the page fault handler
+// finds the faulting instruction in the exception table (__ex_table) and
+// resumes at its fixup, so the copy fails with -EFAULT instead of taking
+// the kernel down.
+//
+// Where the CPU has SMAP, supervisor access to user pages is switched off
+// and only opened (stac/clac) for the duration of each copy.
+// ============================================================================
+
+#define EFAULT 14   // Bad address (Linux errno)
+
+#define USER_SPACE_MAX 0x0000800000000000ULL  // First non-user address
+
+// One exception table entry: a faulting instruction and where to resume
+struct ExTableEntry {
+    uint64_t insn;
+    uint64_t fixup;
+};
+
+// Detect SMAP and enable it (call after the kernel's own user-memory
+// accesses have all been converted to the functions below)
+void uaccess_init();
+
+bool uaccess_smap_enabled();
+
+// True if [addr, addr + size) lies entirely in user space
+static inline bool user_range_ok(const void* ptr, uint64_t size) {
+    uint64_t addr = (uint64_t)ptr;
+    if (addr == 0 || addr >= USER_SPACE_MAX) return false;
+    return size <= USER_SPACE_MAX - addr;
+}
+
+// Copy between kernel and user memory. Return 0, or -EFAULT if the user
+// range is invalid or not fully mapped (part of it may have been copied).
+int64_t copy_from_user(void* dst, const void* user_src, uint64_t n);
+int64_t copy_to_user(void* user_dst, const void* src, uint64_t n);
+
+// Copy a NUL-terminated user string of at most max - 1 characters into
+// dst (always terminated). Returns its length, max if it didn't fit (dst
+// then holds a truncated copy), or -EFAULT.
+int64_t strncpy_from_user(char* dst, const char* user_src, uint64_t max);
+
+// Page fault recovery: the fixup address for a faulting kernel RIP, or 0
+// if the instruction has no exception table entry
+uint64_t uaccess_fixup(uint64_t rip);
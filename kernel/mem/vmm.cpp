@@ -1,5 +1,6 @@
 #include "vmm.h"
 #include "pmm.h"
+#include "shm.h"
 #include "limine.h"
 
 // Limine HHDM request (Higher Half Direct Map)
@@ -142,14 +143,15 @@ static inline void vmm_flush_tlb_all() {
     asm volatile("mov %%cr3, %%rax; mov %%rax, %%cr3" ::: "rax", "memory");
 }
 
-uint64_t vmm_virt_to_phys(uint64_t virt) {
+// Walk the tables under root (any PML4) without allocating
+static uint64_t translate(uint64_t* root, uint64_t virt) {
     uint64_t pml4_index = (virt >> 39) & 0x1FF;
     uint64_t pdpt_index = (virt >> 30) & 0x1FF;
     uint64_t pd_index   = (virt >> 21) & 0x1FF;
     uint64_t pt_index   = (virt >> 12) & 0x1FF;
 
-    if (!(pml4[pml4_index] & PTE_PRESENT)) return 0;
-    uint64_t* pdpt = (uint64_t*)((pml4[pml4_index] & 0x000FFFFFFFFFF000) + hhdm_offset);
+    if (!(root[pml4_index] & PTE_PRESENT)) return 0;
+    uint64_t* pdpt = (uint64_t*)((root[pml4_index] & 0x000FFFFFFFFFF000) + hhdm_offset);
     
     if (!(pdpt[pdpt_index] & PTE_PRESENT)) return 0;
     // Check for 1GB huge page (PS bit set at PDPT level)
@@ -174,6 +176,14 @@ uint64_t vmm_virt_to_phys(uint64_t virt) {
     return (pt[pt_index] & 0x000FFFFFFFFFF000) + (virt & 0xFFF);
 }
 
+uint64_t vmm_virt_to_phys(uint64_t virt) {
+    return translate(pml4, virt);
+}
+
+uint64_t vmm_virt_to_phys_in(uint64_t* target_pml4, uint64_t virt) {
+    return translate(target_pml4, virt);
+}
+
 uint64_t* vmm_get_kernel_pml4() {
     return pml4;
 }
@@ -217,6 +227,81 @@ void vmm_map_page_in(uint64_t* target_pml4, uint64_t virt, uint64_t phys, uint64
     pt[pt_index] = phys | flags;
 }
 
+bool vmm_map_range_in(uint64_t* target_pml4, uint64_t virt, uint64_t phys, uint64_t pages, uint64_t flags) {
+    while (pages > 0) {
+        uint64_t pml4_index = (virt >> 39) & 0x1FF;
+        uint64_t pdpt_index = (virt >> 30) & 0x1FF;
+        uint64_t pd_index   = (virt >> 21) & 0x1FF;
+        uint64_t pt_index   = (virt >> 12) & 0x1FF;
+
+        uint64_t* pdpt = get_next_level_in(target_pml4, pml4_index, true);
+        if (!pdpt) return false;
+
+        uint64_t* pd = get_next_level_in(pdpt, pdpt_index, true);
+        if (!pd) return false;
+
+        uint64_t* pt = get_next_level_in(pd, pd_index, true);
+        if (!pt) return false;
+
+        // Fill this page table's run of entries without walking again
+        uint64_t run = 512 - pt_index;
+        if (run > pages) run = pages;
+        for (uint64_t i = 0; i < run; i++) {
+            pt[pt_index + i] = (phys + i * 0x1000) | flags;
+        }
+
+        virt += run * 0x1000;
+        phys += run * 0x1000;
+        pages -= run;
+    }
+    return true;
+}
+
+uint64_t vmm_unmap_page_in(uint64_t* target_pml4, uint64_t virt) {
+    uint64_t pml4_index = (virt >> 39) & 0x1FF;
+    uint64_t pdpt_index = (virt >> 30) & 0x1FF;
+    uint64_t pd_index   = (virt >> 21) & 0x1FF;
+    uint64_t pt_index   = (virt >> 12) & 0x1FF;
+
+    uint64_t* pdpt = get_next_level_in(target_pml4, pml4_index, false);
+    if (!pdpt || (pdpt[pdpt_index] & (1ULL << 7))) return 0;  // Only 4KB pages
+
+    uint64_t* pd = get_next_level_in(pdpt, pdpt_index, false);
+    if (!pd || (pd[pd_index] & (1ULL << 7))) return 0;
+
+    uint64_t* pt = get_next_level_in(pd, pd_index, false);
+    if (!pt || !(pt[pt_index] & PTE_PRESENT)) return 0;
+
+    uint64_t phys = pt[pt_index] & 0x000FFFFFFFFFF000;
+    pt[pt_index] = 0;
+
+    // Only the active address space can have the entry cached; other
+    // spaces are flushed by the CR3 load that switches to them
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    if (cr3 == (uint64_t)target_pml4 - hhdm_offset) {
+        asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+    }
+    return phys;
+}
+
+uint64_t vmm_get_pte_in(uint64_t* target_pml4, uint64_t virt) {
+    uint64_t pml4_index = (virt >> 39) & 0x1FF;
+    uint64_t pdpt_index = (virt >> 30) & 0x1FF;
+    uint64_t pd_index   = (virt >> 21) & 0x1FF;
+    uint64_t pt_index   = (virt >> 12) & 0x1FF;
+
+    uint64_t* pdpt = get_next_level_in(target_pml4, pml4_index, false);
+    if (!pdpt || (pdpt[pdpt_index] & (1ULL << 7))) return 0;
+
+    uint64_t* pd = get_next_level_in(pdpt, pdpt_index, false);
+    if (!pd || (pd[pd_index] & (1ULL << 7))) return 0;
+
+    uint64_t* pt = get_next_level_in(pd, pd_index, false);
+    if (!pt || !(pt[pt_index] & PTE_PRESENT)) return 0;
+    return pt[pt_index];
+}
+
 uint64_t* vmm_create_address_space() {
     // Allocate a new PML4
     void* frame = pmm_alloc_frame();
@@ -252,6 +337,14 @@ static void clone_page_table_level(uint64_t* src, uint64_t* dst, int level) {
         uint64_t flags = src[i] & 0xFFF;
         
         if (level == 1) {
+            // Shared pages (the vDSO, shared memory) map the same frame in
+            // every process
+            if (src[i] & PTE_SHARED) {
+                dst[i] = src[i];
+                if (src[i] & PTE_SHM) shm_page_get(src_phys);
+                continue;
+            }
+            
             // Level 1 = PT (Page Table): Copy the actual physical page
             void* new_frame = pmm_alloc_frame();
             if (!new_frame) {
@@ -347,8 +440,9 @@ static void free_page_table_level(uint64_t* table, int level) {
         uint64_t phys = table[i] & 0x000FFFFFFFFFF000ULL;
         
         if (level == 1) {
-            // Level 1 = PT: Free the physical page
-            pmm_free_frame((void*)phys);
+            // Level 1 = PT: Free the physical page (unless it isn't ours)
+            if (table[i] & PTE_SHM) shm_page_put(phys);
+            else if (!(table[i] & PTE_SHARED)) pmm_free_frame((void*)phys);
         } else {
             // Levels 2-3: Recurse then free table
             uint64_t* sub_table = (uint64_t*)(phys + hhdm_offset);
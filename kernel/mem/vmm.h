@@ -9,6 +9,8 @@
 #define PTE_PWT       (1ull << 3)  // Page Write-Through
 #define PTE_PCD       (1ull << 4)  // Page Cache Disable
 #define PTE_PAT       (1ull << 7)  // PAT bit (for 4KB pages)
+#define PTE_SHARED    (1ull << 9)  // Software bit: frame not owned (fork shares, free skips)
+#define PTE_SHM       (1ull << 10) // Software bit: shared memory frame, refcounted (see shm.h)
 #define PTE_NX        (1ull << 63)
 
 // Combined flags for MMIO (uncacheable)
@@ -20,7 +22,12 @@
 void vmm_init();
 void vmm_map_page(uint64_t virt, uint64_t phys, uint64_t flags);
 void vmm_map_page_in(uint64_t* pml4, uint64_t virt, uint64_t phys, uint64_t flags);
+// Map `pages` physically contiguous pages, walking the tables once per
+// page table rather than per page (no TLB flush: for address spaces not
+// yet running). Returns false if a table couldn't be allocated.
+bool vmm_map_range_in(uint64_t* pml4, uint64_t virt, uint64_t phys, uint64_t pages, uint64_t flags);
 uint64_t vmm_virt_to_phys(uint64_t virt);
+uint64_t vmm_virt_to_phys_in(uint64_t* pml4, uint64_t virt);  // 0 if unmapped
 uint64_t vmm_phys_to_virt(uint64_t phys);
 uint64_t* vmm_create_address_space();
 void vmm_switch_address_space(uint64_t* pml4_phys);
@@ -31,12 +38,26 @@ uint64_t* vmm_get_kernel_pml4();
 #define KERNEL_STACK_TOP  0xFFFFFF8000000000ULL
 #define KERNEL_STACK_SIZE 16384  // 16KB per process
 
+// Kernel-only window for cached file pages (uniFS compressed boot files).
+// It sits in the top PML4 slot, which every address space shares, so pages
+// mapped here later are visible everywhere.
+#define PAGE_CACHE_BASE   0xFFFFFFC000000000ULL
+#define PAGE_CACHE_SIZE   0x0000001000000000ULL  // 64 GB
+
 // Clone an address space (deep copy user pages, share kernel pages)
 uint64_t* vmm_clone_address_space(uint64_t* src_pml4);
 
 // Free all user-space pages in an address space
 void vmm_free_address_space(uint64_t* pml4);
 
+// Remove one 4KB mapping. Returns the physical page it mapped (which the
+// caller now owns), or 0 if nothing was mapped there.
+uint64_t vmm_unmap_page_in(uint64_t* pml4, uint64_t virt);
+
+// The 4KB page table entry mapping virt (physical address and flags), or 0
+// if it isn't mapped by a 4KB page
+uint64_t vmm_get_pte_in(uint64_t* pml4, uint64_t virt);
+
 // Get HHDM offset for physical->virtual conversion
 uint64_t vmm_get_hhdm_offset();
 
@@ -3,9 +3,14 @@
 #include "net.h"
 #include "debug.h"
 #include "timer.h"
+#include "heap.h"
+#include "spinlock.h"
+#include "scheduler.h"
 
-// ARP table
-static ArpEntry arp_table[ARP_TABLE_SIZE];
+// ARP table: slots hold RCU-protected pointers. Lookups (every outgoing
+// packet) are lock-free; updates are serialized by arp_lock.
+static ArpEntry* arp_table[ARP_TABLE_SIZE];
+static Spinlock arp_lock = SPINLOCK_INIT;
 
 // Pending ARP request
 static bool arp_waiting = false;
@@ -15,47 +20,66 @@ static bool arp_resolved = false;
 
 void arp_init() {
     for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        arp_table[i].valid = false;
+        arp_table[i] = nullptr;
     }
 
 }
 
+static void arp_entry_free_rcu(RcuHead* head) {
+    free(rcu_container_of(head, ArpEntry, rcu));
+}
+
 // Add entry to ARP table
 void arp_add_entry(uint32_t ip, const uint8_t* mac) {
-    // Check if already exists
+    ArpEntry* entry = (ArpEntry*)malloc(sizeof(ArpEntry));
+    if (!entry) return;
+    entry->ip = ip;
+    eth_mac_copy(entry->mac, mac);
+    entry->timestamp = 0;
+    
+    spinlock_acquire(&arp_lock);
+    
+    // Replace an existing mapping, else take an empty slot, else evict
+    // the first entry (simple eviction)
+    int slot = -1;
     for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        if (arp_table[i].valid && arp_table[i].ip == ip) {
-            eth_mac_copy(arp_table[i].mac, mac);
-            return;
+        if (arp_table[i] && arp_table[i]->ip == ip) {
+            slot = i;
+            break;
         }
     }
-    
-    // Find empty slot
-    for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        if (!arp_table[i].valid) {
-            arp_table[i].ip = ip;
-            eth_mac_copy(arp_table[i].mac, mac);
-            arp_table[i].valid = true;
-
-            return;
+    if (slot < 0) {
+        for (int i = 0; i < ARP_TABLE_SIZE; i++) {
+            if (!arp_table[i]) {
+                slot = i;
+                break;
+            }
         }
     }
+    if (slot < 0) slot = 0;
+    
+    ArpEntry* old = arp_table[slot];
+    rcu_assign_pointer(arp_table[slot], entry);
+    spinlock_release(&arp_lock);
     
-    // Table full, overwrite first entry (simple eviction)
-    arp_table[0].ip = ip;
-    eth_mac_copy(arp_table[0].mac, mac);
-    arp_table[0].valid = true;
+    // Readers may still be copying the old MAC
+    if (old) call_rcu(&old->rcu, arp_entry_free_rcu);
 }
 
 // Lookup IP in ARP table
 bool arp_lookup(uint32_t ip, uint8_t* out_mac) {
+    bool found = false;
+    rcu_read_lock();
     for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        if (arp_table[i].valid && arp_table[i].ip == ip) {
-            eth_mac_copy(out_mac, arp_table[i].mac);
-            return true;
+        ArpEntry* entry = rcu_dereference(arp_table[i]);
+        if (entry && entry->ip == ip) {
+            eth_mac_copy(out_mac, entry->mac);
+            found = true;
+            break;
         }
     }
-    return false;
+    rcu_read_unlock();
+    return found;
 }
 
 // Send ARP request
@@ -170,8 +194,13 @@ bool arp_resolve(uint32_t ip, uint8_t* out_mac) {
         // Poll network
         net_poll();
         
-        // Small delay
-        for (volatile int i = 0; i < 10000; i++);
+        // Let other tasks run until the next poll (a reply sent from the
+        // NET_RX softirq can't sleep and just spins)
+        if (in_interrupt()) {
+            asm volatile("pause");
+        } else {
+            scheduler_yield();
+        }
     }
     
     arp_waiting = false;
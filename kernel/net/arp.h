@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include "ethernet.h"
+#include "rcu.h"
 
 // ARP constants
 #define ARP_HW_ETHERNET     1
@@ -20,12 +21,13 @@ struct ArpPacket {
     uint32_t target_ip;         // Target IP address
 } __attribute__((packed));
 
-// ARP table entry
+// ARP table entry. Entries are immutable once published: an update installs
+// a fresh entry and frees the old one after an RCU grace period.
 struct ArpEntry {
     uint32_t ip;
     uint8_t mac[6];
-    bool valid;
     uint32_t timestamp;         // For aging (not implemented yet)
+    RcuHead rcu;
 };
 
 #define ARP_TABLE_SIZE 32
@@ -4,6 +4,7 @@
 #include "ethernet.h"
 #include "timer.h"
 #include "debug.h"
+#include "poll.h"
 
 // DNS query state
 static uint16_t dns_transaction_id = 0;
@@ -279,14 +280,16 @@ uint32_t dns_resolve(const char* hostname) {
         return 0;
     }
     
-    // Wait for response
-    uint64_t start = timer_get_ticks();
-    uint64_t timeout = (DNS_TIMEOUT_MS * timer_get_frequency()) / 1000;
+    // Wait for the response, sleeping between datagrams (the NET_RX softirq
+    // receives them and notifies the socket)
+    PollWaiter waiter;
+    PollHook hook;
+    poll_waiter_init(&waiter);
+    poll_waiter_attach(&waiter, &hook, udp_poll_queue(sock), POLLIN);
     
-    while (!dns_response_received && (timer_get_ticks() - start) < timeout) {
-        // Poll network
-        net_poll();
-        
+    uint64_t deadline = timer_get_ticks() + poll_ms_to_ticks(DNS_TIMEOUT_MS);
+    
+    while (!dns_response_received) {
         // Check for UDP data
         uint8_t buffer[512];
         uint32_t src_ip;
@@ -298,11 +301,15 @@ uint32_t dns_resolve(const char* hostname) {
             if (dns_resolved_ip != 0) {
                 dns_response_received = true;
             }
+            continue;
         }
         
-        for (volatile int i = 0; i < 1000; i++);
+        uint64_t now = timer_get_ticks();
+        if (now >= deadline) break;
+        poll_waiter_sleep(&waiter, deadline - now);
     }
     
+    poll_hook_remove(&hook);
     udp_close(sock);
     
     if (dns_resolved_ip != 0) {
@@ -10,6 +10,7 @@
 #include "dhcp.h"
 #include "dns.h"
 #include "debug.h"
+#include "softirq.h"
 
 // Global network configuration
 static NetConfig g_net_config = {0, 0, 0, 0, false};
@@ -27,11 +28,18 @@ static uint8_t rx_buffer[2048];
 
 // Unified NIC functions
 static bool nic_send(const void* data, uint16_t length) {
+    // The TX ring is shared by task context and the NET_RX softirq (ACKs,
+    // ARP replies), and the drivers busy-wait on the descriptor: keep
+    // softirqs and preemption off for the whole send
+    bool sent;
+    local_bh_disable();
     switch (g_active_nic) {
-        case NIC_E1000:   return e1000_send(data, length);
-        case NIC_RTL8139: return rtl8139_send(data, length);
-        default:          return false;
+        case NIC_E1000:   sent = e1000_send(data, length); break;
+        case NIC_RTL8139: sent = rtl8139_send(data, length); break;
+        default:          sent = false; break;
     }
+    local_bh_enable();
+    return sent;
 }
 
 static int nic_receive(void* buffer, uint16_t max_length) {
@@ -105,6 +113,11 @@ bool net_init() {
 }
 
 void net_poll() {
+    // The NET_RX softirq and tasks waiting on a reply (DHCP, DNS, ARP, TCP)
+    // both poll; with softirqs off a task's poll can't be interleaved with
+    // the softirq's (or preempted halfway through the RX ring)
+    local_bh_disable();
+    
     // Poll the active NIC
     nic_poll();
     
@@ -113,6 +126,8 @@ void net_poll() {
     while ((len = nic_receive(rx_buffer, sizeof(rx_buffer))) > 0) {
         ethernet_receive(rx_buffer, len);
     }
+    
+    local_bh_enable();
 }
 
 // Configuration getters
@@ -0,0 +1,255 @@
+#include "socket.h"
+#include "vfs.h"
+#include "tcp.h"
+#include "udp.h"
+#include "heap.h"
+#include "uaccess.h"
+
+struct SocketHandle {
+    int type;           // SOCK_STREAM or SOCK_DGRAM
+    int sock;           // Index in the protocol's socket table (-1 = none yet)
+    uint32_t peer_ip;   // UDP destination set by connect
+    uint16_t peer_port;
+};
+
+// Local ports for UDP sockets that send before binding
+#define UDP_EPHEMERAL_MIN 49152
+static uint16_t next_udp_port = UDP_EPHEMERAL_MIN;
+
+// Clamp a byte count to the 16-bit lengths used by the protocol layers
+static uint16_t clamp_len(uint64_t count) {
+    return (count > 0xFFFF) ? 0xFFFF : (uint16_t)count;
+}
+
+// The protocol layers copy with plain memcpy, so user data is staged
+// through a heap bounce buffer (at most 64 KB, their length limit)
+static void* bounce_alloc(uint16_t len) {
+    return malloc(len ? len : 1);
+}
+
+// Copy a user buffer into a fresh bounce buffer (nullptr on fault/OOM)
+static void* bounce_in(const void* buf, uint16_t len) {
+    void* bounce = bounce_alloc(len);
+    if (bounce && copy_from_user(bounce, buf, len) < 0) {
+        free(bounce);
+        return nullptr;
+    }
+    return bounce;
+}
+
+// Hand received bytes back to the user and free the bounce buffer
+static int64_t bounce_out(void* buf, void* bounce, int64_t n) {
+    if (n > 0 && copy_to_user(buf, bounce, n) < 0) n = -EFAULT;
+    free(bounce);
+    return n;
+}
+
+// ============================================================================
+// TCP
+// ============================================================================
+
+static int64_t tcp_file_read(File* f, void* buf, uint64_t count, uint64_t*, uint32_t) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    uint16_t len = clamp_len(count);
+    if (!user_range_ok(buf, len)) return -EFAULT;
+    
+    void* bounce = bounce_alloc(len);
+    if (!bounce) return -1;
+    return bounce_out(buf, bounce, tcp_recv(h->sock, bounce, len));
+}
+
+static int64_t tcp_file_write(File* f, const void* buf, uint64_t count, uint64_t*, uint32_t) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    uint16_t len = clamp_len(count);
+    
+    void* bounce = bounce_in(buf, len);
+    if (!bounce) return -EFAULT;
+    int64_t n = tcp_send(h->sock, bounce, len);
+    free(bounce);
+    return n;
+}
+
+static uint32_t tcp_file_poll(File* f) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    uint32_t events = 0;
+    if (tcp_rx_available(h->sock) > 0) events |= POLLIN;
+    
+    switch (tcp_get_state(h->sock)) {
+        case TCP_LISTEN:
+            if (tcp_accept_pending(h->sock)) events |= POLLIN;
+            break;
+        case TCP_ESTABLISHED:
+            events |= POLLOUT;
+            break;
+        case TCP_CLOSE_WAIT:
+        case TCP_CLOSED:
+            events |= POLLHUP;
+            break;
+        default:
+            break;
+    }
+    return events;
+}
+
+static PollQueue* tcp_file_poll_queue(File* f) {
+    return tcp_poll_queue(((SocketHandle*)f->priv)->sock);
+}
+
+static void tcp_file_release(File* f) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    tcp_close(h->sock);
+    free(h);
+}
+
+static const FileOps tcp_file_ops = {
+    tcp_file_read, tcp_file_write, nullptr, nullptr, tcp_file_poll, tcp_file_poll_queue,
+    tcp_file_release,
+};
+
+// ============================================================================
+// UDP
+// ============================================================================
+
+// Allocate and bind the UDP socket on first use
+static bool udp_ensure_bound(SocketHandle* h, uint16_t port) {
+    if (h->sock >= 0) return true;
+    
+    int sock = udp_socket();
+    if (sock < 0) return false;
+    
+    if (port == 0) {
+        port = next_udp_port++;
+        if (next_udp_port < UDP_EPHEMERAL_MIN) next_udp_port = UDP_EPHEMERAL_MIN;
+    }
+    if (!udp_bind(sock, port)) return false;
+    
+    h->sock = sock;
+    return true;
+}
+
+static int64_t udp_file_read(File* f, void* buf, uint64_t count, uint64_t*, uint32_t) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    if (h->sock < 0) return -1;
+    
+    uint16_t len = clamp_len(count);
+    if (!user_range_ok(buf, len)) return -EFAULT;
+    
+    void* bounce = bounce_alloc(len);
+    if (!bounce) return -1;
+    return bounce_out(buf, bounce, udp_recvfrom(h->sock, bounce, len, nullptr, nullptr));
+}
+
+static int64_t udp_file_write(File* f, const void* buf, uint64_t count, uint64_t*, uint32_t) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    if (h->peer_port == 0 || !udp_ensure_bound(h, 0)) return -1;
+    
+    uint16_t len = clamp_len(count);
+    void* bounce = bounce_in(buf, len);
+    if (!bounce) return -EFAULT;
+    
+    bool sent = udp_sendto(h->sock, h->peer_ip, h->peer_port, bounce, len);
+    free(bounce);
+    return sent ? len : -1;
+}
+
+static uint32_t udp_file_poll(File* f) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    uint32_t events = POLLOUT;
+    if (udp_rx_pending(h->sock)) events |= POLLIN;
+    return events;
+}
+
+static PollQueue* udp_file_poll_queue(File* f) {
+    // Unbound sockets can't receive until bind/connect (callers re-poll)
+    return udp_poll_queue(((SocketHandle*)f->priv)->sock);
+}
+
+static void udp_file_release(File* f) {
+    SocketHandle* h = (SocketHandle*)f->priv;
+    if (h->sock >= 0) udp_close(h->sock);
+    free(h);
+}
+
+static const FileOps udp_file_ops = {
+    udp_file_read, udp_file_write, nullptr, nullptr, udp_file_poll, udp_file_poll_queue,
+    udp_file_release,
+};
+
+// ============================================================================
+// Socket Calls
+// ============================================================================
+
+static File* socket_wrap(int type, int sock) {
+    SocketHandle* h = (SocketHandle*)malloc(sizeof(SocketHandle));
+    if (!h) return nullptr;
+    h->type = type;
+    h->sock = sock;
+    h->peer_ip = 0;
+    h->peer_port = 0;
+    
+    File* f = file_alloc(type == SOCK_STREAM ? &tcp_file_ops : &udp_file_ops, h, O_RDWR);
+    if (!f) free(h);
+    return f;
+}
+
+// Socket state behind f, or nullptr if f is something else
+static SocketHandle* socket_of(File* f) {
+    if (f->ops != &tcp_file_ops && f->ops != &udp_file_ops) return nullptr;
+    return (SocketHandle*)f->priv;
+}
+
+File* socket_open_file(int type) {
+    if (type == SOCK_DGRAM) {
+        // The UDP table has no "allocated but unbound" state, so the socket
+        // is only claimed by bind/connect
+        return socket_wrap(SOCK_DGRAM, -1);
+    }
+    if (type != SOCK_STREAM) return nullptr;
+    
+    int sock = tcp_socket();
+    if (sock < 0) return nullptr;
+    
+    File* f = socket_wrap(SOCK_STREAM, sock);
+    if (!f) tcp_close(sock);
+    return f;
+}
+
+int socket_bind(File* f, uint16_t port) {
+    SocketHandle* h = socket_of(f);
+    if (!h) return -1;
+    
+    if (h->type == SOCK_STREAM) return tcp_bind(h->sock, port) ? 0 : -1;
+    if (h->sock >= 0) return -1;  // Already bound
+    return udp_ensure_bound(h, port) ? 0 : -1;
+}
+
+int socket_listen(File* f) {
+    SocketHandle* h = socket_of(f);
+    if (!h || h->type != SOCK_STREAM) return -1;
+    return tcp_listen(h->sock) ? 0 : -1;
+}
+
+int socket_connect(File* f, uint32_t ip, uint16_t port) {
+    SocketHandle* h = socket_of(f);
+    if (!h) return -1;
+    
+    if (h->type == SOCK_STREAM) return tcp_connect(h->sock, ip, port) ? 0 : -1;
+    
+    // UDP: just remember the peer for write()
+    if (!udp_ensure_bound(h, 0)) return -1;
+    h->peer_ip = ip;
+    h->peer_port = port;
+    return 0;
+}
+
+File* socket_accept(File* f) {
+    SocketHandle* h = socket_of(f);
+    if (!h || h->type != SOCK_STREAM) return nullptr;
+    
+    int sock = tcp_accept(h->sock);
+    if (sock < 0) return nullptr;
+    
+    File* conn = socket_wrap(SOCK_STREAM, sock);
+    if (!conn) tcp_close(sock);
+    return conn;
+}
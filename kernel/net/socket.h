@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+
+// ============================================================================
+// Sockets as VFS Files
+// ============================================================================
+// Wraps the TCP and UDP socket APIs in File objects so user programs reach
+// them through ordinary descriptors: read/write for data, close to tear
+// down. A UDP socket must be connect()ed before write() knows where to send.
+// ============================================================================
+
+#define AF_INET     2
+#define SOCK_STREAM 1   // TCP
+#define SOCK_DGRAM  2   // UDP
+
+// Linux struct sockaddr_in (port and address in network byte order)
+struct SockAddrIn {
+    uint16_t family;
+    uint16_t port;
+    uint32_t addr;
+    uint8_t zero[8];
+} __attribute__((packed));
+
+struct File;
+
+// New unconnected socket of the given type. Returns nullptr on failure.
+File* socket_open_file(int type);
+
+// Socket calls on a File; each returns 0 (or a new File) on success and -1
+// (nullptr) on failure, including when f is not a socket. Ports are in host
+// byte order, addresses as stored by the IP layer.
+int socket_bind(File* f, uint16_t port);
+int socket_listen(File* f);
+int socket_connect(File* f, uint32_t ip, uint16_t port);
+File* socket_accept(File* f);
@@ -34,8 +34,8 @@
 #include "timer.h"
 #include "debug.h"
 #include "heap.h"
-#include "scheduler.h"
 #include "spinlock.h"
+#include "poll.h"
 
 static TcpSocket sockets[TCP_MAX_SOCKETS];
 
@@ -48,6 +48,7 @@ void tcp_init() {
     for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
         sockets[i].in_use = false;
         sockets[i].state = TCP_CLOSED;
+        poll_queue_init(&sockets[i].poll);  // Only here: hooks belong to Files, not connections
     }
     DEBUG_INFO("TCP: Layer initialized (%d sockets)", TCP_MAX_SOCKETS);
 }
@@ -129,11 +130,18 @@ static bool tcp_send_segment(TcpSocket* sock, uint8_t flags, const void* data, u
     return result;
 }
 
+// Slots are static and never freed, so lookups need no reclamation: a
+// socket's fields are filled in before in_use is published with a release
+// store, and the lookup's acquire load sees them complete.
+static inline bool socket_live(TcpSocket* s) {
+    return __atomic_load_n(&s->in_use, __ATOMIC_ACQUIRE);
+}
+
 // Find socket for incoming segment
 static TcpSocket* tcp_find_socket(uint32_t src_ip, uint16_t src_port, uint16_t dst_port) {
     // First, look for established connection
     for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
-        if (sockets[i].in_use && 
+        if (socket_live(&sockets[i]) && 
             sockets[i].state != TCP_LISTEN &&
             sockets[i].local_port == dst_port &&
             sockets[i].remote_port == src_port &&
@@ -144,7 +152,7 @@ static TcpSocket* tcp_find_socket(uint32_t src_ip, uint16_t src_port, uint16_t d
     
     // Then look for listening socket
     for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
-        if (sockets[i].in_use &&
+        if (socket_live(&sockets[i]) &&
             sockets[i].state == TCP_LISTEN &&
             sockets[i].local_port == dst_port) {
             return &sockets[i];
@@ -154,6 +162,18 @@ static TcpSocket* tcp_find_socket(uint32_t src_ip, uint16_t src_port, uint16_t d
     return nullptr;
 }
 
+// A connection on a listener's port finished its handshake: wake accept()
+static void tcp_notify_listener(uint16_t port) {
+    for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
+        if (socket_live(&sockets[i]) &&
+            sockets[i].state == TCP_LISTEN &&
+            sockets[i].local_port == port) {
+            poll_notify(&sockets[i].poll, POLLIN);
+            return;
+        }
+    }
+}
+
 // Receive TCP segment
 void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t dst_ip) {
     if (length < TCP_HEADER_SIZE) {
@@ -194,7 +214,6 @@ void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
                 }
                 if (new_idx >= 0) {
                     TcpSocket* new_sock = &sockets[new_idx];
-                    new_sock->in_use = true;
                     new_sock->state = TCP_SYN_RECEIVED;
                     new_sock->local_port = dst_port;
                     new_sock->remote_port = src_port;
@@ -203,6 +222,8 @@ void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
                     new_sock->seq_num = timer_get_ticks() & 0xFFFFFFFF;
                     new_sock->send_next = new_sock->seq_num;
                     new_sock->rx_head = new_sock->rx_tail = 0;
+                    new_sock->unaccepted = true;
+                    __atomic_store_n(&new_sock->in_use, true, __ATOMIC_RELEASE);
                     
                     // Send SYN-ACK
                     tcp_send_segment(new_sock, TCP_FLAG_SYN | TCP_FLAG_ACK, nullptr, 0);
@@ -217,6 +238,7 @@ void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
                 sock->ack_num = seq + 1;
                 sock->state = TCP_ESTABLISHED;
                 tcp_send_segment(sock, TCP_FLAG_ACK, nullptr, 0);
+                poll_notify(&sock->poll, POLLOUT);
                 DEBUG_INFO("TCP: Connection established (client)");
             }
             break;
@@ -224,6 +246,7 @@ void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
         case TCP_SYN_RECEIVED:
             if (flags & TCP_FLAG_ACK) {
                 sock->state = TCP_ESTABLISHED;
+                tcp_notify_listener(sock->local_port);
                 DEBUG_INFO("TCP: Connection established (server)");
             }
             break;
@@ -254,6 +277,10 @@ void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
                 tcp_send_segment(sock, TCP_FLAG_ACK, nullptr, 0);
                 sock->pending_ack = false;
             }
+            
+            if (payload_len > 0 || (flags & TCP_FLAG_FIN)) {
+                poll_notify(&sock->poll, (flags & TCP_FLAG_FIN) ? (POLLIN | POLLHUP) : POLLIN);
+            }
             break;
             
         case TCP_FIN_WAIT_1:
@@ -314,9 +341,10 @@ void tcp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
 int tcp_socket() {
     for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
         if (!sockets[i].in_use) {
-            sockets[i].in_use = true;
             sockets[i].state = TCP_CLOSED;
             sockets[i].rx_head = sockets[i].rx_tail = 0;
+            sockets[i].unaccepted = false;
+            __atomic_store_n(&sockets[i].in_use, true, __ATOMIC_RELEASE);
             return i;
         }
     }
@@ -348,12 +376,14 @@ int tcp_accept(int sock) {
         return -1;
     }
     
-    // Look for established connection on same port
+    // Look for an established connection on the same port that nobody has
+    // taken yet
     uint16_t port = sockets[sock].local_port;
     for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
-        if (i != sock && sockets[i].in_use && 
+        if (i != sock && sockets[i].in_use && sockets[i].unaccepted &&
             sockets[i].local_port == port &&
             sockets[i].state == TCP_ESTABLISHED) {
+            sockets[i].unaccepted = false;
             return i;
         }
     }
@@ -361,6 +391,24 @@ int tcp_accept(int sock) {
     return -1;  // No connection ready
 }
 
+// Whether tcp_accept would return a connection now
+bool tcp_accept_pending(int sock) {
+    if (sock < 0 || sock >= TCP_MAX_SOCKETS ||
+        !sockets[sock].in_use || sockets[sock].state != TCP_LISTEN) {
+        return false;
+    }
+    
+    uint16_t port = sockets[sock].local_port;
+    for (int i = 0; i < TCP_MAX_SOCKETS; i++) {
+        if (i != sock && sockets[i].in_use && sockets[i].unaccepted &&
+            sockets[i].local_port == port &&
+            sockets[i].state == TCP_ESTABLISHED) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Connect to remote host
 bool tcp_connect(int sock, uint32_t dst_ip, uint16_t dst_port) {
     if (sock < 0 || sock >= TCP_MAX_SOCKETS || !sockets[sock].in_use) {
@@ -382,15 +430,21 @@ bool tcp_connect(int sock, uint32_t dst_ip, uint16_t dst_port) {
     // Send SYN
     tcp_send_segment(s, TCP_FLAG_SYN, nullptr, 0);
     
-    // Wait for connection (with timeout)
-    uint64_t start = timer_get_ticks();
-    uint64_t timeout = (5000 * timer_get_frequency()) / 1000;  // 5 seconds
-    
-    while (s->state == TCP_SYN_SENT && (timer_get_ticks() - start) < timeout) {
-        net_poll();
-        scheduler_yield();  // Yield CPU instead of busy-wait
+    // Sleep until the handshake completes (the NET_RX softirq processes the
+    // SYN-ACK and notifies the socket) or 5 seconds pass
+    PollWaiter waiter;
+    PollHook hook;
+    poll_waiter_init(&waiter);
+    poll_waiter_attach(&waiter, &hook, &s->poll, POLLOUT);
+    
+    uint64_t deadline = timer_get_ticks() + poll_ms_to_ticks(5000);
+    while (s->state == TCP_SYN_SENT) {
+        uint64_t now = timer_get_ticks();
+        if (now >= deadline) break;
+        poll_waiter_sleep(&waiter, deadline - now);
     }
     
+    poll_hook_remove(&hook);
     return s->state == TCP_ESTABLISHED;
 }
 
@@ -463,3 +517,20 @@ TcpState tcp_get_state(int sock) {
     }
     return sockets[sock].state;
 }
+
+// Bytes ready for tcp_recv
+uint16_t tcp_rx_available(int sock) {
+    if (sock < 0 || sock >= TCP_MAX_SOCKETS || !sockets[sock].in_use) {
+        return 0;
+    }
+    TcpSocket* s = &sockets[sock];
+    return (s->rx_head - s->rx_tail + TCP_RX_BUFFER_SIZE) % TCP_RX_BUFFER_SIZE;
+}
+
+// Queue notified when this socket's poll state changes
+PollQueue* tcp_poll_queue(int sock) {
+    if (sock < 0 || sock >= TCP_MAX_SOCKETS) {
+        return nullptr;
+    }
+    return &sockets[sock].poll;
+}
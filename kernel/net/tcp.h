@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include "poll.h"
 
 // TCP Header flags
 #define TCP_FLAG_FIN    0x01
@@ -65,6 +66,9 @@ struct TcpSocket {
     // Connection tracking
     bool pending_ack;
     uint64_t last_activity;
+    bool unaccepted;        // Came in on a listener, not yet taken by accept
+    
+    PollQueue poll;         // Readiness changes (POLLIN/POLLOUT/POLLHUP)
 };
 
 // TCP functions
@@ -81,3 +85,6 @@ int tcp_send(int sock, const void* data, uint16_t length);
 int tcp_recv(int sock, void* buffer, uint16_t max_len);
 void tcp_close(int sock);
 TcpState tcp_get_state(int sock);
+uint16_t tcp_rx_available(int sock);  // Bytes waiting in the receive buffer
+bool tcp_accept_pending(int sock);    // A listener has a connection for tcp_accept
+PollQueue* tcp_poll_queue(int sock);  // Notified on readiness changes (nullptr if invalid)
@@ -4,6 +4,7 @@
 #include "net.h"
 #include "debug.h"
 #include "heap.h"
+#include "poll.h"
 
 static UdpSocket sockets[UDP_MAX_SOCKETS];
 
@@ -11,6 +12,7 @@ void udp_init() {
     for (int i = 0; i < UDP_MAX_SOCKETS; i++) {
         sockets[i].bound = false;
         sockets[i].rx_ready = false;
+        poll_queue_init(&sockets[i].poll);
     }
     DEBUG_INFO("UDP: Layer initialized (%d sockets)", UDP_MAX_SOCKETS);
 }
@@ -79,7 +81,7 @@ void udp_receive(const void* data, uint16_t length, uint32_t src_ip, uint32_t ds
             sockets[i].rx_src_port = src_port;
             sockets[i].rx_ready = true;
             
-
+            poll_notify(&sockets[i].poll, POLLIN);
             return;
         }
     }
@@ -203,3 +205,17 @@ void udp_close(int sock) {
         sockets[sock].rx_ready = false;
     }
 }
+
+bool udp_rx_pending(int sock) {
+    if (sock < 0 || sock >= UDP_MAX_SOCKETS) {
+        return false;
+    }
+    return sockets[sock].bound && sockets[sock].rx_ready;
+}
+
+PollQueue* udp_poll_queue(int sock) {
+    if (sock < 0 || sock >= UDP_MAX_SOCKETS) {
+        return nullptr;
+    }
+    return &sockets[sock].poll;
+}
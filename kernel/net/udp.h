@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include "poll.h"
 
 // UDP Header
 struct UdpHeader {
@@ -23,6 +24,8 @@ struct UdpSocket {
     uint32_t rx_src_ip;
     uint16_t rx_src_port;
     bool rx_ready;
+    
+    PollQueue poll;         // Notified when a datagram arrives
 };
 
 // UDP functions
@@ -36,3 +39,5 @@ bool udp_bind(int sock, uint16_t port);
 bool udp_sendto(int sock, uint32_t dst_ip, uint16_t dst_port, const void* data, uint16_t length);
 int udp_recvfrom(int sock, void* buffer, uint16_t max_len, uint32_t* src_ip, uint16_t* src_port);
 void udp_close(int sock);
+bool udp_rx_pending(int sock);  // A datagram is waiting for udp_recvfrom
+PollQueue* udp_poll_queue(int sock);  // Notified on arrivals (nullptr if invalid)
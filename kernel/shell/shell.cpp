@@ -4,6 +4,7 @@
 #include "fs/unifs.h"
 #include "mem/pmm.h"
 #include "arch/io.h"
+#include "arch/fpu.h"
 #include "drivers/acpi.h"
 #include "drivers/timer.h"
 #include "drivers/input.h"
@@ -22,9 +23,13 @@
 #include "core/debug.h"
 #include "core/process.h"
 #include "core/syscall.h"
+#include "core/lockstat.h"
+#include "core/softirq.h"
+#include "core/workqueue.h"
 #include <stddef.h>
 
 #include "sound.h"
+#include "block.h"
 
 // Use shared string utilities
 using kstring::strcmp;
@@ -754,12 +759,14 @@ static void cmd_run(const char* filename) {
     // storage that could be affected by nested file operations.
     char* script_data = (char*)malloc(file.size + 1);
     if (!script_data) {
+        unifs_close_into(&file);
         g_terminal.write_line("Out of memory for script");
         last_exit_status = 1;
         return;
     }
     kstring::memcpy(script_data, file.data, file.size);
     script_data[file.size] = '\0';
+    unifs_close_into(&file);
     
     // Parse script_data into lines
     uint64_t size = file.size;
@@ -826,15 +833,19 @@ static void cmd_run(const char* filename) {
 
 static void cmd_help() {
     g_terminal.write_line("File Commands:");
-    g_terminal.write_line("  ls        - List files with sizes");
+    g_terminal.write_line("  ls [dir]  - List files with sizes");
     g_terminal.write_line("  cat <f>   - Show file contents");
     g_terminal.write_line("  stat <f>  - Show file information");
     g_terminal.write_line("  hexdump <f> - Hex dump of file");
     g_terminal.write_line("  touch <f> - Create empty file");
     g_terminal.write_line("  rm <f>    - Delete file");
+    g_terminal.write_line("  mkdir <d> - Create directory");
+    g_terminal.write_line("  rmdir <d> - Delete empty directory");
     g_terminal.write_line("  write <f> <text> - Write text to file");
     g_terminal.write_line("  append <f> <text> - Append text to file");
     g_terminal.write_line("  df        - Show filesystem stats");
+    g_terminal.write_line("  fsck      - Verify boot image checksums");
+    g_terminal.write_line("  sync      - Save RAM files to disk");
     g_terminal.write_line("");
     g_terminal.write_line("System Commands:");
     g_terminal.write_line("  mem       - Show memory usage");
@@ -844,6 +855,11 @@ static void cmd_help() {
     g_terminal.write_line("  uname     - System information");
     g_terminal.write_line("  cpuinfo   - CPU information");
     g_terminal.write_line("  lspci     - List PCI devices");
+    g_terminal.write_line("  lsblk     - List disks and I/O stats");
+    g_terminal.write_line("  nice <pid> <n> - Set task priority (-20..19)");
+    g_terminal.write_line("  lockstat [reset] - Lock contention stats");
+    g_terminal.write_line("  softirqs         - Deferred work counters");
+    g_terminal.write_line("  latency [reset]  - Scheduling latency trace");
     g_terminal.write_line("");
     g_terminal.write_line("Network Commands:");
     g_terminal.write_line("  ifconfig  - Show network config");
@@ -909,24 +925,32 @@ static void cmd_help() {
     g_terminal.write_line("  Shift+Arrows - Select text");
 }
 
-static void cmd_ls() {
-    uint64_t count = unifs_get_file_count();
+static void cmd_ls(const char* path) {
+    if (!*path) path = "/";
     
-    if (count == 0) {
-        g_terminal.write_line("No files.");
+    if (!unifs_is_dir(path)) {
+        error_file_not_found(path);
         return;
     }
     
-    for (uint64_t i = 0; i < count; i++) {
-        const char* name = unifs_get_file_name(i);
-        uint64_t size = unifs_get_file_size_by_index(i);
-        int type = unifs_get_file_type(name);
+    // Listed in chunks so the directory can be any size
+    UnifsDirEntry entries[8];
+    uint64_t index = 0;
+    for (;;) {
+        int64_t n = unifs_read_dir(path, index, entries, 8);
+        if (n <= 0) break;
+        index += n;
         
-        if (name) {
+        for (int64_t e = 0; e < n; e++) {
+            const char* name = entries[e].name;
+            uint64_t size = entries[e].size;
+            
             // Format size (right-aligned in 8 chars)
             char size_str[16];
             int si = 0;
-            if (size >= 1024) {
+            if (entries[e].is_dir) {
+                size_str[si++] = '-';
+            } else if (size >= 1024) {
                 uint64_t kb = size / 1024;
                 if (kb >= 1000) size_str[si++] = '0' + (kb / 1000) % 10;
                 if (kb >= 100) size_str[si++] = '0' + (kb / 100) % 10;
@@ -942,9 +966,24 @@ static void cmd_ls() {
             }
             size_str[si] = 0;
             
-            // Type indicator
+            // Type indicator (the type check wants the full path)
+            int type = UNIFS_TYPE_DIR;
+            if (!entries[e].is_dir) {
+                char full[UNIFS_MAX_PATH + 1];
+                uint64_t plen = strlen(path);
+                if (plen + 1 + strlen(name) > UNIFS_MAX_PATH) {
+                    type = UNIFS_TYPE_UNKNOWN;
+                } else {
+                    strcpy(full, path);
+                    if (plen == 0 || full[plen - 1] != '/') full[plen++] = '/';
+                    strcpy(full + plen, name);
+                    type = unifs_get_file_type(full);
+                }
+            }
+            
             const char* type_str;
             switch (type) {
+                case UNIFS_TYPE_DIR:  type_str = "[DIR]"; break;
                 case UNIFS_TYPE_TEXT: type_str = "[TXT]"; break;
                 case UNIFS_TYPE_ELF:  type_str = "[ELF]"; break;
                 case UNIFS_TYPE_BINARY: type_str = "[BIN]"; break;
@@ -959,9 +998,12 @@ static void cmd_ls() {
             for (int p = si; p < 6; p++) g_terminal.write(" ");
             g_terminal.write(size_str);
             g_terminal.write("  ");
-            g_terminal.write_line(name);
+            g_terminal.write(name);
+            g_terminal.write_line(entries[e].is_dir ? "/" : "");
         }
     }
+    
+    if (index == 0) g_terminal.write_line("No files.");
 }
 
 static void cmd_stat(const char* filename) {
@@ -1056,6 +1098,7 @@ static void cmd_hexdump(const char* filename) {
     if (file.size > 256) {
         g_terminal.write_line("... (truncated, showing first 256 bytes)");
     }
+    unifs_close_into(&file);
 }
 
 static void cmd_cat(const char* filename) {
@@ -1064,6 +1107,7 @@ static void cmd_cat(const char* filename) {
         // Check if it's a text file
         if (unifs_get_file_type(filename) != UNIFS_TYPE_TEXT) {
             g_terminal.write_line("Binary file, use 'hexdump' instead.");
+            unifs_close_into(&file);
             return;
         }
         
@@ -1092,6 +1136,7 @@ static void cmd_cat(const char* filename) {
                     // Allow quitting with 'q'
                     if (c == 'q' || c == 'Q') {
                         g_terminal.write("\n");
+                        unifs_close_into(&file);
                         return;
                     }
                     
@@ -1100,6 +1145,7 @@ static void cmd_cat(const char* filename) {
             }
         }
         g_terminal.write("\n");
+        unifs_close_into(&file);
     } else {
         error_file_not_found(filename);
     }
@@ -1115,8 +1161,9 @@ static void cmd_touch(const char* filename) {
         case UNIFS_ERR_EXISTS:
             g_terminal.write_line("File already exists.");
             break;
-        case UNIFS_ERR_FULL:
-            g_terminal.write_line("Filesystem full (max 64 files).");
+        case UNIFS_ERR_NOT_FOUND:
+        case UNIFS_ERR_NOT_DIR:
+            g_terminal.write_line("No such directory.");
             break;
         case UNIFS_ERR_NAME_TOO_LONG:
             g_terminal.write_line("Filename too long (max 63 chars).");
@@ -1126,6 +1173,52 @@ static void cmd_touch(const char* filename) {
     }
 }
 
+static void cmd_mkdir(const char* path) {
+    int result = unifs_mkdir(path);
+    switch (result) {
+        case UNIFS_OK:
+            g_terminal.write("Created: ");
+            g_terminal.write_line(path);
+            break;
+        case UNIFS_ERR_EXISTS:
+            g_terminal.write_line("Already exists.");
+            break;
+        case UNIFS_ERR_NOT_FOUND:
+        case UNIFS_ERR_NOT_DIR:
+            g_terminal.write_line("No such directory.");
+            break;
+        case UNIFS_ERR_NAME_TOO_LONG:
+            g_terminal.write_line("Name too long (max 63 chars).");
+            break;
+        default:
+            g_terminal.write_line("Error creating directory.");
+    }
+}
+
+static void cmd_rmdir(const char* path) {
+    int result = unifs_rmdir(path);
+    switch (result) {
+        case UNIFS_OK:
+            g_terminal.write("Deleted: ");
+            g_terminal.write_line(path);
+            break;
+        case UNIFS_ERR_NOT_FOUND:
+            error_file_not_found(path);
+            break;
+        case UNIFS_ERR_NOT_DIR:
+            g_terminal.write_line("Not a directory.");
+            break;
+        case UNIFS_ERR_NOT_EMPTY:
+            g_terminal.write_line("Directory not empty.");
+            break;
+        case UNIFS_ERR_READONLY:
+            g_terminal.write_line("Cannot delete the root directory.");
+            break;
+        default:
+            g_terminal.write_line("Error deleting directory.");
+    }
+}
+
 static void cmd_rm(const char* filename) {
     int result = unifs_delete(filename);
     switch (result) {
@@ -1142,6 +1235,9 @@ static void cmd_rm(const char* filename) {
         case UNIFS_ERR_IN_USE:
             g_terminal.write_line("Cannot delete: file is currently open.");
             break;
+        case UNIFS_ERR_IS_DIR:
+            g_terminal.write_line("Is a directory (use rmdir).");
+            break;
         default:
             g_terminal.write_line("Error deleting file.");
     }
@@ -1190,9 +1286,9 @@ static void cmd_write(const char* args) {
     }
     
     // Extract filename
-    char filename[64];
+    char filename[UNIFS_MAX_PATH + 1];
     int len = space - args;
-    if (len > 63) len = 63;
+    if (len > UNIFS_MAX_PATH) len = UNIFS_MAX_PATH;
     for (int i = 0; i < len; i++) filename[i] = args[i];
     filename[len] = 0;
     
@@ -1241,8 +1337,8 @@ static void cmd_write(const char* args) {
         case UNIFS_ERR_NO_MEMORY:
             g_terminal.write_line("Out of memory or file too large.");
             break;
-        case UNIFS_ERR_FULL:
-            g_terminal.write_line("Filesystem full.");
+        case UNIFS_ERR_IS_DIR:
+            g_terminal.write_line("Is a directory.");
             break;
         default:
             g_terminal.write_line("Error writing file.");
@@ -1260,9 +1356,9 @@ static void cmd_append(const char* args) {
     }
     
     // Extract filename
-    char filename[64];
+    char filename[UNIFS_MAX_PATH + 1];
     int len = space - args;
-    if (len > 63) len = 63;
+    if (len > UNIFS_MAX_PATH) len = UNIFS_MAX_PATH;
     for (int i = 0; i < len; i++) filename[i] = args[i];
     filename[len] = 0;
     
@@ -1318,8 +1414,6 @@ static void cmd_append(const char* args) {
 
 static void cmd_df() {
     uint64_t total = unifs_get_total_size();
-    uint64_t free_slots = unifs_get_free_slots();
-    uint64_t file_count = unifs_get_file_count();
     
     char buf[128];
     int i = 0;
@@ -1332,9 +1426,8 @@ static void cmd_df() {
         while (j-- > 0) buf[i++] = tmp[j];
     };
     
-    // Calculate boot vs RAM files (boot files have is_boot flag in uniFS)
     uint64_t boot_file_count = unifs_get_boot_file_count();
-    uint64_t ram_file_count = file_count > boot_file_count ? file_count - boot_file_count : 0;
+    uint64_t ram_file_count = unifs_get_ram_file_count();
     
     // Filesystem summary
     g_terminal.write_line("uniFS Status:");
@@ -1349,8 +1442,6 @@ static void cmd_df() {
     i = 0;
     append_str("  RAM:   ");
     append_num(ram_file_count);
-    append_str(" / ");
-    append_num(64);  // UNIFS_MAX_FILES
     append_str(" files");
     buf[i] = 0;
     g_terminal.write_line(buf);
@@ -1366,6 +1457,150 @@ static void cmd_df() {
     }
     buf[i] = 0;
     g_terminal.write_line(buf);
+    
+    i = 0;
+    append_str("  Cache: ");
+    append_num(unifs_get_cache_size() / 1024);
+    append_str(" KB (inflated boot files)");
+    buf[i] = 0;
+    g_terminal.write_line(buf);
+
+    UnifsShareStats share;
+    unifs_get_share_stats(&share);
+    i = 0;
+    append_str("  Dedup: ");
+    append_num(share.saved / 1024);
+    append_str(" KB saved (");
+    append_num(share.refs);
+    append_str(" RAM pages on ");
+    append_num(share.pages);
+    append_str(" shared, ");
+    append_num(share.boot_pages);
+    append_str(" from boot)");
+    buf[i] = 0;
+    g_terminal.write_line(buf);
+
+    UnifsStoreInfo store;
+    i = 0;
+    append_str("  Disk:  ");
+    if (unifs_get_store_info(&store)) {
+        append_str(store.device);
+        append_str(", ");
+        append_num(store.image_size / 1024);
+        append_str(" KB saved (sync ");
+        append_num(store.generation);
+        append_str(")");
+    } else {
+        append_str("none (RAM files are lost on reboot)");
+    }
+    buf[i] = 0;
+    g_terminal.write_line(buf);
+}
+
+static void fsck_report(const char* path, const char* problem) {
+    g_terminal.write("  ");
+    if (*path) {
+        g_terminal.write(path);
+        g_terminal.write(": ");
+    }
+    g_terminal.write_line(problem);
+}
+
+static void cmd_fsck() {
+    g_terminal.write_line("Checking boot image...");
+    uint64_t problems = unifs_fsck(fsck_report);
+    if (problems == 0) {
+        g_terminal.write_line("No problems found.");
+    } else {
+        char buf[32];
+        int i = 0;
+        uint64_t n = problems;
+        char tmp[20]; int j = 0;
+        while (n > 0) { tmp[j++] = '0' + (n % 10); n /= 10; }
+        while (j-- > 0) buf[i++] = tmp[j];
+        buf[i] = 0;
+        g_terminal.write(buf);
+        g_terminal.write_line(" problem(s) found.");
+    }
+}
+
+static void cmd_sync() {
+    int result = unifs_sync();
+    switch (result) {
+        case UNIFS_OK:
+            g_terminal.write_line("RAM files saved.");
+            break;
+        case UNIFS_ERR_NOT_FOUND:
+            g_terminal.write_line("Error: No disk to save to.");
+            break;
+        case UNIFS_ERR_NO_SPACE:
+            g_terminal.write_line("Error: Disk is too small.");
+            break;
+        case UNIFS_ERR_NO_MEMORY:
+            g_terminal.write_line("Error: Out of memory.");
+            break;
+        default:
+            g_terminal.write_line("Error: Disk I/O failed (previous save kept).");
+    }
+}
+
+static void cmd_lsblk() {
+    uint32_t count = block_get_device_count();
+    if (count == 0) {
+        g_terminal.write_line("No disks.");
+        return;
+    }
+
+    char buf[128];
+    int i = 0;
+    auto append_str = [&](const char* s) { while (*s) buf[i++] = *s++; };
+    auto append_num = [&](uint64_t n) {
+        if (n == 0) { buf[i++] = '0'; return; }
+        char tmp[20]; int j = 0;
+        while (n > 0) { tmp[j++] = '0' + (n % 10); n /= 10; }
+        while (j-- > 0) buf[i++] = tmp[j];
+    };
+
+    for (uint32_t d = 0; d < count; d++) {
+        BlockDevice* dev = block_get_device(d);
+
+        // Format: name  size MB  depth N  irq N|polled
+        i = 0;
+        append_str(dev->name);
+        append_str("  ");
+        append_num(dev->sectors / (1024 * 1024 / BLOCK_SECTOR_SIZE));
+        append_str(" MB  depth ");
+        append_num(dev->depth);
+        if (dev->irq != BLOCK_NO_IRQ) {
+            append_str("  irq ");
+            append_num(dev->irq);
+        } else {
+            append_str("  polled");
+        }
+        buf[i] = 0;
+        g_terminal.write_line(buf);
+
+        i = 0;
+        append_str("  bios ");
+        append_num(dev->bios);
+        append_str(", merged ");
+        append_num(dev->merges);
+        append_str(", requests ");
+        append_num(dev->requests);
+        append_str(", errors ");
+        append_num(dev->errors);
+        buf[i] = 0;
+        g_terminal.write_line(buf);
+
+        i = 0;
+        append_str("  read ");
+        append_num(dev->sectors_read * BLOCK_SECTOR_SIZE / 1024);
+        append_str(" KB, written ");
+        append_num(dev->sectors_written * BLOCK_SECTOR_SIZE / 1024);
+        append_str(" KB");
+        buf[i] = 0;
+        g_terminal.write_line(buf);
+    }
 }
 
 static void cmd_mem() {
@@ -1731,12 +1966,12 @@ static void cmd_source(const char* filename) {
 // wc - Word/line/character count with formatted output
 // Usage: wc [file] or pipe: ls | wc
 static void cmd_wc(const char* filename, const char* piped_input) {
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     // Get data from file or piped input
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -1788,6 +2023,7 @@ static void cmd_wc(const char* filename, const char* piped_input) {
     append_str("  Chars: "); append_num(chars);
     buf[i] = 0;
     g_terminal.write_line(buf);
+    unifs_close_into(&file);
 }
 
 // head - Show first N lines (default 10)
@@ -1812,11 +2048,11 @@ static void cmd_head(const char* args, const char* piped_input) {
         }
     }
     
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -1842,6 +2078,7 @@ static void cmd_head(const char* args, const char* piped_input) {
     if (data_len > 0 && data[data_len - 1] != '\n' && line_count < n) {
         g_terminal.put_char('\n');
     }
+    unifs_close_into(&file);
 }
 
 // tail - Show last N lines (default 10)
@@ -1866,11 +2103,11 @@ static void cmd_tail(const char* args, const char* piped_input) {
         }
     }
     
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -1913,6 +2150,7 @@ static void cmd_tail(const char* args, const char* piped_input) {
     if (data_len > 0 && data[data_len - 1] != '\n') {
         g_terminal.put_char('\n');
     }
+    unifs_close_into(&file);
 }
 
 // Helper: case-insensitive character comparison
@@ -1948,7 +2186,7 @@ static void cmd_grep(const char* args, const char* piped_input) {
     const char* data = nullptr;
     uint64_t data_len = 0;
     
-    UniFSFile file_data;
+    UniFSFile file_data = {};
     if (filename && filename[0]) {
         if (!unifs_open_into(filename, &file_data)) {
             error_file_not_found(filename);
@@ -1965,7 +2203,10 @@ static void cmd_grep(const char* args, const char* piped_input) {
     }
     
     int pattern_len = strlen(pattern);
-    if (pattern_len == 0) return;
+    if (pattern_len == 0) {
+        unifs_close_into(&file_data);
+        return;
+    }
     
     // Process line by line
     uint64_t line_start = 0;
@@ -2004,6 +2245,7 @@ static void cmd_grep(const char* args, const char* piped_input) {
     if (matches == 0) {
         g_terminal.write_line("No matches found.");
     }
+    unifs_close_into(&file_data);
 }
 
 // sort - Sort lines alphabetically
@@ -2012,7 +2254,7 @@ static void cmd_sort(const char* filename, const char* piped_input) {
     const char* data = nullptr;
     uint64_t data_len = 0;
     
-    UniFSFile file_data;
+    UniFSFile file_data = {};
     if (filename && filename[0]) {
         if (!unifs_open_into(filename, &file_data)) {
             error_file_not_found(filename);
@@ -2028,7 +2270,10 @@ static void cmd_sort(const char* filename, const char* piped_input) {
         return;
     }
     
-    if (data_len == 0) return;
+    if (data_len == 0) {
+        unifs_close_into(&file_data);
+        return;
+    }
     
     // Count lines and store pointers
     const int MAX_LINES = 256;
@@ -2078,16 +2323,17 @@ static void cmd_sort(const char* filename, const char* piped_input) {
         }
         g_terminal.put_char('\n');
     }
+    unifs_close_into(&file_data);
 }
 
 // uniq - Remove consecutive duplicate lines
 // Usage: uniq [file] or pipe: sort data.txt | uniq
 static void cmd_uniq(const char* filename, const char* piped_input) {
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -2102,7 +2348,10 @@ static void cmd_uniq(const char* filename, const char* piped_input) {
         return;
     }
     
-    if (data_len == 0) return;
+    if (data_len == 0) {
+        unifs_close_into(&file);
+        return;
+    }
     
     const char* prev_line = nullptr;
     int prev_len = 0;
@@ -2137,16 +2386,17 @@ static void cmd_uniq(const char* filename, const char* piped_input) {
             line_start = i + 1;
         }
     }
+    unifs_close_into(&file);
 }
 
 // rev - Reverse characters in each line
 // Usage: rev [file] or pipe: echo hello | rev → olleh
 static void cmd_rev(const char* filename, const char* piped_input) {
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -2161,7 +2411,10 @@ static void cmd_rev(const char* filename, const char* piped_input) {
         return;
     }
     
-    if (data_len == 0) return;
+    if (data_len == 0) {
+        unifs_close_into(&file);
+        return;
+    }
     
     uint64_t line_start = 0;
     for (uint64_t i = 0; i <= data_len; i++) {
@@ -2174,16 +2427,17 @@ static void cmd_rev(const char* filename, const char* piped_input) {
             line_start = i + 1;
         }
     }
+    unifs_close_into(&file);
 }
 
 // tac - Print lines in reverse order (opposite of cat)
 // Usage: tac [file] or pipe: ls | tac
 static void cmd_tac(const char* filename, const char* piped_input) {
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -2198,7 +2452,10 @@ static void cmd_tac(const char* filename, const char* piped_input) {
         return;
     }
     
-    if (data_len == 0) return;
+    if (data_len == 0) {
+        unifs_close_into(&file);
+        return;
+    }
     
     // Store line positions
     const int MAX_LINES = 256;
@@ -2225,16 +2482,17 @@ static void cmd_tac(const char* filename, const char* piped_input) {
         }
         g_terminal.put_char('\n');
     }
+    unifs_close_into(&file);
 }
 
 // nl - Number lines
 // Usage: nl [file] or pipe: cat file.txt | nl
 static void cmd_nl(const char* filename, const char* piped_input) {
+    UniFSFile file = {};
     const char* data = nullptr;
     uint64_t data_len = 0;
     
     if (filename && filename[0]) {
-        UniFSFile file;
         if (!unifs_open_into(filename, &file)) {
             error_file_not_found(filename);
             return;
@@ -2249,7 +2507,10 @@ static void cmd_nl(const char* filename, const char* piped_input) {
         return;
     }
     
-    if (data_len == 0) return;
+    if (data_len == 0) {
+        unifs_close_into(&file);
+        return;
+    }
     
     int line_num = 1;
     uint64_t line_start = 0;
@@ -2282,6 +2543,7 @@ static void cmd_nl(const char* filename, const char* piped_input) {
             line_start = i + 1;
         }
     }
+    unifs_close_into(&file);
 }
 
 // tr - Translate characters (simple version: tr <from> <to>)
@@ -2388,8 +2650,18 @@ static void cmd_cpuinfo() {
     if (edx & (1 << 26)) g_terminal.write("SSE2 ");
     if (ecx & (1 << 0)) g_terminal.write("SSE3 ");
     if (ecx & (1 << 9)) g_terminal.write("SSSE3 ");
+    if (ecx & (1 << 26)) g_terminal.write("XSAVE ");
     if (ecx & (1 << 28)) g_terminal.write("AVX ");
     g_terminal.write("\n");
+    
+    // Lazy FPU context switching
+    i = 0;
+    append_str("FPU save: "); append_str(fpu_get_mode_name());
+    append_str(", "); append_num((uint32_t)fpu_get_state_size());
+    append_str(" bytes, "); append_num((uint32_t)fpu_get_restore_count());
+    append_str(" restores");
+    buf[i] = 0;
+    g_terminal.write_line(buf);
 }
 
 static void cmd_lspci() {
@@ -2675,8 +2947,8 @@ static void cmd_cat_piped(const char* input) {
 // Process Inspection (ps command)
 // =============================================================================
 static void cmd_ps() {
-    g_terminal.write_line("PID  State      Name");
-    g_terminal.write_line("---  ---------  ----------------");
+    g_terminal.write_line("PID  State       NI     TICKS  Name");
+    g_terminal.write_line("---  ---------  ---  --------  ----------------");
     
     Process* head = scheduler_get_process_list();
     if (!head) {
@@ -2710,6 +2982,26 @@ static void cmd_ps() {
         while (*state_str) buf[i++] = *state_str++;
         buf[i++] = ' '; buf[i++] = ' ';
         
+        // Nice (3 chars, right-align with sign)
+        int nice = p->nice;
+        char nice_str[4];
+        int ni = 0;
+        if (nice < 0) { nice_str[ni++] = '-'; nice = -nice; }
+        if (nice >= 10) nice_str[ni++] = '0' + nice / 10;
+        nice_str[ni++] = '0' + nice % 10;
+        for (int pad = ni; pad < 3; pad++) buf[i++] = ' ';
+        for (int k = 0; k < ni; k++) buf[i++] = nice_str[k];
+        buf[i++] = ' '; buf[i++] = ' ';
+        
+        // CPU ticks consumed (8 chars, right-align)
+        char tick_str[20];
+        int ti = 0;
+        uint64_t t = p->cpu_time;
+        do { tick_str[ti++] = '0' + t % 10; t /= 10; } while (t > 0 && ti < 8);
+        for (int pad = ti; pad < 8; pad++) buf[i++] = ' ';
+        while (ti > 0) buf[i++] = tick_str[--ti];
+        buf[i++] = ' '; buf[i++] = ' ';
+        
         // Name
         const char* n = p->name[0] ? p->name : "(unnamed)";
         while (*n && i < 60) buf[i++] = *n++;
@@ -2717,7 +3009,242 @@ static void cmd_ps() {
         
         g_terminal.write_line(buf);
         p = p->next;
-    } while (p != head);
+    } while (p != head);    
+    // Tasks already freed by the reaper thread
+    char foot[40] = "Reaped: ";
+    int fi = 8;
+    char num[20];
+    int nl = 0;
+    uint64_t reaped = scheduler_get_reaped_count();
+    do { num[nl++] = '0' + reaped % 10; reaped /= 10; } while (reaped > 0);
+    while (nl > 0) foot[fi++] = num[--nl];
+    foot[fi] = '\0';
+    g_terminal.write_line(foot);
+}
+
+// nice <pid> <level> - Set scheduling priority (-20 highest .. 19 lowest)
+static void cmd_nice(const char* args) {
+    while (*args == ' ') args++;
+    
+    if (*args < '0' || *args > '9') {
+        g_terminal.write_line("Usage: nice <pid> <level>");
+        g_terminal.write_line("  level: -20 (highest priority) .. 19 (lowest)");
+        return;
+    }
+    
+    uint64_t pid = (uint64_t)str_to_int(args);
+    while (*args >= '0' && *args <= '9') args++;
+    while (*args == ' ') args++;
+    
+    if (*args != '-' && (*args < '0' || *args > '9')) {
+        g_terminal.write_line("Usage: nice <pid> <level>");
+        return;
+    }
+    int level = str_to_int(args);
+    
+    if (level < NICE_MIN || level > NICE_MAX) {
+        g_terminal.write_line("Error: level must be between -20 and 19");
+        last_exit_status = 1;
+        return;
+    }
+    
+    if (!scheduler_set_nice(pid, level)) {
+        g_terminal.write_line("Error: no such process");
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+}
+
+// lockstat [reset] - Show contention statistics of instrumented locks
+static void cmd_lockstat(const char* args) {
+    while (args && *args == ' ') args++;
+    if (args && kstring::strcmp(args, "reset") == 0) {
+        lock_stats_reset();
+        g_terminal.write_line("Lock statistics reset");
+        return;
+    }
+    
+    LockStats* st = lock_stats_get_list();
+    if (!st) {
+        g_terminal.write_line("No instrumented locks used yet");
+        return;
+    }
+    
+    g_terminal.write_line("Lock            Acquired  Contended       Spins   MaxHold   AvgHold");
+    g_terminal.write_line("------------  ----------  ---------  ----------  --------  --------");
+    
+    for (; st; st = st->next) {
+        char buf[96];
+        int i = 0;
+        
+        // Right-aligned decimal in a fixed-width column
+        auto append_num = [&](uint64_t n, int width) {
+            char tmp[20];
+            int j = 0;
+            do { tmp[j++] = '0' + n % 10; n /= 10; } while (n > 0 && j < 20);
+            for (int pad = j; pad < width; pad++) buf[i++] = ' ';
+            while (j > 0) buf[i++] = tmp[--j];
+            buf[i++] = ' '; buf[i++] = ' ';
+        };
+        
+        const char* n = st->name ? st->name : "(unnamed)";
+        int len = 0;
+        while (*n && len < 12) { buf[i++] = *n++; len++; }
+        while (len++ < 12) buf[i++] = ' ';
+        buf[i++] = ' '; buf[i++] = ' ';
+        
+        // Snapshot: counters keep moving while we print
+        uint64_t acq = st->acquisitions;
+        uint64_t total_hold = st->total_hold;
+        append_num(acq, 10);
+        append_num(st->contended, 9);
+        append_num(st->spins, 10);
+        append_num(st->max_hold, 8);
+        append_num(acq ? total_hold / acq : 0, 8);
+        buf[i] = '\0';
+        
+        g_terminal.write_line(buf);
+    }
+    g_terminal.write_line("(hold times in TSC cycles)");
+}
+
+// softirqs - Show softirq and workqueue activity
+static void cmd_softirqs() {
+    char buf[64];
+    int i;
+    
+    auto append_num = [&](uint64_t n, int width) {
+        char tmp[20];
+        int j = 0;
+        do { tmp[j++] = '0' + n % 10; n /= 10; } while (n > 0 && j < 20);
+        for (int pad = j; pad < width; pad++) buf[i++] = ' ';
+        while (j > 0) buf[i++] = tmp[--j];
+        buf[i++] = ' '; buf[i++] = ' ';
+    };
+    auto append_name = [&](const char* n, int width) {
+        int len = 0;
+        while (*n && len < width) { buf[i++] = *n++; len++; }
+        while (len++ < width) buf[i++] = ' ';
+        buf[i++] = ' '; buf[i++] = ' ';
+    };
+    
+    g_terminal.write_line("Softirq           Runs");
+    g_terminal.write_line("--------  ------------");
+    for (uint32_t nr = 0; nr < NR_SOFTIRQS; nr++) {
+        i = 0;
+        append_name(softirq_get_name(nr), 8);
+        append_num(softirq_get_count(nr), 12);
+        buf[i] = '\0';
+        g_terminal.write_line(buf);
+    }
+    i = 0;
+    append_name("(ksoftirqd batches)", 19);
+    append_num(softirq_get_deferred_count(), 0);
+    buf[i] = '\0';
+    g_terminal.write_line(buf);
+    
+    g_terminal.write_line("");
+    g_terminal.write_line("Workqueue      Queued   Completed");
+    g_terminal.write_line("--------  ----------  ----------");
+    for (Workqueue* wq = workqueue_get_list(); wq; wq = wq->next) {
+        i = 0;
+        append_name(wq->name, 8);
+        append_num(wq->queued, 10);
+        append_num(wq->completed, 10);
+        buf[i] = '\0';
+        g_terminal.write_line(buf);
+    }
+}
+
+// latency [reset] - Show wakeup latency and preemption delay statistics
+static void cmd_latency(const char* args) {
+    while (args && *args == ' ') args++;
+    if (args && kstring::strcmp(args, "reset") == 0) {
+        scheduler_reset_latency();
+        g_terminal.write_line("Latency statistics reset");
+        return;
+    }
+    
+    SchedLatencyStats st;
+    scheduler_get_latency(&st);
+    
+    char buf[80];
+    int i;
+    auto append_str = [&](const char* s) {
+        while (*s && i < 70) buf[i++] = *s++;
+    };
+    auto append_num = [&](uint64_t n) {
+        char tmp[20];
+        int j = 0;
+        do { tmp[j++] = '0' + n % 10; n /= 10; } while (n > 0 && j < 20);
+        while (j > 0) buf[i++] = tmp[--j];
+    };
+    
+    i = 0;
+    append_str("Wakeups:      ");
+    append_num(st.samples);
+    buf[i] = '\0';
+    g_terminal.write_line(buf);
+    
+    i = 0;
+    append_str("Avg latency:  ");
+    append_num(st.samples ? scheduler_cycles_to_us(st.total_cycles / st.samples) : 0);
+    append_str(" us");
+    buf[i] = '\0';
+    g_terminal.write_line(buf);
+    
+    i = 0;
+    append_str("Max latency:  ");
+    append_num(scheduler_cycles_to_us(st.max_cycles));
+    append_str(" us");
+    if (st.max_pid) {
+        append_str(" (PID ");
+        append_num(st.max_pid);
+        append_str(" ");
+        append_str(st.max_name);
+        append_str(")");
+    }
+    buf[i] = '\0';
+    g_terminal.write_line(buf);
+    
+    i = 0;
+    append_str("Preemptions deferred: ");
+    append_num(st.preempt_deferred);
+    append_str(", max delay ");
+    append_num(scheduler_cycles_to_us(st.max_preempt_delay));
+    append_str(" us");
+    buf[i] = '\0';
+    g_terminal.write_line(buf);
+    
+    if (st.atomic_schedules) {
+        i = 0;
+        append_str("Scheduled while atomic: ");
+        append_num(st.atomic_schedules);
+        buf[i] = '\0';
+        g_terminal.write_line(buf);
+    }
+    
+    g_terminal.write_line("Histogram (us):");
+    uint64_t lo = 0, hi = 16;
+    for (int b = 0; b < SCHED_LAT_BUCKETS; b++) {
+        i = 0;
+        append_str("  ");
+        if (b == SCHED_LAT_BUCKETS - 1) {
+            append_str(">=");
+            append_num(lo);
+        } else {
+            append_num(lo);
+            append_str("-");
+            append_num(hi);
+        }
+        while (i < 16) buf[i++] = ' ';
+        append_num(st.hist[b]);
+        buf[i] = '\0';
+        g_terminal.write_line(buf);
+        lo = hi;
+        hi *= 4;
+    }
 }
 
 // =============================================================================
@@ -2842,8 +3369,9 @@ static void cmd_debug(const char* args) {
 static const CommandEntry commands[] = {
     // No-arg commands (exact match, no arguments)
     {"help",     CMD_NONE, cmd_help, nullptr, nullptr},
-    {"ls",       CMD_NONE, cmd_ls, nullptr, nullptr},
-    {"df",       CMD_NONE, cmd_df, nullptr, nullptr},
+        {"df",       CMD_NONE, cmd_df, nullptr, nullptr},
+    {"fsck",     CMD_NONE, cmd_fsck, nullptr, nullptr},
+    {"sync",     CMD_NONE, cmd_sync, nullptr, nullptr},
     {"mem",      CMD_NONE, cmd_mem, nullptr, nullptr},
     {"date",     CMD_NONE, cmd_date, nullptr, nullptr},
     {"uptime",   CMD_NONE, cmd_uptime, nullptr, nullptr},
@@ -2851,6 +3379,7 @@ static const CommandEntry commands[] = {
     {"uname",    CMD_NONE, cmd_uname, nullptr, nullptr},
     {"cpuinfo",  CMD_NONE, cmd_cpuinfo, nullptr, nullptr},
     {"lspci",    CMD_NONE, cmd_lspci, nullptr, nullptr},
+    {"lsblk",    CMD_NONE, cmd_lsblk, nullptr, nullptr},
     {"ifconfig", CMD_NONE, cmd_ifconfig, nullptr, nullptr},
     {"dhcp",     CMD_NONE, cmd_dhcp_request, nullptr, nullptr},
     {"env",      CMD_NONE, cmd_env, nullptr, nullptr},
@@ -2862,7 +3391,10 @@ static const CommandEntry commands[] = {
     {"cat",      CMD_ARGS, nullptr, cmd_cat, nullptr},
     {"stat",     CMD_ARGS, nullptr, cmd_stat, nullptr},
     {"hexdump",  CMD_ARGS, nullptr, cmd_hexdump, nullptr},
+    {"ls",       CMD_ARGS, nullptr, cmd_ls, nullptr},
     {"touch",    CMD_ARGS, nullptr, cmd_touch, nullptr},
+    {"mkdir",    CMD_ARGS, nullptr, cmd_mkdir, nullptr},
+    {"rmdir",    CMD_ARGS, nullptr, cmd_rmdir, nullptr},
     {"rm",       CMD_ARGS, nullptr, cmd_rm, nullptr},
     {"write",    CMD_ARGS, nullptr, cmd_write, nullptr},
     {"append",   CMD_ARGS, nullptr, cmd_append, nullptr},
@@ -2879,6 +3411,10 @@ static const CommandEntry commands[] = {
     {"echo",     CMD_ARGS, nullptr, cmd_echo, nullptr},
     {"debug",    CMD_ARGS, nullptr, cmd_debug, nullptr},
     {"exec",     CMD_ARGS, nullptr, cmd_exec, nullptr},
+    {"nice",     CMD_ARGS, nullptr, cmd_nice, nullptr},
+    {"lockstat", CMD_ARGS, nullptr, cmd_lockstat, nullptr},
+    {"softirqs", CMD_NONE, cmd_softirqs, nullptr, nullptr},
+    {"latency",  CMD_ARGS, nullptr, cmd_latency, nullptr},
     
     // Piped commands (support file arg or piped input)
     {"wc",       CMD_PIPED, nullptr, nullptr, cmd_wc},
@@ -3661,8 +4197,8 @@ void shell_process_char(char c) {
         } else if (cmd_len > 0) {
             // Command completion
             static const char* commands[] = {
-                "help", "ls", "cat", "stat", "hexdump", "touch", "rm", "write", "append", "df",
-                "mem", "date", "uptime", "version", "uname", "cpuinfo", "lspci",
+                "help", "ls", "cat", "stat", "hexdump", "touch", "mkdir", "rmdir", "rm", "write", "append", "df", "fsck",
+                "sync", "mem", "date", "uptime", "version", "uname", "cpuinfo", "lspci", "lsblk",
                 "ifconfig", "dhcp", "ping", "clear", "gui", "reboot", "poweroff", "echo",
                 "wc", "head", "tail", "grep", "sort", "uniq", "rev", "tac", "nl", "tr",
                 // Scripting commands (v0.5.0+)
@@ -1,44 +1,266 @@
+#!/usr/bin/env python3
+"""
+mkunifs.py - Build a uniFS boot image from a directory
+
+Writes a version 2 image (see kernel/fs/unifs.h):
+  Header  (32 bytes)  magic, entry count, image size, index CRC, header CRC
+  Entries (128 bytes) path, offset, size, data CRC, type - sorted by path
+  Data                each file starts on a 4 KB boundary
+
+Files matching a --compress pattern are stored as independent LZ4 blocks,
+which the kernel inflates on first access. A file is only kept compressed
+if that saves at least one page of the image.
+
+Usage: python3 tools/mkunifs.py [options] <source_dir> <output_file>
+  --compress GLOB    LZ4-compress files whose path matches (repeatable,
+                     e.g. --compress '*' or --compress 'sounds/*.wav')
+  --block-size N     Uncompressed bytes per LZ4 block (default 16384; a
+                     power of two from 4096 to 1048576)
+  --v1               Write the old unaligned format without checksums,
+                     directories or compression
+"""
+
+import fnmatch
 import os
 import struct
 import sys
 
-def create_unifs(source_dir, output_file):
-    files = []
-    for root, _, filenames in os.walk(source_dir):
-        for filename in filenames:
-            filepath = os.path.join(root, filename)
-            files.append((filename, filepath))
+ALIGN = 4096
+V2_HEADER = struct.Struct("<8sQQII")
+V2_ENTRY = struct.Struct("<104sQQII")
+V2_PATH_MAX = 103
+TYPE_FILE = 0
+TYPE_DIR = 1
+FLAG_LZ4 = 0x100
+LZ4_HEADER = struct.Struct("<II")   # Block size, block count
+DEFAULT_BLOCK_SIZE = 16384
+
+
+def _crc32c_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+        table.append(crc)
+    return table
+
+
+_CRC32C_TABLE = _crc32c_table()
+
+
+def crc32c(data):
+    """CRC-32C (Castagnoli), as computed by the kernel's crc32c()"""
+    crc = 0xFFFFFFFF
+    table = _CRC32C_TABLE
+    for b in data:
+        crc = (crc >> 8) ^ table[(crc ^ b) & 0xFF]
+    return crc ^ 0xFFFFFFFF
+
+
+# ----------------------------------------------------------------------------
+# LZ4 block format (see kernel/core/lz4.cpp)
+# ----------------------------------------------------------------------------
+
+LZ4_MIN_MATCH = 4
+LZ4_LAST_LITERALS = 5   # The last 5 bytes are always literals
+LZ4_MF_LIMIT = 12       # No match may start in the last 12 bytes
+LZ4_MAX_OFFSET = 65535
+
+
+def _lz4_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _lz4_sequence(out, literals, match_len, offset):
+    lit = len(literals)
+    token = (min(lit, 15) << 4)
+    if match_len:
+        token |= min(match_len - LZ4_MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        _lz4_length(out, lit - 15)
+    out += literals
+    if match_len:
+        out += struct.pack("<H", offset)
+        if match_len - LZ4_MIN_MATCH >= 15:
+            _lz4_length(out, match_len - LZ4_MIN_MATCH - 15)
+
+
+def lz4_compress(data):
+    """Greedy LZ4 block compression with a hash of 4-byte prefixes"""
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = n - LZ4_MF_LIMIT
+    while i < limit:
+        key = data[i:i + 4]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > LZ4_MAX_OFFSET:
+            i += 1
+            continue
+
+        # Extend the match, stopping short of the final literals
+        end = n - LZ4_LAST_LITERALS
+        length = 4
+        while i + length < end and data[cand + length] == data[i + length]:
+            length += 1
+
+        _lz4_sequence(out, data[anchor:i], length, i - cand)
+        i += length
+        anchor = i
+    _lz4_sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def lz4_decompress(src, size):
+    """Inverse of lz4_compress; raises ValueError on malformed input"""
+    out = bytearray()
+    i = 0
+
+    def length(n):
+        nonlocal i
+        if n != 15:
+            return n
+        while True:
+            if i >= len(src):
+                raise ValueError("truncated length")
+            b = src[i]
+            i += 1
+            n += b
+            if b != 255:
+                return n
+
+    while i < len(src):
+        token = src[i]
+        i += 1
+        lit = length(token >> 4)
+        if i + lit > len(src):
+            raise ValueError("truncated literals")
+        out += src[i:i + lit]
+        i += lit
+        if i == len(src):
+            break
+        if i + 2 > len(src):
+            raise ValueError("truncated offset")
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        if offset == 0 or offset > len(out):
+            raise ValueError("bad offset")
+        match_len = length(token & 0xF) + LZ4_MIN_MATCH
+        for _ in range(match_len):
+            out.append(out[-offset])
+        if len(out) > size:
+            raise ValueError("output too long")
+    if len(out) != size:
+        raise ValueError("output size mismatch")
+    return bytes(out)
+
+
+def align_up(n):
+    return (n + ALIGN - 1) & ~(ALIGN - 1)
+
+
+def lz4_pack(content, block_size):
+    """Stored form of a compressed file: header, block end table, blocks.
+    A block that doesn't shrink is stored raw (its stored length then
+    equals its uncompressed length)."""
+    blocks = []
+    for start in range(0, len(content), block_size):
+        raw = content[start:start + block_size]
+        packed = lz4_compress(raw)
+        blocks.append(packed if len(packed) < len(raw) else raw)
+
+    table = bytearray()
+    end = 0
+    for block in blocks:
+        end += len(block)
+        table += struct.pack("<I", end)
+    return LZ4_HEADER.pack(block_size, len(blocks)) + bytes(table) + b"".join(blocks)
+
+
+def lz4_unpack(stored, size):
+    """Inverse of lz4_pack; raises ValueError on malformed input"""
+    if len(stored) < LZ4_HEADER.size:
+        raise ValueError("truncated header")
+    block_size, count = LZ4_HEADER.unpack_from(stored, 0)
+    if block_size < ALIGN or block_size > 1 << 20 or block_size & (block_size - 1):
+        raise ValueError(f"bad block size {block_size}")
+    if count != (size + block_size - 1) // block_size:
+        raise ValueError(f"{count} blocks for {size} bytes")
+
+    base = LZ4_HEADER.size + 4 * count
+    ends = struct.unpack_from(f"<{count}I", stored, LZ4_HEADER.size) if count else ()
+    out = bytearray()
+    start = 0
+    for i, end in enumerate(ends):
+        if end < start or base + end > len(stored):
+            raise ValueError(f"block {i} outside data")
+        want = min(block_size, size - i * block_size)
+        block = stored[base + start:base + end]
+        out += block if len(block) == want else lz4_decompress(block, want)
+        start = end
+    return bytes(out)
+
+
+def lz4_stored_size(stored_prefix):
+    """Length of a compressed file's stored form, from its header and table"""
+    _, count = LZ4_HEADER.unpack_from(stored_prefix, 0)
+    last = struct.unpack_from("<I", stored_prefix, LZ4_HEADER.size + 4 * (count - 1))[0] if count else 0
+    return LZ4_HEADER.size + 4 * count + last
+
+
+def collect(source_dir):
+    """(path, filepath or None for a directory) for everything under source_dir"""
+    items = []
+    for root, dirnames, filenames in os.walk(source_dir):
+        for name in dirnames + filenames:
+            filepath = os.path.join(root, name)
+            # Entries are paths relative to the root ("bin/hello")
+            path = os.path.relpath(filepath, source_dir).replace(os.sep, '/')
+            items.append((path, None if name in dirnames else filepath))
+    return items
+
+
+def create_unifs_v1(source_dir, output_file):
+    files = [(path, fp) for path, fp in collect(source_dir) if fp]
 
     # Header: Magic (8 bytes), File Count (8 bytes)
     magic = b"UNIFS v1"
     file_count = len(files)
-    
+
     header = struct.pack("<8sQ", magic, file_count)
-    
+
     # Calculate offsets
     # Header size: 16 bytes
     # Entry size: 64 (name) + 8 (offset) + 8 (size) = 80 bytes
     current_offset = 16 + (file_count * 80)
-    
+
     entries = []
     data_blob = bytearray()
-    
+
     for name, filepath in files:
         with open(filepath, "rb") as f:
             content = f.read()
-            
+
         size = len(content)
-        
+
         # Entry: Name (64s), Offset (Q), Size (Q)
         # Pad name to 64 bytes
         name_bytes = name.encode('utf-8')
         if len(name_bytes) > 63:
-            print(f"Warning: Filename {name} truncated")
+            print(f"Warning: Path {name} truncated")
             name_bytes = name_bytes[:63]
-            
+
         entry = struct.pack("<64sQQ", name_bytes, current_offset, size)
         entries.append(entry)
-        
+
         data_blob.extend(content)
         current_offset += size
 
@@ -47,12 +269,98 @@ def create_unifs(source_dir, output_file):
         for entry in entries:
             f.write(entry)
         f.write(data_blob)
-        
+
     print(f"Created {output_file} with {file_count} files.")
 
-if __name__ == "__main__":
-    if len(sys.argv) < 3:
-        print("Usage: mkunifs.py <source_dir> <output_file>")
+
+def create_unifs_v2(source_dir, output_file, compress=(), block_size=DEFAULT_BLOCK_SIZE):
+    items = []
+    for path, filepath in collect(source_dir):
+        path_bytes = path.encode('utf-8')
+        if len(path_bytes) > V2_PATH_MAX:
+            print(f"Error: Path {path} longer than {V2_PATH_MAX} bytes")
+            sys.exit(1)
+        items.append((path_bytes, filepath))
+
+    # Bytewise order, as the kernel's strcmp() sees it: a directory sorts
+    # before everything inside it
+    items.sort(key=lambda item: item[0])
+
+    index_end = V2_HEADER.size + len(items) * V2_ENTRY.size
+    offset = align_up(index_end)
+
+    entries = bytearray()
+    data_blob = bytearray()
+    file_count = 0
+    compressed = 0
+    saved = 0
+    for path_bytes, filepath in items:
+        if filepath is None:
+            entries += V2_ENTRY.pack(path_bytes, 0, 0, 0, TYPE_DIR)
+            continue
+
+        with open(filepath, "rb") as f:
+            content = f.read()
+
+        # The checksum covers the bytes as stored
+        stored, kind = content, TYPE_FILE
+        path = path_bytes.decode('utf-8')
+        if content and any(fnmatch.fnmatchcase(path, pattern) for pattern in compress):
+            packed = lz4_pack(content, block_size)
+            if align_up(len(packed)) < align_up(len(content)):
+                saved += align_up(len(content)) - align_up(len(packed))
+                stored, kind = packed, TYPE_FILE | FLAG_LZ4
+                compressed += 1
+        entries += V2_ENTRY.pack(path_bytes, offset, len(content), crc32c(stored), kind)
+
+        # Pad to the next page so the following file starts on one
+        padded = align_up(len(stored))
+        data_blob += stored + bytes(padded - len(stored))
+        offset += padded
+        file_count += 1
+
+    image_size = align_up(index_end) + len(data_blob)
+    header = V2_HEADER.pack(b"UNIFS v2", len(items), image_size, crc32c(entries), 0)
+    header = header[:-4] + struct.pack("<I", crc32c(header[:-4]))
+
+    with open(output_file, "wb") as f:
+        f.write(header)
+        f.write(entries)
+        f.write(bytes(align_up(index_end) - index_end))
+        f.write(data_blob)
+
+    dir_count = len(items) - file_count
+    print(f"Created {output_file} with {file_count} files, {dir_count} directories.")
+    if compressed:
+        print(f"  {compressed} files compressed, {saved // 1024} KB saved.")
+
+
+def main():
+    args = sys.argv[1:]
+    v1 = False
+    compress = []
+    block_size = DEFAULT_BLOCK_SIZE
+    paths = []
+    while args:
+        arg = args.pop(0)
+        if arg == "--v1":
+            v1 = True
+        elif arg == "--compress" and args:
+            compress.append(args.pop(0))
+        elif arg == "--block-size" and args:
+            block_size = int(args.pop(0), 0)
+        else:
+            paths.append(arg)
+
+    if len(paths) != 2 or block_size < ALIGN or block_size > 1 << 20 or block_size & (block_size - 1):
+        print("Usage: mkunifs.py [--compress GLOB]... [--block-size N] [--v1] <source_dir> <output_file>")
         sys.exit(1)
-        
-    create_unifs(sys.argv[1], sys.argv[2])
+
+    if v1:
+        create_unifs_v1(paths[0], paths[1])
+    else:
+        create_unifs_v2(paths[0], paths[1], compress, block_size)
+
+
+if __name__ == "__main__":
+    main()
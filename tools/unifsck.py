@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+unifsck.py - Check a uniFS boot image
+
+Verifies what the kernel relies on: the magic, the header and index
+checksums, index order (sorted, no duplicates, parents before children),
+entry bounds, data alignment and every file's CRC32C. Compressed files
+are inflated in full and must come out at their recorded size. Version 1
+images are checked for bounds only (they carry no checksums).
+
+Usage: python3 tools/unifsck.py [-v] <image>
+  -v: List every entry
+Exit status: 0 if clean, 1 if problems were found.
+"""
+
+import struct
+import sys
+
+from mkunifs import (ALIGN, V2_HEADER, V2_ENTRY, TYPE_FILE, TYPE_DIR, FLAG_LZ4, LZ4_HEADER,
+                     crc32c, lz4_unpack, lz4_stored_size)
+
+
+class Checker:
+    def __init__(self, verbose):
+        self.verbose = verbose
+        self.problems = 0
+
+    def problem(self, path, what):
+        self.problems += 1
+        print(f"  {path or '<image>'}: {what}")
+
+    def info(self, line):
+        if self.verbose:
+            print(f"  {line}")
+
+
+def check_v1(image, c):
+    if len(image) < 16:
+        c.problem("", "truncated header")
+        return
+    count = struct.unpack_from("<Q", image, 8)[0]
+    if 16 + count * 80 > len(image):
+        c.problem("", f"{count} entries do not fit the image")
+        return
+
+    for i in range(count):
+        name, offset, size = struct.unpack_from("<64sQQ", image, 16 + i * 80)
+        path = name.split(b"\0", 1)[0].decode("utf-8", "replace")
+        c.info(f"{path} ({size} bytes)")
+        if offset + size > len(image):
+            c.problem(path, "data outside image")
+
+
+def check_v2(image, c):
+    if len(image) < V2_HEADER.size:
+        c.problem("", "truncated header")
+        return
+    _, count, image_size, index_crc, header_crc = V2_HEADER.unpack_from(image, 0)
+
+    if crc32c(image[:V2_HEADER.size - 4]) != header_crc:
+        c.problem("", "header checksum mismatch")
+        return
+    if image_size > len(image):
+        c.problem("", f"image size {image_size} exceeds file ({len(image)} bytes)")
+        return
+
+    index_end = V2_HEADER.size + count * V2_ENTRY.size
+    if index_end > image_size:
+        c.problem("", f"{count} entries do not fit the image")
+        return
+    if crc32c(image[V2_HEADER.size:index_end]) != index_crc:
+        c.problem("", "index checksum mismatch")
+        return
+
+    dirs = set()
+    prev = None
+    extents = []
+    for i in range(count):
+        raw, offset, size, crc, kind = V2_ENTRY.unpack_from(image, V2_HEADER.size + i * V2_ENTRY.size)
+        if b"\0" not in raw or raw[0] == 0:
+            c.problem("", f"entry {i}: bad path")
+            continue
+        path_bytes = raw.split(b"\0", 1)[0]
+        path = path_bytes.decode("utf-8", "replace")
+
+        if prev is not None and path_bytes <= prev:
+            c.problem(path, "index out of order or duplicate")
+        prev = path_bytes
+
+        parent = path_bytes.rsplit(b"/", 1)[0] if b"/" in path_bytes else None
+        if parent is not None and parent not in dirs:
+            c.problem(path, "parent directory missing or listed later")
+
+        if kind == TYPE_DIR:
+            c.info(f"{path}/")
+            dirs.add(path_bytes)
+            if size:
+                c.problem(path, "directory with data")
+            continue
+        if kind not in (TYPE_FILE, TYPE_FILE | FLAG_LZ4):
+            c.problem(path, f"unknown entry type {kind}")
+            continue
+
+        # Bytes as stored
+        stored_size = size
+        if kind & FLAG_LZ4:
+            if offset + LZ4_HEADER.size > image_size:
+                c.problem(path, "data outside image")
+                continue
+            blocks = LZ4_HEADER.unpack_from(image, offset)[1]
+            table_end = offset + LZ4_HEADER.size + 4 * blocks
+            if table_end > image_size:
+                c.problem(path, "block table outside image")
+                continue
+            stored_size = lz4_stored_size(image[offset:table_end])
+            c.info(f"{path} ({size} bytes, {stored_size} stored, LZ4, at {offset:#x})")
+        else:
+            c.info(f"{path} ({size} bytes at {offset:#x})")
+
+        if offset % ALIGN:
+            c.problem(path, "data not page-aligned")
+        if offset < index_end or offset + stored_size > image_size:
+            c.problem(path, "data outside image")
+            continue
+        stored = image[offset:offset + stored_size]
+        if crc32c(stored) != crc:
+            c.problem(path, "checksum mismatch")
+        elif kind & FLAG_LZ4:
+            try:
+                lz4_unpack(stored, size)
+            except ValueError as e:
+                c.problem(path, f"LZ4 data: {e}")
+        extents.append((offset, offset + stored_size, path))
+
+    extents.sort()
+    for (_, end, a), (start, _, b) in zip(extents, extents[1:]):
+        if start < end:
+            c.problem(b, f"data overlaps {a}")
+
+
+def main():
+    args = sys.argv[1:]
+    verbose = "-v" in args
+    args = [a for a in args if a != "-v"]
+    if len(args) != 1:
+        print("Usage: unifsck.py [-v] <image>")
+        sys.exit(2)
+
+    with open(args[0], "rb") as f:
+        image = f.read()
+
+    c = Checker(verbose)
+    magic = image[:8]
+    print(f"{args[0]}: {magic.decode('ascii', 'replace')}")
+    if magic == b"UNIFS v2":
+        check_v2(image, c)
+    elif magic == b"UNIFS v1":
+        check_v1(image, c)
+    else:
+        c.problem("", "not a uniFS image")
+
+    if c.problems:
+        print(f"{c.problems} problem(s) found.")
+        sys.exit(1)
+    print("No problems found.")
+
+
+if __name__ == "__main__":
+    main()
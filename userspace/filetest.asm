@@ -6,9 +6,10 @@ section .text
 global _start
 
 _start:
-    ; SYS_OPEN: open("hello.txt", 0, 0) -> fd in RAX
+    ; SYS_OPEN: open("hello.txt", O_RDONLY) -> fd in RAX
     mov rax, 2              ; SYS_OPEN
-    lea rbx, [rel filename]
+    lea rdi, [rel filename]
+    mov rsi, 0              ; O_RDONLY
     int 0x80
     
     ; Check if open failed
@@ -20,9 +21,9 @@ _start:
     
     ; SYS_READ: read(fd, buffer, 64) -> bytes in RAX
     mov rax, 0              ; SYS_READ
-    mov rbx, r12            ; fd
-    lea rcx, [rel buffer]   ; buffer
-    mov r8, 64              ; count
+    mov rdi, r12            ; fd
+    lea rsi, [rel buffer]   ; buffer
+    mov rdx, 64             ; count
     int 0x80
     
     ; Save bytes read
@@ -30,36 +31,38 @@ _start:
     
     ; SYS_WRITE: write(1, buffer, bytes_read)
     mov rax, 1              ; SYS_WRITE
-    mov rbx, 1              ; stdout
-    lea rcx, [rel buffer]   ; buffer
-    mov r8, r13             ; bytes read
+    mov rdi, 1              ; stdout
+    lea rsi, [rel buffer]   ; buffer
+    mov rdx, r13            ; bytes read
     int 0x80
     
     ; Print success message
     mov rax, 1
-    mov rbx, 1
-    lea rcx, [rel success]
-    mov r8, 15
+    mov rdi, 1
+    lea rsi, [rel success]
+    mov rdx, 15
     int 0x80
     
     ; SYS_CLOSE: close(fd)
     mov rax, 3              ; SYS_CLOSE
-    mov rbx, r12
+    mov rdi, r12
     int 0x80
     
     ; SYS_EXIT
     mov rax, 60
+    mov rdi, 0
     int 0x80
 
 .error:
     ; Print error message
     mov rax, 1
-    mov rbx, 1
-    lea rcx, [rel errmsg]
-    mov r8, 12
+    mov rdi, 1
+    lea rsi, [rel errmsg]
+    mov rdx, 12
     int 0x80
     
     mov rax, 60
+    mov rdi, 1
     int 0x80
 
 section .data
@@ -0,0 +1,104 @@
+; pipetest.asm - Zero-copy pipe demo for uniOS
+; Opens a non-blocking pipe and checks that reading it empty fails instead
+; of sleeping. Then gifts a page to the pipe with vmsplice (the page is
+; replaced by a zeroed one) and reads it back into a page-aligned buffer,
+; which maps the pipe's page there instead of copying it.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4
+
+bits 64
+section .text
+global _start
+
+SYS_READ          equ 0
+SYS_WRITE         equ 1
+SYS_EXIT          equ 60
+SYS_VMSPLICE      equ 278
+SYS_PIPE2         equ 293
+
+O_NONBLOCK        equ 0x800
+SPLICE_F_GIFT     equ 0x08
+
+PAGE_SIZE         equ 4096
+PATTERN           equ 'p'
+
+_start:
+    mov rax, SYS_PIPE2
+    lea rdi, [rel pipe_fds]
+    mov rsi, O_NONBLOCK
+    syscall
+    test rax, rax
+    jnz .fail
+
+    ; Empty non-blocking pipe: read fails at once
+    mov rax, SYS_READ
+    mov edi, [rel pipe_fds]
+    lea rsi, [rel dst_page]
+    mov rdx, PAGE_SIZE
+    syscall
+    cmp rax, -1
+    jne .fail
+
+    ; Fill the page to give away
+    lea rdi, [rel src_page]
+    mov al, PATTERN
+    mov rcx, PAGE_SIZE
+    rep stosb
+
+    lea rax, [rel src_page]
+    mov [rel iov], rax
+    mov qword [rel iov + 8], PAGE_SIZE
+    mov rax, SYS_VMSPLICE
+    mov edi, [rel pipe_fds + 4]
+    lea rsi, [rel iov]
+    mov rdx, 1
+    mov r10, SPLICE_F_GIFT
+    syscall
+    cmp rax, PAGE_SIZE
+    jne .fail
+
+    ; The gifted page was swapped for a zeroed one
+    cmp byte [rel src_page], 0
+    jne .fail
+
+    mov rax, SYS_READ
+    mov edi, [rel pipe_fds]
+    lea rsi, [rel dst_page]
+    mov rdx, PAGE_SIZE
+    syscall
+    cmp rax, PAGE_SIZE
+    jne .fail
+    cmp byte [rel dst_page], PATTERN
+    jne .fail
+    cmp byte [rel dst_page + PAGE_SIZE - 1], PATTERN
+    jne .fail
+
+    lea rsi, [rel msg_ok]
+    mov rdx, msg_ok_len
+    jmp .done
+
+.fail:
+    lea rsi, [rel msg_fail]
+    mov rdx, msg_fail_len
+
+.done:
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    syscall
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    syscall
+    jmp $
+
+section .rodata
+msg_ok: db "pipe: page moved through vmsplice and read", 0x0A
+msg_ok_len equ $ - msg_ok
+msg_fail: db "pipe: failed", 0x0A
+msg_fail_len equ $ - msg_fail
+
+section .bss align=4096
+src_page: resb PAGE_SIZE
+dst_page: resb PAGE_SIZE
+pipe_fds: resd 2
+iov: resq 2
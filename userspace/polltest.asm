@@ -0,0 +1,151 @@
+; polltest.asm - Readiness notification demo for uniOS
+; Watches the read end of a pipe with epoll, checks that nothing is ready,
+; then forks a child that writes one byte. The parent sleeps in epoll_wait
+; until the write wakes it, and confirms with poll() that the pipe is
+; readable.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4
+
+bits 64
+section .text
+global _start
+
+SYS_WRITE         equ 1
+SYS_POLL          equ 7
+SYS_PIPE          equ 22
+SYS_FORK          equ 57
+SYS_EXIT          equ 60
+SYS_WAIT4         equ 61
+SYS_EPOLL_WAIT    equ 232
+SYS_EPOLL_CTL     equ 233
+SYS_EPOLL_CREATE1 equ 291
+
+EPOLLIN           equ 0x001
+EPOLL_CTL_ADD     equ 1
+POLLIN            equ 0x001
+
+WATCH_DATA        equ 42
+WAIT_MS           equ 2000
+
+; EpollEvent (packed, 12 bytes)
+EV_EVENTS         equ 0
+EV_DATA           equ 4
+
+_start:
+    mov rax, SYS_PIPE
+    lea rdi, [rel pipe_fds]
+    syscall
+    test rax, rax
+    jnz .fail
+
+    mov rax, SYS_EPOLL_CREATE1
+    xor edi, edi
+    syscall
+    test rax, rax
+    js .fail
+    mov r12, rax                        ; epoll fd
+
+    ; Watch the read end for input
+    mov dword [rel watch + EV_EVENTS], EPOLLIN
+    mov qword [rel watch + EV_DATA], WATCH_DATA
+    mov rax, SYS_EPOLL_CTL
+    mov rdi, r12
+    mov rsi, EPOLL_CTL_ADD
+    mov edx, [rel pipe_fds]
+    lea r10, [rel watch]
+    syscall
+    test rax, rax
+    jnz .fail
+
+    ; Empty pipe: nothing ready yet
+    mov rax, SYS_EPOLL_WAIT
+    mov rdi, r12
+    lea rsi, [rel events]
+    mov rdx, 4
+    xor r10, r10
+    syscall
+    test rax, rax
+    jnz .fail
+
+    mov rax, SYS_FORK
+    syscall
+    test rax, rax
+    js .fail
+    jz .child
+
+    ; Parent: sleep until the child's write arrives
+    mov rax, SYS_EPOLL_WAIT
+    mov rdi, r12
+    lea rsi, [rel events]
+    mov rdx, 4
+    mov r10, WAIT_MS
+    syscall
+    cmp rax, 1
+    jne .fail
+    test dword [rel events + EV_EVENTS], EPOLLIN
+    jz .fail
+    cmp qword [rel events + EV_DATA], WATCH_DATA
+    jne .fail
+
+    ; poll() must agree
+    mov eax, [rel pipe_fds]
+    mov [rel pfd], eax
+    mov word [rel pfd + 4], POLLIN
+    mov rax, SYS_POLL
+    lea rdi, [rel pfd]
+    mov rsi, 1
+    xor edx, edx
+    syscall
+    cmp rax, 1
+    jne .fail
+    test word [rel pfd + 6], POLLIN
+    jz .fail
+
+    mov rax, SYS_WAIT4
+    mov rdi, -1
+    xor esi, esi
+    xor edx, edx
+    xor r10, r10
+    syscall
+
+    lea rsi, [rel msg_ok]
+    mov rdx, msg_ok_len
+    jmp .done
+
+.child:
+    mov rax, SYS_WRITE
+    mov edi, [rel pipe_fds + 4]
+    lea rsi, [rel byte_x]
+    mov rdx, 1
+    syscall
+    mov rax, SYS_EXIT
+    xor edi, edi
+    syscall
+    jmp $
+
+.fail:
+    lea rsi, [rel msg_fail]
+    mov rdx, msg_fail_len
+
+.done:
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    syscall
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    syscall
+    jmp $
+
+section .rodata
+byte_x: db "x"
+msg_ok: db "poll: woken by pipe write", 0x0A
+msg_ok_len equ $ - msg_ok
+msg_fail: db "poll: failed", 0x0A
+msg_fail_len equ $ - msg_fail
+
+section .bss
+pipe_fds: resd 2
+watch: resb 12
+events: resb 48
+pfd: resb 8
@@ -0,0 +1,204 @@
+; shmtest.asm - Shared memory demo for uniOS
+; Creates a /dev/shm object, maps it and sets up an SPSC ring in it, then
+; forks. The child opens the object again by name, maps its own view and
+; streams 1 MB through the ring; the parent consumes it and checks the
+; byte sum. Neither side makes a syscall per transfer.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4,
+; R8=arg5, R9=arg6
+
+bits 64
+section .text
+global _start
+
+SYS_WRITE         equ 1
+SYS_OPEN          equ 2
+SYS_CLOSE         equ 3
+SYS_MMAP          equ 9
+SYS_MUNMAP        equ 11
+SYS_FORK          equ 57
+SYS_EXIT          equ 60
+SYS_WAIT4         equ 61
+SYS_FTRUNCATE     equ 77
+SYS_UNLINK        equ 87
+
+O_RDWR            equ 0x002
+O_CREAT           equ 0x040
+O_EXCL            equ 0x080
+PROT_READ         equ 0x1
+PROT_WRITE        equ 0x2
+MAP_SHARED        equ 0x01
+
+RING_BYTES        equ 65536
+BLOCK             equ 4096
+TOTAL             equ 1024 * 1024
+; Each block holds 0..255 sixteen times
+EXPECTED_SUM      equ (TOTAL / 256) * (255 * 256 / 2)
+
+_start:
+    mov rax, SYS_OPEN
+    lea rdi, [rel shm_path]
+    mov rsi, O_CREAT | O_EXCL | O_RDWR
+    syscall
+    test rax, rax
+    js .fail
+    mov r12, rax                        ; fd
+
+    mov rax, SYS_FTRUNCATE
+    mov rdi, r12
+    mov rsi, RING_BYTES
+    syscall
+    test rax, rax
+    jnz .fail
+
+    call map_ring
+    js .fail
+    mov r13, rax                        ; Parent's view
+    mov rdi, r13
+    mov rsi, RING_BYTES
+    call spsc_init
+
+    mov rax, SYS_FORK
+    syscall
+    test rax, rax
+    js .fail
+    jz .child
+
+    ; Consumer: sum everything the child sends
+    xor r14, r14                        ; Bytes received
+    xor r15, r15                        ; Byte sum
+.consume:
+    mov rdi, r13
+    lea rsi, [rel block]
+    mov rdx, BLOCK
+    call spsc_read
+    test rax, rax
+    jnz .sum
+    pause
+    jmp .consume
+.sum:
+    add r14, rax
+    lea rsi, [rel block]
+    mov rcx, rax
+.sum_byte:
+    movzx edx, byte [rsi]
+    add r15, rdx
+    inc rsi
+    dec rcx
+    jnz .sum_byte
+    cmp r14, TOTAL
+    jb .consume
+
+    mov rax, SYS_WAIT4
+    mov rdi, -1
+    xor esi, esi
+    xor edx, edx
+    xor r10, r10
+    syscall
+
+    mov rax, SYS_MUNMAP
+    mov rdi, r13
+    mov rsi, RING_BYTES
+    syscall
+    mov rax, SYS_UNLINK
+    lea rdi, [rel shm_path]
+    syscall
+    test rax, rax
+    jnz .fail
+
+    mov rax, EXPECTED_SUM
+    cmp r15, rax
+    jne .fail
+    lea rsi, [rel msg_ok]
+    mov rdx, msg_ok_len
+    jmp .done
+
+.child:
+    ; A second view of the same object, found by name
+    mov rax, SYS_CLOSE
+    mov rdi, r12
+    syscall
+    mov rax, SYS_OPEN
+    lea rdi, [rel shm_path]
+    mov rsi, O_RDWR
+    syscall
+    test rax, rax
+    js .child_exit
+    mov r12, rax
+    call map_ring
+    js .child_exit
+    mov r13, rax
+
+    ; The pattern block
+    lea rdi, [rel block]
+    xor eax, eax
+.fill:
+    mov [rdi + rax], al
+    inc eax
+    cmp eax, BLOCK
+    jb .fill
+
+    xor r14, r14                        ; Bytes sent
+.produce:
+    mov rdi, r13
+    mov rax, r14
+    and rax, BLOCK - 1                  ; Resume mid-block after a short write
+    lea rsi, [rel block]
+    add rsi, rax
+    mov rdx, BLOCK
+    sub rdx, rax
+    call spsc_write
+    test rax, rax
+    jnz .sent
+    pause
+    jmp .produce
+.sent:
+    add r14, rax
+    cmp r14, TOTAL
+    jb .produce
+
+.child_exit:
+    mov rax, SYS_EXIT
+    xor edi, edi
+    syscall
+    jmp $
+
+.fail:
+    lea rsi, [rel msg_fail]
+    mov rdx, msg_fail_len
+
+.done:
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    syscall
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    syscall
+    jmp $
+
+; Map RING_BYTES of the object open as r12. RAX = address (sign flag set
+; on failure).
+map_ring:
+    mov rax, SYS_MMAP
+    xor edi, edi
+    mov rsi, RING_BYTES
+    mov rdx, PROT_READ | PROT_WRITE
+    mov r10, MAP_SHARED
+    mov r8, r12
+    xor r9, r9
+    syscall
+    test rax, rax
+    ret
+
+%include "spsc.inc"
+
+section .rodata
+shm_path: db "/dev/shm/spscdemo", 0
+msg_ok: db "shm: 1 MB streamed through a shared ring", 0x0A
+msg_ok_len equ $ - msg_ok
+msg_fail: db "shm: failed", 0x0A
+msg_fail_len equ $ - msg_fail
+
+section .bss
+block: resb BLOCK
@@ -0,0 +1,121 @@
+; sysbench.asm - Null-syscall round-trip benchmark for uniOS
+; Times ITERATIONS calls of getpid through the legacy int 0x80 gate and
+; through the SYSCALL/SYSRET fast path, and prints TSC cycles per call.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4
+; (SYSCALL additionally clobbers RCX and R11)
+
+bits 64
+section .text
+global _start
+
+SYS_WRITE  equ 1
+SYS_GETPID equ 39
+SYS_EXIT   equ 60
+
+ITERATIONS equ 100000
+
+_start:
+    ; Warm up both paths (TLB, caches, branch predictors)
+    mov rax, SYS_GETPID
+    int 0x80
+    mov rax, SYS_GETPID
+    syscall
+
+    ; --- int 0x80 ---
+    call read_tsc
+    mov r12, rax
+    mov rbx, ITERATIONS
+.loop_int:
+    mov rax, SYS_GETPID
+    int 0x80
+    dec rbx
+    jnz .loop_int
+    call read_tsc
+    sub rax, r12
+    mov r13, rax
+
+    ; --- SYSCALL ---
+    call read_tsc
+    mov r12, rax
+    mov rbx, ITERATIONS
+.loop_fast:
+    mov rax, SYS_GETPID
+    syscall
+    dec rbx
+    jnz .loop_fast
+    call read_tsc
+    sub rax, r12
+    mov r14, rax
+
+    lea rsi, [rel msg_int]
+    mov rdx, msg_int_len
+    call print
+    mov rax, r13
+    call print_per_call
+
+    lea rsi, [rel msg_fast]
+    mov rdx, msg_fast_len
+    call print
+    mov rax, r14
+    call print_per_call
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    syscall
+    jmp $
+
+; RAX = TSC (serialized against earlier instructions with lfence)
+read_tsc:
+    lfence
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+; RSI = buffer, RDX = length
+print:
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    syscall
+    ret
+
+; RAX = total cycles; prints "<total / ITERATIONS> cycles/call\n"
+print_per_call:
+    xor edx, edx
+    mov rcx, ITERATIONS
+    div rcx
+
+    ; Convert to decimal, filling num_buf from the end
+    lea rdi, [rel num_buf_end]
+    mov rcx, 10
+.digit:
+    xor edx, edx
+    div rcx
+    add dl, '0'
+    dec rdi
+    mov [rdi], dl
+    test rax, rax
+    jnz .digit
+
+    mov rsi, rdi
+    lea rdx, [rel num_buf_end]
+    sub rdx, rdi
+    call print
+
+    lea rsi, [rel msg_unit]
+    mov rdx, msg_unit_len
+    call print
+    ret
+
+section .rodata
+msg_int: db "int 0x80: "
+msg_int_len equ $ - msg_int
+msg_fast: db "syscall:  "
+msg_fast_len equ $ - msg_fast
+msg_unit: db " cycles/call", 0x0A
+msg_unit_len equ $ - msg_unit
+
+section .bss
+num_buf: resb 24
+num_buf_end:
@@ -0,0 +1,114 @@
+; threads.asm - Thread demo for uniOS
+; Creates a second thread with SYS_CLONE, gives it its own TLS block (FS base)
+; and joins it with SYS_FUTEX before reaping it with SYS_WAIT4.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4
+
+bits 64
+section .text
+global _start
+
+SYS_WRITE  equ 1
+SYS_CLONE  equ 56
+SYS_EXIT   equ 60
+SYS_WAIT4  equ 61
+SYS_FUTEX  equ 202
+
+FUTEX_WAIT equ 0
+FUTEX_WAKE equ 1
+
+_start:
+    ; TLS convention: the first word of the block points to itself, so
+    ; "mov rax, [fs:0]" yields the thread's TLS address
+    lea rax, [rel tls_block]
+    mov [rax], rax
+
+    ; clone(entry, stack, arg, tls)
+    mov rax, SYS_CLONE
+    lea rdi, [rel thread_main]
+    lea rsi, [rel thread_stack_top]
+    lea rdx, [rel msg_thread]
+    lea r10, [rel tls_block]
+    int 0x80
+    mov [rel tid], rax
+
+.wait:
+    ; Sleep until the thread flips `done` from 0 to 1
+    mov eax, [rel done]
+    test eax, eax
+    jnz .joined
+    mov rax, SYS_FUTEX
+    lea rdi, [rel done]
+    mov rsi, FUTEX_WAIT
+    mov rdx, 0              ; Only sleep while done == 0
+    int 0x80
+    jmp .wait
+
+.joined:
+    ; Reap the thread's task
+    mov rax, SYS_WAIT4
+    mov rdi, [rel tid]
+    mov rsi, 0
+    int 0x80
+
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    lea rsi, [rel msg_joined]
+    mov rdx, msg_joined_len
+    int 0x80
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    int 0x80
+    jmp $
+
+; Thread entry: RDI = arg (message), FS base = tls_block
+thread_main:
+    mov rsi, rdi
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    mov rdx, msg_thread_len
+    int 0x80
+
+    ; Check that FS-relative loads see our TLS block
+    mov rax, [fs:0]
+    lea rcx, [rel tls_block]
+    cmp rax, rcx
+    jne .bad_tls
+
+    ; done = 1; futex(&done, FUTEX_WAKE, 1)
+    mov dword [rel done], 1
+    mov rax, SYS_FUTEX
+    lea rdi, [rel done]
+    mov rsi, FUTEX_WAKE
+    mov rdx, 1
+    int 0x80
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    int 0x80
+    jmp $
+
+.bad_tls:
+    mov rax, SYS_EXIT
+    mov rdi, 1
+    int 0x80
+    jmp $
+
+section .rodata
+msg_thread: db "Hello from a thread!", 0x0A
+msg_thread_len equ $ - msg_thread
+msg_joined: db "Thread joined", 0x0A
+msg_joined_len equ $ - msg_joined
+
+section .data
+align 4
+done: dd 0
+align 8
+tid: dq 0
+
+section .bss
+align 16
+tls_block: resb 64
+thread_stack: resb 8192
+thread_stack_top:
@@ -0,0 +1,158 @@
+; timebench.asm - vDSO clock benchmark for uniOS
+; Times ITERATIONS calls of clock_gettime(CLOCK_MONOTONIC) through the vDSO
+; and through the syscall, prints TSC cycles per call for each, then checks
+; that the clock moved forward.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4
+; vDSO entry points use the normal System V calling convention
+
+bits 64
+section .text
+global _start
+
+SYS_WRITE         equ 1
+SYS_EXIT          equ 60
+SYS_CLOCK_GETTIME equ 228
+
+CLOCK_MONOTONIC   equ 1
+
+VDSO_CLOCK_GETTIME equ 0x00007FFFFFFF1000
+
+ITERATIONS equ 100000
+
+_start:
+    ; First reading, also warming up both paths
+    mov edi, CLOCK_MONOTONIC
+    lea rsi, [rel ts_start]
+    mov rax, VDSO_CLOCK_GETTIME
+    call rax
+    mov rax, SYS_CLOCK_GETTIME
+    mov rdi, CLOCK_MONOTONIC
+    lea rsi, [rel ts_now]
+    syscall
+
+    ; --- vDSO ---
+    call read_tsc
+    mov r12, rax
+    mov rbx, ITERATIONS
+.loop_vdso:
+    mov edi, CLOCK_MONOTONIC
+    lea rsi, [rel ts_now]
+    mov rax, VDSO_CLOCK_GETTIME
+    call rax
+    dec rbx
+    jnz .loop_vdso
+    call read_tsc
+    sub rax, r12
+    mov r13, rax
+
+    ; --- syscall ---
+    call read_tsc
+    mov r12, rax
+    mov rbx, ITERATIONS
+.loop_sys:
+    mov rax, SYS_CLOCK_GETTIME
+    mov rdi, CLOCK_MONOTONIC
+    lea rsi, [rel ts_now]
+    syscall
+    dec rbx
+    jnz .loop_sys
+    call read_tsc
+    sub rax, r12
+    mov r14, rax
+
+    lea rsi, [rel msg_vdso]
+    mov rdx, msg_vdso_len
+    call print
+    mov rax, r13
+    call print_per_call
+
+    lea rsi, [rel msg_sys]
+    mov rdx, msg_sys_len
+    call print
+    mov rax, r14
+    call print_per_call
+
+    ; The last reading must be later than the first
+    mov rax, [rel ts_now]
+    mov rdx, [rel ts_now + 8]
+    cmp rax, [rel ts_start]
+    ja .ok
+    jb .fail
+    cmp rdx, [rel ts_start + 8]
+    ja .ok
+.fail:
+    lea rsi, [rel msg_fail]
+    mov rdx, msg_fail_len
+    jmp .done
+.ok:
+    lea rsi, [rel msg_ok]
+    mov rdx, msg_ok_len
+.done:
+    call print
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    syscall
+    jmp $
+
+; RAX = TSC (serialized against earlier instructions with lfence)
+read_tsc:
+    lfence
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+; RSI = buffer, RDX = length
+print:
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    syscall
+    ret
+
+; RAX = total cycles; prints "<total / ITERATIONS> cycles/call\n"
+print_per_call:
+    xor edx, edx
+    mov rcx, ITERATIONS
+    div rcx
+
+    ; Convert to decimal, filling num_buf from the end
+    lea rdi, [rel num_buf_end]
+    mov rcx, 10
+.digit:
+    xor edx, edx
+    div rcx
+    add dl, '0'
+    dec rdi
+    mov [rdi], dl
+    test rax, rax
+    jnz .digit
+
+    mov rsi, rdi
+    lea rdx, [rel num_buf_end]
+    sub rdx, rdi
+    call print
+
+    lea rsi, [rel msg_unit]
+    mov rdx, msg_unit_len
+    call print
+    ret
+
+section .rodata
+msg_vdso: db "vdso:    "
+msg_vdso_len equ $ - msg_vdso
+msg_sys: db "syscall: "
+msg_sys_len equ $ - msg_sys
+msg_unit: db " cycles/call", 0x0A
+msg_unit_len equ $ - msg_unit
+msg_ok: db "clock: monotonic ok", 0x0A
+msg_ok_len equ $ - msg_ok
+msg_fail: db "clock: did not advance", 0x0A
+msg_fail_len equ $ - msg_fail
+
+section .bss
+ts_start: resq 2
+ts_now: resq 2
+num_buf: resb 24
+num_buf_end:
@@ -0,0 +1,117 @@
+; uringtest.asm - Asynchronous I/O ring demo for uniOS
+; Sets up a ring, queues two console writes and a NOP, submits them all
+; with one io_uring_enter and checks that three completions came back.
+;
+; Syscall convention: RAX=syscall, RDI=arg1, RSI=arg2, RDX=arg3, R10=arg4
+
+bits 64
+section .text
+global _start
+
+SYS_WRITE          equ 1
+SYS_EXIT           equ 60
+SYS_IO_URING_SETUP equ 425
+SYS_IO_URING_ENTER equ 426
+
+URING_OP_NOP       equ 0
+URING_OP_WRITE     equ 2
+URING_ENTER_GETEVENTS equ 1
+
+; UringParams
+PARAMS_RINGS equ 8
+PARAMS_SQES  equ 16
+
+; UringRings
+RINGS_SQ_TAIL equ 4
+RINGS_CQ_TAIL equ 20
+
+; UringSqe (40 bytes)
+SQE_SIZE      equ 40
+SQE_OPCODE    equ 0
+SQE_FD        equ 4
+SQE_OFF       equ 8
+SQE_ADDR      equ 16
+SQE_LEN       equ 24
+SQE_USER_DATA equ 32
+
+_start:
+    mov rax, SYS_IO_URING_SETUP
+    mov rdi, 8
+    lea rsi, [rel params]
+    syscall
+    test rax, rax
+    js .fail
+    mov r12, rax                        ; Ring fd
+
+    mov r13, [rel params + PARAMS_RINGS]
+    mov rbx, [rel params + PARAMS_SQES]
+
+    ; SQE 0: write msg_one to stdout at the current position
+    mov byte [rbx + SQE_OPCODE], URING_OP_WRITE
+    mov dword [rbx + SQE_FD], 1
+    mov qword [rbx + SQE_OFF], -1
+    lea rax, [rel msg_one]
+    mov [rbx + SQE_ADDR], rax
+    mov dword [rbx + SQE_LEN], msg_one_len
+    mov qword [rbx + SQE_USER_DATA], 1
+
+    ; SQE 1: NOP
+    add rbx, SQE_SIZE
+    mov byte [rbx + SQE_OPCODE], URING_OP_NOP
+    mov qword [rbx + SQE_USER_DATA], 2
+
+    ; SQE 2: write msg_two
+    add rbx, SQE_SIZE
+    mov byte [rbx + SQE_OPCODE], URING_OP_WRITE
+    mov dword [rbx + SQE_FD], 1
+    mov qword [rbx + SQE_OFF], -1
+    lea rax, [rel msg_two]
+    mov [rbx + SQE_ADDR], rax
+    mov dword [rbx + SQE_LEN], msg_two_len
+    mov qword [rbx + SQE_USER_DATA], 3
+
+    ; Publish all three (x86 stores are not reordered with older stores)
+    mov dword [r13 + RINGS_SQ_TAIL], 3
+
+    mov rax, SYS_IO_URING_ENTER
+    mov rdi, r12
+    mov rsi, 3
+    mov rdx, 3
+    mov r10, URING_ENTER_GETEVENTS
+    syscall
+    cmp rax, 3
+    jne .fail
+
+    cmp dword [r13 + RINGS_CQ_TAIL], 3
+    jne .fail
+
+    lea rsi, [rel msg_ok]
+    mov rdx, msg_ok_len
+    jmp .done
+
+.fail:
+    lea rsi, [rel msg_fail]
+    mov rdx, msg_fail_len
+
+.done:
+    mov rax, SYS_WRITE
+    mov rdi, 1
+    syscall
+
+    mov rax, SYS_EXIT
+    mov rdi, 0
+    syscall
+    jmp $
+
+section .rodata
+msg_one: db "uring: first write", 0x0A
+msg_one_len equ $ - msg_one
+msg_two: db "uring: second write", 0x0A
+msg_two_len equ $ - msg_two
+msg_ok: db "uring: 3 completions", 0x0A
+msg_ok_len equ $ - msg_ok
+msg_fail: db "uring: failed", 0x0A
+msg_fail_len equ $ - msg_fail
+
+section .bss
+params: resb 32